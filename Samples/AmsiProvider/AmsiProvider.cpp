@@ -1,4 +1,6 @@
 #include "stdafx.h"
+#include "ScanCache.h"
+#include "SignatureScanner.h"
 
 using namespace Microsoft::WRL;
 
@@ -82,8 +84,25 @@ public:
     IFACEMETHOD(DisplayName)(_Outptr_ LPWSTR* displayName) override;
 
 private:
+    std::shared_ptr<const SignatureSet> GetSignatures(_Out_ ULONG* generation);
+    void LoadSignaturesIfChanged();
+    void LogCacheStatistics();
+
     // We assign each Scan request a unique number for logging purposes.
     LONG m_requestNumber = 0;
+
+    // Loaded on first use, from the signature file next to the DLL, and again whenever the file changes.
+    // m_signaturesLock guards the current set; m_loadLock lets one thread at a time load a new one.
+    SRWLOCK m_signaturesLock = SRWLOCK_INIT;
+    SRWLOCK m_loadLock = SRWLOCK_INIT;
+    std::shared_ptr<const SignatureSet> m_signatures;
+    ULONG m_signaturesGeneration = 0;
+    FILETIME m_signaturesWriteTime = {};
+    volatile LONG64 m_signaturesChecked = 0;
+
+    // Results of earlier scans, by session and content digest.
+    ScanCache m_cache{ 4096 };
+    volatile LONG m_cacheLookups = 0;
 };
 
 template<typename T>
@@ -116,16 +135,172 @@ HeapMemPtr<wchar_t> GetStringAttribute(_In_ IAmsiStream* stream, _In_ AMSI_ATTRI
     return HeapMemPtr<wchar_t>();
 }
 
-BYTE CalculateBufferXor(_In_ LPCBYTE buffer, _In_ ULONGLONG size)
+constexpr wchar_t SignatureFileName[] = L"AmsiSignatures.txt";
+
+// How often, in milliseconds, to check whether the signature file has changed.
+constexpr LONG64 SignatureCheckInterval = 5000;
+
+HRESULT GetSignatureFilePath(_Out_writes_(MAX_PATH) PWSTR path)
+{
+    path[0] = L'\0';
+    DWORD length = GetModuleFileName(g_currentModule, path, MAX_PATH);
+    PWSTR fileName = (length > 0 && length < MAX_PATH) ? wcsrchr(path, L'\\') : nullptr;
+    return fileName ? StringCchCopy(fileName + 1, MAX_PATH - (fileName + 1 - path), SignatureFileName) : E_UNEXPECTED;
+}
+
+std::shared_ptr<const SignatureSet> LoadSignatures(_In_ HRESULT pathResult, _In_ PCWSTR path)
+{
+    try
+    {
+        auto signatures = std::make_shared<SignatureSet>();
+
+        HRESULT hr = pathResult;
+        ULONG errorLine = 0;
+        if (SUCCEEDED(hr))
+        {
+            hr = signatures->LoadFromFile(path, &errorLine);
+        }
+
+        if (FAILED(hr))
+        {
+            // Carry on with no signatures rather than failing (or retrying) every scan.
+            TraceLoggingWrite(g_traceLoggingProvider, "Signatures not loaded",
+                TraceLoggingWideString(path, "Path"),
+                TraceLoggingValue(errorLine, "Line"),
+                TraceLoggingValue(hr));
+            return std::make_shared<SignatureSet>();
+        }
+
+        TraceLoggingWrite(g_traceLoggingProvider, "Signatures loaded",
+            TraceLoggingWideString(path, "Path"),
+            TraceLoggingValue(signatures->SignatureCount(), "Signatures"),
+            TraceLoggingValue(signatures->StateCount(), "States"),
+            TraceLoggingUInt64(signatures->MemoryUsage(), "Bytes"));
+        return signatures;
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+// Called with m_loadLock held exclusively.
+void SampleAmsiProvider::LoadSignaturesIfChanged()
+{
+    wchar_t path[MAX_PATH];
+    HRESULT hr = GetSignatureFilePath(path);
+
+    // A missing file has a zero write time, so one that turns up later is loaded then.
+    FILETIME writeTime = {};
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (SUCCEEDED(hr) && GetFileAttributesEx(path, GetFileExInfoStandard, &data))
+    {
+        writeTime = data.ftLastWriteTime;
+    }
+
+    if (m_signatures && CompareFileTime(&writeTime, &m_signaturesWriteTime) == 0)
+    {
+        return;
+    }
+
+    auto signatures = LoadSignatures(hr, path);
+    if (!signatures)
+    {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&m_signaturesLock);
+    m_signatures = std::move(signatures);
+    m_signaturesGeneration++;
+    m_signaturesWriteTime = writeTime;
+    ReleaseSRWLockExclusive(&m_signaturesLock);
+
+    // Cached results from the old signatures no longer match the generation, so lookups would discard
+    // them anyway. Dropping them now frees the memory.
+    m_cache.Clear();
+}
+
+std::shared_ptr<const SignatureSet> SampleAmsiProvider::GetSignatures(_Out_ ULONG* generation)
+{
+    // Every so often, one thread checks whether the signature file has changed. Other threads carry on
+    // scanning with the current signatures while it loads the new ones.
+    const LONG64 now = static_cast<LONG64>(GetTickCount64());
+    const LONG64 checked = m_signaturesChecked;
+    if (now - checked >= SignatureCheckInterval &&
+        InterlockedCompareExchange64(&m_signaturesChecked, now, checked) == checked)
+    {
+        AcquireSRWLockExclusive(&m_loadLock);
+        LoadSignaturesIfChanged();
+        ReleaseSRWLockExclusive(&m_loadLock);
+    }
+
+    AcquireSRWLockShared(&m_signaturesLock);
+    auto signatures = m_signatures;
+    *generation = m_signaturesGeneration;
+    ReleaseSRWLockShared(&m_signaturesLock);
+    if (signatures)
+    {
+        return signatures;
+    }
+
+    // Nothing is loaded yet: either another thread is loading the first set, or loading ran out of memory.
+    AcquireSRWLockExclusive(&m_loadLock);
+    if (!m_signatures)
+    {
+        LoadSignaturesIfChanged();
+    }
+    signatures = m_signatures;
+    *generation = m_signaturesGeneration;
+    ReleaseSRWLockExclusive(&m_loadLock);
+    return signatures;
+}
+
+void SampleAmsiProvider::LogCacheStatistics()
+{
+    const auto statistics = m_cache.GetStatistics();
+    const ULONGLONG lookups = statistics.hits + statistics.misses;
+    TraceLoggingWrite(g_traceLoggingProvider, "Scan cache",
+        TraceLoggingUInt64(statistics.hits, "Hits"),
+        TraceLoggingUInt64(statistics.misses, "Misses"),
+        TraceLoggingFloat64(lookups ? 100.0 * statistics.hits / lookups : 0, "Hit Rate Percent"),
+        TraceLoggingUInt64(statistics.entries, "Entries"),
+        TraceLoggingFloat64(statistics.averageDigestMicroseconds, "Average Digest Microseconds"),
+        TraceLoggingFloat64(statistics.averageLookupMicroseconds, "Average Lookup Microseconds"));
+}
+
+// Streams are read through a large window that each thread allocates once and then reuses.
+constexpr ULONG ReadWindowSize = 256 * 1024;
+
+PBYTE GetReadWindow()
+{
+    thread_local std::unique_ptr<BYTE[]> window(new (std::nothrow) BYTE[ReadWindowSize]);
+    return window.get();
+}
+
+// Reads up to size bytes from the start of the stream into the buffer.
+HRESULT ReadContent(_In_ IAmsiStream* stream, _In_ ULONG size, _Out_writes_bytes_to_(size, *readSize) PBYTE buffer, _Out_ ULONG* readSize)
 {
-    BYTE value = 0;
-    for (ULONGLONG i = 0; i < size; i++)
+    *readSize = 0;
+    while (*readSize < size)
     {
-        value ^= buffer[i];
+        ULONG chunkSize;
+        HRESULT hr = stream->Read(*readSize, size - *readSize, buffer + *readSize, &chunkSize);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        if (chunkSize == 0)
+        {
+            break;
+        }
+        *readSize += chunkSize;
     }
-    return value;
+    return S_OK;
 }
 
+// Log the cache statistics every this many lookups.
+constexpr LONG CacheStatisticsInterval = 1024;
+
 HRESULT SampleAmsiProvider::Scan(_In_ IAmsiStream* stream, _Out_ AMSI_RESULT* result)
 {
     LONG requestNumber = InterlockedIncrement(&m_requestNumber);
@@ -134,7 +309,7 @@ HRESULT SampleAmsiProvider::Scan(_In_ IAmsiStream* stream, _Out_ AMSI_RESULT* re
     auto appName = GetStringAttribute(stream, AMSI_ATTRIBUTE_APP_NAME);
     auto contentName = GetStringAttribute(stream, AMSI_ATTRIBUTE_CONTENT_NAME);
     auto contentSize = GetFixedSizeAttribute<ULONGLONG>(stream, AMSI_ATTRIBUTE_CONTENT_SIZE);
-    auto session = GetFixedSizeAttribute<ULONGLONG>(stream, AMSI_ATTRIBUTE_SESSION);
+    auto session = static_cast<ULONGLONG>(reinterpret_cast<ULONG_PTR>(GetFixedSizeAttribute<HAMSISESSION>(stream, AMSI_ATTRIBUTE_SESSION)));
     auto contentAddress = GetFixedSizeAttribute<PBYTE>(stream, AMSI_ATTRIBUTE_CONTENT_ADDRESS);
 
     TraceLoggingWrite(g_traceLoggingProvider, "Attributes",
@@ -145,33 +320,88 @@ HRESULT SampleAmsiProvider::Scan(_In_ IAmsiStream* stream, _Out_ AMSI_RESULT* re
         TraceLoggingUInt64(session, "Session"),
         TraceLoggingPointer(contentAddress, "Content Address"));
 
-    if (contentAddress)
+    *result = AMSI_RESULT_NOT_DETECTED;
+
+    ULONG generation;
+    auto signatures = GetSignatures(&generation);
+    if (!signatures)
     {
-        // The data to scan is provided in the form of a memory buffer.
-        auto result = CalculateBufferXor(contentAddress, contentSize);
-        TraceLoggingWrite(g_traceLoggingProvider, "Memory xor",
-            TraceLoggingValue(requestNumber),
-            TraceLoggingValue(result));
+        return E_OUTOFMEMORY;
     }
-    else
+
+    PBYTE window = nullptr;
+    if (!contentAddress)
     {
-        // Provided as a stream. Read it stream a chunk at a time.
-        BYTE cumulativeXor = 0;
-        BYTE chunk[1024];
-        ULONG readSize;
-        for (ULONGLONG position = 0; position < contentSize; position += readSize)
+        window = GetReadWindow();
+        if (!window)
         {
-            HRESULT hr = stream->Read(position, sizeof(chunk), chunk, &readSize);
-            if (SUCCEEDED(hr))
+            return E_OUTOFMEMORY;
+        }
+    }
+
+    ULONG match = SignatureSet::NoMatch;
+    SignatureSet::ScanState state = SignatureSet::InitialState;
+    if (contentAddress || contentSize <= ReadWindowSize)
+    {
+        // The content is at hand in one piece: either it is provided in the form of a memory buffer,
+        // which we scan in place, or it is a stream small enough to read in one go.
+        LPCBYTE content = contentAddress;
+        SIZE_T size = static_cast<SIZE_T>(contentSize);
+        bool complete = true;
+        if (!content)
+        {
+            ULONG readSize;
+            HRESULT hr = ReadContent(stream, static_cast<ULONG>(contentSize), window, &readSize);
+            if (FAILED(hr))
             {
-                cumulativeXor ^= CalculateBufferXor(chunk, readSize);
-                TraceLoggingWrite(g_traceLoggingProvider, "Read chunk",
+                TraceLoggingWrite(g_traceLoggingProvider, "Read failed",
                     TraceLoggingValue(requestNumber),
-                    TraceLoggingValue(position),
-                    TraceLoggingValue(readSize),
-                    TraceLoggingValue(cumulativeXor));
+                    TraceLoggingValue(readSize, "position"),
+                    TraceLoggingValue(hr));
             }
-            else
+            complete = SUCCEEDED(hr) && readSize == contentSize;
+            content = window;
+            size = readSize;
+        }
+
+        // Script hosts submit the same content over and over (PowerShell, for example, scans every
+        // command it runs), so look for the result of an earlier scan of it first.
+        ScanCache::Key key;
+        key.session = session;
+        const bool cacheable = complete && SUCCEEDED(m_cache.ComputeDigest(content, size, &key));
+        if (cacheable)
+        {
+            const bool hit = m_cache.Lookup(key, generation, result);
+            if (InterlockedIncrement(&m_cacheLookups) % CacheStatisticsInterval == 0)
+            {
+                LogCacheStatistics();
+            }
+            if (hit)
+            {
+                TraceLoggingWrite(g_traceLoggingProvider, "Cache hit",
+                    TraceLoggingValue(requestNumber),
+                    TraceLoggingValue(static_cast<int>(*result), "Result"));
+                TraceLoggingWrite(g_traceLoggingProvider, "Scan End", TraceLoggingValue(requestNumber));
+                return S_OK;
+            }
+        }
+
+        match = signatures->Scan(&state, content, size);
+
+        if (cacheable)
+        {
+            m_cache.Insert(key, generation, (match != SignatureSet::NoMatch) ? AMSI_RESULT_DETECTED : AMSI_RESULT_NOT_DETECTED);
+        }
+    }
+    else
+    {
+        // A large stream. Read it a window at a time; the scan state carries signatures that straddle
+        // two windows. Its result is not cached, since digesting it would mean reading it twice.
+        ULONG readSize;
+        for (ULONGLONG position = 0; position < contentSize && match == SignatureSet::NoMatch; position += readSize)
+        {
+            HRESULT hr = stream->Read(position, ReadWindowSize, window, &readSize);
+            if (FAILED(hr))
             {
                 TraceLoggingWrite(g_traceLoggingProvider, "Read failed",
                     TraceLoggingValue(requestNumber),
@@ -179,13 +409,28 @@ HRESULT SampleAmsiProvider::Scan(_In_ IAmsiStream* stream, _Out_ AMSI_RESULT* re
                     TraceLoggingValue(hr));
                 break;
             }
+            if (readSize == 0)
+            {
+                break;
+            }
+
+            match = signatures->Scan(&state, window, readSize);
         }
     }
 
+    if (match != SignatureSet::NoMatch)
+    {
+        TraceLoggingWrite(g_traceLoggingProvider, "Detected",
+            TraceLoggingValue(requestNumber),
+            TraceLoggingString(signatures->SignatureName(match), "Signature"));
+
+        // AMSI_RESULT_DETECTED means "This is malware; block it."
+        *result = AMSI_RESULT_DETECTED;
+    }
+
     TraceLoggingWrite(g_traceLoggingProvider, "Scan End", TraceLoggingValue(requestNumber));
 
     // AMSI_RESULT_NOT_DETECTED means "We did not detect a problem but let other providers scan it, too."
-    *result = AMSI_RESULT_NOT_DETECTED;
     return S_OK;
 }
 
@@ -193,6 +438,10 @@ void SampleAmsiProvider::CloseSession(_In_ ULONGLONG session)
 {
     TraceLoggingWrite(g_traceLoggingProvider, "Close session",
         TraceLoggingValue(session));
+
+    // The session's results will not be asked for again.
+    m_cache.RemoveSession(session);
+    LogCacheStatistics();
 }
 
 HRESULT SampleAmsiProvider::DisplayName(_Outptr_ LPWSTR *displayName)
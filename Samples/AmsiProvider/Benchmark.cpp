@@ -0,0 +1,143 @@
+#include "stdafx.h"
+#include "SignatureScanner.h"
+
+// rundll32 AmsiProvider.dll,Benchmark [signatureCount [corpusMegabytes]]
+//
+// Compiles a set of random signatures and reports how fast a synthetic script corpus (UTF-16, as
+// script hosts submit it) is scanned when none of them is present, which is the common case and
+// the worst one, since the whole buffer is read. The corpus is scanned in place, as content
+// passed by address is, and through the 256 KB read window used for streams.
+// Results are written to the console rundll32 was started from.
+
+namespace
+{
+    constexpr char SignatureAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    const char* const ScriptTokens[] =
+    {
+        "function ", "$env:", "Get-ChildItem ", "-Path ", "if (", "} else {", "\r\n    ", "Write-Host \"",
+        "\"", " = ", "; ", "(", ")", "foreach ($item in ", "return ", "-eq ", "$_", "[string]", "| Where-Object { ",
+    };
+
+    std::string RandomString(_Inout_ std::mt19937& random, _In_ size_t length, _In_ PCSTR alphabet, _In_ size_t alphabetSize)
+    {
+        std::string result(length, '\0');
+        for (auto& c : result)
+        {
+            c = alphabet[random() % alphabetSize];
+        }
+        return result;
+    }
+
+    std::vector<BYTE> MakeScriptCorpus(_Inout_ std::mt19937& random, _In_ size_t size)
+    {
+        // Identifiers are drawn from a vocabulary with a skewed distribution, like real scripts.
+        std::vector<std::string> vocabulary;
+        for (int i = 0; i < 5000; i++)
+        {
+            vocabulary.push_back(RandomString(random, 2 + random() % 10, "abcdefghijklmnopqrstuvwxyz", 26));
+        }
+
+        std::vector<BYTE> corpus;
+        corpus.reserve(size + 64);
+        while (corpus.size() < size)
+        {
+            std::string token;
+            if (random() % 3 == 0)
+            {
+                token = ScriptTokens[random() % ARRAYSIZE(ScriptTokens)];
+            }
+            else
+            {
+                const size_t rank = random() % vocabulary.size();
+                token = vocabulary[rank * rank / vocabulary.size()] + " ";
+            }
+
+            for (char c : token)
+            {
+                corpus.push_back(static_cast<BYTE>(c));
+                corpus.push_back(0);
+            }
+        }
+        corpus.resize(size);
+        return corpus;
+    }
+
+    double Seconds(_In_ const LARGE_INTEGER& start, _In_ const LARGE_INTEGER& end)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+    }
+}
+
+extern "C" void CALLBACK Benchmark(_In_ HWND, _In_ HINSTANCE, _In_ LPSTR commandLine, _In_ int)
+{
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        FILE* console;
+        freopen_s(&console, "CONOUT$", "w", stdout);
+    }
+
+    ULONG signatureCount = 100000;
+    ULONG corpusMegabytes = 64;
+    sscanf_s(commandLine, "%lu %lu", &signatureCount, &corpusMegabytes);
+
+    std::mt19937 random(1);
+
+    std::vector<SignatureSet::Signature> signatures(signatureCount);
+    for (auto& signature : signatures)
+    {
+        signature.bytes = RandomString(random, 16 + random() % 24, SignatureAlphabet, sizeof(SignatureAlphabet) - 1);
+        signature.name = signature.bytes;
+        signature.text = true;
+    }
+
+    LARGE_INTEGER start, end;
+    SignatureSet set;
+    QueryPerformanceCounter(&start);
+    HRESULT hr = set.Compile(signatures);
+    QueryPerformanceCounter(&end);
+    if (FAILED(hr))
+    {
+        printf("Compile failed with 0x%x\n", hr);
+        return;
+    }
+    printf("Compiled %lu signatures in %.2f s: %lu states, %.1f MB\n",
+        set.SignatureCount(), Seconds(start, end), set.StateCount(), set.MemoryUsage() / (1024.0 * 1024.0));
+
+    const std::vector<BYTE> corpus = MakeScriptCorpus(random, static_cast<size_t>(corpusMegabytes) * 1024 * 1024);
+    const double megabytes = corpus.size() / (1024.0 * 1024.0);
+
+    // Best of three runs, to keep the first touch of the tables out of the numbers.
+    double best = 0;
+    ULONG match = SignatureSet::NoMatch;
+    for (int run = 0; run < 3; run++)
+    {
+        SignatureSet::ScanState state = SignatureSet::InitialState;
+        QueryPerformanceCounter(&start);
+        match = set.Scan(&state, corpus.data(), corpus.size());
+        QueryPerformanceCounter(&end);
+        best = (std::max)(best, megabytes / Seconds(start, end));
+    }
+    printf("In place:        %8.0f MB/s%s\n", best, (match != SignatureSet::NoMatch) ? " (found a signature)" : "");
+
+    constexpr size_t WindowSize = 256 * 1024;
+    std::unique_ptr<BYTE[]> window(new BYTE[WindowSize]);
+    best = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        SignatureSet::ScanState state = SignatureSet::InitialState;
+        match = SignatureSet::NoMatch;
+        QueryPerformanceCounter(&start);
+        for (size_t position = 0; position < corpus.size() && match == SignatureSet::NoMatch; position += WindowSize)
+        {
+            const size_t size = (std::min)(WindowSize, corpus.size() - position);
+            memcpy(window.get(), corpus.data() + position, size);
+            match = set.Scan(&state, window.get(), size);
+        }
+        QueryPerformanceCounter(&end);
+        best = (std::max)(best, megabytes / Seconds(start, end));
+    }
+    printf("256 KB windows:  %8.0f MB/s%s\n", best, (match != SignatureSet::NoMatch) ? " (found a signature)" : "");
+}
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "ScanCache.h"
+
+constexpr ULONG ScanCache::DigestSize;
+constexpr ULONG ScanCache::ShardCount;
+
+namespace
+{
+    LONGLONG Now()
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+}
+
+ScanCache::ScanCache(_In_ SIZE_T capacity) :
+    m_shardCapacity((std::max)(capacity / ShardCount, static_cast<SIZE_T>(1)))
+{
+}
+
+HRESULT ScanCache::ComputeDigest(_In_reads_bytes_(size) LPCBYTE content, _In_ SIZE_T size, _Inout_ Key* key)
+{
+    // The digest stands in for the content, so it has to be one that nobody can find a collision for:
+    // otherwise a script could be crafted to match the digest of harmless content scanned earlier.
+    const LONGLONG start = Now();
+
+    BCRYPT_HASH_HANDLE hash;
+    NTSTATUS status = BCryptCreateHash(BCRYPT_SHA256_ALG_HANDLE, &hash, nullptr, 0, nullptr, 0, 0);
+    if (!BCRYPT_SUCCESS(status))
+    {
+        return HRESULT_FROM_NT(status);
+    }
+
+    // BCryptHashData takes a ULONG length.
+    constexpr SIZE_T MaxChunk = 0x40000000;
+    for (SIZE_T position = 0; position < size && BCRYPT_SUCCESS(status); position += MaxChunk)
+    {
+        const ULONG chunk = static_cast<ULONG>((std::min)(size - position, MaxChunk));
+        status = BCryptHashData(hash, const_cast<PUCHAR>(content + position), chunk, 0);
+    }
+    if (BCRYPT_SUCCESS(status))
+    {
+        status = BCryptFinishHash(hash, key->digest, DigestSize, 0);
+    }
+    BCryptDestroyHash(hash);
+
+    InterlockedIncrement64(&m_digests);
+    InterlockedAdd64(&m_digestTicks, Now() - start);
+    return BCRYPT_SUCCESS(status) ? S_OK : HRESULT_FROM_NT(status);
+}
+
+bool ScanCache::Lookup(_In_ const Key& key, _In_ ULONG generation, _Out_ AMSI_RESULT* result)
+{
+    const LONGLONG start = Now();
+    bool found = false;
+    *result = AMSI_RESULT_NOT_DETECTED;
+
+    Shard& shard = ShardFor(key);
+    AcquireSRWLockExclusive(&shard.lock);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        if (it->second->generation == generation)
+        {
+            // Move the entry to the front of the LRU list.
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            *result = it->second->result;
+            found = true;
+        }
+        else
+        {
+            // Scanned with signatures that have since been replaced.
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+    ReleaseSRWLockExclusive(&shard.lock);
+
+    InterlockedIncrement64(found ? &m_hits : &m_misses);
+    InterlockedAdd64(&m_lookupTicks, Now() - start);
+    return found;
+}
+
+void ScanCache::Insert(_In_ const Key& key, _In_ ULONG generation, _In_ AMSI_RESULT result)
+{
+    Shard& shard = ShardFor(key);
+    AcquireSRWLockExclusive(&shard.lock);
+    try
+    {
+        auto it = shard.index.find(key);
+        if (it != shard.index.end())
+        {
+            // Another thread scanned the same content at the same time.
+            it->second->generation = generation;
+            it->second->result = result;
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        }
+        else
+        {
+            if (shard.entries.size() >= m_shardCapacity)
+            {
+                shard.index.erase(shard.entries.back().key);
+                shard.entries.pop_back();
+            }
+            shard.entries.push_front({ key, generation, result });
+            try
+            {
+                shard.index.emplace(key, shard.entries.begin());
+            }
+            catch (const std::bad_alloc&)
+            {
+                shard.entries.pop_front();
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Not caching the result is harmless.
+    }
+    ReleaseSRWLockExclusive(&shard.lock);
+}
+
+void ScanCache::RemoveSession(_In_ ULONGLONG session)
+{
+    for (auto& shard : m_shards)
+    {
+        AcquireSRWLockExclusive(&shard.lock);
+        for (auto it = shard.entries.begin(); it != shard.entries.end(); )
+        {
+            if (it->key.session == session)
+            {
+                shard.index.erase(it->key);
+                it = shard.entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        ReleaseSRWLockExclusive(&shard.lock);
+    }
+}
+
+void ScanCache::Clear()
+{
+    for (auto& shard : m_shards)
+    {
+        AcquireSRWLockExclusive(&shard.lock);
+        shard.index.clear();
+        shard.entries.clear();
+        ReleaseSRWLockExclusive(&shard.lock);
+    }
+}
+
+ScanCache::Statistics ScanCache::GetStatistics()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const double microsecondsPerTick = 1e6 / frequency.QuadPart;
+
+    Statistics statistics = {};
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    for (auto& shard : m_shards)
+    {
+        AcquireSRWLockShared(&shard.lock);
+        statistics.entries += shard.index.size();
+        ReleaseSRWLockShared(&shard.lock);
+    }
+
+    const ULONGLONG lookups = statistics.hits + statistics.misses;
+    const ULONGLONG digests = m_digests;
+    statistics.averageDigestMicroseconds = digests ? m_digestTicks * microsecondsPerTick / digests : 0;
+    statistics.averageLookupMicroseconds = lookups ? m_lookupTicks * microsecondsPerTick / lookups : 0;
+    return statistics;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Remembers scan results by session and content digest, so that content a script host submits
+// again (which PowerShell, for one, does a lot) is not scanned again.
+//
+// The cache is split into shards, each a small LRU list behind its own lock, so concurrent scans
+// rarely contend. Every entry records the signature generation it was scanned with; an entry from
+// an older generation is a miss, so reloading the signatures invalidates the cache at once.
+class ScanCache
+{
+public:
+    static constexpr ULONG DigestSize = 32;   // SHA-256
+
+    struct Key
+    {
+        ULONGLONG session;
+        BYTE digest[DigestSize];
+    };
+
+    struct Statistics
+    {
+        ULONGLONG hits;
+        ULONGLONG misses;
+        ULONGLONG entries;
+        double averageDigestMicroseconds;
+        double averageLookupMicroseconds;
+    };
+
+    explicit ScanCache(_In_ SIZE_T capacity);
+    ScanCache(const ScanCache&) = delete;
+    ScanCache& operator=(const ScanCache&) = delete;
+
+    // Fills in key->digest for the content.
+    HRESULT ComputeDigest(_In_reads_bytes_(size) LPCBYTE content, _In_ SIZE_T size, _Inout_ Key* key);
+
+    // Returns true and the cached result on a hit; on a miss, result is AMSI_RESULT_NOT_DETECTED.
+    bool Lookup(_In_ const Key& key, _In_ ULONG generation, _Out_ AMSI_RESULT* result);
+    void Insert(_In_ const Key& key, _In_ ULONG generation, _In_ AMSI_RESULT result);
+
+    void RemoveSession(_In_ ULONGLONG session);
+    void Clear();
+
+    Statistics GetStatistics();
+
+private:
+    struct Entry
+    {
+        Key key;
+        ULONG generation;
+        AMSI_RESULT result;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            // The digest is already uniformly distributed.
+            size_t value;
+            memcpy(&value, key.digest, sizeof(value));
+            return value ^ static_cast<size_t>(key.session);
+        }
+    };
+
+    struct KeyEqual
+    {
+        bool operator()(const Key& a, const Key& b) const
+        {
+            return a.session == b.session && memcmp(a.digest, b.digest, DigestSize) == 0;
+        }
+    };
+
+    struct Shard
+    {
+        SRWLOCK lock = SRWLOCK_INIT;
+        std::list<Entry> entries;   // Most recently used first.
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash, KeyEqual> index;
+    };
+
+    static constexpr ULONG ShardCount = 16;
+
+    Shard& ShardFor(_In_ const Key& key) { return m_shards[key.digest[DigestSize - 1] % ShardCount]; }
+
+    SIZE_T m_shardCapacity;
+    Shard m_shards[ShardCount];
+
+    volatile LONG64 m_hits = 0;
+    volatile LONG64 m_misses = 0;
+    volatile LONG64 m_digests = 0;
+    volatile LONG64 m_digestTicks = 0;
+    volatile LONG64 m_lookupTicks = 0;
+};
@@ -0,0 +1,657 @@
+#include "stdafx.h"
+#include "SignatureScanner.h"
+
+// Upper bound on the number of full transition rows (entries, not bytes).
+constexpr SIZE_T MaxDenseEntries = 1 << 21;
+
+// Buffers smaller than this go straight through the automaton.
+constexpr SIZE_T MinFilteredSize = 4096;
+
+// Upper bound on the distance between positions tested by the prefilter.
+constexpr SIZE_T MaxSampleStride = 4;
+
+constexpr ULONG SignatureSet::NoMatch;
+constexpr SIZE_T SignatureSet::PrefixLength;
+constexpr ULONG SignatureSet::MatchFlag;
+constexpr ULONG SignatureSet::SparseFail;
+constexpr ULONG SignatureSet::SparseMatch;
+constexpr ULONG SignatureSet::SparseDepth;
+constexpr ULONG SignatureSet::SparseEdgeCount;
+constexpr ULONG SignatureSet::SparseEdges;
+
+ULONG SignatureSet::SparseStep(_In_ ULONG cursor, _In_ ULONG inputClass) const
+{
+    for (;;)
+    {
+        const ULONG* record = &m_sparse[cursor - m_denseLimit];
+        const ULONG* edges = record + SparseEdges;
+        for (ULONG e = 0; e < record[SparseEdgeCount]; e++)
+        {
+            if (edges[2 * e] == inputClass)
+            {
+                return edges[2 * e + 1];
+            }
+        }
+
+        // Failure links always lead to shallower states, so this ends at a state with a full row.
+        cursor = record[SparseFail];
+        if (cursor < m_denseLimit)
+        {
+            return m_dense[cursor + inputClass];
+        }
+    }
+}
+
+ULONG SignatureSet::MatchAt(_In_ ULONG cursor) const
+{
+    return (cursor < m_denseLimit) ? m_denseMatch[cursor / m_stride] : m_sparse[cursor - m_denseLimit + SparseMatch];
+}
+
+ULONG SignatureSet::DepthAt(_In_ ULONG cursor) const
+{
+    return (cursor < m_denseLimit) ? m_denseDepth[cursor / m_stride] : m_sparse[cursor - m_denseLimit + SparseDepth];
+}
+
+ULONG SignatureSet::ScanAutomaton(_Inout_ ULONG* cursor, _In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const
+{
+    ULONG current = *cursor;
+    for (SIZE_T i = 0; i < size; i++)
+    {
+        const ULONG next = Step(current, buffer[i]);
+        current = next & ~MatchFlag;
+        if (next & MatchFlag)
+        {
+            return MatchAt(current);
+        }
+    }
+
+    *cursor = current;
+    return NoMatch;
+}
+
+// Follows the automaton from the root for only as long as it stays on a path that started at
+// buffer[0]; any signature found on the way is reported, wherever it started.
+ULONG SignatureSet::MatchFrom(_In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const
+{
+    ULONG cursor = InitialState;
+    for (SIZE_T i = 0; i < size; i++)
+    {
+        const ULONG next = Step(cursor, buffer[i]);
+        cursor = next & ~MatchFlag;
+        if (next & MatchFlag)
+        {
+            return MatchAt(cursor);
+        }
+        if (DepthAt(cursor) <= i)
+        {
+            break;
+        }
+    }
+    return NoMatch;
+}
+
+ULONG SignatureSet::Scan(_Inout_ ScanState* state, _In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const
+{
+    if (m_stateCount == 1)
+    {
+        return NoMatch;
+    }
+
+    const SIZE_T tailLength = (std::max)(static_cast<SIZE_T>(m_maxLength), PrefixLength);
+    if (size < MinFilteredSize || size <= 2 * tailLength)
+    {
+        return ScanAutomaton(state, buffer, size);
+    }
+
+    // Finish any signature that started in an earlier buffer: run the automaton until the
+    // longest prefix it is tracking starts inside this one.
+    ULONG cursor = *state;
+    SIZE_T i = 0;
+    for (; DepthAt(cursor) > i; i++)
+    {
+        const ULONG next = Step(cursor, buffer[i]);
+        cursor = next & ~MatchFlag;
+        if (next & MatchFlag)
+        {
+            return MatchAt(cursor);
+        }
+    }
+
+    // Signatures that start in the body are checked where the prefilter lets them, and always
+    // have room to complete. Only every m_sampleStride'th position is tested: the filter holds that
+    // many consecutive windows of each signature, so one of them lines up with a tested position.
+    const SIZE_T tail = size - tailLength;
+    const SIZE_T stride = m_sampleStride;
+    for (SIZE_T position = 0; position < tail + stride - 1; position += stride)
+    {
+        if (!MayStartAt(buffer + position))
+        {
+            continue;
+        }
+
+        for (SIZE_T start = (position + 1 > stride) ? position + 1 - stride : 0; start <= position; start++)
+        {
+            if (stride > 1 && !FilterContains(m_startFilter, m_startFilterShift, buffer + start))
+            {
+                continue;
+            }
+
+            const ULONG match = MatchFrom(buffer + start, size - start);
+            if (match != NoMatch)
+            {
+                return match;
+            }
+        }
+    }
+
+    // The automaton only remembers the last m_maxLength bytes, so starting it from the root here
+    // finds the signatures that start in the tail and leaves it in the right state for the next buffer.
+    cursor = InitialState;
+    const ULONG match = ScanAutomaton(&cursor, buffer + tail, tailLength);
+    if (match == NoMatch)
+    {
+        *state = cursor;
+    }
+    return match;
+}
+
+SIZE_T SignatureSet::MemoryUsage() const
+{
+    SIZE_T size = sizeof(*this) +
+        m_dense.size() * sizeof(ULONG) +
+        m_denseMatch.size() * sizeof(ULONG) +
+        m_denseDepth.size() * sizeof(ULONG) +
+        m_sparse.size() * sizeof(ULONG) +
+        m_filter.size() * sizeof(ULONGLONG) +
+        m_startFilter.size() * sizeof(ULONGLONG) +
+        m_shortFilter.size() * sizeof(ULONGLONG);
+    for (const auto& name : m_names)
+    {
+        size += name.capacity();
+    }
+    return size;
+}
+
+HRESULT SignatureSet::Compile(_In_ const std::vector<Signature>& signatures) try
+{
+    // Every signature contributes its bytes, and text signatures their UTF-16LE form as well.
+    struct Pattern
+    {
+        std::string bytes;
+        ULONG signature;
+    };
+    std::vector<Pattern> patterns;
+    patterns.reserve(signatures.size() * 2);
+    for (ULONG i = 0; i < signatures.size(); i++)
+    {
+        const auto& signature = signatures[i];
+        if (signature.bytes.empty())
+        {
+            continue;
+        }
+
+        patterns.push_back({ signature.bytes, i });
+        if (signature.text)
+        {
+            std::string wide;
+            wide.reserve(signature.bytes.size() * 2);
+            for (char c : signature.bytes)
+            {
+                wide.push_back(c);
+                wide.push_back('\0');
+            }
+            patterns.push_back({ std::move(wide), i });
+        }
+    }
+
+    // Input classes: 0 for bytes no signature uses, then one per used byte, in byte order.
+    bool used[256] = {};
+    for (const auto& pattern : patterns)
+    {
+        for (char c : pattern.bytes)
+        {
+            used[static_cast<BYTE>(c)] = true;
+        }
+    }
+
+    BYTE classes[256] = {};
+    ULONG stride = 1;
+    for (ULONG b = 0; b < 256; b++)
+    {
+        if (used[b])
+        {
+            classes[b] = static_cast<BYTE>(stride++);
+        }
+    }
+    if (stride > 256)
+    {
+        // All 256 byte values are used; class 0 is never needed, so shift the classes down.
+        for (ULONG b = 0; b < 256; b++)
+        {
+            classes[b]--;
+        }
+        stride = 256;
+    }
+
+    // Build the trie from the sorted patterns (std::string compares bytes as unsigned, like memcmp).
+    // Sorting puts the children of every node in increasing class order and lets each pattern
+    // reuse the path of the previous one.
+    std::sort(patterns.begin(), patterns.end(),
+        [](const Pattern& a, const Pattern& b) { return a.bytes < b.bytes; });
+
+    SIZE_T totalLength = 1;
+    SIZE_T maxLength = 0;
+    for (const auto& pattern : patterns)
+    {
+        totalLength += pattern.bytes.size();
+        maxLength = (std::max)(maxLength, pattern.bytes.size());
+    }
+    if (totalLength >= (MatchFlag >> 1))
+    {
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    }
+
+    std::vector<ULONG> firstChild(1, NoMatch);
+    std::vector<ULONG> lastChild(1, NoMatch);
+    std::vector<ULONG> nextSibling(1, NoMatch);
+    std::vector<BYTE> label(1, 0);
+    std::vector<ULONG> terminal(1, NoMatch);
+    firstChild.reserve(totalLength);
+    lastChild.reserve(totalLength);
+    nextSibling.reserve(totalLength);
+    label.reserve(totalLength);
+    terminal.reserve(totalLength);
+
+    std::vector<ULONG> path(1, 0);
+    const std::string* previous = nullptr;
+    for (const auto& pattern : patterns)
+    {
+        const std::string& bytes = pattern.bytes;
+
+        SIZE_T common = 0;
+        if (previous)
+        {
+            while (common < previous->size() && common < bytes.size() && (*previous)[common] == bytes[common])
+            {
+                common++;
+            }
+        }
+        path.resize(common + 1);
+
+        for (SIZE_T j = common; j < bytes.size(); j++)
+        {
+            const ULONG parent = path.back();
+            const ULONG node = static_cast<ULONG>(label.size());
+            firstChild.push_back(NoMatch);
+            lastChild.push_back(NoMatch);
+            nextSibling.push_back(NoMatch);
+            label.push_back(classes[static_cast<BYTE>(bytes[j])]);
+            terminal.push_back(NoMatch);
+
+            if (lastChild[parent] == NoMatch)
+            {
+                firstChild[parent] = node;
+            }
+            else
+            {
+                nextSibling[lastChild[parent]] = node;
+            }
+            lastChild[parent] = node;
+            path.push_back(node);
+        }
+
+        // Of identical patterns, the first signature listed wins.
+        ULONG& end = terminal[path.back()];
+        end = (std::min)(end, pattern.signature);
+        previous = &bytes;
+    }
+
+    // Prefilter: the hashed PrefixLength-byte windows at the first sampleStride offsets of every
+    // signature at least that long, and the first two bytes (or for single bytes, every pair
+    // starting with it) of the others. Those have to be tested at every position.
+    SIZE_T longCount = 0;
+    SIZE_T minLongLength = SIZE_MAX;
+    bool hasShort = false;
+    for (const auto& pattern : patterns)
+    {
+        if (pattern.bytes.size() >= PrefixLength)
+        {
+            longCount++;
+            minLongLength = (std::min)(minLongLength, pattern.bytes.size());
+        }
+        else
+        {
+            hasShort = true;
+        }
+    }
+
+    const SIZE_T sampleStride = (hasShort || longCount == 0) ? 1 : (std::min)(minLongLength - PrefixLength + 1, MaxSampleStride);
+
+    // About 16 bits per window keeps false positives near 1%.
+    auto filterShiftFor = [](SIZE_T windows) -> ULONG
+    {
+        ULONG wordBits = 6;
+        while (wordBits < 18 && (SIZE_T(64) << wordBits) < windows * 16)
+        {
+            wordBits++;
+        }
+        return 64 - wordBits;
+    };
+
+    auto addWindow = [](std::vector<ULONGLONG>& filter, ULONG shift, const char* bytes)
+    {
+        ULONGLONG window;
+        memcpy(&window, bytes, sizeof(window));
+        SIZE_T word;
+        const ULONGLONG bits = FilterBits(window, shift, &word);
+        filter[word] |= bits;
+    };
+
+    const ULONG filterShift = filterShiftFor(longCount * sampleStride);
+    const ULONG startFilterShift = filterShiftFor(longCount);
+    std::vector<ULONGLONG> filter(SIZE_T(1) << (64 - filterShift), 0);
+    std::vector<ULONGLONG> startFilter((sampleStride > 1) ? (SIZE_T(1) << (64 - startFilterShift)) : 0, 0);
+    std::vector<ULONGLONG> shortFilter(65536 / 64, 0);
+    for (const auto& pattern : patterns)
+    {
+        const std::string& bytes = pattern.bytes;
+        if (bytes.size() >= PrefixLength)
+        {
+            for (SIZE_T offset = 0; offset < sampleStride; offset++)
+            {
+                addWindow(filter, filterShift, bytes.data() + offset);
+            }
+            if (sampleStride > 1)
+            {
+                addWindow(startFilter, startFilterShift, bytes.data());
+            }
+        }
+        else
+        {
+            const ULONG first = static_cast<BYTE>(bytes[0]);
+            for (ULONG second = 0; second < 256; second++)
+            {
+                if (bytes.size() == 1 || static_cast<BYTE>(bytes[1]) == second)
+                {
+                    const ULONG pair = first | (second << 8);
+                    shortFilter[pair >> 6] |= 1ull << (pair & 63);
+                }
+            }
+        }
+    }
+
+    patterns.clear();
+    patterns.shrink_to_fit();
+    lastChild.clear();
+    lastChild.shrink_to_fit();
+
+    // Number the states breadth first: failure links then always point to lower numbers, and the
+    // states given full rows are the shallowest ones.
+    const ULONG stateCount = static_cast<ULONG>(label.size());
+    std::vector<ULONG> order;   // state -> trie node
+    order.reserve(stateCount);
+    order.push_back(0);
+    for (ULONG i = 0; i < order.size(); i++)
+    {
+        for (ULONG child = firstChild[order[i]]; child != NoMatch; child = nextSibling[child])
+        {
+            order.push_back(child);
+        }
+    }
+
+    std::vector<ULONG> stateOf(stateCount); // trie node -> state
+    for (ULONG s = 0; s < stateCount; s++)
+    {
+        stateOf[order[s]] = s;
+    }
+
+    const ULONG denseCount = static_cast<ULONG>((std::min)(static_cast<SIZE_T>(stateCount), (std::max)(MaxDenseEntries / stride, SIZE_T(1))));
+
+    // Compute failure links, matches and full rows, all in state numbers for now.
+    std::vector<ULONG> dense(static_cast<SIZE_T>(denseCount) * stride);
+    std::vector<ULONG> fail(stateCount, 0);
+    std::vector<ULONG> match(stateCount, NoMatch);
+    std::vector<ULONG> depth(stateCount, 0);
+
+    auto step = [&](ULONG s, ULONG inputClass) -> ULONG
+    {
+        for (;;)
+        {
+            if (s < denseCount)
+            {
+                return dense[static_cast<SIZE_T>(s) * stride + inputClass];
+            }
+
+            for (ULONG child = firstChild[order[s]]; child != NoMatch && label[child] <= inputClass; child = nextSibling[child])
+            {
+                if (label[child] == inputClass)
+                {
+                    return stateOf[child];
+                }
+            }
+            s = fail[s];
+        }
+    };
+
+    for (ULONG s = 0; s < stateCount; s++)
+    {
+        const ULONG node = order[s];
+        match[s] = (terminal[node] != NoMatch) ? terminal[node] : ((s == 0) ? NoMatch : match[fail[s]]);
+
+        if (s < denseCount)
+        {
+            ULONG* row = &dense[static_cast<SIZE_T>(s) * stride];
+            for (ULONG c = 0; c < stride; c++)
+            {
+                row[c] = (s == 0) ? 0 : step(fail[s], c);
+            }
+            for (ULONG child = firstChild[node]; child != NoMatch; child = nextSibling[child])
+            {
+                row[label[child]] = stateOf[child];
+            }
+        }
+
+        for (ULONG child = firstChild[node]; child != NoMatch; child = nextSibling[child])
+        {
+            fail[stateOf[child]] = (s == 0) ? 0 : step(fail[s], label[child]);
+            depth[stateOf[child]] = depth[s] + 1;
+        }
+    }
+
+    // Lay out the sparse state records, then convert everything to cursors.
+    std::vector<ULONG> offsetOf(stateCount - denseCount);
+    SIZE_T sparseSize = 0;
+    for (ULONG s = denseCount; s < stateCount; s++)
+    {
+        offsetOf[s - denseCount] = static_cast<ULONG>(sparseSize);
+
+        ULONG edgeCount = 0;
+        for (ULONG child = firstChild[order[s]]; child != NoMatch; child = nextSibling[child])
+        {
+            edgeCount++;
+        }
+        sparseSize += SparseEdges + 2 * edgeCount;
+    }
+
+    const ULONG denseLimit = denseCount * stride;
+    if (static_cast<ULONGLONG>(denseLimit) + sparseSize >= MatchFlag)
+    {
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+    }
+
+    auto cursorOf = [&](ULONG s) -> ULONG
+    {
+        const ULONG cursor = (s < denseCount) ? s * stride : denseLimit + offsetOf[s - denseCount];
+        return (match[s] != NoMatch) ? (cursor | MatchFlag) : cursor;
+    };
+
+    for (auto& target : dense)
+    {
+        target = cursorOf(target);
+    }
+
+    std::vector<ULONG> sparse;
+    sparse.reserve(sparseSize);
+    for (ULONG s = denseCount; s < stateCount; s++)
+    {
+        sparse.push_back(cursorOf(fail[s]) & ~MatchFlag);
+        sparse.push_back(match[s]);
+        sparse.push_back(depth[s]);
+        const SIZE_T countIndex = sparse.size();
+        sparse.push_back(0);
+        for (ULONG child = firstChild[order[s]]; child != NoMatch; child = nextSibling[child])
+        {
+            sparse.push_back(label[child]);
+            sparse.push_back(cursorOf(stateOf[child]));
+            sparse[countIndex]++;
+        }
+    }
+
+    match.resize(denseCount);
+    depth.resize(denseCount);
+
+    std::vector<std::string> names;
+    names.reserve(signatures.size());
+    for (const auto& signature : signatures)
+    {
+        names.push_back(signature.name);
+    }
+
+    memcpy_s(m_classes, sizeof(m_classes), classes, sizeof(classes));
+    m_stride = stride;
+    m_denseLimit = denseLimit;
+    m_stateCount = stateCount;
+    m_maxLength = static_cast<ULONG>(maxLength);
+    m_dense = std::move(dense);
+    m_denseMatch = std::move(match);
+    m_denseDepth = std::move(depth);
+    m_sparse = std::move(sparse);
+    m_sampleStride = static_cast<ULONG>(sampleStride);
+    m_filterShift = filterShift;
+    m_filter = std::move(filter);
+    m_startFilterShift = startFilterShift;
+    m_startFilter = std::move(startFilter);
+    m_hasShort = hasShort;
+    m_shortFilter = hasShort ? std::move(shortFilter) : std::vector<ULONGLONG>();
+    m_names = std::move(names);
+    return S_OK;
+}
+catch (const std::bad_alloc&)
+{
+    return E_OUTOFMEMORY;
+}
+
+static bool ParseHexDigit(_In_ char c, _Out_ BYTE* value)
+{
+    if (c >= '0' && c <= '9') { *value = static_cast<BYTE>(c - '0'); return true; }
+    if (c >= 'a' && c <= 'f') { *value = static_cast<BYTE>(c - 'a' + 10); return true; }
+    if (c >= 'A' && c <= 'F') { *value = static_cast<BYTE>(c - 'A' + 10); return true; }
+    return false;
+}
+
+static bool ParseHexSignature(_In_ const std::string& text, _Out_ std::string* bytes)
+{
+    bytes->clear();
+    for (SIZE_T i = 0; i < text.size(); )
+    {
+        if (text[i] == ' ' || text[i] == '\t')
+        {
+            i++;
+            continue;
+        }
+
+        BYTE high, low;
+        if (i + 1 >= text.size() || !ParseHexDigit(text[i], &high) || !ParseHexDigit(text[i + 1], &low))
+        {
+            return false;
+        }
+        bytes->push_back(static_cast<char>((high << 4) | low));
+        i += 2;
+    }
+    return !bytes->empty();
+}
+
+HRESULT SignatureSet::LoadFromFile(_In_ PCWSTR fileName, _Out_opt_ ULONG* errorLine) try
+{
+    if (errorLine)
+    {
+        *errorLine = 0;
+    }
+
+    Microsoft::WRL::Wrappers::FileHandle file(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (!file.IsValid())
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file.Get(), &fileSize))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    if (fileSize.QuadPart > MAXLONG)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+    }
+
+    std::string contents(static_cast<SIZE_T>(fileSize.QuadPart), '\0');
+    DWORD bytesRead;
+    if (!contents.empty() &&
+        (!ReadFile(file.Get(), &contents[0], static_cast<DWORD>(contents.size()), &bytesRead, nullptr) ||
+         bytesRead != contents.size()))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    std::vector<Signature> signatures;
+    ULONG lineNumber = 0;
+    for (SIZE_T start = 0; start < contents.size(); )
+    {
+        SIZE_T end = contents.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = contents.size();
+        }
+
+        std::string line = contents.substr(start, end - start);
+        start = end + 1;
+        lineNumber++;
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        Signature signature;
+        signature.name = line;
+        if (line.compare(0, 4, "hex:") == 0)
+        {
+            signature.text = false;
+            if (!ParseHexSignature(line.substr(4), &signature.bytes))
+            {
+                if (errorLine)
+                {
+                    *errorLine = lineNumber;
+                }
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+        }
+        else
+        {
+            signature.text = true;
+            signature.bytes = line;
+        }
+        signatures.push_back(std::move(signature));
+    }
+
+    return Compile(signatures);
+}
+catch (const std::bad_alloc&)
+{
+    return E_OUTOFMEMORY;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// A set of byte signatures, compiled so that a buffer is checked for all of them in one pass.
+//
+// Matching is done by an Aho-Corasick automaton. Bytes that appear in no signature share a single
+// input class, which keeps the transition rows narrow. The shallow states get a full transition
+// row each; deeper states are compact records of their own edges, laid out breadth first, that fall
+// back along their failure links. That bounds the memory used by large signature sets.
+//
+// Stepping the automaton over every byte is bound by memory latency, though, and with many
+// signatures nearly every short prefix is a state of its own. So large buffers are first run
+// through a prefilter: a Bloom filter of PrefixLength-byte windows from the start of every
+// signature (and a bitmap of the first two bytes of the shorter ones). Only positions that pass it are walked
+// through the automaton, and only for as long as a signature starting there is still possible.
+//
+// A compiled set is immutable and may be used by any number of threads at once. Scanning state is
+// kept by the caller, so a stream can be scanned one chunk at a time and a signature that straddles
+// two chunks is still found.
+class SignatureSet
+{
+public:
+    static constexpr ULONG NoMatch = ULONG_MAX;
+
+    // Scanning state to pass to successive Scan calls for the same content.
+    // Start each new piece of content from InitialState.
+    using ScanState = ULONG;
+    static constexpr ScanState InitialState = 0;
+
+    struct Signature
+    {
+        std::string name;
+        std::string bytes;
+        bool text;  // Also match the UTF-16LE form, which is how script hosts usually submit content.
+    };
+
+    // Signature file format: one signature per line. Blank lines and lines starting with '#' are ignored.
+    // A line of the form "hex:4d 5a 90 00" is a byte signature, any other line is a text signature.
+    HRESULT LoadFromFile(_In_ PCWSTR fileName, _Out_opt_ ULONG* errorLine = nullptr);
+
+    HRESULT Compile(_In_ const std::vector<Signature>& signatures);
+
+    // Scans the buffer, continuing from *state, and returns the index of a signature found in it
+    // (the scan stops there, and *state is not meaningful afterwards), or NoMatch.
+    ULONG Scan(_Inout_ ScanState* state, _In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const;
+
+    ULONG SignatureCount() const { return static_cast<ULONG>(m_names.size()); }
+    ULONG StateCount() const { return m_stateCount; }
+    SIZE_T MemoryUsage() const;
+    PCSTR SignatureName(_In_ ULONG index) const { return m_names[index].c_str(); }
+
+private:
+    static constexpr SIZE_T PrefixLength = sizeof(ULONGLONG);
+
+    // States are referred to by "cursors": the offset of the state's row in m_dense if it has one,
+    // otherwise m_denseLimit + the offset of its record in m_sparse. The top bit marks transitions
+    // to states at which a signature ends.
+    static constexpr ULONG MatchFlag = 0x80000000;
+
+    // Sparse state record: failure cursor, match, depth, edge count, then (input class, target cursor) pairs.
+    static constexpr ULONG SparseFail = 0;
+    static constexpr ULONG SparseMatch = 1;
+    static constexpr ULONG SparseDepth = 2;
+    static constexpr ULONG SparseEdgeCount = 3;
+    static constexpr ULONG SparseEdges = 4;
+
+    ULONG Step(_In_ ULONG cursor, _In_ BYTE input) const
+    {
+        const ULONG inputClass = m_classes[input];
+        return (cursor < m_denseLimit) ? m_dense[cursor + inputClass] : SparseStep(cursor, inputClass);
+    }
+
+    bool MayStartAt(_In_reads_bytes_(PrefixLength) LPCBYTE position) const
+    {
+        if (FilterContains(m_filter, m_filterShift, position))
+        {
+            return true;
+        }
+
+        const ULONG pair = position[0] | (position[1] << 8);
+        return m_hasShort && ((m_shortFilter[pair >> 6] >> (pair & 63)) & 1);
+    }
+
+    static bool FilterContains(_In_ const std::vector<ULONGLONG>& filter, _In_ ULONG shift, _In_reads_bytes_(PrefixLength) LPCBYTE position)
+    {
+        ULONGLONG window;
+        memcpy(&window, position, sizeof(window));
+        SIZE_T word;
+        const ULONGLONG bits = FilterBits(window, shift, &word);
+        return (filter[word] & bits) == bits;
+    }
+
+    // Each window sets two bits in one word of the filter, picked by the top bits of its hash.
+    static ULONGLONG FilterBits(_In_ ULONGLONG window, _In_ ULONG shift, _Out_ SIZE_T* word)
+    {
+        const ULONGLONG hash = window * 0x9E3779B97F4A7C15ull;
+        *word = static_cast<SIZE_T>(hash >> shift);
+        return (1ull << ((hash >> (shift - 6)) & 63)) | (1ull << ((hash >> (shift - 12)) & 63));
+    }
+
+    ULONG SparseStep(_In_ ULONG cursor, _In_ ULONG inputClass) const;
+    ULONG MatchAt(_In_ ULONG cursor) const;
+    ULONG DepthAt(_In_ ULONG cursor) const;
+    ULONG ScanAutomaton(_Inout_ ULONG* cursor, _In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const;
+    ULONG MatchFrom(_In_reads_bytes_(size) LPCBYTE buffer, _In_ SIZE_T size) const;
+
+    BYTE m_classes[256] = {};
+    ULONG m_stride = 1;
+    ULONG m_denseLimit = 1;
+    ULONG m_stateCount = 1;
+    ULONG m_maxLength = 0;
+
+    std::vector<ULONG> m_dense = std::vector<ULONG>(1, 0);  // An empty set stays in the root state.
+    std::vector<ULONG> m_denseMatch;    // Per full-row state: signature ending there (or at its longest suffix).
+    std::vector<ULONG> m_denseDepth;
+    std::vector<ULONG> m_sparse;
+
+    ULONG m_sampleStride = 1;
+    ULONG m_filterShift = 64 - 6;
+    std::vector<ULONGLONG> m_filter = std::vector<ULONGLONG>(64, 0);
+    ULONG m_startFilterShift = 64 - 6;
+    std::vector<ULONGLONG> m_startFilter;   // Just the first window of each signature, when sampling.
+    bool m_hasShort = false;
+    std::vector<ULONGLONG> m_shortFilter;
+
+    std::vector<std::string> m_names;
+};
@@ -6,9 +6,19 @@
 #pragma once
 
 #include <windows.h>
+#include <bcrypt.h>
 #include <strsafe.h>
+#include <stdio.h>
 #include <TraceLoggingProvider.h>
 #include <amsi.h>
 #include <wrl/module.h>
+#include <wrl/wrappers/corewrappers.h>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 TRACELOGGING_DECLARE_PROVIDER(g_traceLoggingProvider);
@@ -318,6 +318,208 @@ static void OptimizeRGB(_Out_ HDRColorA *pX, _Out_ HDRColorA *pY,
 }
 
 
+//-------------------------------------------------------------------------------------
+// OptimizeRGB for BC_BATCH_LANES blocks at once; each lane holds one block and vUse3
+// selects the 3-step codec per lane. Lanes leave early and stop iterating independently,
+// so every lane matches OptimizeRGB bit for bit.
+//-------------------------------------------------------------------------------------
+#ifndef COLOR_WEIGHTS
+static void OptimizeRGBBatch(_Out_writes_(3) XMVECTOR *pX, _Out_writes_(3) XMVECTOR *pY,
+                             _In_reads_(NUM_PIXELS_PER_BLOCK*3) const XMVECTOR *pPoints, _In_ FXMVECTOR vUse3, _In_ DWORD flags)
+{
+    static const float fEpsilon = (0.25f / 64.0f) * (0.25f / 64.0f);
+
+    // cSteps - 1 for each lane
+    const XMVECTOR fSteps = XMVectorSelect( XMVectorReplicate( 3.0f ), XMVectorReplicate( 2.0f ), vUse3 );
+
+    // Find Min and Max points, as starting point
+    XMVECTOR X[3], Y[3];
+    if (flags & BC_FLAGS_UNIFORM)
+    {
+        X[0] = X[1] = X[2] = g_XMOne;
+    }
+    else
+    {
+        X[0] = XMVectorReplicate( g_Luminance.r );
+        X[1] = XMVectorReplicate( g_Luminance.g );
+        X[2] = XMVectorReplicate( g_Luminance.b );
+    }
+    Y[0] = Y[1] = Y[2] = XMVectorZero();
+
+    for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+    {
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            X[iChannel] = XMVectorMin( pPoints[iPoint*3 + iChannel], X[iChannel] );
+            Y[iChannel] = XMVectorMax( pPoints[iPoint*3 + iChannel], Y[iChannel] );
+        }
+    }
+
+    // Diagonal axis
+    XMVECTOR AB[3];
+    AB[0] = XMVectorSubtract( Y[0], X[0] );
+    AB[1] = XMVectorSubtract( Y[1], X[1] );
+    AB[2] = XMVectorSubtract( Y[2], X[2] );
+
+    XMVECTOR fAB = XMVectorAdd( XMVectorAdd( XMVectorMultiply( AB[0], AB[0] ), XMVectorMultiply( AB[1], AB[1] ) ), XMVectorMultiply( AB[2], AB[2] ) );
+
+    // Single color lanes.. no need to root-find
+    XMVECTOR vSingle = XMVectorLess( fAB, XMVectorReplicate( FLT_MIN ) );
+
+    // Try all four axis directions, to determine which diagonal best fits data
+    XMVECTOR fABInv = XMVectorDivide( g_XMOne, fAB );
+
+    XMVECTOR Dir[3], Mid[3];
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        Dir[iChannel] = XMVectorMultiply( AB[iChannel], fABInv );
+        Mid[iChannel] = XMVectorMultiply( XMVectorAdd( X[iChannel], Y[iChannel] ), g_XMOneHalf );
+    }
+
+    XMVECTOR fDir[4];
+    fDir[0] = fDir[1] = fDir[2] = fDir[3] = XMVectorZero();
+
+    for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+    {
+        XMVECTOR Pt[3];
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            Pt[iChannel] = XMVectorMultiply( XMVectorSubtract( pPoints[iPoint*3 + iChannel], Mid[iChannel] ), Dir[iChannel] );
+        }
+
+        XMVECTOR f;
+
+        f = XMVectorAdd( XMVectorAdd( Pt[0], Pt[1] ), Pt[2] );
+        fDir[0] = XMVectorAdd( fDir[0], XMVectorMultiply( f, f ) );
+
+        f = XMVectorSubtract( XMVectorAdd( Pt[0], Pt[1] ), Pt[2] );
+        fDir[1] = XMVectorAdd( fDir[1], XMVectorMultiply( f, f ) );
+
+        f = XMVectorAdd( XMVectorSubtract( Pt[0], Pt[1] ), Pt[2] );
+        fDir[2] = XMVectorAdd( fDir[2], XMVectorMultiply( f, f ) );
+
+        f = XMVectorSubtract( XMVectorSubtract( Pt[0], Pt[1] ), Pt[2] );
+        fDir[3] = XMVectorAdd( fDir[3], XMVectorMultiply( f, f ) );
+    }
+
+    XMVECTOR fDirMax = fDir[0];
+    XMVECTOR vSwapG = XMVectorFalseInt();
+    XMVECTOR vSwapB = XMVectorFalseInt();
+
+    for(size_t iDir = 1; iDir < 4; iDir++)
+    {
+        XMVECTOR vBetter = XMVectorGreater( fDir[iDir], fDirMax );
+        fDirMax = XMVectorSelect( fDirMax, fDir[iDir], vBetter );
+        vSwapG = XMVectorSelect( vSwapG, (iDir & 2) ? XMVectorTrueInt() : XMVectorFalseInt(), vBetter );
+        vSwapB = XMVectorSelect( vSwapB, (iDir & 1) ? XMVectorTrueInt() : XMVectorFalseInt(), vBetter );
+    }
+
+    vSwapG = XMVectorAndCInt( vSwapG, vSingle );
+    vSwapB = XMVectorAndCInt( vSwapB, vSingle );
+
+    XMVECTOR f = X[1];
+    X[1] = XMVectorSelect( X[1], Y[1], vSwapG );
+    Y[1] = XMVectorSelect( Y[1], f, vSwapG );
+
+    f = X[2];
+    X[2] = XMVectorSelect( X[2], Y[2], vSwapB );
+    Y[2] = XMVectorSelect( Y[2], f, vSwapB );
+
+    // Two color lanes.. no need to root-find
+    XMVECTOR vActive = XMVectorAndCInt( XMVectorTrueInt(), XMVectorLess( fAB, XMVectorReplicate( 1.0f / 4096.0f ) ) );
+
+    // Use Newton's Method to find local minima of sum-of-squares error.
+    const XMVECTOR fEighth = XMVectorReplicate( 1.0f / 8.0f );
+
+    for(size_t iIteration = 0; iIteration < 8; iIteration++)
+    {
+        // Calculate color direction
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            Dir[iChannel] = XMVectorSubtract( Y[iChannel], X[iChannel] );
+        }
+
+        XMVECTOR fLen = XMVectorAdd( XMVectorAdd( XMVectorMultiply( Dir[0], Dir[0] ), XMVectorMultiply( Dir[1], Dir[1] ) ), XMVectorMultiply( Dir[2], Dir[2] ) );
+
+        vActive = XMVectorAndCInt( vActive, XMVectorLess( fLen, XMVectorReplicate( 1.0f / 4096.0f ) ) );
+        if ( XMVector4EqualInt( vActive, XMVectorFalseInt() ) )
+            break;
+
+        XMVECTOR fScale = XMVectorDivide( fSteps, fLen );
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            Dir[iChannel] = XMVectorMultiply( Dir[iChannel], fScale );
+        }
+
+        // Evaluate function, and derivatives
+        XMVECTOR d2X = XMVectorZero();
+        XMVECTOR d2Y = XMVectorZero();
+        XMVECTOR dX[3], dY[3];
+        dX[0] = dX[1] = dX[2] = dY[0] = dY[1] = dY[2] = XMVectorZero();
+
+        for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+        {
+            const XMVECTOR *pPoint = pPoints + iPoint*3;
+
+            XMVECTOR fDot = XMVectorAdd( XMVectorAdd( XMVectorMultiply( XMVectorSubtract( pPoint[0], X[0] ), Dir[0] ),
+                                                      XMVectorMultiply( XMVectorSubtract( pPoint[1], X[1] ), Dir[1] ) ),
+                                         XMVectorMultiply( XMVectorSubtract( pPoint[2], X[2] ), Dir[2] ) );
+
+            XMVECTOR fStep = XMVectorTruncate( XMVectorAdd( fDot, g_XMOneHalf ) );
+            fStep = XMVectorSelect( fStep, fSteps, XMVectorGreaterOrEqual( fDot, fSteps ) );
+            fStep = XMVectorSelect( fStep, g_XMZero, XMVectorLessOrEqual( fDot, g_XMZero ) );
+
+            XMVECTOR pC = XMVectorDivide( XMVectorSubtract( fSteps, fStep ), fSteps );
+            XMVECTOR pD = XMVectorDivide( fStep, fSteps );
+
+            XMVECTOR fC = XMVectorMultiply( pC, fEighth );
+            XMVECTOR fD = XMVectorMultiply( pD, fEighth );
+
+            d2X = XMVectorAdd( d2X, XMVectorMultiply( fC, pC ) );
+            d2Y = XMVectorAdd( d2Y, XMVectorMultiply( fD, pD ) );
+
+            for(size_t iChannel = 0; iChannel < 3; iChannel++)
+            {
+                XMVECTOR Step = XMVectorAdd( XMVectorMultiply( X[iChannel], pC ), XMVectorMultiply( Y[iChannel], pD ) );
+                XMVECTOR Diff = XMVectorSubtract( Step, pPoint[iChannel] );
+
+                dX[iChannel] = XMVectorAdd( dX[iChannel], XMVectorMultiply( fC, Diff ) );
+                dY[iChannel] = XMVectorAdd( dY[iChannel], XMVectorMultiply( fD, Diff ) );
+            }
+        }
+
+        // Move endpoints
+        XMVECTOR vMoveX = XMVectorAndInt( vActive, XMVectorGreater( d2X, g_XMZero ) );
+        XMVECTOR vMoveY = XMVectorAndInt( vActive, XMVectorGreater( d2Y, g_XMZero ) );
+
+        XMVECTOR fX = XMVectorDivide( g_XMNegativeOne, d2X );
+        XMVECTOR fY = XMVectorDivide( g_XMNegativeOne, d2Y );
+
+        XMVECTOR vConverged = XMVectorTrueInt();
+        const XMVECTOR vEpsilon = XMVectorReplicate( fEpsilon );
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            X[iChannel] = XMVectorSelect( X[iChannel], XMVectorAdd( X[iChannel], XMVectorMultiply( dX[iChannel], fX ) ), vMoveX );
+            Y[iChannel] = XMVectorSelect( Y[iChannel], XMVectorAdd( Y[iChannel], XMVectorMultiply( dY[iChannel], fY ) ), vMoveY );
+
+            vConverged = XMVectorAndInt( vConverged, XMVectorLess( XMVectorMultiply( dX[iChannel], dX[iChannel] ), vEpsilon ) );
+            vConverged = XMVectorAndInt( vConverged, XMVectorLess( XMVectorMultiply( dY[iChannel], dY[iChannel] ), vEpsilon ) );
+        }
+
+        vActive = XMVectorAndCInt( vActive, vConverged );
+    }
+
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        pX[iChannel] = X[iChannel];
+        pY[iChannel] = Y[iChannel];
+    }
+}
+#endif // !COLOR_WEIGHTS
+
+
 //-------------------------------------------------------------------------------------
 inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
 {
@@ -676,6 +878,237 @@ static void EncodeBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) cons
     pBC->bitmap = dw;
 }
 
+//-------------------------------------------------------------------------------------
+// EncodeBC1 for BC_BATCH_LANES blocks at once, pColor holding one block per lane (see
+// LoadBlocksSoA). Dithering is sequential within a block, so only the undithered path
+// is batched; the caller falls back to EncodeBC1 for dithered blocks.
+//-------------------------------------------------------------------------------------
+#ifndef COLOR_WEIGHTS
+static void EncodeBC1Batch(_Out_writes_(BC_BATCH_LANES) D3DX_BC1 **pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMMATRIX *pColor,
+                           _In_ bool bColorKey, _In_ float alphaRef, _In_ DWORD flags)
+{
+    assert( pBC && pColor );
+    assert( !(flags & BC_FLAGS_DITHER_RGB) );
+    static_assert( sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes" );
+
+    const XMVECTOR vAlphaRef = XMVectorReplicate( alphaRef );
+
+    // Determine which lanes need to colorkey
+    XMVECTORU32 uUse3;
+    uUse3.v = XMVectorFalseInt();
+
+    XMVECTORU32 uColorKeyAll;
+    uColorKeyAll.v = XMVectorFalseInt();
+
+    if (bColorKey)
+    {
+        XMVECTOR fColorKey = XMVectorZero();
+
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            fColorKey = XMVectorAdd( fColorKey, XMVectorSelect( g_XMZero, g_XMOne, XMVectorLess( pColor[i].r[3], vAlphaRef ) ) );
+        }
+
+        uUse3.v = XMVectorGreater( fColorKey, g_XMZero );
+        uColorKeyAll.v = XMVectorEqual( fColorKey, XMVectorReplicate( (float) NUM_PIXELS_PER_BLOCK ) );
+    }
+
+    // Quantize block to R56B5
+    static const XMVECTORF32 s_Scale = { 31.0f, 63.0f, 31.0f, 1.0f };
+    static const XMVECTORF32 s_ScaleInv = { 1.0f / 31.0f, 1.0f / 63.0f, 1.0f / 31.0f, 1.0f };
+
+    XMVECTOR Color[NUM_PIXELS_PER_BLOCK * 3];
+    XMVECTOR Lum[3];
+    Lum[0] = XMVectorReplicate( g_Luminance.r );
+    Lum[1] = XMVectorReplicate( g_Luminance.g );
+    Lum[2] = XMVectorReplicate( g_Luminance.b );
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            XMVECTOR Clr = XMVectorAdd( XMVectorMultiply( pColor[i].r[iChannel], XMVectorReplicate( s_Scale.f[iChannel] ) ), g_XMOneHalf );
+            Clr = XMVectorMultiply( XMVectorTruncate( Clr ), XMVectorReplicate( s_ScaleInv.f[iChannel] ) );
+
+            if ( !( flags & BC_FLAGS_UNIFORM ) )
+                Clr = XMVectorMultiply( Clr, Lum[iChannel] );
+
+            Color[i*3 + iChannel] = Clr;
+        }
+    }
+
+    // Perform 6D root finding function to find two endpoints of color axis.
+    XMVECTORF32 EndPtA[3], EndPtB[3];
+    {
+        XMVECTOR vA[3], vB[3];
+        OptimizeRGBBatch(vA, vB, Color, uUse3, flags);
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            EndPtA[iChannel].v = vA[iChannel];
+            EndPtB[iChannel].v = vB[iChannel];
+        }
+    }
+
+    // Quantize and sort the endpoints of each lane, as in EncodeBC1
+    XMVECTORF32 Step0[3], Dir[3], fStepsLane;
+    bool bEncode[BC_BATCH_LANES];
+
+    for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+    {
+        bEncode[iLane] = false;
+
+        Step0[0].f[iLane] = Step0[1].f[iLane] = Step0[2].f[iLane] = 0.0f;
+        Dir[0].f[iLane] = Dir[1].f[iLane] = Dir[2].f[iLane] = 0.0f;
+        fStepsLane.f[iLane] = 3.0f;
+
+        if (uColorKeyAll.u[iLane])
+        {
+            pBC[iLane]->rgb[0] = 0x0000;
+            pBC[iLane]->rgb[1] = 0xffff;
+            pBC[iLane]->bitmap = 0xffffffff;
+            continue;
+        }
+
+        size_t uSteps = (uUse3.u[iLane]) ? 3 : 4;
+
+        HDRColorA ColorA, ColorB, ColorC, ColorD;
+        ColorA.r = EndPtA[0].f[iLane]; ColorA.g = EndPtA[1].f[iLane]; ColorA.b = EndPtA[2].f[iLane];
+        ColorB.r = EndPtB[0].f[iLane]; ColorB.g = EndPtB[1].f[iLane]; ColorB.b = EndPtB[2].f[iLane];
+
+        if ( flags & BC_FLAGS_UNIFORM )
+        {
+            ColorC = ColorA;
+            ColorD = ColorB;
+        }
+        else
+        {
+            ColorC.r = ColorA.r * g_LuminanceInv.r;
+            ColorC.g = ColorA.g * g_LuminanceInv.g;
+            ColorC.b = ColorA.b * g_LuminanceInv.b;
+
+            ColorD.r = ColorB.r * g_LuminanceInv.r;
+            ColorD.g = ColorB.g * g_LuminanceInv.g;
+            ColorD.b = ColorB.b * g_LuminanceInv.b;
+        }
+
+        uint16_t wColorA = Encode565(&ColorC);
+        uint16_t wColorB = Encode565(&ColorD);
+
+        if((uSteps == 4) && (wColorA == wColorB))
+        {
+            pBC[iLane]->rgb[0] = wColorA;
+            pBC[iLane]->rgb[1] = wColorB;
+            pBC[iLane]->bitmap = 0x00000000;
+            continue;
+        }
+
+        Decode565(&ColorC, wColorA);
+        Decode565(&ColorD, wColorB);
+
+        if ( flags & BC_FLAGS_UNIFORM )
+        {
+            ColorA = ColorC;
+            ColorB = ColorD;
+        }
+        else
+        {
+            ColorA.r = ColorC.r * g_Luminance.r;
+            ColorA.g = ColorC.g * g_Luminance.g;
+            ColorA.b = ColorC.b * g_Luminance.b;
+
+            ColorB.r = ColorD.r * g_Luminance.r;
+            ColorB.g = ColorD.g * g_Luminance.g;
+            ColorB.b = ColorD.b * g_Luminance.b;
+        }
+
+        // Calculate color steps
+        HDRColorA Step[2];
+
+        if((3 == uSteps) == (wColorA <= wColorB))
+        {
+            pBC[iLane]->rgb[0] = wColorA;
+            pBC[iLane]->rgb[1] = wColorB;
+
+            Step[0] = ColorA;
+            Step[1] = ColorB;
+        }
+        else
+        {
+            pBC[iLane]->rgb[0] = wColorB;
+            pBC[iLane]->rgb[1] = wColorA;
+
+            Step[0] = ColorB;
+            Step[1] = ColorA;
+        }
+
+        // Calculate color direction
+        HDRColorA vDir;
+
+        vDir.r = Step[1].r - Step[0].r;
+        vDir.g = Step[1].g - Step[0].g;
+        vDir.b = Step[1].b - Step[0].b;
+
+        float fSteps = (float) (uSteps - 1);
+        float fScale = (wColorA != wColorB) ? (fSteps / (vDir.r * vDir.r + vDir.g * vDir.g + vDir.b * vDir.b)) : 0.0f;
+
+        Step0[0].f[iLane] = Step[0].r;
+        Step0[1].f[iLane] = Step[0].g;
+        Step0[2].f[iLane] = Step[0].b;
+
+        Dir[0].f[iLane] = vDir.r * fScale;
+        Dir[1].f[iLane] = vDir.g * fScale;
+        Dir[2].f[iLane] = vDir.b * fScale;
+
+        fStepsLane.f[iLane] = fSteps;
+        bEncode[iLane] = true;
+    }
+
+    // Encode colors; the step order is { 0, 2, 1 } or { 0, 2, 3, 1 }, so interior steps map to index + 1
+    uint32_t dw[BC_BATCH_LANES] = { 0, 0, 0, 0 };
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMVECTOR Clr[3];
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            Clr[iChannel] = pColor[i].r[iChannel];
+
+            if ( !( flags & BC_FLAGS_UNIFORM ) )
+                Clr[iChannel] = XMVectorMultiply( Clr[iChannel], Lum[iChannel] );
+        }
+
+        XMVECTOR fDot = XMVectorAdd( XMVectorAdd( XMVectorMultiply( XMVectorSubtract( Clr[0], Step0[0] ), Dir[0] ),
+                                                  XMVectorMultiply( XMVectorSubtract( Clr[1], Step0[1] ), Dir[1] ) ),
+                                     XMVectorMultiply( XMVectorSubtract( Clr[2], Step0[2] ), Dir[2] ) );
+
+        XMVECTOR fStep = XMVectorTruncate( XMVectorAdd( fDot, g_XMOneHalf ) );
+        fStep = XMVectorSelect( XMVectorAdd( fStep, g_XMOne ), fStep, XMVectorEqual( fStep, g_XMZero ) );
+        fStep = XMVectorSelect( fStep, g_XMOne, XMVectorEqual( fStep, XMVectorAdd( fStepsLane, g_XMOne ) ) );
+        fStep = XMVectorSelect( fStep, g_XMOne, XMVectorGreaterOrEqual( fDot, fStepsLane ) );
+        fStep = XMVectorSelect( fStep, g_XMZero, XMVectorLessOrEqual( fDot, g_XMZero ) );
+
+        XMVECTOR vKey = XMVectorAndInt( uUse3, XMVectorLess( pColor[i].r[3], vAlphaRef ) );
+        fStep = XMVectorSelect( fStep, XMVectorReplicate( 3.0f ), vKey );
+
+        XMVECTORF32 fIndex;
+        fIndex.v = fStep;
+
+        for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            dw[iLane] |= static_cast<uint32_t>( fIndex.f[iLane] ) << (i * 2);
+        }
+    }
+
+    for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+    {
+        if (bEncode[iLane])
+            pBC[iLane]->bitmap = dw[iLane];
+    }
+}
+#endif // !COLOR_WEIGHTS
+
+
 //-------------------------------------------------------------------------------------
 #ifdef COLOR_WEIGHTS
 static void EncodeSolidBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor)
@@ -1138,4 +1571,267 @@ void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
     }
 }
 
+
+//-------------------------------------------------------------------------------------
+// Batched BC1-BC3 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXEncodeBC1Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, float alphaRef, DWORD flags)
+{
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A)) )
+    {
+        XMMATRIX aColor[NUM_PIXELS_PER_BLOCK];
+        D3DX_BC1 unused[BC_BATCH_LANES];
+
+        for(size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+        {
+            size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+            LoadBlocksSoA( aColor, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+            D3DX_BC1 *pBC1[BC_BATCH_LANES];
+            for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+            {
+                pBC1[iLane] = (iLane < nLanes) ? reinterpret_cast<D3DX_BC1 *>(pBC) + iBlock + iLane : &unused[iLane];
+            }
+
+            EncodeBC1Batch(pBC1, aColor, true, alphaRef, flags);
+        }
+        return;
+    }
+#endif // !COLOR_WEIGHTS
+
+    // Dithered blocks are encoded one at a time
+    for(size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+    {
+        D3DXEncodeBC1(pBC + iBlock * sizeof(D3DX_BC1), pColor + iBlock * NUM_PIXELS_PER_BLOCK, alphaRef, flags);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC2Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags)
+{
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A)) )
+    {
+        XMMATRIX aColor[NUM_PIXELS_PER_BLOCK];
+        D3DX_BC2 unused[BC_BATCH_LANES];
+
+        for(size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+        {
+            size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+            LoadBlocksSoA( aColor, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+            D3DX_BC2 *pBC2[BC_BATCH_LANES];
+            D3DX_BC1 *pBC1[BC_BATCH_LANES];
+            for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+            {
+                pBC2[iLane] = (iLane < nLanes) ? reinterpret_cast<D3DX_BC2 *>(pBC) + iBlock + iLane : &unused[iLane];
+                pBC1[iLane] = &pBC2[iLane]->bc1;
+                pBC2[iLane]->bitmap[0] = 0;
+                pBC2[iLane]->bitmap[1] = 0;
+            }
+
+            // 4-bit alpha part
+            for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                XMVECTORF32 fAlph;
+                fAlph.v = XMVectorTruncate( XMVectorAdd( XMVectorMultiply( aColor[i].r[3], XMVectorReplicate( 15.0f ) ), g_XMOneHalf ) );
+
+                for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+                {
+                    uint32_t u = (uint32_t) static_cast<int32_t>( fAlph.f[iLane] );
+                    pBC2[iLane]->bitmap[i >> 3] |= (u & 0xf) << ((i & 7) * 4);
+                }
+            }
+
+            // RGB part
+            EncodeBC1Batch(pBC1, aColor, false, 0.f, flags);
+        }
+        return;
+    }
+#endif // !COLOR_WEIGHTS
+
+    // Dithered blocks are encoded one at a time
+    for(size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+    {
+        D3DXEncodeBC2(pBC + iBlock * sizeof(D3DX_BC2), pColor + iBlock * NUM_PIXELS_PER_BLOCK, flags);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC3Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags)
+{
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A)) )
+    {
+        XMMATRIX aColor[NUM_PIXELS_PER_BLOCK];
+        D3DX_BC3 unused[BC_BATCH_LANES];
+
+        for(size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+        {
+            size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+            LoadBlocksSoA( aColor, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+            D3DX_BC3 *pBC3[BC_BATCH_LANES];
+            D3DX_BC1 *pBC1[BC_BATCH_LANES];
+            for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+            {
+                pBC3[iLane] = (iLane < nLanes) ? reinterpret_cast<D3DX_BC3 *>(pBC) + iBlock + iLane : &unused[iLane];
+                pBC1[iLane] = &pBC3[iLane]->bc1;
+            }
+
+            // Quantize block to A8
+            XMVECTOR fAlpha[NUM_PIXELS_PER_BLOCK];
+
+            XMVECTOR vMinAlpha = aColor[0].r[3];
+            XMVECTOR vMaxAlpha = aColor[0].r[3];
+
+            for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                XMVECTOR fAlph = XMVectorAdd( XMVectorMultiply( aColor[i].r[3], XMVectorReplicate( 255.0f ) ), g_XMOneHalf );
+                fAlpha[i] = XMVectorMultiply( XMVectorTruncate( fAlph ), XMVectorReplicate( 1.0f / 255.0f ) );
+
+                vMinAlpha = XMVectorMin( fAlpha[i], vMinAlpha );
+                vMaxAlpha = XMVectorMax( fAlpha[i], vMaxAlpha );
+            }
+
+            // RGB part
+            EncodeBC1Batch(pBC1, aColor, false, 0.f, flags);
+
+            // Optimize and Quantize Min and Max values
+            XMVECTORF32 fMinAlpha;
+            fMinAlpha.v = vMinAlpha;
+
+            XMVECTORU32 uUse6;
+            uUse6.v = XMVectorOrInt( XMVectorEqual( vMinAlpha, g_XMZero ), XMVectorEqual( vMaxAlpha, g_XMOne ) );
+
+            XMVECTORF32 fAlphaA, fAlphaB;
+            OptimizeAlphaBatch<false>(&fAlphaA.v, &fAlphaB.v, fAlpha, uUse6);
+
+            // Setup blocks
+            XMVECTORF32 fStep0, fStep1, fScale, fSteps;
+            bool bEncode[BC_BATCH_LANES];
+
+            for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+            {
+                bEncode[iLane] = false;
+                fStep0.f[iLane] = fStep1.f[iLane] = fScale.f[iLane] = 0.0f;
+                fSteps.f[iLane] = 7.0f;
+
+                D3DX_BC3 *pBlock = pBC3[iLane];
+
+                if(1.0f == fMinAlpha.f[iLane])
+                {
+                    pBlock->alpha[0] = 0xff;
+                    pBlock->alpha[1] = 0xff;
+                    memset(pBlock->bitmap, 0x00, 6);
+                    continue;
+                }
+
+                size_t uSteps = (uUse6.u[iLane]) ? 6 : 8;
+
+                uint8_t bAlphaA = (uint8_t) static_cast<int32_t>(fAlphaA.f[iLane] * 255.0f + 0.5f);
+                uint8_t bAlphaB = (uint8_t) static_cast<int32_t>(fAlphaB.f[iLane] * 255.0f + 0.5f);
+
+                float fA = (float) bAlphaA * (1.0f / 255.0f);
+                float fB = (float) bAlphaB * (1.0f / 255.0f);
+
+                if((8 == uSteps) && (bAlphaA == bAlphaB))
+                {
+                    pBlock->alpha[0] = bAlphaA;
+                    pBlock->alpha[1] = bAlphaB;
+                    memset(pBlock->bitmap, 0x00, 6);
+                    continue;
+                }
+
+                if(6 == uSteps)
+                {
+                    pBlock->alpha[0] = bAlphaA;
+                    pBlock->alpha[1] = bAlphaB;
+
+                    fStep0.f[iLane] = fA;
+                    fStep1.f[iLane] = fB;
+                }
+                else
+                {
+                    pBlock->alpha[0] = bAlphaB;
+                    pBlock->alpha[1] = bAlphaA;
+
+                    fStep0.f[iLane] = fB;
+                    fStep1.f[iLane] = fA;
+                }
+
+                float fLaneSteps = (float) (uSteps - 1);
+                fSteps.f[iLane] = fLaneSteps;
+                fScale.f[iLane] = (fStep0.f[iLane] != fStep1.f[iLane]) ? (fLaneSteps / (fStep1.f[iLane] - fStep0.f[iLane])) : 0.0f;
+                bEncode[iLane] = true;
+            }
+
+            // Encode alpha bitmap; the step order is { 0, 2, 3, 4, 5, 1 } or { 0, 2, 3, 4, 5, 6, 7, 1 },
+            // so interior steps map to index + 1
+            uint32_t dw[BC_BATCH_LANES][2] = { 0 };
+
+            const XMVECTOR fLowFixed = XMVectorMultiply( fStep0, g_XMOneHalf );
+            const XMVECTOR fHighFixed = XMVectorMultiply( XMVectorAdd( fStep1, g_XMOne ), g_XMOneHalf );
+
+            for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                XMVECTOR fAlph = aColor[i].r[3];
+                XMVECTOR fDot = XMVectorMultiply( XMVectorSubtract( fAlph, fStep0 ), fScale );
+
+                XMVECTOR fStep = XMVectorTruncate( XMVectorAdd( fDot, g_XMOneHalf ) );
+                fStep = XMVectorSelect( XMVectorAdd( fStep, g_XMOne ), fStep, XMVectorEqual( fStep, g_XMZero ) );
+                fStep = XMVectorSelect( fStep, g_XMOne, XMVectorEqual( fStep, XMVectorAdd( fSteps, g_XMOne ) ) );
+
+                XMVECTOR vHighFixed = XMVectorAndInt( uUse6, XMVectorGreaterOrEqual( fAlph, fHighFixed ) );
+                XMVECTOR fHigh = XMVectorSelect( g_XMOne, XMVectorReplicate( 7.0f ), vHighFixed );
+                fStep = XMVectorSelect( fStep, fHigh, XMVectorGreaterOrEqual( fDot, fSteps ) );
+
+                XMVECTOR vLowFixed = XMVectorAndInt( uUse6, XMVectorLessOrEqual( fAlph, fLowFixed ) );
+                XMVECTOR fLow = XMVectorSelect( g_XMZero, XMVectorReplicate( 6.0f ), vLowFixed );
+                fStep = XMVectorSelect( fStep, fLow, XMVectorLessOrEqual( fDot, g_XMZero ) );
+
+                XMVECTORF32 fIndex;
+                fIndex.v = fStep;
+
+                for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+                {
+                    dw[iLane][i >> 3] |= static_cast<uint32_t>( fIndex.f[iLane] ) << ((i & 7) * 3);
+                }
+            }
+
+            for(size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+            {
+                if (!bEncode[iLane])
+                    continue;
+
+                for(size_t iSet = 0; iSet < 2; iSet++)
+                {
+                    pBC3[iLane]->bitmap[0 + iSet * 3] = ((uint8_t *) &dw[iLane][iSet])[0];
+                    pBC3[iLane]->bitmap[1 + iSet * 3] = ((uint8_t *) &dw[iLane][iSet])[1];
+                    pBC3[iLane]->bitmap[2 + iSet * 3] = ((uint8_t *) &dw[iLane][iSet])[2];
+                }
+            }
+        }
+        return;
+    }
+#endif // !COLOR_WEIGHTS
+
+    // Dithered blocks are encoded one at a time
+    for(size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+    {
+        D3DXEncodeBC3(pBC + iBlock * sizeof(D3DX_BC3), pColor + iBlock * NUM_PIXELS_PER_BLOCK, flags);
+    }
+}
+
 } // namespace
@@ -49,6 +49,9 @@ const size_t BC6H_MAX_SHAPES = 32;
 const size_t BC7_NUM_CHANNELS = 4;
 const size_t BC7_MAX_SHAPES = 64;
 
+const size_t BC_MAX_BATCH = 16;     // most blocks accepted by one batched encoder call
+const size_t BC_BATCH_LANES = 4;    // blocks encoded side by side, one per XMVECTOR lane
+
 const int32_t BC67_WEIGHT_MAX = 64;
 const uint32_t BC67_WEIGHT_SHIFT = 6;
 const int32_t BC67_WEIGHT_ROUND = 32;
@@ -63,6 +66,8 @@ enum BC_FLAGS
     BC_FLAGS_DITHER_RGB = 0x10000,  // Enables dithering for RGB colors for BC1-3
     BC_FLAGS_DITHER_A   = 0x20000,  // Enables dithering for Alpha channel for BC1-3
     BC_FLAGS_UNIFORM    = 0x40000,  // By default, uses perceptual weighting for BC1-3; this flag makes it a uniform weighting
+    BC_FLAGS_BC67_FAST    = 0x100000, // Prunes the BC6H/BC7 mode and partition search and stops early once the error is small
+    BC_FLAGS_BC67_FASTEST = 0x200000, // Searches only the most useful BC6H/BC7 modes; takes precedence over BC_FLAGS_BC67_FAST
 };
 
 //-------------------------------------------------------------------------------------
@@ -523,7 +528,7 @@ class D3DX_BC6H : private CBits< 16 >
 {
 public:
     void Decode(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(_In_ bool bSigned, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ bool bSigned, _In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
     enum EField : uint8_t
@@ -624,7 +629,7 @@ class D3DX_BC7 : private CBits< 16 >
 {
 public:
     void Decode(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(_In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
     struct ModeInfo
@@ -712,6 +717,7 @@ private:
                    _In_reads_(NUM_PIXELS_PER_BLOCK) const size_t aIndex[],
                    _In_reads_(NUM_PIXELS_PER_BLOCK) const size_t aIndex2[]);
     float Refine(_In_ const EncodeParams* pEP, _In_ size_t uShape, _In_ size_t uRotation, _In_ size_t uIndexMode);
+    void EncodeSingleColor(_Inout_ EncodeParams* pEP, _In_ const LDRColorA& color);
 
     float MapColors(_In_ const EncodeParams* pEP, _In_reads_(np) const LDRColorA aColors[], _In_ size_t np, _In_ size_t uIndexMode,
                     _In_ const LDREndPntPair& endPts, _In_ float fMinErr) const;
@@ -854,8 +860,130 @@ template <bool bRange> void OptimizeAlpha(float *pX, float *pY, const float *pPo
     *pX = (fX < MIN_VALUE) ? MIN_VALUE : (fX > MAX_VALUE) ? MAX_VALUE : fX;
     *pY = (fY < MIN_VALUE) ? MIN_VALUE : (fY > MAX_VALUE) ? MAX_VALUE : fY;
 }
+
+//-------------------------------------------------------------------------------------
+// OptimizeAlpha for BC_BATCH_LANES blocks at once; each lane holds one block (see
+// LoadBlocksSoA). vUse6 selects the 6-step codec per lane. Lanes leave the Newton
+// iteration independently, so every lane matches the scalar OptimizeAlpha bit for bit.
+//-------------------------------------------------------------------------------------
+template <bool bRange> void OptimizeAlphaBatch(XMVECTOR *pX, XMVECTOR *pY, const XMVECTOR *pPoints, FXMVECTOR vUse6)
+{
+    const XMVECTOR MAX_VALUE = g_XMOne;
+    const XMVECTOR MIN_VALUE = (bRange) ? g_XMNegativeOne : g_XMZero;
+
+    // cSteps - 1 for each lane
+    const XMVECTOR fSteps = XMVectorSelect( XMVectorReplicate( 7.0f ), XMVectorReplicate( 5.0f ), vUse6 );
+
+    // Find Min and Max points, as starting point
+    XMVECTOR fX = MAX_VALUE;
+    XMVECTOR fY = MIN_VALUE;
+    XMVECTOR fX6 = MAX_VALUE;
+    XMVECTOR fY6 = MIN_VALUE;
+
+    for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+    {
+        XMVECTOR fPoint = pPoints[iPoint];
+
+        fX = XMVectorMin( fPoint, fX );
+        fY = XMVectorMax( fPoint, fY );
+
+        fX6 = XMVectorSelect( fX6, XMVectorMin( fPoint, fX6 ), XMVectorGreater( fPoint, MIN_VALUE ) );
+        fY6 = XMVectorSelect( fY6, XMVectorMax( fPoint, fY6 ), XMVectorLess( fPoint, MAX_VALUE ) );
+    }
+
+    fY6 = XMVectorSelect( fY6, MAX_VALUE, XMVectorEqual( fX6, fY6 ) );
+
+    fX = XMVectorSelect( fX, fX6, vUse6 );
+    fY = XMVectorSelect( fY, fY6, vUse6 );
+
+    // Use Newton's Method to find local minima of sum-of-squares error.
+    const XMVECTOR fHalf = g_XMOneHalf;
+    XMVECTOR vActive = XMVectorTrueInt();
+
+    for(size_t iIteration = 0; iIteration < 8; iIteration++)
+    {
+        XMVECTOR fRange = XMVectorSubtract( fY, fX );
+
+        vActive = XMVectorAndCInt( vActive, XMVectorLess( fRange, XMVectorReplicate( 1.0f / 256.0f ) ) );
+        if ( XMVector4EqualInt( vActive, XMVectorFalseInt() ) )
+            break;
+
+        XMVECTOR fScale = XMVectorDivide( fSteps, fRange );
+
+        // Evaluate function, and derivatives
+        XMVECTOR dX  = XMVectorZero();
+        XMVECTOR dY  = XMVectorZero();
+        XMVECTOR d2X = XMVectorZero();
+        XMVECTOR d2Y = XMVectorZero();
+
+        for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+        {
+            XMVECTOR fPoint = pPoints[iPoint];
+            XMVECTOR fDot = XMVectorMultiply( XMVectorSubtract( fPoint, fX ), fScale );
+
+            XMVECTOR vLow = XMVectorLessOrEqual( fDot, g_XMZero );
+            XMVECTOR vHigh = XMVectorAndCInt( XMVectorGreaterOrEqual( fDot, fSteps ), vLow );
+
+            XMVECTOR fStep = XMVectorTruncate( XMVectorAdd( fDot, fHalf ) );
+            fStep = XMVectorSelect( fStep, g_XMZero, vLow );
+            fStep = XMVectorSelect( fStep, fSteps, vHigh );
+
+            // Points mapped to the fixed MIN_VALUE/MAX_VALUE codes of the 6-step codec don't contribute
+            XMVECTOR vFixed = XMVectorOrInt( XMVectorAndInt( vLow, XMVectorLessOrEqual( fPoint, XMVectorMultiply( fX, fHalf ) ) ),
+                                             XMVectorAndInt( vHigh, XMVectorGreaterOrEqual( fPoint, XMVectorMultiply( XMVectorAdd( fY, g_XMOne ), fHalf ) ) ) );
+            XMVECTOR vValid = XMVectorAndCInt( XMVectorTrueInt(), XMVectorAndInt( vFixed, vUse6 ) );
+
+            XMVECTOR fC = XMVectorDivide( XMVectorSubtract( fSteps, fStep ), fSteps );
+            XMVECTOR fD = XMVectorDivide( fStep, fSteps );
+
+            XMVECTOR fDiff = XMVectorSubtract( XMVectorAdd( XMVectorMultiply( fC, fX ), XMVectorMultiply( fD, fY ) ), fPoint );
+
+            dX  = XMVectorSelect( dX,  XMVectorAdd( dX,  XMVectorMultiply( fC, fDiff ) ), vValid );
+            d2X = XMVectorSelect( d2X, XMVectorAdd( d2X, XMVectorMultiply( fC, fC ) ), vValid );
+
+            dY  = XMVectorSelect( dY,  XMVectorAdd( dY,  XMVectorMultiply( fD, fDiff ) ), vValid );
+            d2Y = XMVectorSelect( d2Y, XMVectorAdd( d2Y, XMVectorMultiply( fD, fD ) ), vValid );
+        }
+
+        // Move endpoints
+        XMVECTOR fNewX = XMVectorSelect( fX, XMVectorSubtract( fX, XMVectorDivide( dX, d2X ) ), XMVectorGreater( d2X, g_XMZero ) );
+        XMVECTOR fNewY = XMVectorSelect( fY, XMVectorSubtract( fY, XMVectorDivide( dY, d2Y ) ), XMVectorGreater( d2Y, g_XMZero ) );
+
+        XMVECTOR vSwap = XMVectorGreater( fNewX, fNewY );
+        fX = XMVectorSelect( fX, XMVectorSelect( fNewX, fNewY, vSwap ), vActive );
+        fY = XMVectorSelect( fY, XMVectorSelect( fNewY, fNewX, vSwap ), vActive );
+
+        const XMVECTOR fEpsilon = XMVectorReplicate( 1.0f / 64.0f );
+        vActive = XMVectorAndCInt( vActive, XMVectorAndInt( XMVectorLess( XMVectorMultiply( dX, dX ), fEpsilon ),
+                                                            XMVectorLess( XMVectorMultiply( dY, dY ), fEpsilon ) ) );
+    }
+
+    *pX = XMVectorClamp( fX, MIN_VALUE, MAX_VALUE );
+    *pY = XMVectorClamp( fY, MIN_VALUE, MAX_VALUE );
+}
 #pragma warning(pop)
 
+//-------------------------------------------------------------------------------------
+// Transposes up to BC_BATCH_LANES consecutive blocks so that aTexels[i].r[c] holds channel
+// c of texel i with one block per lane. Missing trailing blocks repeat the first block.
+//-------------------------------------------------------------------------------------
+inline void LoadBlocksSoA(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMMATRIX *aTexels,
+                          _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_range_(1,BC_BATCH_LANES) size_t nBlocks)
+{
+    assert( aTexels && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_BATCH_LANES );
+
+    const XMVECTOR *pBlock1 = pColor + ( (nBlocks > 1) ? NUM_PIXELS_PER_BLOCK : 0 );
+    const XMVECTOR *pBlock2 = pColor + ( (nBlocks > 2) ? NUM_PIXELS_PER_BLOCK*2 : 0 );
+    const XMVECTOR *pBlock3 = pColor + ( (nBlocks > 3) ? NUM_PIXELS_PER_BLOCK*3 : 0 );
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMMATRIX M( pColor[i], pBlock1[i], pBlock2[i], pBlock3[i] );
+        aTexels[i] = XMMatrixTranspose( M );
+    }
+}
+
 
 //-------------------------------------------------------------------------------------
 // Functions
@@ -863,6 +991,7 @@ template <bool bRange> void OptimizeAlpha(float *pX, float *pY, const float *pPo
 
 typedef void (*BC_DECODE)(XMVECTOR *pColor, const uint8_t *pBC);
 typedef void (*BC_ENCODE)(uint8_t *pDXT, const XMVECTOR *pColor, DWORD flags);
+typedef void (*BC_ENCODE_BATCH)(uint8_t *pDXT, const XMVECTOR *pColor, size_t nBlocks, DWORD flags);
 
 void D3DXDecodeBC1(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(8) const uint8_t *pBC);
 void D3DXDecodeBC2(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC);
@@ -888,4 +1017,21 @@ void D3DXEncodeBC6HU(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BL
 void D3DXEncodeBC6HS(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 void D3DXEncodeBC7(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 
+// Batched encoders: nBlocks (1 to BC_MAX_BATCH) blocks of NUM_PIXELS_PER_BLOCK colors stored back to back,
+// compressed into consecutive output blocks. Results are identical to calling the encoders above per block.
+void D3DXEncodeBC1Batch(_Out_writes_(nBlocks*8) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                        _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ float alphaRef, _In_ DWORD flags);
+void D3DXEncodeBC2Batch(_Out_writes_(nBlocks*16) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                        _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+void D3DXEncodeBC3Batch(_Out_writes_(nBlocks*16) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                        _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+void D3DXEncodeBC4UBatch(_Out_writes_(nBlocks*8) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                         _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+void D3DXEncodeBC4SBatch(_Out_writes_(nBlocks*8) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                         _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+void D3DXEncodeBC5UBatch(_Out_writes_(nBlocks*16) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                         _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+void D3DXEncodeBC5SBatch(_Out_writes_(nBlocks*16) uint8_t *pBC, _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                         _In_range_(1,BC_MAX_BATCH) size_t nBlocks, _In_ DWORD flags);
+
 }; // namespace
@@ -362,6 +362,116 @@ static void FindClosestSNORM(_Inout_ BC4_SNORM* pBC, _In_reads_(NUM_PIXELS_PER_B
 }
 
 
+//------------------------------------------------------------------------------
+// Batched versions of the above: each XMVECTOR lane holds one of BC_BATCH_LANES blocks
+//------------------------------------------------------------------------------
+static void FindEndPointsBC4UBatch( _In_reads_(BLOCK_SIZE) const XMVECTOR theTexelsU[], _In_reads_(BC_BATCH_LANES) BC4_UNORM* pBC[] )
+{
+    // Find max/min of input texels
+    XMVECTOR fBlockMax = theTexelsU[0];
+    XMVECTOR fBlockMin = theTexelsU[0];
+    for (size_t i = 1; i < BLOCK_SIZE; ++i)
+    {
+        fBlockMin = XMVectorMin( theTexelsU[i], fBlockMin );
+        fBlockMax = XMVectorMax( theTexelsU[i], fBlockMax );
+    }
+
+    // Lanes with boundary values use the 6-step codec, as in FindEndPointsBC4U
+    XMVECTORU32 bUsing4BlockCodec;
+    bUsing4BlockCodec.v = XMVectorOrInt( XMVectorEqual( fBlockMin, g_XMZero ), XMVectorEqual( fBlockMax, g_XMOne ) );
+
+    XMVECTORF32 fStart, fEnd;
+    OptimizeAlphaBatch<false>( &fStart.v, &fEnd.v, theTexelsU, bUsing4BlockCodec );
+
+    for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+    {
+        uint8_t iStart = (uint8_t) (fStart.f[iLane] * 255.0f);
+        uint8_t iEnd   = (uint8_t) (fEnd.f[iLane]   * 255.0f);
+
+        if (!bUsing4BlockCodec.u[iLane])
+        {
+            pBC[iLane]->red_0 = iEnd;
+            pBC[iLane]->red_1 = iStart;
+        }
+        else
+        {
+            pBC[iLane]->red_1 = iEnd;
+            pBC[iLane]->red_0 = iStart;
+        }
+    }
+}
+
+static void FindEndPointsBC4SBatch( _In_reads_(BLOCK_SIZE) const XMVECTOR theTexelsU[], _In_reads_(BC_BATCH_LANES) BC4_SNORM* pBC[] )
+{
+    // Find max/min of input texels
+    XMVECTOR fBlockMax = theTexelsU[0];
+    XMVECTOR fBlockMin = theTexelsU[0];
+    for (size_t i = 1; i < BLOCK_SIZE; ++i)
+    {
+        fBlockMin = XMVectorMin( theTexelsU[i], fBlockMin );
+        fBlockMax = XMVectorMax( theTexelsU[i], fBlockMax );
+    }
+
+    // Lanes with boundary values use the 6-step codec, as in FindEndPointsBC4S
+    XMVECTORU32 bUsing4BlockCodec;
+    bUsing4BlockCodec.v = XMVectorOrInt( XMVectorEqual( fBlockMin, g_XMNegativeOne ), XMVectorEqual( fBlockMax, g_XMOne ) );
+
+    XMVECTORF32 fStart, fEnd;
+    OptimizeAlphaBatch<true>( &fStart.v, &fEnd.v, theTexelsU, bUsing4BlockCodec );
+
+    for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+    {
+        int8_t iStart, iEnd;
+        FloatToSNorm(fStart.f[iLane], &iStart);
+        FloatToSNorm(fEnd.f[iLane], &iEnd);
+
+        if (!bUsing4BlockCodec.u[iLane])
+        {
+            pBC[iLane]->red_0 = iEnd;
+            pBC[iLane]->red_1 = iStart;
+        }
+        else
+        {
+            pBC[iLane]->red_1 = iEnd;
+            pBC[iLane]->red_0 = iStart;
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+template <class BC4> static void FindClosestBatch(_In_reads_(BC_BATCH_LANES) BC4* pBC[], _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR theTexelsU[])
+{
+    XMVECTOR rGradient[8];
+    for (size_t uIndex = 0; uIndex < 8; ++uIndex)
+    {
+        XMVECTORF32 fGradient;
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            fGradient.f[iLane] = pBC[iLane]->DecodeFromIndex(uIndex);
+        }
+        rGradient[uIndex] = fGradient;
+    }
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMVECTORU32 uBestIndex;
+        uBestIndex.v = XMVectorZero();
+        XMVECTOR fBestDelta = XMVectorReplicate( 100000.f );
+        for (uint32_t uIndex = 0; uIndex < 8; uIndex++)
+        {
+            XMVECTOR fCurrentDelta = XMVectorAbs( XMVectorSubtract( rGradient[uIndex], theTexelsU[i] ) );
+            XMVECTOR vBetter = XMVectorLess( fCurrentDelta, fBestDelta );
+            uBestIndex.v = XMVectorSelect( uBestIndex, XMVectorReplicateInt( uIndex ), vBetter );
+            fBestDelta = XMVectorSelect( fBestDelta, fCurrentDelta, vBetter );
+        }
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            pBC[iLane]->SetIndex(i, uBestIndex.u[iLane]);
+        }
+    }
+}
+
+
 //=====================================================================================
 // Entry points
 //=====================================================================================
@@ -545,4 +655,168 @@ void D3DXEncodeBC5S( uint8_t *pBC, const XMVECTOR *pColor, DWORD flags )
     FindClosestSNORM(pBCG, theTexelsV);
 }
 
+
+//-------------------------------------------------------------------------------------
+// Batched BC4/BC5 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXEncodeBC4UBatch( uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags )
+{
+    UNREFERENCED_PARAMETER( flags );
+
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+    memset(pBC, 0, sizeof(BC4_UNORM)*nBlocks);
+    BC4_UNORM unused[BC_BATCH_LANES];
+    memset(unused, 0, sizeof(unused));
+
+    XMMATRIX aTexels[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsU[NUM_PIXELS_PER_BLOCK];
+
+    for (size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+    {
+        size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+        LoadBlocksSoA( aTexels, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+        BC4_UNORM* pBC4[BC_BATCH_LANES];
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            pBC4[iLane] = (iLane < nLanes) ? reinterpret_cast<BC4_UNORM*>(pBC) + iBlock + iLane : &unused[iLane];
+        }
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            theTexelsU[i] = aTexels[i].r[0];
+        }
+
+        FindEndPointsBC4UBatch(theTexelsU, pBC4);
+        FindClosestBatch(pBC4, theTexelsU);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC4SBatch( uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags )
+{
+    UNREFERENCED_PARAMETER( flags );
+
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+    memset(pBC, 0, sizeof(BC4_SNORM)*nBlocks);
+    BC4_SNORM unused[BC_BATCH_LANES];
+    memset(unused, 0, sizeof(unused));
+
+    XMMATRIX aTexels[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsU[NUM_PIXELS_PER_BLOCK];
+
+    for (size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+    {
+        size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+        LoadBlocksSoA( aTexels, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+        BC4_SNORM* pBC4[BC_BATCH_LANES];
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            pBC4[iLane] = (iLane < nLanes) ? reinterpret_cast<BC4_SNORM*>(pBC) + iBlock + iLane : &unused[iLane];
+        }
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            theTexelsU[i] = aTexels[i].r[0];
+        }
+
+        FindEndPointsBC4SBatch(theTexelsU, pBC4);
+        FindClosestBatch(pBC4, theTexelsU);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC5UBatch( uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags )
+{
+    UNREFERENCED_PARAMETER( flags );
+
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+    memset(pBC, 0, sizeof(BC4_UNORM)*2*nBlocks);
+    BC4_UNORM unused[BC_BATCH_LANES*2];
+    memset(unused, 0, sizeof(unused));
+
+    XMMATRIX aTexels[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsU[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsV[NUM_PIXELS_PER_BLOCK];
+
+    for (size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+    {
+        size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+        LoadBlocksSoA( aTexels, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+        BC4_UNORM* pBCR[BC_BATCH_LANES];
+        BC4_UNORM* pBCG[BC_BATCH_LANES];
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            BC4_UNORM* pBC5 = (iLane < nLanes) ? reinterpret_cast<BC4_UNORM*>(pBC) + (iBlock + iLane)*2 : &unused[iLane*2];
+            pBCR[iLane] = pBC5;
+            pBCG[iLane] = pBC5 + 1;
+        }
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            theTexelsU[i] = aTexels[i].r[0];
+            theTexelsV[i] = aTexels[i].r[1];
+        }
+
+        FindEndPointsBC4UBatch(theTexelsU, pBCR);
+        FindEndPointsBC4UBatch(theTexelsV, pBCG);
+
+        FindClosestBatch(pBCR, theTexelsU);
+        FindClosestBatch(pBCG, theTexelsV);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC5SBatch( uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags )
+{
+    UNREFERENCED_PARAMETER( flags );
+
+    assert( pBC && pColor );
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+    memset(pBC, 0, sizeof(BC4_SNORM)*2*nBlocks);
+    BC4_SNORM unused[BC_BATCH_LANES*2];
+    memset(unused, 0, sizeof(unused));
+
+    XMMATRIX aTexels[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsU[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR theTexelsV[NUM_PIXELS_PER_BLOCK];
+
+    for (size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_LANES)
+    {
+        size_t nLanes = std::min<size_t>( BC_BATCH_LANES, nBlocks - iBlock );
+        LoadBlocksSoA( aTexels, pColor + iBlock * NUM_PIXELS_PER_BLOCK, nLanes );
+
+        BC4_SNORM* pBCR[BC_BATCH_LANES];
+        BC4_SNORM* pBCG[BC_BATCH_LANES];
+        for (size_t iLane = 0; iLane < BC_BATCH_LANES; ++iLane)
+        {
+            BC4_SNORM* pBC5 = (iLane < nLanes) ? reinterpret_cast<BC4_SNORM*>(pBC) + (iBlock + iLane)*2 : &unused[iLane*2];
+            pBCR[iLane] = pBC5;
+            pBCG[iLane] = pBC5 + 1;
+        }
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            theTexelsU[i] = aTexels[i].r[0];
+            theTexelsV[i] = aTexels[i].r[1];
+        }
+
+        FindEndPointsBC4SBatch(theTexelsU, pBCR);
+        FindEndPointsBC4SBatch(theTexelsV, pBCG);
+
+        FindClosestBatch(pBCR, theTexelsU);
+        FindClosestBatch(pBCG, theTexelsV);
+    }
+}
+
 } // namespace
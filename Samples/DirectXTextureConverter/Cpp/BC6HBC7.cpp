@@ -554,10 +554,104 @@ const D3DX_BC7::ModeInfo D3DX_BC7::ms_aInfo[] =
         // Mode 7: Color+Alpha, 2 Subsets, RGBAP 55551 (unique P-bit), 2-bit indices, 64 partitions
 };
 
+// BC7 mode 5 color endpoints (7-bit) for each 8-bit value, chosen so that color index 1 reproduces the value exactly
+static const uint8_t g_aBC7SingleColor[256][2] =
+{
+    {  0,  0}, {  0,  1}, {  1,  1}, {  1,  2}, {  2,  2}, {  2,  3}, {  3,  3}, {  3,  4},
+    {  4,  4}, {  4,  5}, {  5,  5}, {  5,  6}, {  6,  6}, {  6,  7}, {  7,  7}, {  7,  8},
+    {  8,  8}, {  8,  9}, {  9,  9}, {  9, 10}, { 10, 10}, { 10, 11}, { 11, 11}, { 11, 12},
+    { 12, 12}, { 12, 13}, { 13, 13}, { 13, 14}, { 14, 14}, { 14, 15}, { 15, 15}, { 15, 16},
+    { 16, 16}, { 16, 17}, { 17, 17}, { 17, 18}, { 18, 18}, { 18, 19}, { 19, 19}, { 19, 20},
+    { 20, 20}, { 20, 21}, { 21, 21}, { 21, 22}, { 22, 22}, { 22, 23}, { 23, 23}, { 23, 24},
+    { 24, 24}, { 24, 25}, { 25, 25}, { 25, 26}, { 26, 26}, { 26, 27}, { 27, 27}, { 27, 28},
+    { 28, 28}, { 28, 29}, { 29, 29}, { 29, 30}, { 30, 30}, { 30, 31}, { 31, 31}, { 31, 32},
+    { 32, 32}, { 32, 33}, { 33, 33}, { 33, 34}, { 34, 34}, { 34, 35}, { 35, 35}, { 35, 36},
+    { 36, 36}, { 36, 37}, { 37, 37}, { 37, 38}, { 38, 38}, { 38, 39}, { 39, 39}, { 39, 40},
+    { 40, 40}, { 40, 41}, { 41, 41}, { 41, 42}, { 42, 42}, { 42, 43}, { 43, 43}, { 43, 44},
+    { 44, 44}, { 44, 45}, { 45, 45}, { 45, 46}, { 46, 46}, { 46, 47}, { 47, 47}, { 47, 48},
+    { 48, 48}, { 48, 49}, { 49, 49}, { 49, 50}, { 50, 50}, { 50, 51}, { 51, 51}, { 51, 52},
+    { 52, 52}, { 52, 53}, { 53, 53}, { 53, 54}, { 54, 54}, { 54, 55}, { 55, 55}, { 55, 56},
+    { 56, 56}, { 56, 57}, { 57, 57}, { 57, 58}, { 58, 58}, { 58, 59}, { 59, 59}, { 59, 60},
+    { 60, 60}, { 60, 61}, { 61, 61}, { 61, 62}, { 62, 62}, { 62, 63}, { 63, 63}, { 63, 64},
+    { 64, 63}, { 64, 64}, { 64, 65}, { 65, 65}, { 65, 66}, { 66, 66}, { 66, 67}, { 67, 67},
+    { 67, 68}, { 68, 68}, { 68, 69}, { 69, 69}, { 69, 70}, { 70, 70}, { 70, 71}, { 71, 71},
+    { 71, 72}, { 72, 72}, { 72, 73}, { 73, 73}, { 73, 74}, { 74, 74}, { 74, 75}, { 75, 75},
+    { 75, 76}, { 76, 76}, { 76, 77}, { 77, 77}, { 77, 78}, { 78, 78}, { 78, 79}, { 79, 79},
+    { 79, 80}, { 80, 80}, { 80, 81}, { 81, 81}, { 81, 82}, { 82, 82}, { 82, 83}, { 83, 83},
+    { 83, 84}, { 84, 84}, { 84, 85}, { 85, 85}, { 85, 86}, { 86, 86}, { 86, 87}, { 87, 87},
+    { 87, 88}, { 88, 88}, { 88, 89}, { 89, 89}, { 89, 90}, { 90, 90}, { 90, 91}, { 91, 91},
+    { 91, 92}, { 92, 92}, { 92, 93}, { 93, 93}, { 93, 94}, { 94, 94}, { 94, 95}, { 95, 95},
+    { 95, 96}, { 96, 96}, { 96, 97}, { 97, 97}, { 97, 98}, { 98, 98}, { 98, 99}, { 99, 99},
+    { 99,100}, {100,100}, {100,101}, {101,101}, {101,102}, {102,102}, {102,103}, {103,103},
+    {103,104}, {104,104}, {104,105}, {105,105}, {105,106}, {106,106}, {106,107}, {107,107},
+    {107,108}, {108,108}, {108,109}, {109,109}, {109,110}, {110,110}, {110,111}, {111,111},
+    {111,112}, {112,112}, {112,113}, {113,113}, {113,114}, {114,114}, {114,115}, {115,115},
+    {115,116}, {116,116}, {116,117}, {117,117}, {117,118}, {118,118}, {118,119}, {119,119},
+    {119,120}, {120,120}, {120,121}, {121,121}, {121,122}, {122,122}, {122,123}, {123,123},
+    {123,124}, {124,124}, {124,125}, {125,125}, {125,126}, {126,126}, {126,127}, {127,127}
+};
+
+
+//-------------------------------------------------------------------------------------
+// Quality levels
+//-------------------------------------------------------------------------------------
+enum BC67_QUALITY
+{
+    BC67_QUALITY_MAX = 0,   // Exhaustive search (default)
+    BC67_QUALITY_FAST,      // BC_FLAGS_BC67_FAST
+    BC67_QUALITY_FASTEST,   // BC_FLAGS_BC67_FASTEST
+};
+
+// BC6H search per quality level: aModeOrder, uNumModes, uItemsShift, fThreshold
+//  Modes are tried in aModeOrder up to uNumModes, the best (shapes >> uItemsShift) rough shapes
+//  of each mode are refined, and the search stops once the block error is at or below fThreshold
+struct BC6HQuality
+{
+    uint8_t aModeOrder[14];
+    uint8_t uNumModes;
+    uint8_t uItemsShift;
+    float fThreshold;
+};
+
+static const BC6HQuality g_aBC6HQuality[] =
+{
+    { { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 }, 14, 2, 0.0f },
+    { { 10, 11, 12, 13, 1, 0, 5, 6, 7, 8, 2, 3, 4, 9 }, 14, 4, 768.0f },    // ~4 half-float ULPs RMS
+    { { 10, 11, 12, 13, 1, 0, 5, 6, 7, 8, 2, 3, 4, 9 }, 6, 6, 3072.0f },    // ~8 half-float ULPs RMS
+};
+
+// BC7 search per quality level: aModeOrder, uOpaqueModes, uAlphaModes, uItemsShift, fThreshold
+//  As for BC6H; uOpaqueModes and uAlphaModes are masks of the modes tried for opaque blocks and
+//  for blocks with alpha (modes 0-3 can't store alpha)
+struct BC7Quality
+{
+    uint8_t aModeOrder[8];
+    uint8_t uOpaqueModes;
+    uint8_t uAlphaModes;
+    uint8_t uItemsShift;
+    float fThreshold;
+};
+
+static const BC7Quality g_aBC7Quality[] =
+{
+    { { 0, 1, 2, 3, 4, 5, 6, 7 }, 0xff, 0xff, 2, 0.0f },
+    { { 6, 1, 3, 5, 4, 0, 2, 7 }, 0x4a, 0x70, 4, 48.0f },     // Modes 1, 3, 6 or 4, 5, 6
+    { { 6, 1, 3, 5, 4, 0, 2, 7 }, 0x42, 0x60, 6, 160.0f },    // Modes 1, 6 or 5, 6
+};
+
 
 //-------------------------------------------------------------------------------------
 // Helper functions
 //-------------------------------------------------------------------------------------
+inline static BC67_QUALITY GetBC67Quality(_In_ DWORD flags)
+{
+    if(flags & BC_FLAGS_BC67_FASTEST)
+        return BC67_QUALITY_FASTEST;
+    if(flags & BC_FLAGS_BC67_FAST)
+        return BC67_QUALITY_FAST;
+    return BC67_QUALITY_MAX;
+}
+
 inline static bool IsFixUpOffset(_In_range_(0,2) size_t uPartitions, _In_range_(0,63) size_t uShape, _In_range_(0,15) size_t uOffset)
 {
     assert(uPartitions < 3 && uShape < 64 && uOffset < 16);
@@ -1236,18 +1330,30 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
+void D3DX_BC6H::Encode(bool bSigned, DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
     EncodeParams EP(pIn, bSigned);
+    const BC6HQuality& quality = g_aBC6HQuality[GetBC67Quality(flags)];
 
-    for(EP.uMode = 0; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > 0; ++EP.uMode)
+    // A single-color block gains nothing from a second region, and the 16-bit one-region mode represents it exactly
+    bool bSingleColor = true;
+    for(size_t i = 1; i < NUM_PIXELS_PER_BLOCK && bSingleColor; ++i)
     {
+        bSingleColor = EP.aIPixels[i].r == EP.aIPixels[0].r && EP.aIPixels[i].g == EP.aIPixels[0].g && EP.aIPixels[i].b == EP.aIPixels[0].b;
+    }
+
+    for(size_t m = 0; m < quality.uNumModes && EP.fBestErr > quality.fThreshold; ++m)
+    {
+        EP.uMode = quality.aModeOrder[m];
+        if(bSingleColor && ms_aInfo[EP.uMode].uPartitions)
+            continue;
+
         const uint8_t uShapes = ms_aInfo[EP.uMode].uPartitions ? 32 : 1;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> quality.uItemsShift);
         float afRoughMSE[BC6H_MAX_SHAPES];
         uint8_t auShape[BC6H_MAX_SHAPES];
 
@@ -1272,7 +1378,7 @@ void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
             }
         }
 
-        for(size_t i = 0; i < uItems && EP.fBestErr > 0; i++)
+        for(size_t i = 0; i < uItems && EP.fBestErr > quality.fThreshold; i++)
         {
             EP.uShape = auShape[i];
             Refine(&EP);
@@ -2144,7 +2250,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC7::Encode(const HDRColorA* const pIn)
+void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
@@ -2160,8 +2266,33 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         EP.aLDRPixels[i].a = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].a * 255.0f + 0.01f ) ) );
     }
 
-    for(EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
+    // Cheap block statistics used to prune the search
+    bool bOpaque = true;
+    bool bSingleColor = true;
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        const LDRColorA& c = EP.aLDRPixels[i];
+        if(c.a < 255)
+            bOpaque = false;
+        if(c.r != EP.aLDRPixels[0].r || c.g != EP.aLDRPixels[0].g || c.b != EP.aLDRPixels[0].b || c.a != EP.aLDRPixels[0].a)
+            bSingleColor = false;
+    }
+
+    if(bSingleColor)
     {
+        EncodeSingleColor(&EP, EP.aLDRPixels[0]);
+        return;
+    }
+
+    const BC7Quality& quality = g_aBC7Quality[GetBC67Quality(flags)];
+    const uint8_t uModes = bOpaque ? quality.uOpaqueModes : quality.uAlphaModes;
+
+    for(size_t m = 0; m < 8 && fMSEBest > quality.fThreshold; ++m)
+    {
+        EP.uMode = quality.aModeOrder[m];
+        if(!(uModes & (1 << EP.uMode)))
+            continue;
+
         const size_t uShapes = size_t(1) << ms_aInfo[EP.uMode].uPartitionBits;
         assert( uShapes <= BC7_MAX_SHAPES );
         _Analysis_assume_( uShapes <= BC7_MAX_SHAPES );
@@ -2170,11 +2301,11 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> quality.uItemsShift);
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
 
-        for(size_t r = 0; r < uNumRots && fMSEBest > 0; ++r)
+        for(size_t r = 0; r < uNumRots && fMSEBest > quality.fThreshold; ++r)
         {
             switch(r)
             {
@@ -2183,7 +2314,7 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
             case 3: for(register size_t i = 0; i < NUM_PIXELS_PER_BLOCK; i++) std::swap(EP.aLDRPixels[i].b, EP.aLDRPixels[i].a); break;
             }
 
-            for(size_t im = 0; im < uNumIdxMode && fMSEBest > 0; ++im)
+            for(size_t im = 0; im < uNumIdxMode && fMSEBest > quality.fThreshold; ++im)
             {
                 // pick the best uItems shapes and refine these.
                 for(size_t s = 0; s < uShapes; s++)
@@ -2205,7 +2336,7 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
                     }
                 }
 
-                for(size_t i = 0; i < uItems && fMSEBest > 0; i++)
+                for(size_t i = 0; i < uItems && fMSEBest > quality.fThreshold; i++)
                 {
                     float fMSE = Refine(&EP, auShape[i], r, im);
                     if(fMSE < fMSEBest)
@@ -2678,6 +2809,29 @@ float D3DX_BC7::Refine(const EncodeParams* pEP, size_t uShape, size_t uRotation,
     }
 }
 
+_Use_decl_annotations_
+void D3DX_BC7::EncodeSingleColor(EncodeParams* pEP, const LDRColorA& color)
+{
+    assert( pEP );
+
+    // Mode 5 keeps alpha at full precision, and color index 1 hits every 8-bit value exactly (see g_aBC7SingleColor)
+    pEP->uMode = 5;
+
+    LDREndPntPair aEndPts[BC7_MAX_REGIONS];
+    aEndPts[0].A = LDRColorA(g_aBC7SingleColor[color.r][0], g_aBC7SingleColor[color.g][0], g_aBC7SingleColor[color.b][0], color.a);
+    aEndPts[0].B = LDRColorA(g_aBC7SingleColor[color.r][1], g_aBC7SingleColor[color.g][1], g_aBC7SingleColor[color.b][1], color.a);
+
+    size_t aIndex[NUM_PIXELS_PER_BLOCK];
+    size_t aIndex2[NUM_PIXELS_PER_BLOCK];
+    for(register size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        aIndex[i] = 1;
+        aIndex2[i] = 0;
+    }
+
+    EmitBlock(pEP, 0, 0, 0, aEndPts, aIndex, aIndex2);
+}
+
 _Use_decl_annotations_
 float D3DX_BC7::MapColors(const EncodeParams* pEP, const LDRColorA aColors[], size_t np, size_t uIndexMode, const LDREndPntPair& endPts, float fMinErr) const
 {
@@ -2832,19 +2986,17 @@ void D3DXDecodeBC6HS(XMVECTOR *pColor, const uint8_t *pBC)
 _Use_decl_annotations_
 void D3DXEncodeBC6HU(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 _Use_decl_annotations_
 void D3DXEncodeBC6HS(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 
@@ -2862,10 +3014,9 @@ void D3DXDecodeBC7(XMVECTOR *pColor, const uint8_t *pBC)
 _Use_decl_annotations_
 void D3DXEncodeBC7(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes" );
-    reinterpret_cast< D3DX_BC7* >( pBC )->Encode(reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC7* >( pBC )->Encode(flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 } // namespace
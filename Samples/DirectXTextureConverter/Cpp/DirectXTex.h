@@ -141,6 +141,9 @@ namespace DirectX
         DDS_FLAGS_EXPAND_LUMINANCE      = 0x20,
             // When loading legacy luminance formats expand replicating the color channels rather than leaving them packed (L8, L16, A8L8)
 
+        DDS_FLAGS_MAPPED                = 0x40,
+            // Map the file's pixel data copy-on-write instead of reading it into memory (only used when no conversion is required)
+
         DDS_FLAGS_FORCE_DX10_EXT        = 0x10000,
             // Always use the 'DX10' header extension for DDS writer (i.e. don't try to write DX9 compatible DDS files)
 
@@ -148,6 +151,17 @@ namespace DirectX
             // DDS_FLAGS_FORCE_DX10_EXT including miscFlags2 information (result may not be compatible with D3DX10 or D3DX11)
     };
 
+    enum TGA_FLAGS
+    {
+        TGA_FLAGS_NONE                  = 0x0,
+
+        TGA_FLAGS_PARALLEL              = 0x1,
+            // RLE scanlines are decoded/encoded on multiple threads (reading first indexes where each scanline starts)
+
+        TGA_FLAGS_RLE                   = 0x10000,
+            // Write RLE compressed image data for TGA writer
+    };
+
     enum WIC_FLAGS
     {
         WIC_FLAGS_NONE                  = 0x0,
@@ -210,7 +224,7 @@ namespace DirectX
     class ScratchImage
     {
     public:
-        ScratchImage() : _nimages(0), _size(0), _image(0), _memory(0) {}
+        ScratchImage() : _nimages(0), _size(0), _image(0), _memory(0), _view(0) {}
         ~ScratchImage() { Release(); }
 
         HRESULT Initialize( _In_ const TexMetadata& mdata );
@@ -225,6 +239,9 @@ namespace DirectX
         HRESULT InitializeCubeFromImages( _In_reads_(nImages) const Image* images, _In_ size_t nImages );
         HRESULT Initialize3DFromImages( _In_reads_(depth) const Image* images, _In_ size_t depth );
 
+        HRESULT InitializeFromFile( _In_ const TexMetadata& mdata, _In_ HANDLE hFile, _In_ uint64_t offset );
+            // Maps the pixels copy-on-write from a file holding the image array at offset (pages are only read when touched)
+
         void Release();
 
         bool OverrideFormat( _In_ DXGI_FORMAT f );
@@ -246,6 +263,7 @@ namespace DirectX
         TexMetadata _metadata;
         Image*      _image;
         uint8_t*    _memory;
+        void*       _view;
 
         // Hide copy constructor and assignment operator
         ScratchImage( const ScratchImage& );
@@ -293,7 +311,48 @@ namespace DirectX
     HRESULT SaveToDDSFile( _In_ const Image& image, _In_ DWORD flags, _In_z_ LPCWSTR szFile );
     HRESULT SaveToDDSFile( _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ const TexMetadata& metadata, _In_ DWORD flags, _In_z_ LPCWSTR szFile );
 
+    // Writes a DDS file one image at a time as each is produced, in the same order as ScratchImage::GetImages
+    class DDSFileWriter
+    {
+    public:
+        DDSFileWriter() : _hFile(0), _flags(0), _nimages(0), _index(0), _headerSize(0) {}
+        ~DDSFileWriter() { Release(); }
+
+        HRESULT Initialize( _In_ const TexMetadata& metadata, _In_ DWORD flags, _In_z_ LPCWSTR szFile );
+
+        HRESULT WriteImage( _In_ const Image& image );
+
+        HRESULT Finish( _In_opt_ const TexMetadata* metadata = nullptr );
+            // Fails if images are missing; metadata may only differ in miscFlags2 (e.g. an alpha mode known after compression)
+
+        void Release();
+
+        const TexMetadata& GetMetadata() const { return _metadata; }
+        size_t GetImageCount() const { return _nimages; }
+        size_t GetImagesWritten() const { return _index; }
+
+    private:
+        HANDLE      _hFile;
+        DWORD       _flags;
+        size_t      _nimages;
+        size_t      _index;
+        size_t      _headerSize;
+        TexMetadata _metadata;
+
+        // Hide copy constructor and assignment operator
+        DDSFileWriter( const DDSFileWriter& );
+        DDSFileWriter& operator=( const DDSFileWriter& );
+    };
+
     // TGA operations
+    HRESULT LoadFromTGAMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DWORD flags,
+                               _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+    HRESULT LoadFromTGAFile( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
+                             _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+
+    HRESULT SaveToTGAMemory( _In_ const Image& image, _In_ DWORD flags, _Out_ Blob& blob );
+    HRESULT SaveToTGAFile( _In_ const Image& image, _In_ DWORD flags, _In_z_ LPCWSTR szFile );
+
     HRESULT LoadFromTGAMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size,
                                _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
     HRESULT LoadFromTGAFile( _In_z_ LPCWSTR szFile,
@@ -301,6 +360,7 @@ namespace DirectX
 
     HRESULT SaveToTGAMemory( _In_ const Image& image, _Out_ Blob& blob );
     HRESULT SaveToTGAFile( _In_ const Image& image, _In_z_ LPCWSTR szFile );
+        // Earlier signatures without flags, same as passing TGA_FLAGS_NONE
 
     // WIC operations
     HRESULT LoadFromWICMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DWORD flags,
@@ -392,6 +452,13 @@ namespace DirectX
             // if the input format type is IsSRGB(), then SRGB_IN is on by default
             // if the output format type is IsSRGB(), then SRGB_OUT is on by default
 
+        TEX_FILTER_PARALLEL         = 0x4000000,
+            // Custom (non-WIC) Resize and mipmap filters are free to use multithreading, splitting each image
+            // into bands of rows (or volume slices); the thread count follows the OpenMP runtime setting
+
+        TEX_FILTER_FORCE_GENERAL    = 0x8000000,
+            // Forces Convert to use the general per-pixel path instead of a direct conversion between common formats
+
         TEX_FILTER_FORCE_NON_WIC    = 0x10000000,
             // Forces use of the non-WIC path when both are an option
 
@@ -446,6 +513,12 @@ namespace DirectX
         TEX_COMPRESS_UNIFORM        = 0x40000,
             // Uniform color weighting for BC1-3 compression; by default uses perceptual weighting
 
+        TEX_COMPRESS_BC67_FAST      = 0x100000,
+            // Faster BC6H/BC7 compression; limits the mode and partition search using per-block statistics
+
+        TEX_COMPRESS_BC67_FASTEST   = 0x200000,
+            // Fastest BC6H/BC7 compression; searches only the most useful modes (overrides TEX_COMPRESS_BC67_FAST)
+
         TEX_COMPRESS_PARALLEL       = 0x10000000,
             // Compress is free to use multithreading to improve performance (by default it does not use multithreading)
     };
@@ -455,6 +528,7 @@ namespace DirectX
     HRESULT Compress( _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
                       _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float alphaRef, _Out_ ScratchImage& cImages );
         // Note that alphaRef is only used by BC1. 0.5f is a typical value to use
+        // A single image may be any size; the multi-image version requires the top level to be a multiple of 4 (or 1 or 2)
 
     HRESULT Decompress( _In_ const Image& cImage, _In_ DXGI_FORMAT format, _Out_ ScratchImage& image );
     HRESULT Decompress( _In_reads_(nimages) const Image* cImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
@@ -274,3 +274,27 @@ inline HRESULT SaveToDDSFile( const Image& image, DWORD flags, LPCWSTR szFile )
 
     return SaveToDDSFile( &image, 1, mdata, flags, szFile );
 }
+
+_Use_decl_annotations_
+inline HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata, ScratchImage& image )
+{
+    return LoadFromTGAMemory( pSource, size, TGA_FLAGS_NONE, metadata, image );
+}
+
+_Use_decl_annotations_
+inline HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& image )
+{
+    return LoadFromTGAFile( szFile, TGA_FLAGS_NONE, metadata, image );
+}
+
+_Use_decl_annotations_
+inline HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
+{
+    return SaveToTGAMemory( image, TGA_FLAGS_NONE, blob );
+}
+
+_Use_decl_annotations_
+inline HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
+{
+    return SaveToTGAFile( image, TGA_FLAGS_NONE, szFile );
+}
@@ -32,28 +32,83 @@ inline static DWORD _GetBCFlags( _In_ DWORD compress )
     static_assert( TEX_COMPRESS_A_DITHER == BC_FLAGS_DITHER_A, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_DITHER == (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A), "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_UNIFORM == BC_FLAGS_UNIFORM, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
-    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM) );
+    static_assert( TEX_COMPRESS_BC67_FAST == BC_FLAGS_BC67_FAST, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_BC67_FASTEST == BC_FLAGS_BC67_FASTEST, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM|BC_FLAGS_BC67_FAST|BC_FLAGS_BC67_FASTEST) );
 }
 
-inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_ENCODE& pfEncode, _Out_ size_t& blocksize, _Out_ DWORD& cflags )
+inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_ENCODE& pfEncode, _Out_ BC_ENCODE_BATCH& pfEncodeBatch,
+                                              _Out_ size_t& blocksize, _Out_ DWORD& cflags )
 {
     switch(format)
     {
     case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfEncode = nullptr;         blocksize = 8;   cflags = 0; break;
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    pfEncode = nullptr;         pfEncodeBatch = nullptr;                blocksize = 8;   cflags = 0; break;
     case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:    pfEncode = D3DXEncodeBC2;   blocksize = 16;  cflags = 0; break;
+    case DXGI_FORMAT_BC2_UNORM_SRGB:    pfEncode = D3DXEncodeBC2;   pfEncodeBatch = D3DXEncodeBC2Batch;     blocksize = 16;  cflags = 0; break;
     case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfEncode = D3DXEncodeBC3;   blocksize = 16;  cflags = 0; break;
-    case DXGI_FORMAT_BC4_UNORM:         pfEncode = D3DXEncodeBC4U;  blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
-    case DXGI_FORMAT_BC4_SNORM:         pfEncode = D3DXEncodeBC4S;  blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
-    case DXGI_FORMAT_BC5_UNORM:         pfEncode = D3DXEncodeBC5U;  blocksize = 16;  cflags = TEX_FILTER_RGB_COPY_RED | TEX_FILTER_RGB_COPY_GREEN; break;
-    case DXGI_FORMAT_BC5_SNORM:         pfEncode = D3DXEncodeBC5S;  blocksize = 16;  cflags = TEX_FILTER_RGB_COPY_RED | TEX_FILTER_RGB_COPY_GREEN; break;
-    case DXGI_FORMAT_BC6H_UF16:         pfEncode = D3DXEncodeBC6HU; blocksize = 16;  cflags = 0; break;
-    case DXGI_FORMAT_BC6H_SF16:         pfEncode = D3DXEncodeBC6HS; blocksize = 16;  cflags = 0; break;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:    pfEncode = D3DXEncodeBC3;   pfEncodeBatch = D3DXEncodeBC3Batch;     blocksize = 16;  cflags = 0; break;
+    case DXGI_FORMAT_BC4_UNORM:         pfEncode = D3DXEncodeBC4U;  pfEncodeBatch = D3DXEncodeBC4UBatch;    blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
+    case DXGI_FORMAT_BC4_SNORM:         pfEncode = D3DXEncodeBC4S;  pfEncodeBatch = D3DXEncodeBC4SBatch;    blocksize = 8;   cflags = TEX_FILTER_RGB_COPY_RED; break;
+    case DXGI_FORMAT_BC5_UNORM:         pfEncode = D3DXEncodeBC5U;  pfEncodeBatch = D3DXEncodeBC5UBatch;    blocksize = 16;  cflags = TEX_FILTER_RGB_COPY_RED | TEX_FILTER_RGB_COPY_GREEN; break;
+    case DXGI_FORMAT_BC5_SNORM:         pfEncode = D3DXEncodeBC5S;  pfEncodeBatch = D3DXEncodeBC5SBatch;    blocksize = 16;  cflags = TEX_FILTER_RGB_COPY_RED | TEX_FILTER_RGB_COPY_GREEN; break;
+    case DXGI_FORMAT_BC6H_UF16:         pfEncode = D3DXEncodeBC6HU; pfEncodeBatch = nullptr;                blocksize = 16;  cflags = 0; break;
+    case DXGI_FORMAT_BC6H_SF16:         pfEncode = D3DXEncodeBC6HS; pfEncodeBatch = nullptr;                blocksize = 16;  cflags = 0; break;
     case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:    pfEncode = D3DXEncodeBC7;   blocksize = 16;  cflags = 0; break;
-    default:                            pfEncode = nullptr;         blocksize = 0;   cflags = 0; return false;
+    case DXGI_FORMAT_BC7_UNORM_SRGB:    pfEncode = D3DXEncodeBC7;   pfEncodeBatch = nullptr;                blocksize = 16;  cflags = 0; break;
+    default:                            pfEncode = nullptr;         pfEncodeBatch = nullptr;                blocksize = 0;   cflags = 0; return false;
+    }
+
+    return true;
+}
+
+inline static void _EncodeBlocks( _In_opt_ BC_ENCODE pfEncode, _In_opt_ BC_ENCODE_BATCH pfEncodeBatch, _Out_writes_(nBlocks*blocksize) uint8_t* pDest,
+                                  _In_reads_(nBlocks*NUM_PIXELS_PER_BLOCK) const XMVECTOR* pColor, _In_ size_t nBlocks, _In_ size_t blocksize,
+                                  _In_ DWORD bcflags, _In_ float alphaRef )
+{
+    if ( pfEncodeBatch )
+    {
+        pfEncodeBatch( pDest, pColor, nBlocks, bcflags );
+    }
+    else if ( pfEncode )
+    {
+        // BC6H and BC7 have no batched encoder
+        for( size_t i = 0; i < nBlocks; ++i )
+        {
+            pfEncode( pDest + i*blocksize, pColor + i*NUM_PIXELS_PER_BLOCK, bcflags );
+        }
+    }
+    else
+    {
+        D3DXEncodeBC1Batch( pDest, pColor, nBlocks, alphaRef, bcflags );
+    }
+}
+
+//-------------------------------------------------------------------------------------
+// Loads the 4 scanlines of a run of up to BC_MAX_BATCH blocks and scatters them into
+// consecutive blocks of NUM_PIXELS_PER_BLOCK colors
+//-------------------------------------------------------------------------------------
+static bool _LoadBlocks( _Out_writes_(nBlocks*NUM_PIXELS_PER_BLOCK) XMVECTOR* pBlocks, _In_range_(1,BC_MAX_BATCH) size_t nBlocks,
+                         _In_reads_bytes_(size) const uint8_t* pSrc, _In_ size_t size, _In_ size_t rowPitch, _In_ size_t rows,
+                         _In_ DXGI_FORMAT format )
+{
+    assert( nBlocks > 0 && nBlocks <= BC_MAX_BATCH );
+
+    XMVECTOR scanline[ 4*BC_MAX_BATCH ];
+
+    for( size_t t = 0; t < rows && t < 4; ++t )
+    {
+        if ( !_LoadScanline( scanline, 4*nBlocks, pSrc + rowPitch*t, size, format ) )
+            return false;
+
+        for( size_t b = 0; b < nBlocks; ++b )
+        {
+            XMVECTOR* pBlock = pBlocks + b*NUM_PIXELS_PER_BLOCK + t*4;
+            pBlock[0] = scanline[ b*4 ];
+            pBlock[1] = scanline[ b*4 + 1 ];
+            pBlock[2] = scanline[ b*4 + 2 ];
+            pBlock[3] = scanline[ b*4 + 3 ];
+        }
     }
 
     return true;
@@ -62,7 +117,7 @@ inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_
 
 //-------------------------------------------------------------------------------------
 static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _In_ DWORD bcflags,
-                            _In_ float alphaRef, _In_ bool degenerate )
+                            _In_ float alphaRef )
 {
     if ( !image.pixels || !result.pixels )
         return E_POINTER;
@@ -88,75 +143,68 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
 
     // Determine BC format encoder
     BC_ENCODE pfEncode;
+    BC_ENCODE_BATCH pfEncodeBatch;
     size_t blocksize;
     DWORD cflags;
-    if ( !_DetermineEncoderSettings( result.format, pfEncode, blocksize, cflags ) )
+    if ( !_DetermineEncoderSettings( result.format, pfEncode, pfEncodeBatch, blocksize, cflags ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
-    XMVECTOR temp[16];
+    // Blocks are loaded and encoded in runs of up to BC_MAX_BATCH along each row of blocks
+    const size_t nbWidth = std::max<size_t>( 1, ( image.width + 3 ) / 4 );
+
+    XMVECTOR temp[ NUM_PIXELS_PER_BLOCK * BC_MAX_BATCH ];
     const uint8_t *pSrc = image.pixels;
     const size_t rowPitch = image.rowPitch;
     for( size_t h=0; h < image.height; h += 4 )
     {
+        const size_t ph = std::min<size_t>( 4, image.height - h );
+
         const uint8_t *sptr = pSrc;
         uint8_t* dptr = pDest;
-        for( size_t count = 0; count < rowPitch; count += sbpp*4 )
+        for( size_t count = 0; count < nbWidth; )
         {
-            if ( !_LoadScanline( &temp[0], 4, sptr, rowPitch, format ) )
-                return E_FAIL;
-
-            if ( image.height > 1 )
-            {
-                if ( !_LoadScanline( &temp[4], 4, sptr + rowPitch, rowPitch, format ) )
-                    return E_FAIL;
+            const size_t nBlocks = std::min<size_t>( BC_MAX_BATCH, nbWidth - count );
 
-                if ( image.height > 2 )
-                {
-                    if ( !_LoadScanline( &temp[8], 4, sptr + rowPitch*2, rowPitch, format ) )
-                        return E_FAIL;
-
-                    if ( !_LoadScanline( &temp[12], 4, sptr + rowPitch*3, rowPitch, format ) )
-                        return E_FAIL;
-                }
-            }
+            if ( !_LoadBlocks( temp, nBlocks, sptr, rowPitch - static_cast<size_t>( sptr - pSrc ), rowPitch, ph, format ) )
+                return E_FAIL;
 
-            if ( degenerate )
+            // Blocks on the right and bottom edges that lie partly outside the image (all of them for
+            // a 1 or 2 texel mip) get the missing texels by repeating ones inside it
+            const size_t pw = std::min<size_t>( 4, image.width - ( count + nBlocks - 1 )*4 );
+            if ( ph < 4 || pw < 4 )
             {
-                assert( image.width < 4 || image.height < 4 );
                 const size_t uSrc[] = { 0, 0, 0, 1 };
 
-                if ( image.width < 4 )
+                for( size_t b = 0; b < nBlocks; ++b )
                 {
-                    for( size_t t=0; t < image.height && t < 4; ++t )
+                    XMVECTOR* pBlock = temp + b*NUM_PIXELS_PER_BLOCK;
+                    const size_t bw = ( b == nBlocks - 1 ) ? pw : 4;
+
+                    for( size_t t=0; t < ph; ++t )
                     {
-                        for( size_t s = image.width; s < 4; ++s )
+                        for( size_t s = bw; s < 4; ++s )
                         {
-                            temp[ t*4 + s ] = temp[ t*4 + uSrc[s] ]; 
+                            pBlock[ t*4 + s ] = pBlock[ t*4 + uSrc[s] ]; 
                         }
                     }
-                }
 
-                if ( image.height < 4 )
-                {
-                    for( size_t t=image.height; t < 4; ++t )
+                    for( size_t t=ph; t < 4; ++t )
                     {
                         for( size_t s =0; s < 4; ++s )
                         {
-                            temp[ t*4 + s ] = temp[ uSrc[t]*4 + s ]; 
+                            pBlock[ t*4 + s ] = pBlock[ uSrc[t]*4 + s ]; 
                         }
                     }
                 }
             }
 
-            _ConvertScanline( temp, 16, result.format, format, cflags );
-            
-            if ( pfEncode )
-                pfEncode( dptr, temp, bcflags );
-            else
-                D3DXEncodeBC1( dptr, temp, alphaRef, bcflags );
+            _ConvertScanline( temp, NUM_PIXELS_PER_BLOCK * nBlocks, result.format, format, cflags );
+
+            _EncodeBlocks( pfEncode, pfEncodeBatch, dptr, temp, nBlocks, blocksize, bcflags, alphaRef );
 
-            sptr += sbpp*4;
-            dptr += blocksize;
+            count += nBlocks;
+            sptr += sbpp*4*nBlocks;
+            dptr += blocksize*nBlocks;
         }
 
         pSrc += rowPitch*4;
@@ -175,7 +223,7 @@ static HRESULT _CompressBC_Parallel( _In_ const Image& image, _In_ const Image&
     if ( !image.pixels || !result.pixels )
         return E_POINTER;
 
-    // Parallel version doesn't support degenerate case
+    // Parallel version doesn't support partial blocks
     assert( ((image.width % 4) == 0) && ((image.height % 4) == 0 ) );
 
     assert( image.width == result.width );
@@ -197,50 +245,48 @@ static HRESULT _CompressBC_Parallel( _In_ const Image& image, _In_ const Image&
 
     // Determine BC format encoder
     BC_ENCODE pfEncode;
+    BC_ENCODE_BATCH pfEncodeBatch;
     size_t blocksize;
     DWORD cflags;
-    if ( !_DetermineEncoderSettings( result.format, pfEncode, blocksize, cflags ) )
+    if ( !_DetermineEncoderSettings( result.format, pfEncode, pfEncodeBatch, blocksize, cflags ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
-    // Refactored version of loop to support parallel independance
-    const size_t nBlocks = std::max<size_t>(1, image.width / 4) * std::max<size_t>(1, image.height / 4);
+    // Refactored version of loop to support parallel independance; each work item is a
+    // run of blocks along one row of blocks. BC6H/BC7 have no batched encoder and are slow
+    // enough per block that they keep one block per work item.
+    const size_t nRun = ( pfEncode && !pfEncodeBatch ) ? 1 : BC_MAX_BATCH;
+    const size_t nbWidth = std::max<size_t>(1, image.width / 4);
+    const size_t nbHeight = std::max<size_t>(1, image.height / 4);
+    const size_t nRuns = ( nbWidth + nRun - 1 ) / nRun;
+    const size_t nWork = nRuns * nbHeight;
 
     bool fail = false;
 
 #pragma omp parallel for
-    for( int nb=0; nb < static_cast<int>( nBlocks ); ++nb )
+    for( int nw=0; nw < static_cast<int>( nWork ); ++nw )
     {
-        const size_t nbWidth = std::max<size_t>(1, image.width / 4);
+        const size_t y = nw / nRuns;
+        const size_t x = ( nw - (y*nRuns) ) * nRun;
 
-        const size_t y = nb / nbWidth;
-        const size_t x = nb - (y*nbWidth);
+        assert( x < nbWidth && y < nbHeight );
 
-        assert( x < image.width && y < image.height );
+        const size_t nBlocks = std::min<size_t>( nRun, nbWidth - x );
 
         size_t rowPitch = image.rowPitch;
         const uint8_t *pSrc = image.pixels + (y*4*rowPitch) + (x*4*sbpp);
 
-        uint8_t *pDest = result.pixels + (nb*blocksize);
-
-        XMVECTOR temp[16];
-        if ( !_LoadScanline( &temp[0], 4, pSrc, rowPitch, format ) )
-            fail = true;
-
-        if ( !_LoadScanline( &temp[4], 4, pSrc + rowPitch, rowPitch, format ) )
-            fail = true;
+        uint8_t *pDest = result.pixels + (y*nbWidth + x)*blocksize;
 
-        if ( !_LoadScanline( &temp[8], 4, pSrc + rowPitch*2, rowPitch, format ) )
+        XMVECTOR temp[ NUM_PIXELS_PER_BLOCK * BC_MAX_BATCH ];
+        if ( !_LoadBlocks( temp, nBlocks, pSrc, rowPitch - (x*4*sbpp), rowPitch, 4, format ) )
+        {
             fail = true;
+            continue;
+        }
 
-        if ( !_LoadScanline( &temp[12], 4, pSrc + rowPitch*3, rowPitch, format ) )
-            fail = true;
+        _ConvertScanline( temp, NUM_PIXELS_PER_BLOCK * nBlocks, result.format, format, cflags );
 
-        _ConvertScanline( temp, 16, result.format, format, cflags );
-            
-        if ( pfEncode )
-            pfEncode( pDest, temp, bcflags );
-        else
-            D3DXEncodeBC1( pDest, temp, alphaRef, bcflags );
+        _EncodeBlocks( pfEncode, pfEncodeBatch, pDest, temp, nBlocks, blocksize, bcflags, alphaRef );
     }
 
     return (fail) ? E_FAIL : S_OK;
@@ -510,26 +556,11 @@ HRESULT Compress( const Image& srcImage, DXGI_FORMAT format, DWORD compress, flo
     if ( IsCompressed(srcImage.format) || !IsCompressed(format) || IsTypeless(format) )
         return E_INVALIDARG;
 
-    // Image size must be a multiple of 4 (degenerate cases for mipmaps are allowed)
-    bool degenerate = false;
-
+    // Any size is accepted, so each level of a mip chain can be compressed on its own; edge blocks
+    // that lie partly outside the image repeat the texels inside it
     size_t width = srcImage.width;
-    if ( (width % 4) != 0 )
-    {
-        if ( width != 1 && width != 2 )
-            return E_INVALIDARG;
-
-        degenerate = true;
-    }
-
     size_t height = srcImage.height;
-    if ( (height % 4) != 0 )
-    {
-        if ( height != 1 && height != 2 )
-            return E_INVALIDARG;
-
-        degenerate = true;
-    }
+    bool partial = ( (width % 4) != 0 ) || ( (height % 4) != 0 );
 
     // Create compressed image
     HRESULT hr = image.Initialize2D( format, width, height, 1, 1 );
@@ -544,7 +575,7 @@ HRESULT Compress( const Image& srcImage, DXGI_FORMAT format, DWORD compress, flo
     }
 
     // Compress single image
-    if ( (compress & TEX_COMPRESS_PARALLEL) && !degenerate )
+    if ( (compress & TEX_COMPRESS_PARALLEL) && !partial )
     {
 #ifndef _OPENMP
         return E_NOTIMPL;
@@ -554,7 +585,7 @@ HRESULT Compress( const Image& srcImage, DXGI_FORMAT format, DWORD compress, flo
     }
     else
     {
-        hr = _CompressBC( srcImage, *img, _GetBCFlags( compress ), alphaRef, degenerate );
+        hr = _CompressBC( srcImage, *img, _GetBCFlags( compress ), alphaRef );
     }
 
     if ( FAILED(hr) )
@@ -623,9 +654,9 @@ HRESULT Compress( const Image* srcImages, size_t nimages, const TexMetadata& met
             return E_FAIL;
         }
 
-        bool degenerate = ((height < 4) || (width < 4)) != 0;
+        bool partial = ( (width % 4) != 0 ) || ( (height % 4) != 0 );
 
-        if ( (compress & TEX_COMPRESS_PARALLEL) && !degenerate)
+        if ( (compress & TEX_COMPRESS_PARALLEL) && !partial)
         {
 #ifndef _OPENMP
             return E_NOTIMPL;
@@ -643,7 +674,7 @@ HRESULT Compress( const Image* srcImages, size_t nimages, const TexMetadata& met
         }
         else
         {
-            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), alphaRef, degenerate );
+            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), alphaRef );
             if ( FAILED(hr) )
             {
                 cImages.Release();
@@ -3193,10 +3193,348 @@ static HRESULT _ConvertUsingWIC( _In_ const Image& srcImage, _In_ const WICPixel
 }
 
 
+//-------------------------------------------------------------------------------------
+// Direct conversion for common format pairs
+//
+// Every channel of these formats converts independently of the others, so running each
+// possible source channel value once through _LoadScanline/_ConvertScanline/_StoreScanline
+// gives per-channel tables that reproduce the general path exactly. Rows then convert
+// straight from source to destination memory, using SSE2 where a table turns out to be
+// a plain copy, widen, or normalize of the 8-bit source value.
+//-------------------------------------------------------------------------------------
+struct FastConvertFormat
+{
+    DXGI_FORMAT format;
+    size_t      bpc;        // bytes per channel
+    uint8_t     order[4];   // position in memory of the R, G, B, and A channels
+};
+
+static const FastConvertFormat g_FastConvertFormats[] =
+{
+    { DXGI_FORMAT_R32G32B32A32_FLOAT,   4, { 0, 1, 2, 3 } },
+    { DXGI_FORMAT_R16G16B16A16_FLOAT,   2, { 0, 1, 2, 3 } },
+    { DXGI_FORMAT_R16G16B16A16_UNORM,   2, { 0, 1, 2, 3 } },
+    { DXGI_FORMAT_R8G8B8A8_UNORM,       1, { 0, 1, 2, 3 } },
+    { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,  1, { 0, 1, 2, 3 } },
+    { DXGI_FORMAT_B8G8R8A8_UNORM,       1, { 2, 1, 0, 3 } },
+    { DXGI_FORMAT_B8G8R8X8_UNORM,       1, { 2, 1, 0, 3 } },
+    { DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,  1, { 2, 1, 0, 3 } },
+    { DXGI_FORMAT_B8G8R8X8_UNORM_SRGB,  1, { 2, 1, 0, 3 } },
+};
+
+enum FAST_CONVERT_KERNEL
+{
+    FAST_CONVERT_TABLE = 0,     // Per-channel table lookup
+    FAST_CONVERT_COPY8,         // 8-bit to 8-bit with values unchanged
+    FAST_CONVERT_WIDEN16,       // 8-bit to 16-bit UNORM as value * 257
+    FAST_CONVERT_NORMALIZE32,   // 8-bit to 32-bit FLOAT as value * (1/255)
+};
+
+struct FastConvert
+{
+    const FastConvertFormat*    in;
+    const FastConvertFormat*    out;
+    FAST_CONVERT_KERNEL         kernel;
+    bool                        swapRB;     // Source and destination disagree on RGB vs. BGR order
+    bool                        opaque;     // Destination alpha is always the maximum value
+    size_t                      entries;
+    std::unique_ptr<uint8_t[]>  table;      // [channel][entry], out->bpc bytes each
+};
+
+static const FastConvertFormat* _FindFastConvertFormat( _In_ DXGI_FORMAT format )
+{
+    for( size_t j = 0; j < _countof(g_FastConvertFormats); ++j )
+    {
+        if ( g_FastConvertFormats[j].format == format )
+            return &g_FastConvertFormats[j];
+    }
+
+    return nullptr;
+}
+
+static void _FastConvertScanlineTable( _In_ const FastConvert& fc, _Out_ void* pDestination, _In_ const void* pSource, _In_ size_t count )
+{
+    const size_t ibpc = fc.in->bpc;
+    const size_t obpc = fc.out->bpc;
+    const size_t entries = fc.entries;
+
+    const uint8_t * __restrict sPtr = reinterpret_cast<const uint8_t*>( pSource );
+    uint8_t * __restrict dPtr = reinterpret_cast<uint8_t*>( pDestination );
+
+    for( size_t i = 0; i < count; ++i, sPtr += 4*ibpc, dPtr += 4*obpc )
+    {
+        for( size_t c = 0; c < 4; ++c )
+        {
+            size_t value = ( ibpc == 1 ) ? sPtr[ fc.in->order[c] ]
+                                         : reinterpret_cast<const uint16_t*>( sPtr )[ fc.in->order[c] ];
+
+            const uint8_t* entry = fc.table.get() + ( c * entries + value ) * obpc;
+            uint8_t* target = dPtr + fc.out->order[c] * obpc;
+
+            switch( obpc )
+            {
+            case 1: *target = *entry; break;
+            case 2: *reinterpret_cast<uint16_t*>( target ) = *reinterpret_cast<const uint16_t*>( entry ); break;
+            default: *reinterpret_cast<uint32_t*>( target ) = *reinterpret_cast<const uint32_t*>( entry ); break;
+            }
+        }
+    }
+}
+
+static void _FastConvertScanline( _In_ const FastConvert& fc, _Out_ void* pDestination, _In_ const void* pSource, _In_ size_t count )
+{
+    size_t simdCount = 0;
+
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+    if ( fc.kernel != FAST_CONVERT_TABLE )
+    {
+        static const XMVECTORU32 s_MaskRB = { 0x00FF00FF, 0x00FF00FF, 0x00FF00FF, 0x00FF00FF };
+        static const XMVECTORU32 s_MaskGA = { 0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00 };
+        static const XMVECTORU32 s_Alpha  = { 0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000 };
+        static const XMVECTORF32 s_Scale  = { 1.f/255.f, 1.f/255.f, 1.f/255.f, 1.f/255.f };
+
+        const __m128i maskRB = _mm_castps_si128( s_MaskRB );
+        const __m128i maskGA = _mm_castps_si128( s_MaskGA );
+        const __m128i alpha = _mm_castps_si128( s_Alpha );
+        const __m128i zero = _mm_setzero_si128();
+
+        const uint8_t * __restrict sPtr = reinterpret_cast<const uint8_t*>( pSource );
+        uint8_t * __restrict dPtr = reinterpret_cast<uint8_t*>( pDestination );
+
+        simdCount = count & ~size_t(3);
+        for( size_t i = 0; i < simdCount; i += 4, sPtr += 16 )
+        {
+            // Four 8:8:8:8 pixels, reordered to destination channel order
+            __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( sPtr ) );
+
+            if ( fc.swapRB )
+            {
+                __m128i rb = _mm_and_si128( v, maskRB );
+                rb = _mm_or_si128( _mm_srli_epi32( rb, 16 ), _mm_slli_epi32( rb, 16 ) );
+                v = _mm_or_si128( _mm_and_si128( v, maskGA ), _mm_and_si128( rb, maskRB ) );
+            }
+
+            if ( fc.opaque )
+                v = _mm_or_si128( v, alpha );
+
+            switch( fc.kernel )
+            {
+            case FAST_CONVERT_COPY8:
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dPtr ), v );
+                dPtr += 16;
+                break;
+
+            case FAST_CONVERT_WIDEN16:
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dPtr ), _mm_unpacklo_epi8( v, v ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dPtr + 16 ), _mm_unpackhi_epi8( v, v ) );
+                dPtr += 32;
+                break;
+
+            case FAST_CONVERT_NORMALIZE32:
+                {
+                    __m128i lo = _mm_unpacklo_epi8( v, zero );
+                    __m128i hi = _mm_unpackhi_epi8( v, zero );
+                    __m128 p0 = _mm_cvtepi32_ps( _mm_unpacklo_epi16( lo, zero ) );
+                    __m128 p1 = _mm_cvtepi32_ps( _mm_unpackhi_epi16( lo, zero ) );
+                    __m128 p2 = _mm_cvtepi32_ps( _mm_unpacklo_epi16( hi, zero ) );
+                    __m128 p3 = _mm_cvtepi32_ps( _mm_unpackhi_epi16( hi, zero ) );
+                    _mm_storeu_ps( reinterpret_cast<float*>( dPtr ), _mm_mul_ps( p0, s_Scale ) );
+                    _mm_storeu_ps( reinterpret_cast<float*>( dPtr + 16 ), _mm_mul_ps( p1, s_Scale ) );
+                    _mm_storeu_ps( reinterpret_cast<float*>( dPtr + 32 ), _mm_mul_ps( p2, s_Scale ) );
+                    _mm_storeu_ps( reinterpret_cast<float*>( dPtr + 48 ), _mm_mul_ps( p3, s_Scale ) );
+                    dPtr += 64;
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+#endif
+
+    if ( simdCount < count )
+    {
+        _FastConvertScanlineTable( fc,
+                                   reinterpret_cast<uint8_t*>( pDestination ) + simdCount * 4 * fc.out->bpc,
+                                   reinterpret_cast<const uint8_t*>( pSource ) + simdCount * 4 * fc.in->bpc,
+                                   count - simdCount );
+    }
+}
+
+// Returns true if every channel's table matches 'expected', allowing alpha to instead be constant 'opaqueValue'
+template<class T, class F>
+static bool _MatchFastConvertTable( _In_ const FastConvert& fc, _In_ F expected, _In_ T opaqueValue, _Out_ bool& opaque )
+{
+    const T* table = reinterpret_cast<const T*>( fc.table.get() );
+
+    opaque = false;
+    for( size_t c = 0; c < 4; ++c )
+    {
+        const T* channel = table + c * fc.entries;
+
+        bool match = true;
+        bool constant = true;
+        for( size_t i = 0; i < fc.entries; ++i )
+        {
+            T value = expected( i );
+            if ( memcmp( &channel[i], &value, sizeof(T) ) != 0 )
+                match = false;
+            if ( memcmp( &channel[i], &opaqueValue, sizeof(T) ) != 0 )
+                constant = false;
+        }
+
+        if ( match )
+            continue;
+
+        if ( c == 3 && constant )
+        {
+            opaque = true;
+            continue;
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------
+// Prepares a direct conversion, or returns false if the general path must be used
+//-------------------------------------------------------------------------------------
+static bool _SetupFastConvert( _In_ DXGI_FORMAT inFormat, _In_ DXGI_FORMAT outFormat, _In_ DWORD filter, _In_ float threshold,
+                               _In_ size_t pixels, _Out_ FastConvert& fc )
+{
+    fc.in = _FindFastConvertFormat( inFormat );
+    fc.out = _FindFastConvertFormat( outFormat );
+    fc.kernel = FAST_CONVERT_TABLE;
+    fc.swapRB = false;
+    fc.opaque = false;
+    fc.entries = 0;
+    fc.table.reset();
+
+    if ( !fc.in || !fc.out || fc.in->bpc > 2 || ( fc.in->bpc == 2 && fc.out->bpc != 1 ) )
+        return false;
+
+    if ( filter & (TEX_FILTER_DITHER | TEX_FILTER_DITHER_DIFFUSION | TEX_FILTER_FORCE_GENERAL) )
+        return false;
+
+    // Building and checking the tables costs about as much as converting 'entries' pixels
+    fc.entries = size_t(1) << ( fc.in->bpc * 8 );
+    if ( pixels < fc.entries )
+        return false;
+
+    const size_t entries = fc.entries;
+    const size_t ibpc = fc.in->bpc;
+    const size_t obpc = fc.out->bpc;
+
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * entries, 16 ) ) );
+    std::unique_ptr<uint8_t[]> probe( new (std::nothrow) uint8_t[ entries * 4 * ( ibpc + obpc*2 ) ] );
+    fc.table.reset( new (std::nothrow) uint8_t[ entries * 4 * obpc ] );
+    if ( !scanline || !probe || !fc.table )
+        return false;
+
+    uint8_t* src = probe.get();
+    uint8_t* dest = src + entries * 4 * ibpc;
+    uint8_t* check = dest + entries * 4 * obpc;
+
+    // Run the general path over a row where pixel i has every channel set to i
+    for( size_t i = 0; i < entries; ++i )
+    {
+        for( size_t c = 0; c < 4; ++c )
+        {
+            if ( ibpc == 1 )
+                src[ i*4 + c ] = static_cast<uint8_t>( i );
+            else
+                reinterpret_cast<uint16_t*>( src )[ i*4 + c ] = static_cast<uint16_t>( i );
+        }
+    }
+
+    if ( !_LoadScanline( scanline.get(), entries, src, entries * 4 * ibpc, inFormat ) )
+        return false;
+
+    _ConvertScanline( scanline.get(), entries, outFormat, inFormat, filter );
+
+    if ( !_StoreScanline( dest, entries * 4 * obpc, outFormat, scanline.get(), entries, threshold ) )
+        return false;
+
+    for( size_t c = 0; c < 4; ++c )
+    {
+        for( size_t i = 0; i < entries; ++i )
+        {
+            memcpy( fc.table.get() + ( c * entries + i ) * obpc, dest + ( i*4 + fc.out->order[c] ) * obpc, obpc );
+        }
+    }
+
+    // Use a SIMD kernel when the tables show the conversion reduces to one
+    if ( ibpc == 1 )
+    {
+        fc.swapRB = ( fc.in->order[0] != fc.out->order[0] );
+
+        switch( outFormat )
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            if ( _MatchFastConvertTable<float>( fc, []( size_t i ) { return float(i) * (1.f/255.f); }, 1.f, fc.opaque ) )
+                fc.kernel = FAST_CONVERT_NORMALIZE32;
+            break;
+
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            if ( _MatchFastConvertTable<uint16_t>( fc, []( size_t i ) { return static_cast<uint16_t>( i * 257 ); }, uint16_t(0xFFFF), fc.opaque ) )
+                fc.kernel = FAST_CONVERT_WIDEN16;
+            break;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            break;
+
+        default:
+            if ( _MatchFastConvertTable<uint8_t>( fc, []( size_t i ) { return static_cast<uint8_t>( i ); }, uint8_t(0xFF), fc.opaque ) )
+                fc.kernel = FAST_CONVERT_COPY8;
+            break;
+        }
+    }
+
+    // Confirm against the general path with distinct values in each channel
+    for( size_t i = 0; i < entries; ++i )
+    {
+        for( size_t c = 0; c < 4; ++c )
+        {
+            if ( ibpc == 1 )
+                src[ i*4 + c ] = static_cast<uint8_t>( i + c*67 );
+            else
+                reinterpret_cast<uint16_t*>( src )[ i*4 + c ] = static_cast<uint16_t>( i + c*16411 );
+        }
+    }
+
+    if ( !_LoadScanline( scanline.get(), entries, src, entries * 4 * ibpc, inFormat ) )
+        return false;
+
+    _ConvertScanline( scanline.get(), entries, outFormat, inFormat, filter );
+
+    if ( !_StoreScanline( dest, entries * 4 * obpc, outFormat, scanline.get(), entries, threshold ) )
+        return false;
+
+    _FastConvertScanline( fc, check, src, entries );
+    if ( memcmp( dest, check, entries * 4 * obpc ) != 0 )
+    {
+        if ( fc.kernel == FAST_CONVERT_TABLE )
+            return false;
+
+        fc.kernel = FAST_CONVERT_TABLE;
+
+        _FastConvertScanline( fc, check, src, entries );
+        if ( memcmp( dest, check, entries * 4 * obpc ) != 0 )
+            return false;
+    }
+
+    return true;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Convert the source image (not using WIC)
 //-------------------------------------------------------------------------------------
-static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z )
+static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z,
+                         _In_opt_ const FastConvert* fast )
 {
     assert( srcImage.width == destImage.width );
     assert( srcImage.height == destImage.height );
@@ -3208,6 +3546,21 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
 
     size_t width = srcImage.width;
 
+    if ( fast )
+    {
+        assert( fast->in->format == srcImage.format && fast->out->format == destImage.format );
+
+        for( size_t h = 0; h < srcImage.height; ++h )
+        {
+            _FastConvertScanline( *fast, pDest, pSrc, width );
+
+            pSrc += srcImage.rowPitch;
+            pDest += destImage.rowPitch;
+        }
+
+        return S_OK;
+    }
+
     if ( filter & TEX_FILTER_DITHER_DIFFUSION )
     {
         // Error diffusion dithering (aka Floyd-Steinberg dithering)
@@ -3322,7 +3675,10 @@ HRESULT Convert( const Image& srcImage, DXGI_FORMAT format, DWORD filter, float
     }
     else
     {
-        hr = _Convert( srcImage, filter, *rimage, threshold, 0 );
+        FastConvert fast;
+        bool usefast = _SetupFastConvert( srcImage.format, format, filter, threshold, srcImage.width * srcImage.height, fast );
+
+        hr = _Convert( srcImage, filter, *rimage, threshold, 0, usefast ? &fast : nullptr );
     }
 
     if ( FAILED(hr) )
@@ -3377,6 +3733,20 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
     WICPixelFormatGUID pfGUID, targetGUID;
     bool usewic = _UseWICConversion( filter, metadata.format, format, pfGUID, targetGUID );
 
+    // Direct conversion tables are built once and shared by every image
+    FastConvert fast;
+    bool usefast = false;
+    if ( !usewic )
+    {
+        size_t pixels = 0;
+        for( size_t index=0; index < nimages; ++index )
+        {
+            pixels += srcImages[ index ].width * srcImages[ index ].height;
+        }
+
+        usefast = _SetupFastConvert( metadata.format, format, filter, threshold, pixels, fast );
+    }
+
     switch (metadata.dimension)
     {
     case TEX_DIMENSION_TEXTURE1D:
@@ -3410,7 +3780,7 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
             }
             else
             {
-                hr = _Convert( src, filter, dst, threshold, 0 );
+                hr = _Convert( src, filter, dst, threshold, 0, usefast ? &fast : nullptr );
             }
 
             if ( FAILED(hr) )
@@ -3459,7 +3829,7 @@ HRESULT Convert( const Image* srcImages, size_t nimages, const TexMetadata& meta
                     }
                     else
                     {
-                        hr = _Convert( src, filter, dst, threshold, slice );
+                        hr = _Convert( src, filter, dst, threshold, slice, usefast ? &fast : nullptr );
                     }
 
                     if ( FAILED(hr) )
@@ -1322,13 +1322,14 @@ HRESULT GetMetadataFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata& metada
 #endif
 
     // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
-    if ( fileSize.HighPart > 0 )
+    // unless the caller accepts mapping it instead
+    if ( fileSize.HighPart > 0 && !(flags & DDS_FLAGS_MAPPED) )
     {
         return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
     }
 
     // Need at least enough data to fill the standard header and magic number to be a valid DDS
-    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    if ( fileSize.HighPart == 0 && fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
     {
         return E_FAIL;
     }
@@ -1442,13 +1443,14 @@ HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, Scr
 #endif
 
     // File is too big for 32-bit allocation, so reject read (4 GB should be plenty large enough for a valid DDS file)
-    if ( fileSize.HighPart > 0 )
+    // unless the caller accepts mapping it instead
+    if ( fileSize.HighPart > 0 && !(flags & DDS_FLAGS_MAPPED) )
     {
         return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
     }
 
     // Need at least enough data to fill the standard header and magic number to be a valid DDS
-    if ( fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    if ( fileSize.HighPart == 0 && fileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
     {
         return E_FAIL;
     }
@@ -1505,6 +1507,33 @@ HRESULT LoadFromDDSFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, Scr
         offset += ( 256 * sizeof(uint32_t) );
     }
 
+    // Pixels that need no conversion are used straight from the file
+    if ( (flags & DDS_FLAGS_MAPPED)
+         && !(convFlags & (CONV_FLAGS_EXPAND|CONV_FLAGS_SWIZZLE|CONV_FLAGS_NOALPHA))
+         && !(flags & DDS_FLAGS_LEGACY_DWORD) )
+    {
+        size_t pixelSize, nimages;
+        _DetermineImageArray( mdata, CP_FLAGS_NONE, nimages, pixelSize );
+
+        // Truncated or padded files go through the read path below so they are handled as before
+        if ( static_cast<uint64_t>( fileSize.QuadPart ) - offset == pixelSize )
+        {
+            hr = image.InitializeFromFile( mdata, hFile.get(), offset );
+            if ( FAILED(hr) )
+                return hr;
+
+            if ( metadata )
+                memcpy( metadata, &mdata, sizeof(TexMetadata) );
+
+            return S_OK;
+        }
+    }
+
+    if ( fileSize.HighPart > 0 )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
     DWORD remaining = fileSize.LowPart - offset;
     if ( remaining == 0 )
         return E_FAIL;
@@ -1705,14 +1734,34 @@ HRESULT SaveToDDSMemory( const Image* images, size_t nimages, const TexMetadata&
 
 
 //-------------------------------------------------------------------------------------
-// Save a DDS file to disk
+// Streaming DDS file writer
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT SaveToDDSFile( const Image* images, size_t nimages, const TexMetadata& metadata, DWORD flags, LPCWSTR szFile )
+HRESULT DDSFileWriter::Initialize( const TexMetadata& metadata, DWORD flags, LPCWSTR szFile )
 {
     if ( !szFile )
         return E_INVALIDARG;
 
+    Release();
+
+    if ( !metadata.width || !metadata.height || !metadata.depth || !metadata.arraySize || !metadata.mipLevels )
+        return E_INVALIDARG;
+
+    switch( metadata.dimension )
+    {
+    case DDS_DIMENSION_TEXTURE1D:
+    case DDS_DIMENSION_TEXTURE2D:
+        break;
+
+    case DDS_DIMENSION_TEXTURE3D:
+        if ( metadata.arraySize != 1 )
+            return E_FAIL;
+        break;
+
+    default:
+        return E_FAIL;
+    }
+
     // Create DDS Header
     const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
     uint8_t header[MAX_HEADER_SIZE];
@@ -1743,81 +1792,172 @@ HRESULT SaveToDDSFile( const Image* images, size_t nimages, const TexMetadata& m
         return E_FAIL;
     }
 
-    // Write images
-    switch( metadata.dimension )
+    size_t pixelSize;
+    _DetermineImageArray( metadata, CP_FLAGS_NONE, _nimages, pixelSize );
+
+    _hFile = hFile.release();
+    _flags = flags;
+    _index = 0;
+    _headerSize = required;
+    _metadata = metadata;
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DDSFileWriter::WriteImage( const Image& image )
+{
+    if ( !_hFile )
+        return E_UNEXPECTED;
+
+    if ( _index >= _nimages )
+        return E_FAIL;
+
+    if ( !image.pixels )
+        return E_POINTER;
+
+    // Find the mip level of the next image in file order
+    size_t level = 0;
+    if ( _metadata.dimension == TEX_DIMENSION_TEXTURE3D )
     {
-    case DDS_DIMENSION_TEXTURE1D:
-    case DDS_DIMENSION_TEXTURE2D:
+        size_t d = _metadata.depth;
+        for( size_t index = _index; index >= d; ++level )
         {
-            size_t index = 0;
-            for( size_t item = 0; item < metadata.arraySize; ++item )
-            {
-                for( size_t level = 0; level < metadata.mipLevels; ++level, ++index )
-                {
-                    if ( index >= nimages )
-                        return E_FAIL;
+            index -= d;
+            if ( d > 1 )
+                d >>= 1;
+        }
+    }
+    else
+    {
+        level = _index % _metadata.mipLevels;
+    }
 
-                    if ( !images[ index ].pixels )
-                        return E_POINTER;
+    if ( image.width != std::max<size_t>( _metadata.width >> level, 1 )
+         || image.height != std::max<size_t>( _metadata.height >> level, 1 ) )
+    {
+        return E_INVALIDARG;
+    }
 
-                    size_t pixsize = images[ index ].slicePitch;
+    size_t pixsize = image.slicePitch;
 
-                    if ( !WriteFile( hFile.get(), images[ index ].pixels, static_cast<DWORD>( pixsize ), &bytesWritten, 0 ) )
-                    {
-                        return HRESULT_FROM_WIN32( GetLastError() );
-                    }
+    DWORD bytesWritten;
+    if ( !WriteFile( _hFile, image.pixels, static_cast<DWORD>( pixsize ), &bytesWritten, 0 ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
 
-                    if ( bytesWritten != pixsize )
-                    {
-                        return E_FAIL;
-                    }
-                }
-            }
-        }
-        break;
+    if ( bytesWritten != pixsize )
+    {
+        return E_FAIL;
+    }
 
-    case DDS_DIMENSION_TEXTURE3D:
-        {
-            if ( metadata.arraySize != 1 )
-                return E_FAIL;
+    ++_index;
 
-            size_t d = metadata.depth;
+    return S_OK;
+}
 
-            size_t index = 0;
-            for( size_t level = 0; level < metadata.mipLevels; ++level )
-            {
-                for( size_t slice = 0; slice < d; ++slice, ++index )
-                {
-                    if ( index >= nimages )
-                        return E_FAIL;
+_Use_decl_annotations_
+HRESULT DDSFileWriter::Finish( const TexMetadata* metadata )
+{
+    if ( !_hFile )
+        return E_UNEXPECTED;
 
-                    if ( !images[ index ].pixels )
-                        return E_POINTER;
+    // The file is closed however this turns out
+    ScopedHandle hFile( _hFile );
+    _hFile = 0;
 
-                    size_t pixsize = images[ index ].slicePitch;
+    if ( _index != _nimages )
+        return E_FAIL;
 
-                    if ( !WriteFile( hFile.get(), images[ index ].pixels, static_cast<DWORD>( pixsize ), &bytesWritten, 0 ) )
-                    {
-                        return HRESULT_FROM_WIN32( GetLastError() );
-                    }
+    if ( metadata )
+    {
+        if ( metadata->width != _metadata.width
+             || metadata->height != _metadata.height
+             || metadata->depth != _metadata.depth
+             || metadata->arraySize != _metadata.arraySize
+             || metadata->mipLevels != _metadata.mipLevels
+             || metadata->miscFlags != _metadata.miscFlags
+             || metadata->format != _metadata.format
+             || metadata->dimension != _metadata.dimension )
+        {
+            return E_INVALIDARG;
+        }
 
-                    if ( bytesWritten != pixsize )
-                    {
-                        return E_FAIL;
-                    }
-                }
+        // Rewrite the header in place; with the layout unchanged its size is the same
+        const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+        uint8_t header[MAX_HEADER_SIZE];
+        size_t required;
+        HRESULT hr = _EncodeDDSHeader( *metadata, _flags, header, MAX_HEADER_SIZE, required );
+        if ( FAILED(hr) )
+            return hr;
 
-                if ( d > 1 )
-                    d >>= 1;
-            }
+        assert( required == _headerSize );
+
+        LARGE_INTEGER filePos = { 0, 0 };
+        if ( !SetFilePointerEx( hFile.get(), filePos, 0, FILE_BEGIN ) )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
         }
-        break;
 
-    default:
-        return E_FAIL;
+        DWORD bytesWritten;
+        if ( !WriteFile( hFile.get(), header, static_cast<DWORD>( required ), &bytesWritten, 0 ) )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        if ( bytesWritten != required )
+        {
+            return E_FAIL;
+        }
+
+        _metadata.miscFlags2 = metadata->miscFlags2;
     }
 
     return S_OK;
 }
 
+void DDSFileWriter::Release()
+{
+    if ( _hFile )
+    {
+        CloseHandle( _hFile );
+        _hFile = 0;
+    }
+
+    _flags = 0;
+    _nimages = 0;
+    _index = 0;
+    _headerSize = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Save a DDS file to disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT SaveToDDSFile( const Image* images, size_t nimages, const TexMetadata& metadata, DWORD flags, LPCWSTR szFile )
+{
+    if ( !szFile )
+        return E_INVALIDARG;
+
+    DDSFileWriter writer;
+    HRESULT hr = writer.Initialize( metadata, flags, szFile );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Write images
+    for( size_t index = 0; index < writer.GetImageCount(); ++index )
+    {
+        if ( index >= nimages )
+            return E_FAIL;
+
+        hr = writer.WriteImage( images[ index ] );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    return writer.Finish();
+}
+
 }; // namespace
@@ -230,15 +230,14 @@ bool _SetupImageArray( uint8_t *pMemory, size_t pixelSize,
 //=====================================================================================
 
 //-------------------------------------------------------------------------------------
-// Methods
+// Validates metadata for a new image array and resolves the mip count
 //-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-HRESULT ScratchImage::Initialize( const TexMetadata& mdata )
+static HRESULT _ValidateMetadata( _In_ const TexMetadata& mdata, _Out_ size_t& mipLevels )
 {
     if ( !IsValid(mdata.format) || IsVideo(mdata.format) )
         return E_INVALIDARG;
 
-    size_t mipLevels = mdata.mipLevels;
+    mipLevels = mdata.mipLevels;
 
     switch( mdata.dimension )
     {
@@ -276,6 +275,21 @@ HRESULT ScratchImage::Initialize( const TexMetadata& mdata )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Methods
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ScratchImage::Initialize( const TexMetadata& mdata )
+{
+    size_t mipLevels;
+    HRESULT hr = _ValidateMetadata( mdata, mipLevels );
+    if ( FAILED(hr) )
+        return hr;
+
     Release();
 
     _metadata.width = mdata.width;
@@ -314,6 +328,93 @@ HRESULT ScratchImage::Initialize( const TexMetadata& mdata )
     return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT ScratchImage::InitializeFromFile( const TexMetadata& mdata, HANDLE hFile, uint64_t offset )
+{
+    if ( !hFile )
+        return E_INVALIDARG;
+
+    size_t mipLevels;
+    HRESULT hr = _ValidateMetadata( mdata, mipLevels );
+    if ( FAILED(hr) )
+        return hr;
+
+    Release();
+
+    _metadata.width = mdata.width;
+    _metadata.height = mdata.height;
+    _metadata.depth = mdata.depth;
+    _metadata.arraySize = mdata.arraySize;
+    _metadata.mipLevels = mipLevels;
+    _metadata.miscFlags = mdata.miscFlags;
+    _metadata.miscFlags2 = mdata.miscFlags2;
+    _metadata.format = mdata.format;
+    _metadata.dimension = mdata.dimension;
+
+    size_t pixelSize, nimages;
+    _DetermineImageArray( _metadata, CP_FLAGS_NONE, nimages, pixelSize );
+
+    // Views must start on an allocation granularity boundary, so map from the start of the file
+    uint64_t viewSize = offset + pixelSize;
+    if ( viewSize > SIZE_MAX )
+    {
+        Release();
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    LARGE_INTEGER fileSize = {0};
+    if ( !GetFileSizeEx( hFile, &fileSize ) )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+        Release();
+        return hr;
+    }
+
+    if ( static_cast<uint64_t>( fileSize.QuadPart ) < viewSize )
+    {
+        Release();
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+
+    _image = new (std::nothrow) Image[ nimages ];
+    if ( !_image )
+    {
+        Release();
+        return E_OUTOFMEMORY;
+    }
+
+    _nimages = nimages;
+    memset( _image, 0, sizeof(Image) * nimages );
+
+    // Copy-on-write keeps the pixels writable like any other ScratchImage without ever modifying the file
+    ScopedHandle hMapping( CreateFileMappingW( hFile, 0, PAGE_WRITECOPY, 0, 0, 0 ) );
+    if ( !hMapping )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+        Release();
+        return hr;
+    }
+
+    // The view keeps the mapping alive after its handle is closed
+    _view = MapViewOfFile( hMapping.get(), FILE_MAP_COPY, 0, 0, static_cast<SIZE_T>( viewSize ) );
+    if ( !_view )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+        Release();
+        return hr;
+    }
+
+    _memory = reinterpret_cast<uint8_t*>( _view ) + offset;
+    _size = pixelSize;
+    if ( !_SetupImageArray( _memory, pixelSize, _metadata, CP_FLAGS_NONE, _image, nimages ) )
+    {
+        Release();
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
 _Use_decl_annotations_
 HRESULT ScratchImage::Initialize1D( DXGI_FORMAT fmt, size_t length, size_t arraySize, size_t mipLevels )
 {
@@ -600,7 +701,14 @@ void ScratchImage::Release()
         _image = 0;
     }
 
-    if ( _memory )
+    if ( _view )
+    {
+        // _memory points into the mapped view
+        UnmapViewOfFile( _view );
+        _view = 0;
+        _memory = 0;
+    }
+    else if ( _memory )
     {
         _aligned_free( _memory );
         _memory = 0;
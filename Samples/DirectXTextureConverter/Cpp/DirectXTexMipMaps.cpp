@@ -553,6 +553,22 @@ static HRESULT _GenerateMipMapsUsingWIC( _In_ const Image& baseImage, _In_ DWORD
 //-------------------------------------------------------------------------------------
 // Generate (1D/2D) mip-map helpers (custom filtering)
 //-------------------------------------------------------------------------------------
+// Band kernels shared with the custom Resize filters (see DirectXTexResize.cpp)
+extern HRESULT _ResizePointRows( _In_ const Image& srcImage, _In_ const Image& destImage, _In_ size_t yStart, _In_ size_t yEnd,
+                                 _Out_writes_(srcImage.width + destImage.width) XMVECTOR* scanline );
+
+extern HRESULT _ResizeLinearRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                  _In_reads_(destImage.width) const LinearFilter* lfX, _In_reads_(destImage.height) const LinearFilter* lfY,
+                                  _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width*2 + destImage.width) XMVECTOR* scanline );
+
+extern HRESULT _ResizeCubicRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                 _In_reads_(destImage.width) const CubicFilter* cfX, _In_reads_(destImage.height) const CubicFilter* cfY,
+                                 _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width*4 + destImage.width) XMVECTOR* scanline );
+
+extern HRESULT _ResizeTriangleRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                    _In_ TriangleFilter::Filter* tfX, _In_ TriangleFilter::Filter* tfY,
+                                    _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width) XMVECTOR* scanline );
+
 static HRESULT _Setup2DMips( _In_reads_(nimages) const Image* baseImages, _In_ size_t nimages, _In_ const TexMetadata& mdata,
                              _Out_ ScratchImage& mipChain )
 {
@@ -606,7 +622,7 @@ static HRESULT _Setup2DMips( _In_reads_(nimages) const Image* baseImages, _In_ s
 }
 
 //--- 2D Point Filter ---
-static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
     if ( !mipChain.GetImages() )
         return E_INVALIDARG;
@@ -618,22 +634,9 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*2), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row = target + width;
-
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
     {
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
-
         // 2D point filter
         const Image* src = mipChain.GetImage( level-1, item, 0 );
         const Image* dest = mipChain.GetImage( level, item, 0 );
@@ -641,42 +644,17 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
         if ( !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
         size_t nwidth = (width > 1) ? (width >> 1) : 1;
         size_t nheight = (height > 1) ? (height >> 1) : 1;
 
-        size_t xinc = ( width << 16 ) / nwidth;
-        size_t yinc = ( height << 16 ) / nheight;
-
-        size_t lasty = size_t(-1);
-
-        size_t sy = 0;
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            if ( (lasty ^ sy) >> 16 )
-            {
-                if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src->format ) )
-                    return E_FAIL;
-                lasty = sy;
-            }
-
-            size_t sx = 0;
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                target[ x ] = row[ sx >> 16 ];
-                sx += xinc;
-            }
-
-            if ( !_StoreScanline( pDest, dest->rowPitch, dest->format, target, nwidth ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-
-            sy += yinc;
-        }
+        // Temporary space is 2 scanlines per band
+        HRESULT hr = _ProcessBands( nheight, BAND_MIN_ROWS, width + nwidth, filter,
+                                    [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                    {
+                                        return _ResizePointRows( *src, *dest, yStart, yEnd, scanline );
+                                    } );
+        if ( FAILED(hr) )
+            return hr;
 
         if ( height > 1 )
             height >>= 1;
@@ -690,6 +668,67 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
 
 
 //--- 2D Box Filter ---
+static HRESULT _Generate2DMipsBoxRows( _In_ const Image& src, _In_ DWORD filter, _In_ const Image& dest,
+                                       _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(src.width*3) XMVECTOR* scanline )
+{
+    assert( src.pixels && dest.pixels );
+    assert( yStart < yEnd && yEnd <= dest.height );
+
+    size_t width = src.width;
+
+    // Temporary space (3 scanlines)
+    XMVECTOR* target = scanline;
+
+    XMVECTOR* urow0 = target + width;
+    XMVECTOR* urow1 = target + width*2;
+
+    if ( src.height <= 1 )
+    {
+        urow1 = urow0;
+    }
+
+    const XMVECTOR* urow2 = urow0 + 1;
+    const XMVECTOR* urow3 = urow1 + 1;
+
+    if ( width <= 1 )
+    {
+        urow2 = urow0;
+        urow3 = urow1;
+    }
+
+    size_t rowPitch = src.rowPitch;
+
+    const uint8_t* pSrc = src.pixels + ( rowPitch * yStart * 2 );
+    uint8_t* pDest = dest.pixels + ( dest.rowPitch * yStart );
+
+    for( size_t y = yStart; y < yEnd; ++y )
+    {
+        if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src.format, filter ) )
+            return E_FAIL;
+        pSrc += rowPitch;
+
+        if ( urow0 != urow1 )
+        {
+            if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src.format, filter ) )
+                return E_FAIL;
+            pSrc += rowPitch;
+        }
+
+        for( size_t x = 0; x < dest.width; ++x )
+        {
+            size_t x2 = x << 1;
+
+            AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
+        }
+
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, dest.width, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
+    }
+
+    return S_OK;
+}
+
 static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
     if ( !mipChain.GetImages() )
@@ -705,33 +744,9 @@ static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter,
     if ( !ispow2(width) || !ispow2(height) )
         return E_FAIL;
 
-    // Allocate temporary space (3 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* urow0 = target + width;
-    XMVECTOR* urow1 = target + width*2;
-
-    const XMVECTOR* urow2 = urow0 + 1;
-    const XMVECTOR* urow3 = urow1 + 1;
-
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
     {
-        if ( height <= 1 )
-        {
-            urow1 = urow0;
-        }
-
-        if ( width <= 1 )
-        {
-            urow2 = urow0;
-            urow3 = urow1;
-        }
-
         // 2D box filter
         const Image* src = mipChain.GetImage( level-1, item, 0 );
         const Image* dest = mipChain.GetImage( level, item, 0 );
@@ -739,38 +754,15 @@ static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter,
         if ( !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
         size_t nheight = (height > 1) ? (height >> 1) : 1;
 
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
-            pSrc += rowPitch;
-
-            if ( urow0 != urow1 )
-            {
-                if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src->format, filter ) )
-                    return E_FAIL;
-                pSrc += rowPitch;
-            }
-
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                size_t x2 = x << 1;
-
-                AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
-            }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
+        HRESULT hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*3, filter,
+                                    [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                    {
+                                        return _Generate2DMipsBoxRows( *src, filter, *dest, yStart, yEnd, scanline );
+                                    } );
+        if ( FAILED(hr) )
+            return hr;
 
         if ( height > 1 )
             height >>= 1;
@@ -796,22 +788,13 @@ static HRESULT _Generate2DMipsLinearFilter( _In_ size_t levels, _In_ DWORD filte
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
+    // Allocate X and Y filters (scanlines are allocated per band)
     std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ width+height ] );
     if ( !lf )
         return E_OUTOFMEMORY;
 
     LinearFilter* lfX = lf.get();
     LinearFilter* lfY = lf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
 
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
@@ -823,66 +806,19 @@ static HRESULT _Generate2DMipsLinearFilter( _In_ size_t levels, _In_ DWORD filte
         if ( !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
         size_t nwidth = (width > 1) ? (width >> 1) : 1;
         _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
 
         size_t nheight = (height > 1) ? (height >> 1) : 1;
         _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
 
-#ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
-#endif
-
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
-
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            auto& toY = lfY[ y ];
-
-            if ( toY.u0 != u0 )
-            {
-                if ( toY.u0 != u1 )
-                {
-                    u0 = toY.u0;
-
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
-
-                    std::swap( row0, row1 );
-                }
-            }
-
-            if ( toY.u1 != u1 )
-            {
-                u1 = toY.u1;
-
-                if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                    return E_FAIL;
-            }
-
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                auto& toX = lfX[ x ];
-
-                BILINEAR_INTERPOLATE( target[x], toX, toY, row0, row1 );
-            }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
+        HRESULT hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*2 + nwidth, filter,
+                                    [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                    {
+                                        return _ResizeLinearRows( *src, filter, *dest, lfX, lfY, yStart, yEnd, scanline );
+                                    } );
+        if ( FAILED(hr) )
+            return hr;
 
         if ( height > 1 )
             height >>= 1;
@@ -908,24 +844,13 @@ static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
+    // Allocate X and Y filters (scanlines are allocated per band)
     std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ width+height ] );
     if ( !cf )
         return E_OUTOFMEMORY;
 
     CubicFilter* cfX = cf.get();
     CubicFilter* cfY = cf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
-    XMVECTOR* row2 = target + width*3;
-    XMVECTOR* row3 = target + width*4;
 
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
@@ -937,138 +862,19 @@ static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter
         if (  !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
         size_t nwidth = (width > 1) ? (width >> 1) : 1;
         _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
 
         size_t nheight = (height > 1) ? (height >> 1) : 1;
         _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
 
-#ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
-        memset( row2, 0xED, sizeof(XMVECTOR)*width );
-        memset( row3, 0xFD, sizeof(XMVECTOR)*width );
-#endif
-
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
-        size_t u2 = size_t(-1);
-        size_t u3 = size_t(-1);
-
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            auto& toY = cfY[ y ];
-
-            // Scanline 1
-            if ( toY.u0 != u0 )
-            {
-                if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
-                {
-                    u0 = toY.u0;
-
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else if ( toY.u0 == u1 )
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
-
-                    std::swap( row0, row1 );
-                }
-                else if ( toY.u0 == u2 )
-                {
-                    u0 = u2;
-                    u2 = size_t(-1);
-
-                    std::swap( row0, row2 );
-                }
-                else if ( toY.u0 == u3 )
-                {
-                    u0 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row0, row3 );
-                }
-            }
-
-            // Scanline 2
-            if ( toY.u1 != u1 )
-            {
-                if ( toY.u1 != u2 && toY.u1 != u3 )
-                {
-                    u1 = toY.u1;
-
-                    if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else if ( toY.u1 == u2 )
-                {
-                    u1 = u2;
-                    u2 = size_t(-1);
-
-                    std::swap( row1, row2 );
-                }
-                else if ( toY.u1 == u3 )
-                {
-                    u1 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row1, row3 );
-                }
-            }
-
-            // Scanline 3
-            if ( toY.u2 != u2 )
-            {
-                if ( toY.u2 != u3 )
-                {
-                    u2 = toY.u2;
-
-                    if ( !_LoadScanlineLinear( row2, width, pSrc + (rowPitch * u2), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
-                {
-                    u2 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row2, row3 );
-                }
-            }
-
-            // Scanline 4
-            if ( toY.u3 != u3 )
-            {
-                u3 = toY.u3;
-
-                if ( !_LoadScanlineLinear( row3, width, pSrc + (rowPitch * u3), rowPitch, src->format, filter ) )
-                    return E_FAIL;
-            }
-
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                auto& toX = cfX[ x ];
-
-                XMVECTOR C0, C1, C2, C3;
-
-                CUBIC_INTERPOLATE( C0, toX.x, row0[ toX.u0 ], row0[ toX.u1 ], row0[ toX.u2 ], row0[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C1, toX.x, row1[ toX.u0 ], row1[ toX.u1 ], row1[ toX.u2 ], row1[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C2, toX.x, row2[ toX.u0 ], row2[ toX.u1 ], row2[ toX.u2 ], row2[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C3, toX.x, row3[ toX.u0 ], row3[ toX.u1 ], row3[ toX.u2 ], row3[ toX.u3 ] );
-
-                CUBIC_INTERPOLATE( target[x], toY.x, C0, C1, C2, C3 );
-            }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
+        HRESULT hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*4 + nwidth, filter,
+                                    [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                    {
+                                        return _ResizeCubicRows( *src, filter, *dest, cfX, cfY, yStart, yEnd, scanline );
+                                    } );
+        if ( FAILED(hr) )
+            return hr;
 
         if ( height > 1 )
             height >>= 1;
@@ -1096,21 +902,8 @@ static HRESULT _Generate2DMipsTriangleFilter( _In_ size_t levels, _In_ DWORD fil
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * width, 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ height ] );
-    if ( !rowActive )
-        return E_OUTOFMEMORY;
-
-    TriangleRow * rowFree = nullptr;
-
     std::unique_ptr<Filter> tfX, tfY;
 
-    XMVECTOR* row = scanline.get();
-
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
     {
@@ -1121,12 +914,6 @@ static HRESULT _Generate2DMipsTriangleFilter( _In_ size_t levels, _In_ DWORD fil
         if ( !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        size_t rowPitch = src->rowPitch;
-        const uint8_t* pEndSrc = pSrc + rowPitch * height;
-
-        uint8_t* pDest = dest->pixels;
-
         size_t nwidth = (width > 1) ? (width >> 1) : 1;
         HRESULT hr = _Create( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
         if ( FAILED(hr) )
@@ -1137,168 +924,34 @@ static HRESULT _Generate2DMipsTriangleFilter( _In_ size_t levels, _In_ DWORD fil
         if ( FAILED(hr) )
             return hr;
 
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
+        // Each band keeps its own accumulation rows; the scratch space is the source scanline
+        hr = _ProcessBands( nheight, BAND_MIN_ROWS, width, filter,
+                            [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                            {
+                                return _ResizeTriangleRows( *src, filter, *dest, tfX.get(), tfY.get(), yStart, yEnd, scanline );
+                            } );
+        if ( FAILED(hr) )
+            return hr;
 
-        auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
-        auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
+        if ( height > 1 )
+            height >>= 1;
 
-        // Count times rows get written (and clear out any leftover accumulation rows from last miplevel)
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
+        if ( width > 1 )
+            width >>= 1;
+    }
 
-                ++rowAcc->remaining;
+    return S_OK;
+}
 
-                if ( rowAcc->scanline )
-                {
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
 
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
-        }
-
-        // Filter image
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            // Create accumulation rows as needed
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
-
-                if ( !rowAcc->scanline )
-                {
-                    if ( rowFree )
-                    {
-                        // Steal and reuse scanline from 'free row' list
-                        // (it will always be at least as wide as nwidth due to loop decending order)
-                        assert( rowFree->scanline != 0 );
-                        rowAcc->scanline.reset( rowFree->scanline.release() );
-                        rowFree = rowFree->next;
-                    }
-                    else
-                    {
-                        rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * nwidth, 16 ) ) );
-                        if ( !rowAcc->scanline )
-                            return E_OUTOFMEMORY;
-                    }
-
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
-
-            // Load source scanline
-            if ( (pSrc + rowPitch) > pEndSrc )
-                return E_FAIL;
-
-            if ( !_LoadScanlineLinear( row, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
-
-            pSrc += rowPitch;
-
-            // Process row
-            size_t x = 0;
-            for( FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
-            {
-                for ( size_t j = 0; j < yFrom->count; ++j )
-                {
-                    size_t v = yFrom->to[ j ].u;
-                    assert( v < nheight );
-                    float yweight = yFrom->to[ j ].weight;
-
-                    XMVECTOR* accPtr = rowActive[ v ].scanline.get();
-                    if ( !accPtr )
-                        return E_POINTER;
-
-                    for ( size_t k = 0; k < xFrom->count; ++k )
-                    {
-                        size_t u = xFrom->to[ k ].u;
-                        assert( u < nwidth );
-
-                        XMVECTOR weight = XMVectorReplicate( yweight * xFrom->to[ k ].weight );
-
-                        assert( x < width );
-                        accPtr[ u ] = XMVectorMultiplyAdd( row[ x ], weight, accPtr[ u ] );
-                    }
-                }
-
-                xFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( xFrom ) + xFrom->sizeInBytes );
-            }
-
-            // Write completed accumulation rows
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive.get()[ v ];
-
-                assert( rowAcc->remaining > 0 );
-                --rowAcc->remaining;
-
-                if ( !rowAcc->remaining )
-                {
-                    XMVECTOR* pAccSrc = rowAcc->scanline.get();
-                    if ( !pAccSrc )
-                        return E_POINTER;
-
-                    switch( dest->format )
-                    {
-                    case DXGI_FORMAT_R10G10B10A2_UNORM:
-                    case DXGI_FORMAT_R10G10B10A2_UINT:
-                        {
-                            // Need to slightly bias results for floating-point error accumulation which can
-                            // be visible with harshly quantized values
-                            static const XMVECTORF32 Bias = { 0.f, 0.f, 0.f, 0.1f };
-                       
-                            XMVECTOR* ptr = pAccSrc;
-                            for( size_t i=0; i < dest->width; ++i, ++ptr )
-                            {
-                                *ptr = XMVectorAdd( *ptr, Bias );
-                            }
-                        }
-                        break;
-                    }
-
-                    // This performs any required clamping
-                    if ( !_StoreScanlineLinear( pDest + (dest->rowPitch * v), dest->rowPitch, dest->format, pAccSrc, dest->width, filter ) )
-                        return E_FAIL;
-
-                    // Put row on freelist to reuse it's allocated scanline
-                    rowAcc->next = rowFree;
-                    rowFree = rowAcc;
-                }
-            }
-
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
-        }
-
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
-    }
-
-    return S_OK;
-}
-
-
-//-------------------------------------------------------------------------------------
-// Generate volume mip-map helpers
-//-------------------------------------------------------------------------------------
-static HRESULT _Setup3DMips( _In_reads_(depth) const Image* baseImages, _In_ size_t depth, size_t levels,
-                             _Out_ ScratchImage& mipChain )
-{
-    if ( !baseImages || !depth )
-        return E_INVALIDARG;
+//-------------------------------------------------------------------------------------
+// Generate volume mip-map helpers
+//-------------------------------------------------------------------------------------
+static HRESULT _Setup3DMips( _In_reads_(depth) const Image* baseImages, _In_ size_t depth, size_t levels,
+                             _Out_ ScratchImage& mipChain )
+{
+    if ( !baseImages || !depth )
+        return E_INVALIDARG;
 
     assert( levels > 1 );
 
@@ -1346,7 +999,7 @@ static HRESULT _Setup3DMips( _In_reads_(depth) const Image* baseImages, _In_ siz
 
 
 //--- 3D Point Filter ---
-static HRESULT _Generate3DMipsPointFilter( _In_ size_t depth, _In_ size_t levels, _In_ const ScratchImage& mipChain )
+static HRESULT _Generate3DMipsPointFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
 {
     if ( !depth || !mipChain.GetImages() )
         return E_INVALIDARG;
@@ -1358,125 +1011,59 @@ static HRESULT _Generate3DMipsPointFilter( _In_ size_t depth, _In_ size_t levels
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*2), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row = target + width;
-
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
     {
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
+        size_t nwidth = (width > 1) ? (width >> 1) : 1;
+        size_t nheight = (height > 1) ? (height >> 1) : 1;
 
+        // Temporary space is 2 scanlines per band
+        HRESULT hr;
         if ( depth > 1 )
         {
-            // 3D point filter
+            // 3D point filter (bands of slices)
             size_t ndepth = depth >> 1;
 
             size_t zinc = ( depth << 16 ) / ndepth;
 
-            size_t sz = 0;
-            for( size_t slice=0; slice < ndepth; ++slice )
-            {
-                const Image* src = mipChain.GetImage( level-1, 0, (sz >> 16) );
-                const Image* dest = mipChain.GetImage( level, 0, slice );
-
-                if ( !src || !dest )
-                    return E_POINTER;
-
-                const uint8_t* pSrc = src->pixels;
-                uint8_t* pDest = dest->pixels;
-
-                size_t rowPitch = src->rowPitch;
-
-                size_t nwidth = (width > 1) ? (width >> 1) : 1;
-                size_t nheight = (height > 1) ? (height >> 1) : 1;
-
-                size_t xinc = ( width << 16 ) / nwidth;
-                size_t yinc = ( height << 16 ) / nheight;
-
-                size_t lasty = size_t(-1);
-
-                size_t sy = 0;
-                for( size_t y = 0; y < nheight; ++y )
-                {
-                    if ( (lasty ^ sy) >> 16 )
-                    {
-                        if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src->format ) )
-                            return E_FAIL;
-                        lasty = sy;
-                    }
-
-                    size_t sx = 0;
-                    for( size_t x = 0; x < nwidth; ++x )
-                    {
-                        target[ x ] = row[ sx >> 16 ];
-                        sx += xinc;
-                    }
+            hr = _ProcessBands( ndepth, 1, width + nwidth, filter,
+                                [&]( size_t zStart, size_t zEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    for( size_t slice = zStart; slice < zEnd; ++slice )
+                                    {
+                                        const Image* src = mipChain.GetImage( level-1, 0, ( (zinc * slice) >> 16 ) );
+                                        const Image* dest = mipChain.GetImage( level, 0, slice );
 
-                    if ( !_StoreScanline( pDest, dest->rowPitch, dest->format, target, nwidth ) )
-                        return E_FAIL;
-                    pDest += dest->rowPitch;
+                                        if ( !src || !dest )
+                                            return E_POINTER;
 
-                    sy += yinc;
-                }
+                                        HRESULT hrSlice = _ResizePointRows( *src, *dest, 0, nheight, scanline );
+                                        if ( FAILED(hrSlice) )
+                                            return hrSlice;
+                                    }
 
-                sz += zinc;
-            }
+                                    return S_OK;
+                                } );
         }
         else
         {
-            // 2D point filter
+            // 2D point filter (bands of rows)
             const Image* src = mipChain.GetImage( level-1, 0, 0 );
             const Image* dest = mipChain.GetImage( level, 0, 0 );
 
             if ( !src || !dest )
                 return E_POINTER;
 
-            const uint8_t* pSrc = src->pixels;
-            uint8_t* pDest = dest->pixels;
-
-            size_t rowPitch = src->rowPitch;
-
-            size_t nwidth = (width > 1) ? (width >> 1) : 1;
-            size_t nheight = (height > 1) ? (height >> 1) : 1;
-
-            size_t xinc = ( width << 16 ) / nwidth;
-            size_t yinc = ( height << 16 ) / nheight;
-
-            size_t lasty = size_t(-1);
-
-            size_t sy = 0;
-            for( size_t y = 0; y < nheight; ++y )
-            {
-                if ( (lasty ^ sy) >> 16 )
-                {
-                    if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src->format ) )
-                        return E_FAIL;
-                    lasty = sy;
-                }
-
-                size_t sx = 0;
-                for( size_t x = 0; x < nwidth; ++x )
-                {
-                    target[ x ] = row[ sx >> 16 ];
-                    sx += xinc;
-                }
-
-                if ( !_StoreScanline( pDest, dest->rowPitch, dest->format, target, nwidth ) )
-                    return E_FAIL;
-                pDest += dest->rowPitch;
-
-                sy += yinc;
-            }
+            hr = _ProcessBands( nheight, BAND_MIN_ROWS, width + nwidth, filter,
+                                [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    return _ResizePointRows( *src, *dest, yStart, yEnd, scanline );
+                                } );
         }
 
+        if ( FAILED(hr) )
+            return hr;
+
         if ( height > 1 )
             height >>= 1;
 
@@ -1492,163 +1079,155 @@ static HRESULT _Generate3DMipsPointFilter( _In_ size_t depth, _In_ size_t levels
 
 
 //--- 3D Box Filter ---
-static HRESULT _Generate3DMipsBoxFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+static HRESULT _Generate3DMipsBoxSlice( _In_ const Image& srca, _In_ const Image& srcb, _In_ DWORD filter, _In_ const Image& dest,
+                                        _Out_writes_(srca.width*5) XMVECTOR* scanline )
 {
-    if ( !depth || !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+    assert( srca.pixels && srcb.pixels && dest.pixels );
 
-    if ( !ispow2(width) || !ispow2(height) || !ispow2(depth) )
-        return E_FAIL;
-
-    // Allocate temporary space (5 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+    size_t width = srca.width;
 
-    XMVECTOR* target = scanline.get();
+    // Temporary space (5 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* urow0 = target + width;
     XMVECTOR* urow1 = target + width*2;
     XMVECTOR* vrow0 = target + width*3;
     XMVECTOR* vrow1 = target + width*4;
 
+    if ( srca.height <= 1 )
+    {
+        urow1 = urow0;
+        vrow1 = vrow0;
+    }
+
     const XMVECTOR* urow2 = urow0 + 1;
     const XMVECTOR* urow3 = urow1 + 1;
     const XMVECTOR* vrow2 = vrow0 + 1;
     const XMVECTOR* vrow3 = vrow1 + 1;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
+    if ( width <= 1 )
+    {
+        urow2 = urow0;
+        urow3 = urow1;
+        vrow2 = vrow0;
+        vrow3 = vrow1;
+    }
+
+    const uint8_t* pSrc1 = srca.pixels;
+    const uint8_t* pSrc2 = srcb.pixels;
+    uint8_t* pDest = dest.pixels;
+
+    size_t aRowPitch = srca.rowPitch;
+    size_t bRowPitch = srcb.rowPitch;
+
+    for( size_t y = 0; y < dest.height; ++y )
     {
-        if ( height <= 1 )
+        if ( !_LoadScanlineLinear( urow0, width, pSrc1, aRowPitch, srca.format, filter ) )
+            return E_FAIL;
+        pSrc1 += aRowPitch;
+
+        if ( urow0 != urow1 )
         {
-            urow1 = urow0;
-            vrow1 = vrow0;
+            if ( !_LoadScanlineLinear( urow1, width, pSrc1, aRowPitch, srca.format, filter ) )
+                return E_FAIL;
+            pSrc1 += aRowPitch;
         }
 
-        if ( width <= 1 )
+        if ( !_LoadScanlineLinear( vrow0, width, pSrc2, bRowPitch, srcb.format, filter ) )
+            return E_FAIL;
+        pSrc2 += bRowPitch;
+
+        if ( vrow0 != vrow1 )
         {
-            urow2 = urow0;
-            urow3 = urow1;
-            vrow2 = vrow0;
-            vrow3 = vrow1;
+            if ( !_LoadScanlineLinear( vrow1, width, pSrc2, bRowPitch, srcb.format, filter ) )
+                return E_FAIL;
+            pSrc2 += bRowPitch;
         }
 
-        if ( depth > 1 )
+        for( size_t x = 0; x < dest.width; ++x )
         {
-            // 3D box filter
-            size_t ndepth = depth >> 1;
+            size_t x2 = x << 1;
 
-            for( size_t slice=0; slice < ndepth; ++slice )
-            {
-                size_t slicea = std::min<size_t>( slice * 2, depth-1 );
-                size_t sliceb = std::min<size_t>( slicea + 1, depth-1 );
+            AVERAGE8( target[x], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ],
+                                 vrow0[ x2 ], vrow1[ x2 ], vrow2[ x2 ], vrow3[ x2 ] );
+        }
+
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, dest.width, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
+    }
 
-                const Image* srca = mipChain.GetImage( level-1, 0, slicea );
-                const Image* srcb = mipChain.GetImage( level-1, 0, sliceb );
-                const Image* dest = mipChain.GetImage( level, 0, slice );
+    return S_OK;
+}
 
-                if ( !srca || !srcb || !dest )
-                    return E_POINTER;
+static HRESULT _Generate3DMipsBoxFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+{
+    if ( !depth || !mipChain.GetImages() )
+        return E_INVALIDARG;
 
-                const uint8_t* pSrc1 = srca->pixels;
-                const uint8_t* pSrc2 = srcb->pixels;
-                uint8_t* pDest = dest->pixels;
+    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
 
-                size_t aRowPitch = srca->rowPitch;
-                size_t bRowPitch = srcb->rowPitch;
+    assert( levels > 1 );
 
-                size_t nwidth = (width > 1) ? (width >> 1) : 1;
-                size_t nheight = (height > 1) ? (height >> 1) : 1;
+    size_t width = mipChain.GetMetadata().width;
+    size_t height = mipChain.GetMetadata().height;
 
-                for( size_t y = 0; y < nheight; ++y )
-                {
-                    if ( !_LoadScanlineLinear( urow0, width, pSrc1, aRowPitch, srca->format, filter ) )
-                        return E_FAIL;
-                    pSrc1 += aRowPitch;
+    if ( !ispow2(width) || !ispow2(height) || !ispow2(depth) )
+        return E_FAIL;
 
-                    if ( urow0 != urow1 )
-                    {
-                        if ( !_LoadScanlineLinear( urow1, width, pSrc1, aRowPitch, srca->format, filter ) )
-                            return E_FAIL;
-                        pSrc1 += aRowPitch;
-                    }
+    // Resize base image to each target mip level
+    for( size_t level=1; level < levels; ++level )
+    {
+        HRESULT hr;
+        if ( depth > 1 )
+        {
+            // 3D box filter (bands of slices)
+            size_t ndepth = depth >> 1;
 
-                    if ( !_LoadScanlineLinear( vrow0, width, pSrc2, bRowPitch, srcb->format, filter ) )
-                        return E_FAIL;
-                    pSrc2 += bRowPitch;
+            hr = _ProcessBands( ndepth, 1, width*5, filter,
+                                [&]( size_t zStart, size_t zEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    for( size_t slice = zStart; slice < zEnd; ++slice )
+                                    {
+                                        size_t slicea = std::min<size_t>( slice * 2, depth-1 );
+                                        size_t sliceb = std::min<size_t>( slicea + 1, depth-1 );
 
-                    if ( vrow0 != vrow1 )
-                    {
-                        if ( !_LoadScanlineLinear( vrow1, width, pSrc2, bRowPitch, srcb->format, filter ) )
-                            return E_FAIL;
-                        pSrc2 += bRowPitch;
-                    }
+                                        const Image* srca = mipChain.GetImage( level-1, 0, slicea );
+                                        const Image* srcb = mipChain.GetImage( level-1, 0, sliceb );
+                                        const Image* dest = mipChain.GetImage( level, 0, slice );
 
-                    for( size_t x = 0; x < nwidth; ++x )
-                    {
-                        size_t x2 = x << 1;
+                                        if ( !srca || !srcb || !dest )
+                                            return E_POINTER;
 
-                        AVERAGE8( target[x], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ],
-                                             vrow0[ x2 ], vrow1[ x2 ], vrow2[ x2 ], vrow3[ x2 ] );
-                    }
+                                        HRESULT hrSlice = _Generate3DMipsBoxSlice( *srca, *srcb, filter, *dest, scanline );
+                                        if ( FAILED(hrSlice) )
+                                            return hrSlice;
+                                    }
 
-                    if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                        return E_FAIL;
-                    pDest += dest->rowPitch;
-                }
-            }
+                                    return S_OK;
+                                } );
         }
         else
         {
-            // 2D box filter
+            // 2D box filter (bands of rows)
             const Image* src = mipChain.GetImage( level-1, 0, 0 );
             const Image* dest = mipChain.GetImage( level, 0, 0 );
 
             if ( !src || !dest )
                 return E_POINTER;
 
-            const uint8_t* pSrc = src->pixels;
-            uint8_t* pDest = dest->pixels;
-
-            size_t rowPitch = src->rowPitch;
-
-            size_t nwidth = (width > 1) ? (width >> 1) : 1;
             size_t nheight = (height > 1) ? (height >> 1) : 1;
 
-            for( size_t y = 0; y < nheight; ++y )
-            {
-                if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src->format, filter ) )
-                    return E_FAIL;
-                pSrc += rowPitch;
-
-                if ( urow0 != urow1 )
-                {
-                    if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                    pSrc += rowPitch;
-                }
-
-                for( size_t x = 0; x < nwidth; ++x )
-                {
-                    size_t x2 = x << 1;
-
-                    AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
-                }
-
-                if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                    return E_FAIL;
-                pDest += dest->rowPitch;
-            }
+            hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*3, filter,
+                                [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    return _Generate2DMipsBoxRows( *src, filter, *dest, yStart, yEnd, scanline );
+                                } );
         }
 
+        if ( FAILED(hr) )
+            return hr;
+
         if ( height > 1 )
             height >>= 1;
 
@@ -1664,184 +1243,153 @@ static HRESULT _Generate3DMipsBoxFilter( _In_ size_t depth, _In_ size_t levels,
 
 
 //--- 3D Linear Filter ---
-static HRESULT _Generate3DMipsLinearFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+static HRESULT _Generate3DMipsLinearSlice( _In_ const Image& srca, _In_ const Image& srcb, _In_ DWORD filter, _In_ const Image& dest,
+                                           _In_reads_(dest.width) const LinearFilter* lfX, _In_reads_(dest.height) const LinearFilter* lfY,
+                                           _In_ const LinearFilter& toZ, _Out_writes_(srca.width*5) XMVECTOR* scanline )
 {
-    if ( !depth || !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate temporary space (5 scanlines, plus X/Y/Z filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+    assert( srca.pixels && srcb.pixels && dest.pixels );
 
-    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ width+height+depth ] );
-    if ( !lf )
-        return E_OUTOFMEMORY;
-
-    LinearFilter* lfX = lf.get();
-    LinearFilter* lfY = lf.get() + width;
-    LinearFilter* lfZ = lf.get() + width + height;
+    size_t width = srca.width;
 
-    XMVECTOR* target = scanline.get();
+    // Temporary space (5 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* urow0 = target + width;
     XMVECTOR* urow1 = target + width*2;
     XMVECTOR* vrow0 = target + width*3;
     XMVECTOR* vrow1 = target + width*4;
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
+    uint8_t* pDest = dest.pixels;
 
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
+    size_t u0 = size_t(-1);
+    size_t u1 = size_t(-1);
 
-#ifdef _DEBUG
-        memset( urow0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( urow1, 0xDD, sizeof(XMVECTOR)*width );
-        memset( vrow0, 0xED, sizeof(XMVECTOR)*width );
-        memset( vrow1, 0xFD, sizeof(XMVECTOR)*width );
-#endif
+    for( size_t y = 0; y < dest.height; ++y )
+    {
+        auto& toY = lfY[ y ];
 
-        if ( depth > 1 )
+        if ( toY.u0 != u0 )
         {
-            // 3D linear filter
-            size_t ndepth = depth >> 1;
-            _CreateLinearFilter( depth, ndepth, (filter & TEX_FILTER_WRAP_W) != 0, lfZ );
+            if ( toY.u0 != u1 )
+            {
+                u0 = toY.u0;
 
-            for( size_t slice=0; slice < ndepth; ++slice )
+                if ( !_LoadScanlineLinear( urow0, width, srca.pixels + (srca.rowPitch * u0), srca.rowPitch, srca.format, filter )
+                     || !_LoadScanlineLinear( vrow0, width, srcb.pixels + (srcb.rowPitch * u0), srcb.rowPitch, srcb.format, filter ) )
+                    return E_FAIL;
+            }
+            else
             {
-                auto& toZ = lfZ[ slice ];
+                u0 = u1;
+                u1 = size_t(-1);
 
-                const Image* srca = mipChain.GetImage( level-1, 0, toZ.u0 );
-                const Image* srcb = mipChain.GetImage( level-1, 0, toZ.u1 );
-                if ( !srca || !srcb )
-                    return E_POINTER;
+                std::swap( urow0, urow1 );
+                std::swap( vrow0, vrow1 );
+            }
+        }
 
-                size_t u0 = size_t(-1);
-                size_t u1 = size_t(-1);
+        if ( toY.u1 != u1 )
+        {
+            u1 = toY.u1;
 
-                const Image* dest = mipChain.GetImage( level, 0, slice );
-                if ( !dest )
-                    return E_POINTER;
+            if ( !_LoadScanlineLinear( urow1, width, srca.pixels + (srca.rowPitch * u1), srca.rowPitch, srca.format, filter )
+                    || !_LoadScanlineLinear( vrow1, width, srcb.pixels + (srcb.rowPitch * u1), srcb.rowPitch, srcb.format, filter ) )
+                return E_FAIL;
+        }
 
-                uint8_t* pDest = dest->pixels;
+        for( size_t x = 0; x < dest.width; ++x )
+        {
+            auto& toX = lfX[ x ];
 
-                for( size_t y = 0; y < nheight; ++y )
-                {
-                    auto& toY = lfY[ y ];
+            TRILINEAR_INTERPOLATE( target[x], toX, toY, toZ, urow0, urow1, vrow0, vrow1 );
+        }
 
-                    if ( toY.u0 != u0 )
-                    {
-                        if ( toY.u0 != u1 )
-                        {
-                            u0 = toY.u0;
-
-                            if ( !_LoadScanlineLinear( urow0, width, srca->pixels + (srca->rowPitch * u0), srca->rowPitch, srca->format, filter )
-                                 || !_LoadScanlineLinear( vrow0, width, srcb->pixels + (srcb->rowPitch * u0), srcb->rowPitch, srcb->format, filter ) )
-                                return E_FAIL;
-                        }
-                        else
-                        {
-                            u0 = u1;
-                            u1 = size_t(-1);
-
-                            std::swap( urow0, urow1 );
-                            std::swap( vrow0, vrow1 );
-                        }
-                    }
-
-                    if ( toY.u1 != u1 )
-                    {
-                        u1 = toY.u1;
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, dest.width, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
+    }
 
-                        if ( !_LoadScanlineLinear( urow1, width, srca->pixels + (srca->rowPitch * u1), srca->rowPitch, srca->format, filter )
-                                || !_LoadScanlineLinear( vrow1, width, srcb->pixels + (srcb->rowPitch * u1), srcb->rowPitch, srcb->format, filter ) )
-                            return E_FAIL;
-                    }
+    return S_OK;
+}
 
-                    for( size_t x = 0; x < nwidth; ++x )
-                    {
-                        auto& toX = lfX[ x ];
+static HRESULT _Generate3DMipsLinearFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+{
+    if ( !depth || !mipChain.GetImages() )
+        return E_INVALIDARG;
 
-                        TRILINEAR_INTERPOLATE( target[x], toX, toY, toZ, urow0, urow1, vrow0, vrow1 );
-                    }
+    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
 
-                    if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                        return E_FAIL;
-                    pDest += dest->rowPitch;
-                }
-            }
-        }
-        else
-        {
-            // 2D linear filter
-            const Image* src = mipChain.GetImage( level-1, 0, 0 );
-            const Image* dest = mipChain.GetImage( level, 0, 0 );
+    assert( levels > 1 );
 
-            if ( !src || !dest )
-                return E_POINTER;
+    size_t width = mipChain.GetMetadata().width;
+    size_t height = mipChain.GetMetadata().height;
 
-            const uint8_t* pSrc = src->pixels;
-            uint8_t* pDest = dest->pixels;
+    // Allocate X/Y/Z filters (scanlines are allocated per band)
+    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ width+height+depth ] );
+    if ( !lf )
+        return E_OUTOFMEMORY;
 
-            size_t rowPitch = src->rowPitch;
+    LinearFilter* lfX = lf.get();
+    LinearFilter* lfY = lf.get() + width;
+    LinearFilter* lfZ = lf.get() + width + height;
 
-            size_t u0 = size_t(-1);
-            size_t u1 = size_t(-1);
+    // Resize base image to each target mip level
+    for( size_t level=1; level < levels; ++level )
+    {
+        size_t nwidth = (width > 1) ? (width >> 1) : 1;
+        _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
 
-            for( size_t y = 0; y < nheight; ++y )
-            {
-                auto& toY = lfY[ y ];
+        size_t nheight = (height > 1) ? (height >> 1) : 1;
+        _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
 
-                if ( toY.u0 != u0 )
-                {
-                    if ( toY.u0 != u1 )
-                    {
-                        u0 = toY.u0;
+        HRESULT hr;
+        if ( depth > 1 )
+        {
+            // 3D linear filter (bands of slices)
+            size_t ndepth = depth >> 1;
+            _CreateLinearFilter( depth, ndepth, (filter & TEX_FILTER_WRAP_W) != 0, lfZ );
 
-                        if ( !_LoadScanlineLinear( urow0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                            return E_FAIL;
-                    }
-                    else
-                    {
-                        u0 = u1;
-                        u1 = size_t(-1);
+            hr = _ProcessBands( ndepth, 1, width*5, filter,
+                                [&]( size_t zStart, size_t zEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    for( size_t slice = zStart; slice < zEnd; ++slice )
+                                    {
+                                        auto& toZ = lfZ[ slice ];
 
-                        std::swap( urow0, urow1 );
-                    }
-                }
+                                        const Image* srca = mipChain.GetImage( level-1, 0, toZ.u0 );
+                                        const Image* srcb = mipChain.GetImage( level-1, 0, toZ.u1 );
+                                        const Image* dest = mipChain.GetImage( level, 0, slice );
 
-                if ( toY.u1 != u1 )
-                {
-                    u1 = toY.u1;
+                                        if ( !srca || !srcb || !dest )
+                                            return E_POINTER;
 
-                    if ( !_LoadScanlineLinear( urow1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
+                                        HRESULT hrSlice = _Generate3DMipsLinearSlice( *srca, *srcb, filter, *dest, lfX, lfY, toZ, scanline );
+                                        if ( FAILED(hrSlice) )
+                                            return hrSlice;
+                                    }
 
-                for( size_t x = 0; x < nwidth; ++x )
-                {
-                    auto& toX = lfX[ x ];
+                                    return S_OK;
+                                } );
+        }
+        else
+        {
+            // 2D linear filter (bands of rows)
+            const Image* src = mipChain.GetImage( level-1, 0, 0 );
+            const Image* dest = mipChain.GetImage( level, 0, 0 );
 
-                    BILINEAR_INTERPOLATE( target[x], toX, toY, urow0, urow1 );
-                }
+            if ( !src || !dest )
+                return E_POINTER;
 
-                if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                    return E_FAIL;
-                pDest += dest->rowPitch;
-            }
+            hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*2 + nwidth, filter,
+                                [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    return _ResizeLinearRows( *src, filter, *dest, lfX, lfY, yStart, yEnd, scanline );
+                                } );
         }
 
+        if ( FAILED(hr) )
+            return hr;
+
         if ( height > 1 )
             height >>= 1;
 
@@ -1857,39 +1405,24 @@ static HRESULT _Generate3DMipsLinearFilter( _In_ size_t depth, _In_ size_t level
 
 
 //--- 3D Cubic Filter ---
-static HRESULT _Generate3DMipsCubicFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+static HRESULT _Generate3DMipsCubicSlice( _In_ const Image& srca, _In_ const Image& srcb, _In_ const Image& srcc, _In_ const Image& srcd,
+                                          _In_ DWORD filter, _In_ const Image& dest,
+                                          _In_reads_(dest.width) const CubicFilter* cfX, _In_reads_(dest.height) const CubicFilter* cfY,
+                                          _In_ const CubicFilter& toZ, _Out_writes_(srca.width*17) XMVECTOR* scanline )
 {
-    if ( !depth || !mipChain.GetImages() )
-        return E_INVALIDARG;
+    assert( srca.pixels && srcb.pixels && srcc.pixels && srcd.pixels && dest.pixels );
 
-    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
+    size_t width = srca.width;
 
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate temporary space (17 scanlines, plus X/Y/Z filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*17), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ width+height+depth ] );
-    if ( !cf )
-        return E_OUTOFMEMORY;
-
-    CubicFilter* cfX = cf.get();
-    CubicFilter* cfY = cf.get() + width;
-    CubicFilter* cfZ = cf.get() + width + height;
-
-    XMVECTOR* target = scanline.get();
+    // Temporary space (17 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* urow[4];
     XMVECTOR* vrow[4];
     XMVECTOR* srow[4];
     XMVECTOR* trow[4];
 
-    XMVECTOR *ptr = scanline.get() + width;
+    XMVECTOR *ptr = scanline + width;
     for( size_t j = 0; j < 4; ++j )
     {
         urow[j] = ptr;  ptr += width;
@@ -1898,329 +1431,242 @@ static HRESULT _Generate3DMipsCubicFilter( _In_ size_t depth, _In_ size_t levels
         trow[j] = ptr;  ptr += width;
     }
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
+    uint8_t* pDest = dest.pixels;
 
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+    size_t u0 = size_t(-1);
+    size_t u1 = size_t(-1);
+    size_t u2 = size_t(-1);
+    size_t u3 = size_t(-1);
 
-#ifdef _DEBUG
-        for( size_t j = 0; j < 4; ++j )
+    for( size_t y = 0; y < dest.height; ++y )
+    {
+        auto& toY = cfY[ y ];
+
+        // Scanline 1
+        if ( toY.u0 != u0 )
         {
-            memset( urow[j], 0xCD, sizeof(XMVECTOR)*width );
-            memset( vrow[j], 0xDD, sizeof(XMVECTOR)*width );
-            memset( srow[j], 0xED, sizeof(XMVECTOR)*width );
-            memset( trow[j], 0xFD, sizeof(XMVECTOR)*width );
+            if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
+            {
+                u0 = toY.u0;
+
+                if ( !_LoadScanlineLinear( urow[0], width, srca.pixels + (srca.rowPitch * u0), srca.rowPitch, srca.format, filter )
+                        || !_LoadScanlineLinear( urow[1], width, srcb.pixels + (srcb.rowPitch * u0), srcb.rowPitch, srcb.format, filter )
+                        || !_LoadScanlineLinear( urow[2], width, srcc.pixels + (srcc.rowPitch * u0), srcc.rowPitch, srcc.format, filter )
+                        || !_LoadScanlineLinear( urow[3], width, srcd.pixels + (srcd.rowPitch * u0), srcd.rowPitch, srcd.format, filter ) )
+                    return E_FAIL;
+            }
+            else if ( toY.u0 == u1 )
+            {
+                u0 = u1;
+                u1 = size_t(-1);
+
+                std::swap( urow[0], vrow[0] );
+                std::swap( urow[1], vrow[1] );
+                std::swap( urow[2], vrow[2] );
+                std::swap( urow[3], vrow[3] );
+            }
+            else if ( toY.u0 == u2 )
+            {
+                u0 = u2;
+                u2 = size_t(-1);
+
+                std::swap( urow[0], srow[0] );
+                std::swap( urow[1], srow[1] );
+                std::swap( urow[2], srow[2] );
+                std::swap( urow[3], srow[3] );
+            }
+            else if ( toY.u0 == u3 )
+            {
+                u0 = u3;
+                u3 = size_t(-1);
+
+                std::swap( urow[0], trow[0] );
+                std::swap( urow[1], trow[1] );
+                std::swap( urow[2], trow[2] );
+                std::swap( urow[3], trow[3] );
+            }
         }
-#endif
 
-        if ( depth > 1 )
+        // Scanline 2
+        if ( toY.u1 != u1 )
         {
-            // 3D cubic filter
-            size_t ndepth = depth >> 1;
-            _CreateCubicFilter( depth, ndepth, (filter & TEX_FILTER_WRAP_W) != 0, (filter & TEX_FILTER_MIRROR_W) != 0, cfZ );
-
-            for( size_t slice=0; slice < ndepth; ++slice )
+            if ( toY.u1 != u2 && toY.u1 != u3 )
             {
-                auto& toZ = cfZ[ slice ];
+                u1 = toY.u1;
 
-                const Image* srca = mipChain.GetImage( level-1, 0, toZ.u0 );
-                const Image* srcb = mipChain.GetImage( level-1, 0, toZ.u1 );
-                const Image* srcc = mipChain.GetImage( level-1, 0, toZ.u2 );
-                const Image* srcd = mipChain.GetImage( level-1, 0, toZ.u3 );
-                if ( !srca || !srcb || !srcc || !srcd )
-                    return E_POINTER;
+                if ( !_LoadScanlineLinear( vrow[0], width, srca.pixels + (srca.rowPitch * u1), srca.rowPitch, srca.format, filter )
+                        || !_LoadScanlineLinear( vrow[1], width, srcb.pixels + (srcb.rowPitch * u1), srcb.rowPitch, srcb.format, filter )
+                        || !_LoadScanlineLinear( vrow[2], width, srcc.pixels + (srcc.rowPitch * u1), srcc.rowPitch, srcc.format, filter )
+                        || !_LoadScanlineLinear( vrow[3], width, srcd.pixels + (srcd.rowPitch * u1), srcd.rowPitch, srcd.format, filter ) )
+                    return E_FAIL;
+            }
+            else if ( toY.u1 == u2 )
+            {
+                u1 = u2;
+                u2 = size_t(-1);
 
-                size_t u0 = size_t(-1);
-                size_t u1 = size_t(-1);
-                size_t u2 = size_t(-1);
-                size_t u3 = size_t(-1);
+                std::swap( vrow[0], srow[0] );
+                std::swap( vrow[1], srow[1] );
+                std::swap( vrow[2], srow[2] );
+                std::swap( vrow[3], srow[3] );
+            }
+            else if ( toY.u1 == u3 )
+            {
+                u1 = u3;
+                u3 = size_t(-1);
 
-                const Image* dest = mipChain.GetImage( level, 0, slice );
-                if ( !dest )
-                    return E_POINTER;
+                std::swap( vrow[0], trow[0] );
+                std::swap( vrow[1], trow[1] );
+                std::swap( vrow[2], trow[2] );
+                std::swap( vrow[3], trow[3] );
+            }
+        }
 
-                uint8_t* pDest = dest->pixels;
+        // Scanline 3
+        if ( toY.u2 != u2 )
+        {
+            if ( toY.u2 != u3 )
+            {
+                u2 = toY.u2;
 
-                for( size_t y = 0; y < nheight; ++y )
-                {
-                    auto& toY = cfY[ y ];
+                if ( !_LoadScanlineLinear( srow[0], width, srca.pixels + (srca.rowPitch * u2), srca.rowPitch, srca.format, filter )
+                        || !_LoadScanlineLinear( srow[1], width, srcb.pixels + (srcb.rowPitch * u2), srcb.rowPitch, srcb.format, filter )
+                        || !_LoadScanlineLinear( srow[2], width, srcc.pixels + (srcc.rowPitch * u2), srcc.rowPitch, srcc.format, filter )
+                        || !_LoadScanlineLinear( srow[3], width, srcd.pixels + (srcd.rowPitch * u2), srcd.rowPitch, srcd.format, filter ) )
+                    return E_FAIL;
+            }
+            else
+            {
+                u2 = u3;
+                u3 = size_t(-1);
 
-                    // Scanline 1
-                    if ( toY.u0 != u0 )
-                    {
-                        if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
-                        {
-                            u0 = toY.u0;
+                std::swap( srow[0], trow[0] );
+                std::swap( srow[1], trow[1] );
+                std::swap( srow[2], trow[2] );
+                std::swap( srow[3], trow[3] );
+            }
+        }
 
-                            if ( !_LoadScanlineLinear( urow[0], width, srca->pixels + (srca->rowPitch * u0), srca->rowPitch, srca->format, filter )
-                                    || !_LoadScanlineLinear( urow[1], width, srcb->pixels + (srcb->rowPitch * u0), srcb->rowPitch, srcb->format, filter )
-                                    || !_LoadScanlineLinear( urow[2], width, srcc->pixels + (srcc->rowPitch * u0), srcc->rowPitch, srcc->format, filter )
-                                    || !_LoadScanlineLinear( urow[3], width, srcd->pixels + (srcd->rowPitch * u0), srcd->rowPitch, srcd->format, filter ) )
-                                return E_FAIL;
-                        }
-                        else if ( toY.u0 == u1 )
-                        {
-                            u0 = u1;
-                            u1 = size_t(-1);
+        // Scanline 4
+        if ( toY.u3 != u3 )
+        {
+            u3 = toY.u3;
 
-                            std::swap( urow[0], vrow[0] );
-                            std::swap( urow[1], vrow[1] );
-                            std::swap( urow[2], vrow[2] );
-                            std::swap( urow[3], vrow[3] );
-                        }
-                        else if ( toY.u0 == u2 )
-                        {
-                            u0 = u2;
-                            u2 = size_t(-1);
+            if ( !_LoadScanlineLinear( trow[0], width, srca.pixels + (srca.rowPitch * u3), srca.rowPitch, srca.format, filter )
+                    || !_LoadScanlineLinear( trow[1], width, srcb.pixels + (srcb.rowPitch * u3), srcb.rowPitch, srcb.format, filter )
+                    || !_LoadScanlineLinear( trow[2], width, srcc.pixels + (srcc.rowPitch * u3), srcc.rowPitch, srcc.format, filter )
+                    || !_LoadScanlineLinear( trow[3], width, srcd.pixels + (srcd.rowPitch * u3), srcd.rowPitch, srcd.format, filter ) )
+                return E_FAIL;
+        }
 
-                            std::swap( urow[0], srow[0] );
-                            std::swap( urow[1], srow[1] );
-                            std::swap( urow[2], srow[2] );
-                            std::swap( urow[3], srow[3] );
-                        }
-                        else if ( toY.u0 == u3 )
-                        {
-                            u0 = u3;
-                            u3 = size_t(-1);
+        for( size_t x = 0; x < dest.width; ++x )
+        {
+            auto& toX = cfX[ x ];
 
-                            std::swap( urow[0], trow[0] );
-                            std::swap( urow[1], trow[1] );
-                            std::swap( urow[2], trow[2] );
-                            std::swap( urow[3], trow[3] );
-                        }
-                    }
+            XMVECTOR D[4];
 
-                    // Scanline 2
-                    if ( toY.u1 != u1 )
-                    {
-                        if ( toY.u1 != u2 && toY.u1 != u3 )
-                        {
-                            u1 = toY.u1;
+            for( size_t j=0; j < 4; ++j )
+            {
+                XMVECTOR C0, C1, C2, C3;
+                CUBIC_INTERPOLATE( C0, toX.x, urow[j][ toX.u0 ], urow[j][ toX.u1 ], urow[j][ toX.u2 ], urow[j][ toX.u3 ] );
+                CUBIC_INTERPOLATE( C1, toX.x, vrow[j][ toX.u0 ], vrow[j][ toX.u1 ], vrow[j][ toX.u2 ], vrow[j][ toX.u3 ] );
+                CUBIC_INTERPOLATE( C2, toX.x, srow[j][ toX.u0 ], srow[j][ toX.u1 ], srow[j][ toX.u2 ], srow[j][ toX.u3 ] );
+                CUBIC_INTERPOLATE( C3, toX.x, trow[j][ toX.u0 ], trow[j][ toX.u1 ], trow[j][ toX.u2 ], trow[j][ toX.u3 ] );
 
-                            if ( !_LoadScanlineLinear( vrow[0], width, srca->pixels + (srca->rowPitch * u1), srca->rowPitch, srca->format, filter )
-                                    || !_LoadScanlineLinear( vrow[1], width, srcb->pixels + (srcb->rowPitch * u1), srcb->rowPitch, srcb->format, filter )
-                                    || !_LoadScanlineLinear( vrow[2], width, srcc->pixels + (srcc->rowPitch * u1), srcc->rowPitch, srcc->format, filter )
-                                    || !_LoadScanlineLinear( vrow[3], width, srcd->pixels + (srcd->rowPitch * u1), srcd->rowPitch, srcd->format, filter ) )
-                                return E_FAIL;
-                        }
-                        else if ( toY.u1 == u2 )
-                        {
-                            u1 = u2;
-                            u2 = size_t(-1);
+                CUBIC_INTERPOLATE( D[j], toY.x, C0, C1, C2, C3 );
+            }
 
-                            std::swap( vrow[0], srow[0] );
-                            std::swap( vrow[1], srow[1] );
-                            std::swap( vrow[2], srow[2] );
-                            std::swap( vrow[3], srow[3] );
-                        }
-                        else if ( toY.u1 == u3 )
-                        {
-                            u1 = u3;
-                            u3 = size_t(-1);
+            CUBIC_INTERPOLATE( target[x], toZ.x, D[0], D[1], D[2], D[3] );
+        }
 
-                            std::swap( vrow[0], trow[0] );
-                            std::swap( vrow[1], trow[1] );
-                            std::swap( vrow[2], trow[2] );
-                            std::swap( vrow[3], trow[3] );
-                        }
-                    }
+        if ( !_StoreScanlineLinear( pDest, dest.rowPitch, dest.format, target, dest.width, filter ) )
+            return E_FAIL;
+        pDest += dest.rowPitch;
+    }
 
-                    // Scanline 3
-                    if ( toY.u2 != u2 )
-                    {
-                        if ( toY.u2 != u3 )
-                        {
-                            u2 = toY.u2;
+    return S_OK;
+}
 
-                            if ( !_LoadScanlineLinear( srow[0], width, srca->pixels + (srca->rowPitch * u2), srca->rowPitch, srca->format, filter )
-                                    || !_LoadScanlineLinear( srow[1], width, srcb->pixels + (srcb->rowPitch * u2), srcb->rowPitch, srcb->format, filter )
-                                    || !_LoadScanlineLinear( srow[2], width, srcc->pixels + (srcc->rowPitch * u2), srcc->rowPitch, srcc->format, filter )
-                                    || !_LoadScanlineLinear( srow[3], width, srcd->pixels + (srcd->rowPitch * u2), srcd->rowPitch, srcd->format, filter ) )
-                                return E_FAIL;
-                        }
-                        else
-                        {
-                            u2 = u3;
-                            u3 = size_t(-1);
+static HRESULT _Generate3DMipsCubicFilter( _In_ size_t depth, _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain )
+{
+    if ( !depth || !mipChain.GetImages() )
+        return E_INVALIDARG;
 
-                            std::swap( srow[0], trow[0] );
-                            std::swap( srow[1], trow[1] );
-                            std::swap( srow[2], trow[2] );
-                            std::swap( srow[3], trow[3] );
-                        }
-                    }
+    // This assumes that the base images are already placed into the mipChain at the top level... (see _Setup3DMips)
 
-                    // Scanline 4
-                    if ( toY.u3 != u3 )
-                    {
-                        u3 = toY.u3;
+    assert( levels > 1 );
 
-                        if ( !_LoadScanlineLinear( trow[0], width, srca->pixels + (srca->rowPitch * u3), srca->rowPitch, srca->format, filter )
-                                || !_LoadScanlineLinear( trow[1], width, srcb->pixels + (srcb->rowPitch * u3), srcb->rowPitch, srcb->format, filter )
-                                || !_LoadScanlineLinear( trow[2], width, srcc->pixels + (srcc->rowPitch * u3), srcc->rowPitch, srcc->format, filter )
-                                || !_LoadScanlineLinear( trow[3], width, srcd->pixels + (srcd->rowPitch * u3), srcd->rowPitch, srcd->format, filter ) )
-                            return E_FAIL;
-                    }
+    size_t width = mipChain.GetMetadata().width;
+    size_t height = mipChain.GetMetadata().height;
 
-                    for( size_t x = 0; x < nwidth; ++x )
-                    {
-                        auto& toX = cfX[ x ];
+    // Allocate X/Y/Z filters (scanlines are allocated per band)
+    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ width+height+depth ] );
+    if ( !cf )
+        return E_OUTOFMEMORY;
 
-                        XMVECTOR D[4];
+    CubicFilter* cfX = cf.get();
+    CubicFilter* cfY = cf.get() + width;
+    CubicFilter* cfZ = cf.get() + width + height;
 
-                        for( size_t j=0; j < 4; ++j )
-                        {
-                            XMVECTOR C0, C1, C2, C3;
-                            CUBIC_INTERPOLATE( C0, toX.x, urow[j][ toX.u0 ], urow[j][ toX.u1 ], urow[j][ toX.u2 ], urow[j][ toX.u3 ] );
-                            CUBIC_INTERPOLATE( C1, toX.x, vrow[j][ toX.u0 ], vrow[j][ toX.u1 ], vrow[j][ toX.u2 ], vrow[j][ toX.u3 ] );
-                            CUBIC_INTERPOLATE( C2, toX.x, srow[j][ toX.u0 ], srow[j][ toX.u1 ], srow[j][ toX.u2 ], srow[j][ toX.u3 ] );
-                            CUBIC_INTERPOLATE( C3, toX.x, trow[j][ toX.u0 ], trow[j][ toX.u1 ], trow[j][ toX.u2 ], trow[j][ toX.u3 ] );
+    // Resize base image to each target mip level
+    for( size_t level=1; level < levels; ++level )
+    {
+        size_t nwidth = (width > 1) ? (width >> 1) : 1;
+        _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
 
-                            CUBIC_INTERPOLATE( D[j], toY.x, C0, C1, C2, C3 );
-                        }
+        size_t nheight = (height > 1) ? (height >> 1) : 1;
+        _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
 
-                        CUBIC_INTERPOLATE( target[x], toZ.x, D[0], D[1], D[2], D[3] );
-                    }
+        HRESULT hr;
+        if ( depth > 1 )
+        {
+            // 3D cubic filter (bands of slices)
+            size_t ndepth = depth >> 1;
+            _CreateCubicFilter( depth, ndepth, (filter & TEX_FILTER_WRAP_W) != 0, (filter & TEX_FILTER_MIRROR_W) != 0, cfZ );
 
-                    if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                        return E_FAIL;
-                    pDest += dest->rowPitch;
-                }
-            }
+            hr = _ProcessBands( ndepth, 1, width*17, filter,
+                                [&]( size_t zStart, size_t zEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    for( size_t slice = zStart; slice < zEnd; ++slice )
+                                    {
+                                        auto& toZ = cfZ[ slice ];
+
+                                        const Image* srca = mipChain.GetImage( level-1, 0, toZ.u0 );
+                                        const Image* srcb = mipChain.GetImage( level-1, 0, toZ.u1 );
+                                        const Image* srcc = mipChain.GetImage( level-1, 0, toZ.u2 );
+                                        const Image* srcd = mipChain.GetImage( level-1, 0, toZ.u3 );
+                                        const Image* dest = mipChain.GetImage( level, 0, slice );
+
+                                        if ( !srca || !srcb || !srcc || !srcd || !dest )
+                                            return E_POINTER;
+
+                                        HRESULT hrSlice = _Generate3DMipsCubicSlice( *srca, *srcb, *srcc, *srcd, filter, *dest, cfX, cfY, toZ, scanline );
+                                        if ( FAILED(hrSlice) )
+                                            return hrSlice;
+                                    }
+
+                                    return S_OK;
+                                } );
         }
         else
         {
-            // 2D cubic filter
+            // 2D cubic filter (bands of rows)
             const Image* src = mipChain.GetImage( level-1, 0, 0 );
             const Image* dest = mipChain.GetImage( level, 0, 0 );
 
             if ( !src || !dest )
                 return E_POINTER;
 
-            const uint8_t* pSrc = src->pixels;
-            uint8_t* pDest = dest->pixels;
-
-            size_t rowPitch = src->rowPitch;
-
-            size_t u0 = size_t(-1);
-            size_t u1 = size_t(-1);
-            size_t u2 = size_t(-1);
-            size_t u3 = size_t(-1);
-
-            for( size_t y = 0; y < nheight; ++y )
-            {
-                auto& toY = cfY[ y ];
-
-                // Scanline 1
-                if ( toY.u0 != u0 )
-                {
-                    if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
-                    {
-                        u0 = toY.u0;
-
-                        if ( !_LoadScanlineLinear( urow[0], width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                            return E_FAIL;
-                    }
-                    else if ( toY.u0 == u1 )
-                    {
-                        u0 = u1;
-                        u1 = size_t(-1);
-
-                        std::swap( urow[0], vrow[0] );
-                    }
-                    else if ( toY.u0 == u2 )
-                    {
-                        u0 = u2;
-                        u2 = size_t(-1);
-
-                        std::swap( urow[0], srow[0] );
-                    }
-                    else if ( toY.u0 == u3 )
-                    {
-                        u0 = u3;
-                        u3 = size_t(-1);
-
-                        std::swap( urow[0], trow[0] );
-                    }
-                }
-
-                // Scanline 2
-                if ( toY.u1 != u1 )
-                {
-                    if ( toY.u1 != u2 && toY.u1 != u3 )
-                    {
-                        u1 = toY.u1;
-
-                        if ( !_LoadScanlineLinear( vrow[0], width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                            return E_FAIL;
-                    }
-                    else if ( toY.u1 == u2 )
-                    {
-                        u1 = u2;
-                        u2 = size_t(-1);
-
-                        std::swap( vrow[0], srow[0] );
-                    }
-                    else if ( toY.u1 == u3 )
-                    {
-                        u1 = u3;
-                        u3 = size_t(-1);
-
-                        std::swap( vrow[0], trow[0] );
-                    }
-                }
-
-                // Scanline 3
-                if ( toY.u2 != u2 )
-                {
-                    if ( toY.u2 != u3 )
-                    {
-                        u2 = toY.u2;
-
-                        if ( !_LoadScanlineLinear( srow[0], width, pSrc + (rowPitch * u2), rowPitch, src->format, filter ) )
-                            return E_FAIL;
-                    }
-                    else
-                    {
-                        u2 = u3;
-                        u3 = size_t(-1);
-
-                        std::swap( srow[0], trow[0] );
-                    }
-                }
-
-                // Scanline 4
-                if ( toY.u3 != u3 )
-                {
-                    u3 = toY.u3;
-
-                    if ( !_LoadScanlineLinear( trow[0], width, pSrc + (rowPitch * u3), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-
-                for( size_t x = 0; x < nwidth; ++x )
-                {
-                    auto& toX = cfX[ x ];
-
-                    XMVECTOR C0, C1, C2, C3;
-                    CUBIC_INTERPOLATE( C0, toX.x, urow[0][ toX.u0 ], urow[0][ toX.u1 ], urow[0][ toX.u2 ], urow[0][ toX.u3 ] );
-                    CUBIC_INTERPOLATE( C1, toX.x, vrow[0][ toX.u0 ], vrow[0][ toX.u1 ], vrow[0][ toX.u2 ], vrow[0][ toX.u3 ] );
-                    CUBIC_INTERPOLATE( C2, toX.x, srow[0][ toX.u0 ], srow[0][ toX.u1 ], srow[0][ toX.u2 ], srow[0][ toX.u3 ] );
-                    CUBIC_INTERPOLATE( C3, toX.x, trow[0][ toX.u0 ], trow[0][ toX.u1 ], trow[0][ toX.u2 ], trow[0][ toX.u3 ] );
-
-                    CUBIC_INTERPOLATE( target[x], toY.x, C0, C1, C2, C3 );
-                }
-
-                if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                    return E_FAIL;
-                pDest += dest->rowPitch;
-            }
+            hr = _ProcessBands( nheight, BAND_MIN_ROWS, width*4 + nwidth, filter,
+                                [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                                {
+                                    return _ResizeCubicRows( *src, filter, *dest, cfX, cfY, yStart, yEnd, scanline );
+                                } );
         }
 
+        if ( FAILED(hr) )
+            return hr;
+
         if ( height > 1 )
             height >>= 1;
 
@@ -2601,7 +2047,7 @@ HRESULT GenerateMipMaps( const Image& baseImage, DWORD filter, size_t levels, Sc
                 if ( FAILED(hr) )
                     return hr;
 
-                hr = _Generate2DMipsPointFilter( levels, mipChain, 0 );
+                hr = _Generate2DMipsPointFilter( levels, filter, mipChain, 0 );
                 if ( FAILED(hr) )
                     mipChain.Release();
                 return hr;
@@ -2791,7 +2237,7 @@ HRESULT GenerateMipMaps( const Image* srcImages, size_t nimages, const TexMetada
 
                 for( size_t item = 0; item < metadata.arraySize; ++item )
                 {
-                    hr = _Generate2DMipsPointFilter( levels, mipChain, item );
+                    hr = _Generate2DMipsPointFilter( levels, filter, mipChain, item );
                     if ( FAILED(hr) )
                         mipChain.Release();
                 }
@@ -2908,7 +2354,7 @@ HRESULT GenerateMipMaps3D( const Image* baseImages, size_t depth, DWORD filter,
         if ( FAILED(hr) )
             return hr;
 
-        hr = _Generate3DMipsPointFilter( depth, levels, mipChain );
+        hr = _Generate3DMipsPointFilter( depth, levels, filter, mipChain );
         if ( FAILED(hr) )
             mipChain.Release();
         return hr;
@@ -3016,7 +2462,7 @@ HRESULT GenerateMipMaps3D( const Image* srcImages, size_t nimages, const TexMeta
         if ( FAILED(hr) )
             return hr;
 
-        hr = _Generate3DMipsPointFilter( metadata.depth, levels, mipChain );
+        hr = _Generate3DMipsPointFilter( metadata.depth, levels, filter, mipChain );
         if ( FAILED(hr) )
             mipChain.Release();
         return hr;
@@ -221,27 +221,20 @@ static bool _UseWICFiltering( _In_ DXGI_FORMAT format, _In_ DWORD filter )
 //-------------------------------------------------------------------------------------
 
 //--- Point Filter ---
-static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image& destImage )
+HRESULT _ResizePointRows( _In_ const Image& srcImage, _In_ const Image& destImage, _In_ size_t yStart, _In_ size_t yEnd,
+                          _Out_writes_(srcImage.width + destImage.width) XMVECTOR* scanline )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
+    assert( yStart < yEnd && yEnd <= destImage.height );
 
-    // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * (srcImage.width + destImage.width ) ), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    XMVECTOR* target = scanline.get();
+    // Temporary space (2 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* row = target + destImage.width;
 
-#ifdef _DEBUG
-    memset( row, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-#endif
-
     const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * yStart );
 
     size_t rowPitch = srcImage.rowPitch;
 
@@ -250,8 +243,8 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
 
     size_t lasty = size_t(-1);
 
-    size_t sy = 0;
-    for( size_t y = 0; y < destImage.height; ++y )
+    size_t sy = yinc * yStart;
+    for( size_t y = yStart; y < yEnd; ++y )
     {
         if ( (lasty ^ sy) >> 16 )
         {
@@ -277,6 +270,15 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
     return S_OK;
 }
 
+static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+{
+    return _ProcessBands( destImage.height, BAND_MIN_ROWS, srcImage.width + destImage.width, filter,
+                          [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                          {
+                              return _ResizePointRows( srcImage, destImage, yStart, yEnd, scanline );
+                          } );
+}
+
 
 //--- Box Filter ---
 static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
@@ -341,46 +343,29 @@ static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter,
 
 
 //--- Linear Filter ---
-static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+HRESULT _ResizeLinearRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                           _In_reads_(destImage.width) const LinearFilter* lfX, _In_reads_(destImage.height) const LinearFilter* lfY,
+                           _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width*2 + destImage.width) XMVECTOR* scanline )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
+    assert( yStart < yEnd && yEnd <= destImage.height );
 
-    // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ destImage.width + destImage.height ] );
-    if ( !lf )
-        return E_OUTOFMEMORY;
-
-    LinearFilter* lfX = lf.get();
-    LinearFilter* lfY = lf.get() + destImage.width;
-
-    _CreateLinearFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
-    _CreateLinearFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
-
-    XMVECTOR* target = scanline.get();
+    // Temporary space (3 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* row0 = target + destImage.width;
     XMVECTOR* row1 = row0 + srcImage.width;
 
-#ifdef _DEBUG
-    memset( row0, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row1, 0xDD, sizeof(XMVECTOR)*srcImage.width );
-#endif
-
     const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * yStart );
 
     size_t rowPitch = srcImage.rowPitch;
 
     size_t u0 = size_t(-1);
     size_t u1 = size_t(-1);
 
-    for( size_t y = 0; y < destImage.height; ++y )
+    for( size_t y = yStart; y < yEnd; ++y )
     {
         auto& toY = lfY[ y ];
 
@@ -425,45 +410,49 @@ static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filte
     return S_OK;
 }
 
-
-//--- Cubic Filter ---
-static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
 
-    // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*4 + destImage.width ) ), 16 ) ) );
-    if ( !scanline )
+    // Allocate X and Y filters (scanlines are allocated per band)
+    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ destImage.width + destImage.height ] );
+    if ( !lf )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ destImage.width + destImage.height ] );
-    if ( !cf )
-        return E_OUTOFMEMORY;
+    LinearFilter* lfX = lf.get();
+    LinearFilter* lfY = lf.get() + destImage.width;
 
-    CubicFilter* cfX = cf.get();
-    CubicFilter* cfY = cf.get() + destImage.width;
+    _CreateLinearFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
+    _CreateLinearFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
 
-    _CreateCubicFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
-    _CreateCubicFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+    return _ProcessBands( destImage.height, BAND_MIN_ROWS, srcImage.width*2 + destImage.width, filter,
+                          [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                          {
+                              return _ResizeLinearRows( srcImage, filter, destImage, lfX, lfY, yStart, yEnd, scanline );
+                          } );
+}
 
-    XMVECTOR* target = scanline.get();
+
+//--- Cubic Filter ---
+HRESULT _ResizeCubicRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                          _In_reads_(destImage.width) const CubicFilter* cfX, _In_reads_(destImage.height) const CubicFilter* cfY,
+                          _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width*4 + destImage.width) XMVECTOR* scanline )
+{
+    assert( srcImage.pixels && destImage.pixels );
+    assert( srcImage.format == destImage.format );
+    assert( yStart < yEnd && yEnd <= destImage.height );
+
+    // Temporary space (5 scanlines)
+    XMVECTOR* target = scanline;
 
     XMVECTOR* row0 = target + destImage.width;
     XMVECTOR* row1 = row0 + srcImage.width;
     XMVECTOR* row2 = row0 + srcImage.width*2;
     XMVECTOR* row3 = row0 + srcImage.width*3;
 
-#ifdef _DEBUG
-    memset( row0, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row1, 0xDD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row2, 0xED, sizeof(XMVECTOR)*srcImage.width );
-    memset( row3, 0xFD, sizeof(XMVECTOR)*srcImage.width );
-#endif
-
     const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * yStart );
 
     size_t rowPitch = srcImage.rowPitch;
 
@@ -472,7 +461,7 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
     size_t u2 = size_t(-1);
     size_t u3 = size_t(-1);
 
-    for( size_t y = 0; y < destImage.height; ++y )
+    for( size_t y = yStart; y < yEnd; ++y )
     {
         auto& toY = cfY[ y ];
 
@@ -585,53 +574,62 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
     return S_OK;
 }
 
+static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+{
+    assert( srcImage.pixels && destImage.pixels );
+    assert( srcImage.format == destImage.format );
+
+    // Allocate X and Y filters (scanlines are allocated per band)
+    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ destImage.width + destImage.height ] );
+    if ( !cf )
+        return E_OUTOFMEMORY;
+
+    CubicFilter* cfX = cf.get();
+    CubicFilter* cfY = cf.get() + destImage.width;
+
+    _CreateCubicFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
+    _CreateCubicFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+
+    return _ProcessBands( destImage.height, BAND_MIN_ROWS, srcImage.width*4 + destImage.width, filter,
+                          [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                          {
+                              return _ResizeCubicRows( srcImage, filter, destImage, cfX, cfY, yStart, yEnd, scanline );
+                          } );
+}
+
 
 //--- Triangle Filter ---
-static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+HRESULT _ResizeTriangleRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                             _In_ TriangleFilter::Filter* tfX, _In_ TriangleFilter::Filter* tfY,
+                             _In_ size_t yStart, _In_ size_t yEnd, _Out_writes_(srcImage.width) XMVECTOR* scanline )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
+    assert( yStart < yEnd && yEnd <= destImage.height );
 
     using namespace TriangleFilter;
 
-    // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * srcImage.width, 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ destImage.height ] );
+    // Allocate accumulation rows for this band (source scanline is provided by the caller)
+    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ yEnd - yStart ] );
     if ( !rowActive )
         return E_OUTOFMEMORY;
 
     TriangleRow * rowFree = nullptr;
 
-    std::unique_ptr<Filter> tfX;
-    HRESULT hr = _Create( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
-    if ( FAILED(hr) )
-        return hr;
-
-    std::unique_ptr<Filter> tfY;
-    hr = _Create( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
-    if ( FAILED(hr) )
-        return hr;
-
-    XMVECTOR* row = scanline.get();
-
-#ifdef _DEBUG
-    memset( row, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-#endif
+    XMVECTOR* row = scanline;
 
-    auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
-    auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
+    auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX ) + tfX->sizeInBytes );
+    auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY ) + tfY->sizeInBytes );
 
-    // Count times rows get written
+    // Count times rows in this band get written
     for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
     {
         for ( size_t j = 0; j < yFrom->count; ++j )
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            ++rowActive.get()[ v ].remaining;
+            if ( v >= yStart && v < yEnd )
+                ++rowActive.get()[ v - yStart ].remaining;
         }
 
         yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
@@ -647,11 +645,17 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
     for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
     {
         // Create accumulation rows as needed
+        bool inBand = false;
         for ( size_t j = 0; j < yFrom->count; ++j )
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            TriangleRow* rowAcc = &rowActive.get()[ v ];
+            if ( v < yStart || v >= yEnd )
+                continue;
+
+            inBand = true;
+
+            TriangleRow* rowAcc = &rowActive.get()[ v - yStart ];
 
             if ( !rowAcc->scanline )
             {
@@ -673,6 +677,14 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
             }
         }
 
+        // Source rows which only contribute to other bands are skipped
+        if ( !inBand )
+        {
+            pSrc += rowPitch;
+            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+            continue;
+        }
+
         // Load source scanline
         if ( (pSrc + rowPitch) > pEndSrc )
             return E_FAIL;
@@ -690,9 +702,12 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
             {
                 size_t v = yFrom->to[ j ].u;
                 assert( v < destImage.height );
+                if ( v < yStart || v >= yEnd )
+                    continue;
+
                 float yweight = yFrom->to[ j ].weight;
 
-                XMVECTOR* accPtr = rowActive[ v ].scanline.get();
+                XMVECTOR* accPtr = rowActive[ v - yStart ].scanline.get();
                 if ( !accPtr )
                     return E_POINTER;
 
@@ -716,7 +731,10 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            TriangleRow* rowAcc = &rowActive.get()[ v ];
+            if ( v < yStart || v >= yEnd )
+                continue;
+
+            TriangleRow* rowAcc = &rowActive.get()[ v - yStart ];
 
             assert( rowAcc->remaining > 0 );
             --rowAcc->remaining;
@@ -761,6 +779,31 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
     return S_OK;
 }
 
+static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+{
+    assert( srcImage.pixels && destImage.pixels );
+    assert( srcImage.format == destImage.format );
+
+    using namespace TriangleFilter;
+
+    // Allocate X and Y filters (scanlines and accumulation rows are allocated per band)
+    std::unique_ptr<Filter> tfX;
+    HRESULT hr = _Create( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
+    if ( FAILED(hr) )
+        return hr;
+
+    std::unique_ptr<Filter> tfY;
+    hr = _Create( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
+    if ( FAILED(hr) )
+        return hr;
+
+    return _ProcessBands( destImage.height, BAND_MIN_ROWS, srcImage.width, filter,
+                          [&]( size_t yStart, size_t yEnd, XMVECTOR* scanline ) -> HRESULT
+                          {
+                              return _ResizeTriangleRows( srcImage, filter, destImage, tfX.get(), tfY.get(), yStart, yEnd, scanline );
+                          } );
+}
+
 
 //--- Custom filter resize ---
 static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
@@ -781,7 +824,7 @@ static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In
     switch( filter_select )
     {
     case TEX_FILTER_POINT:
-        return _ResizePointFilter( srcImage, destImage );
+        return _ResizePointFilter( srcImage, filter, destImage );
         
     case TEX_FILTER_BOX:
         return _ResizeBoxFilter( srcImage, filter, destImage );
@@ -20,7 +20,7 @@
 //      * Does not support files that contain color maps (these are rare in practice)
 //      * Interleaved files are not supported (deprecated aspect of TGA format)
 //      * Only supports 8-bit grayscale; 16-, 24-, and 32-bit truecolor images
-//      * Always writes uncompressed files (i.e. can read RLE compression, but does not write it)
+//      * Writes uncompressed files unless TGA_FLAGS_RLE is given
 //
 
 enum TGAImageType
@@ -250,59 +250,40 @@ static HRESULT _SetAlphaChannelToOpaque( _In_ const Image* image )
 
 
 //-------------------------------------------------------------------------------------
-// Uncompress pixel data from a TGA into the target image
+// Uncompress one scanline of RLE pixel data from a TGA into the target image
+// (packets never span scanlines); returns the start of the next scanline or nullptr
 //-------------------------------------------------------------------------------------
-static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags )
+static const uint8_t* _UncompressScanline( _In_ const uint8_t* sPtr, _In_ const uint8_t* endPtr, _In_ const Image* image, _In_ size_t y,
+                                           _In_ DWORD convFlags, _Inout_ bool& nonzeroa )
 {
-    assert( pSource && size > 0 );
-
-    if ( !image || !image->pixels )
-        return E_POINTER;
-
-    // Compute TGA image data pitch
-    size_t rowPitch;
-    if ( convFlags & CONV_FLAGS_EXPAND )
-    {
-        rowPitch = image->width * 3;
-    }
-    else
-    {
-        size_t slicePitch;
-        ComputePitch( image->format, image->width, image->height, rowPitch, slicePitch, CP_FLAGS_NONE );
-    }
+    size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
 
-    auto sPtr = reinterpret_cast<const uint8_t*>( pSource );
-    const uint8_t* endPtr = sPtr + size;
+    uint8_t* pRow = reinterpret_cast<uint8_t*>( image->pixels )
+                  + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) );
 
     switch( image->format )
     {
     //--------------------------------------------------------------------------- 8-bit
     case DXGI_FORMAT_R8_UNORM:
-        for( size_t y=0; y < image->height; ++y )
         {
-            size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-            assert( offset < rowPitch);
-
-            uint8_t* dPtr = reinterpret_cast<uint8_t*>( image->pixels )
-                         + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) )
-                         + offset;
+            uint8_t* dPtr = pRow + offset;
 
             for( size_t x=0; x < image->width; )
             {
                 if ( sPtr >= endPtr )
-                    return E_FAIL;
+                    return nullptr;
 
                 if ( *sPtr & 0x80 )
                 {
                     // Repeat
                     size_t j = (*sPtr & 0x7F) + 1;
                     if ( ++sPtr >= endPtr )
-                        return E_FAIL;
+                        return nullptr;
 
                     for( ; j > 0; --j, ++x )
                     {
                         if ( x >= image->width )
-                            return E_FAIL;
+                            return nullptr;
 
                         *dPtr = *sPtr;
 
@@ -321,12 +302,12 @@ static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t
                     ++sPtr;
 
                     if ( sPtr+j > endPtr )
-                        return E_FAIL;
+                        return nullptr;
 
                     for( ; j > 0; --j, ++x )
                     {
                         if ( x >= image->width )
-                            return E_FAIL;
+                            return nullptr;
 
                         *dPtr = *(sPtr++);
 
@@ -343,133 +324,165 @@ static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t
     //-------------------------------------------------------------------------- 16-bit
     case DXGI_FORMAT_B5G5R5A1_UNORM:
         {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
-            {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
-                assert( offset*2 < rowPitch);
+            uint16_t* dPtr = reinterpret_cast<uint16_t*>( pRow ) + offset;
 
-                uint16_t* dPtr = reinterpret_cast<uint16_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                             + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                             + offset;
+            for( size_t x=0; x < image->width; )
+            {
+                if ( sPtr >= endPtr )
+                    return nullptr;
 
-                for( size_t x=0; x < image->width; )
+                if ( *sPtr & 0x80 )
                 {
-                    if ( sPtr >= endPtr )
-                        return E_FAIL;
-
-                    if ( *sPtr & 0x80 )
-                    {
-                        // Repeat
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+                    // Repeat
+                    size_t j = (*sPtr & 0x7F) + 1;
+                    ++sPtr;
 
-                        if ( sPtr+1 >= endPtr )
-                            return E_FAIL;
+                    if ( sPtr+1 >= endPtr )
+                        return nullptr;
 
-                        uint16_t t =  *sPtr | (*(sPtr+1) << 8);
-                        if ( t & 0x8000 )
-                            nonzeroa = true;
-                        sPtr += 2;
+                    uint16_t t =  *sPtr | (*(sPtr+1) << 8);
+                    if ( t & 0x8000 )
+                        nonzeroa = true;
+                    sPtr += 2;
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
+                    for( ; j > 0; --j, ++x )
+                    {
+                        if ( x >= image->width )
+                            return nullptr;
 
-                            *dPtr = t;
+                        *dPtr = t;
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
+                        if ( convFlags & CONV_FLAGS_INVERTX )
+                            --dPtr;
+                        else
+                            ++dPtr;
                     }
-                    else
-                    {
-                        // Literal
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+                }
+                else
+                {
+                    // Literal
+                    size_t j = (*sPtr & 0x7F) + 1;
+                    ++sPtr;
 
-                        if ( sPtr+(j*2) > endPtr )
-                            return E_FAIL;
+                    if ( sPtr+(j*2) > endPtr )
+                        return nullptr;
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
+                    for( ; j > 0; --j, ++x )
+                    {
+                        if ( x >= image->width )
+                            return nullptr;
 
-                            uint16_t t =  *sPtr | (*(sPtr+1) << 8);
-                            if ( t & 0x8000 )
-                                nonzeroa = true;
-                            sPtr += 2;
-                            *dPtr = t;
+                        uint16_t t =  *sPtr | (*(sPtr+1) << 8);
+                        if ( t & 0x8000 )
+                            nonzeroa = true;
+                        sPtr += 2;
+                        *dPtr = t;
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
+                        if ( convFlags & CONV_FLAGS_INVERTX )
+                            --dPtr;
+                        else
+                            ++dPtr;
                     }
                 }
             }
-
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
         }
         break;
 
     //----------------------------------------------------------------------- 24/32-bit
     case DXGI_FORMAT_R8G8B8A8_UNORM:
         {
-            bool nonzeroa = false;
-            for( size_t y=0; y < image->height; ++y )
+            uint32_t* dPtr = reinterpret_cast<uint32_t*>( pRow ) + offset;
+
+            for( size_t x=0; x < image->width; )
             {
-                size_t offset = ( (convFlags & CONV_FLAGS_INVERTX ) ? (image->width - 1) : 0 );
+                if ( sPtr >= endPtr )
+                    return nullptr;
 
-                uint32_t* dPtr = reinterpret_cast<uint32_t*>( reinterpret_cast<uint8_t*>( image->pixels )
-                              + ( image->rowPitch * ( (convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1) ) ) )
-                              + offset;
+                if ( *sPtr & 0x80 )
+                {
+                    // Repeat
+                    size_t j = (*sPtr & 0x7F) + 1;
+                    ++sPtr;
+
+                    DWORD t;
+                    if ( convFlags & CONV_FLAGS_EXPAND )
+                    {
+                        if ( sPtr+2 >= endPtr )
+                            return nullptr;
+
+                        // BGR -> RGBA
+                        t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
+                        sPtr += 3;
+
+                        nonzeroa = true;
+                    }
+                    else
+                    {
+                        if ( sPtr+3 >= endPtr )
+                            return nullptr;
+
+                        // BGRA -> RGBA
+                        t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+
+                        if ( *(sPtr+3) > 0 )
+                            nonzeroa = true;
+
+                        sPtr += 4;
+                    }
+
+                    for( ; j > 0; --j, ++x )
+                    {
+                        if ( x >= image->width )
+                            return nullptr;
+
+                        *dPtr = t;
 
-                for( size_t x=0; x < image->width; )
+                        if ( convFlags & CONV_FLAGS_INVERTX )
+                            --dPtr;
+                        else
+                            ++dPtr;
+                    }
+                }
+                else
                 {
-                    if ( sPtr >= endPtr )
-                        return E_FAIL;
+                    // Literal
+                    size_t j = (*sPtr & 0x7F) + 1;
+                    ++sPtr;
 
-                    if ( *sPtr & 0x80 )
+                    if ( convFlags & CONV_FLAGS_EXPAND )
                     {
-                        // Repeat
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+                        if ( sPtr+(j*3) > endPtr )
+                            return nullptr;
+                    }
+                    else
+                    {
+                        if ( sPtr+(j*4) > endPtr )
+                            return nullptr;
+                    }
+
+                    for( ; j > 0; --j, ++x )
+                    {
+                        if ( x >= image->width )
+                            return nullptr;
 
-                        DWORD t;
                         if ( convFlags & CONV_FLAGS_EXPAND )
                         {
-                            assert( offset*3 < rowPitch);
-
                             if ( sPtr+2 >= endPtr )
-                                return E_FAIL;
+                                return nullptr;
 
                             // BGR -> RGBA
-                            t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
+                            *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
                             sPtr += 3;
 
                             nonzeroa = true;
                         }
                         else
                         {
-                            assert( offset*4 < rowPitch);
-
                             if ( sPtr+3 >= endPtr )
-                                return E_FAIL;
+                                return nullptr;
 
                             // BGRA -> RGBA
-                            t = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+                            *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
 
                             if ( *(sPtr+3) > 0 )
                                 nonzeroa = true;
@@ -477,94 +490,134 @@ static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t
                             sPtr += 4;
                         }
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
-
-                            *dPtr = t;
-
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
+                        if ( convFlags & CONV_FLAGS_INVERTX )
+                            --dPtr;
+                        else
+                            ++dPtr;
                     }
-                    else
-                    {
-                        // Literal
-                        size_t j = (*sPtr & 0x7F) + 1;
-                        ++sPtr;
+                }
+            }
+        }
+        break;
 
-                        if ( convFlags & CONV_FLAGS_EXPAND )
-                        {
-                            if ( sPtr+(j*3) > endPtr )
-                                return E_FAIL;
-                        }
-                        else
-                        {
-                            if ( sPtr+(j*4) > endPtr )
-                                return E_FAIL;
-                        }
+    //---------------------------------------------------------------------------------
+    default:
+        return nullptr;
+    }
 
-                        for( ; j > 0; --j, ++x )
-                        {
-                            if ( x >= image->width )
-                                return E_FAIL;
+    return sPtr;
+}
 
-                            if ( convFlags & CONV_FLAGS_EXPAND )
-                            {
-                                assert( offset*3 < rowPitch);
 
-                                if ( sPtr+2 >= endPtr )
-                                    return E_FAIL;
+//-------------------------------------------------------------------------------------
+// Finds the end of one scanline of RLE pixel data without decoding it
+//-------------------------------------------------------------------------------------
+static const uint8_t* _SkipScanline( _In_ const uint8_t* sPtr, _In_ const uint8_t* endPtr, _In_ size_t width, _In_ size_t bpp )
+{
+    for( size_t x=0; x < width; )
+    {
+        if ( sPtr >= endPtr )
+            return nullptr;
 
-                                // BGR -> RGBA
-                                *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | 0xFF000000;
-                                sPtr += 3;
+        size_t j = (*sPtr & 0x7F) + 1;
+        size_t packetSize = ( *sPtr & 0x80 ) ? bpp : ( j * bpp );
 
-                                nonzeroa = true;
-                            }
-                            else
-                            {
-                                assert( offset*4 < rowPitch);
+        x += j;
+        if ( x > width )
+            return nullptr;
 
-                                if ( sPtr+3 >= endPtr )
-                                    return E_FAIL;
+        if ( packetSize >= size_t( endPtr - sPtr ) )
+            return nullptr;
 
-                                // BGRA -> RGBA
-                                *dPtr = ( *sPtr << 16 ) | ( *(sPtr+1) << 8 ) | ( *(sPtr+2) ) | ( *(sPtr+3) << 24 );
+        sPtr += 1 + packetSize;
+    }
 
-                                if ( *(sPtr+3) > 0 )
-                                    nonzeroa = true;
+    return sPtr;
+}
 
-                                sPtr += 4;
-                            }
 
-                            if ( convFlags & CONV_FLAGS_INVERTX )
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
+//-------------------------------------------------------------------------------------
+// Uncompress pixel data from a TGA into the target image
+//-------------------------------------------------------------------------------------
+static HRESULT _UncompressPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size, _In_ const Image* image, _In_ DWORD convFlags,
+                                  _In_ DWORD flags )
+{
+    assert( pSource && size > 0 );
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if ( !nonzeroa )
-            {
-                HRESULT hr = _SetAlphaChannelToOpaque( image );
-                if ( FAILED(hr) )
-                    return hr;
-            }
-        }
-        break;
+    if ( !image || !image->pixels )
+        return E_POINTER;
 
-    //---------------------------------------------------------------------------------
+    // TGA bytes per pixel
+    size_t bpp;
+    switch( image->format )
+    {
+    case DXGI_FORMAT_R8_UNORM:          bpp = 1; break;
+    case DXGI_FORMAT_B5G5R5A1_UNORM:    bpp = 2; break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:    bpp = ( convFlags & CONV_FLAGS_EXPAND ) ? 3 : 4; break;
     default:
         return E_FAIL;
     }
 
+    auto sPtr = reinterpret_cast<const uint8_t*>( pSource );
+    const uint8_t* endPtr = sPtr + size;
+
+    bool nonzeroa = false;
+
+#ifdef _OPENMP
+    if ( (flags & TGA_FLAGS_PARALLEL) && image->height > 1 )
+    {
+        // First pass only reads the packet headers to find where each scanline starts,
+        // so the scanlines can then be decoded independently
+        std::unique_ptr<const uint8_t*[]> rows( new (std::nothrow) const uint8_t*[ image->height ] );
+        if ( !rows )
+            return E_OUTOFMEMORY;
+
+        for( size_t y=0; y < image->height; ++y )
+        {
+            rows[ y ] = sPtr;
+
+            sPtr = _SkipScanline( sPtr, endPtr, image->width, bpp );
+            if ( !sPtr )
+                return E_FAIL;
+        }
+
+        bool fail = false;
+
+#pragma omp parallel for schedule(dynamic, 16)
+        for( int y=0; y < static_cast<int>( image->height ); ++y )
+        {
+            bool rowAlpha = false;
+            if ( !_UncompressScanline( rows[ y ], endPtr, image, size_t(y), convFlags, rowAlpha ) )
+                fail = true;
+
+            if ( rowAlpha )
+                nonzeroa = true;
+        }
+
+        if ( fail )
+            return E_FAIL;
+    }
+    else
+#else
+    UNREFERENCED_PARAMETER(flags);
+#endif // _OPENMP
+    {
+        for( size_t y=0; y < image->height; ++y )
+        {
+            sPtr = _UncompressScanline( sPtr, endPtr, image, y, convFlags, nonzeroa );
+            if ( !sPtr )
+                return E_FAIL;
+        }
+    }
+
+    // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
+    if ( !nonzeroa && image->format != DXGI_FORMAT_R8_UNORM )
+    {
+        HRESULT hr = _SetAlphaChannelToOpaque( image );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
     return S_OK;
 }
 
@@ -736,7 +789,7 @@ static HRESULT _CopyPixels( _In_reads_bytes_(size) LPCVOID pSource, size_t size,
 //-------------------------------------------------------------------------------------
 // Encodes TGA file header
 //-------------------------------------------------------------------------------------
-static HRESULT _EncodeTGAHeader( _In_ const Image& image, _Out_ TGA_HEADER& header, _Inout_ DWORD& convFlags )
+static HRESULT _EncodeTGAHeader( _In_ const Image& image, _In_ DWORD flags, _Out_ TGA_HEADER& header, _Inout_ DWORD& convFlags )
 {
     assert( IsValid( image.format ) && !IsVideo( image.format ) );
 
@@ -793,6 +846,12 @@ static HRESULT _EncodeTGAHeader( _In_ const Image& image, _Out_ TGA_HEADER& head
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    if ( flags & TGA_FLAGS_RLE )
+    {
+        header.bImageType = ( header.bImageType == TGA_BLACK_AND_WHITE ) ? TGA_BLACK_AND_WHITE_RLE : TGA_TRUECOLOR_RLE;
+        convFlags |= CONV_FLAGS_RLE;
+    }
+
     return S_OK;
 }
 
@@ -831,6 +890,167 @@ static void _Copy24bppScanline( _Out_writes_bytes_(outSize) LPVOID pDestination,
 }
 
 
+//-------------------------------------------------------------------------------------
+// RLE compresses one scanline of TGA pixel data (packets never span scanlines);
+// pDestination needs room for width*bpp + (width+127)/128 bytes
+//-------------------------------------------------------------------------------------
+template<size_t bpp>
+static size_t _CountRepeats( _In_reads_bytes_(count*bpp) const uint8_t* sPtr, _In_ size_t count )
+{
+    size_t n = 1;
+    while ( n < count && memcmp( sPtr, sPtr + n*bpp, bpp ) == 0 )
+        ++n;
+    return n;
+}
+
+template<size_t bpp>
+static size_t _CompressScanline( _Out_ uint8_t* pDestination, _In_reads_bytes_(width*bpp) const uint8_t* pSource, _In_ size_t width )
+{
+    // A repeat of two 8-bit pixels is no smaller than a literal, and would break the size bound above
+    const size_t minRepeat = ( bpp > 1 ) ? 2 : 3;
+
+    uint8_t* dPtr = pDestination;
+
+    for( size_t x=0; x < width; )
+    {
+        const uint8_t* sPtr = pSource + x*bpp;
+        const size_t maxCount = std::min<size_t>( 128, width - x );
+
+        size_t count = _CountRepeats<bpp>( sPtr, maxCount );
+        if ( count >= minRepeat )
+        {
+            // Repeat
+            *(dPtr++) = uint8_t( 0x80 | (count - 1) );
+            memcpy( dPtr, sPtr, bpp );
+            dPtr += bpp;
+        }
+        else
+        {
+            // Literal, up to where the next repeat starts
+            while ( count < maxCount
+                    && _CountRepeats<bpp>( sPtr + count*bpp, std::min<size_t>( minRepeat, width - x - count ) ) < minRepeat )
+                ++count;
+
+            *(dPtr++) = uint8_t( count - 1 );
+            memcpy( dPtr, sPtr, count*bpp );
+            dPtr += count*bpp;
+        }
+
+        x += count;
+    }
+
+    return size_t( dPtr - pDestination );
+}
+
+static size_t _CompressRow( _Out_ uint8_t* pDestination, _Out_writes_bytes_(rowPitch) uint8_t* pTemp, _In_ const Image& image, _In_ size_t y,
+                            _In_ DWORD convFlags, _In_ size_t rowPitch )
+{
+    const uint8_t* pPixels = image.pixels + y*image.rowPitch;
+
+    if ( convFlags & CONV_FLAGS_888 )
+    {
+        _Copy24bppScanline( pTemp, rowPitch, pPixels, image.rowPitch );
+    }
+    else if ( convFlags & CONV_FLAGS_SWIZZLE )
+    {
+        _SwizzleScanline( pTemp, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
+    }
+    else
+    {
+        _CopyScanline( pTemp, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE );
+    }
+
+    switch( rowPitch / image.width )
+    {
+    case 1:     return _CompressScanline<1>( pDestination, pTemp, image.width );
+    case 2:     return _CompressScanline<2>( pDestination, pTemp, image.width );
+    case 3:     return _CompressScanline<3>( pDestination, pTemp, image.width );
+    default:    return _CompressScanline<4>( pDestination, pTemp, image.width );
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// RLE compresses the image into TGA pixel data. Each scanline is encoded into its own
+// worst-case sized slot, so they can be done in parallel, and the slots are then packed.
+//-------------------------------------------------------------------------------------
+static HRESULT _CompressPixels( _In_ const Image& image, _In_ DWORD convFlags, _In_ DWORD flags, _In_ size_t rowPitch,
+                                _Inout_ std::unique_ptr<uint8_t[]>& pixels, _Out_ size_t& size )
+{
+    assert( image.pixels && image.width > 0 && image.height > 0 );
+    assert( (rowPitch % image.width) == 0 );
+
+    size = 0;
+
+    const size_t slotPitch = rowPitch + ( image.width + 127 ) / 128;
+
+    uint64_t slotSize = uint64_t( slotPitch ) * image.height;
+    if ( slotSize > SIZE_MAX )
+        return HRESULT_FROM_WIN32( ERROR_ARITHMETIC_OVERFLOW );
+
+    pixels.reset( new (std::nothrow) uint8_t[ static_cast<size_t>( slotSize ) ] );
+    if ( !pixels )
+        return E_OUTOFMEMORY;
+
+    std::unique_ptr<size_t[]> lengths( new (std::nothrow) size_t[ image.height ] );
+    if ( !lengths )
+        return E_OUTOFMEMORY;
+
+#ifdef _OPENMP
+    if ( (flags & TGA_FLAGS_PARALLEL) && image.height > 1 )
+    {
+        bool fail = false;
+
+#pragma omp parallel
+        {
+            std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ rowPitch ] );
+
+#pragma omp for schedule(dynamic, 16)
+            for( int y=0; y < static_cast<int>( image.height ); ++y )
+            {
+                if ( !temp )
+                {
+                    fail = true;
+                    continue;
+                }
+
+                lengths[ y ] = _CompressRow( pixels.get() + size_t(y)*slotPitch, temp.get(), image, size_t(y), convFlags, rowPitch );
+            }
+        }
+
+        if ( fail )
+            return E_OUTOFMEMORY;
+    }
+    else
+#else
+    UNREFERENCED_PARAMETER(flags);
+#endif // _OPENMP
+    {
+        std::unique_ptr<uint8_t[]> temp( new (std::nothrow) uint8_t[ rowPitch ] );
+        if ( !temp )
+            return E_OUTOFMEMORY;
+
+        for( size_t y=0; y < image.height; ++y )
+        {
+            lengths[ y ] = _CompressRow( pixels.get() + y*slotPitch, temp.get(), image, y, convFlags, rowPitch );
+        }
+    }
+
+    // Pack the scanlines
+    uint8_t* dPtr = pixels.get();
+    for( size_t y=0; y < image.height; ++y )
+    {
+        assert( lengths[ y ] <= slotPitch );
+        memmove( dPtr, pixels.get() + y*slotPitch, lengths[ y ] );
+        dPtr += lengths[ y ];
+    }
+
+    size = size_t( dPtr - pixels.get() );
+
+    return S_OK;
+}
+
+
 //=====================================================================================
 // Entry-points
 //=====================================================================================
@@ -911,7 +1131,7 @@ HRESULT GetMetadataFromTGAFile( LPCWSTR szFile, TexMetadata& metadata )
 // Load a TGA file in memory
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata, ScratchImage& image )
+HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata* metadata, ScratchImage& image )
 {
     if ( !pSource || size == 0 )
         return E_INVALIDARG;
@@ -940,7 +1160,7 @@ HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata,
 
     if ( convFlags & CONV_FLAGS_RLE )
     {
-        hr = _UncompressPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags );
+        hr = _UncompressPixels( pPixels, remaining, image.GetImage(0,0,0), convFlags, flags );
     }
     else
     {
@@ -964,7 +1184,7 @@ HRESULT LoadFromTGAMemory( LPCVOID pSource, size_t size, TexMetadata* metadata,
 // Load a TGA file from disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& image )
+HRESULT LoadFromTGAFile( LPCWSTR szFile, DWORD flags, TexMetadata* metadata, ScratchImage& image )
 {
     if ( !szFile )
         return E_INVALIDARG;
@@ -1188,7 +1408,7 @@ HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& im
 
         if ( convFlags & CONV_FLAGS_RLE )
         {
-            hr = _UncompressPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags );
+            hr = _UncompressPixels( temp.get(), remaining, image.GetImage(0,0,0), convFlags, flags );
         }
         else
         {
@@ -1213,14 +1433,14 @@ HRESULT LoadFromTGAFile( LPCWSTR szFile, TexMetadata* metadata, ScratchImage& im
 // Save a TGA file to memory
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
+HRESULT SaveToTGAMemory( const Image& image, DWORD flags, Blob& blob )
 {
     if ( !image.pixels )
         return E_POINTER;
 
     TGA_HEADER tga_header;
     DWORD convFlags = 0;
-    HRESULT hr = _EncodeTGAHeader( image, tga_header, convFlags );
+    HRESULT hr = _EncodeTGAHeader( image, flags, tga_header, convFlags );
     if ( FAILED(hr) )
         return hr;
 
@@ -1238,6 +1458,27 @@ HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
         ComputePitch( image.format, image.width, image.height, rowPitch, slicePitch, CP_FLAGS_NONE );
     }
 
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        // Size is only known once the pixels have been compressed
+        std::unique_ptr<uint8_t[]> pixels;
+        size_t pixelSize;
+        hr = _CompressPixels( image, convFlags, flags, rowPitch, pixels, pixelSize );
+        if ( FAILED(hr) )
+            return hr;
+
+        hr = blob.Initialize( sizeof(TGA_HEADER) + pixelSize );
+        if ( FAILED(hr) )
+            return hr;
+
+        auto dPtr = reinterpret_cast<uint8_t*>( blob.GetBufferPointer() );
+        assert( dPtr != 0 );
+        memcpy_s( dPtr, blob.GetBufferSize(), &tga_header, sizeof(TGA_HEADER) );
+        memcpy_s( dPtr + sizeof(TGA_HEADER), blob.GetBufferSize() - sizeof(TGA_HEADER), pixels.get(), pixelSize );
+
+        return S_OK;
+    }
+
     hr = blob.Initialize( sizeof(TGA_HEADER) + slicePitch );
     if ( FAILED(hr) )
         return hr;
@@ -1279,7 +1520,7 @@ HRESULT SaveToTGAMemory( const Image& image, Blob& blob )
 // Save a TGA file to disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
+HRESULT SaveToTGAFile( const Image& image, DWORD flags, LPCWSTR szFile )
 {
     if ( !szFile )
         return E_INVALIDARG;
@@ -1289,7 +1530,7 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
 
     TGA_HEADER tga_header;
     DWORD convFlags = 0;
-    HRESULT hr = _EncodeTGAHeader( image, tga_header, convFlags );
+    HRESULT hr = _EncodeTGAHeader( image, flags, tga_header, convFlags );
     if ( FAILED(hr) )
         return hr;
 
@@ -1316,12 +1557,47 @@ HRESULT SaveToTGAFile( const Image& image, LPCWSTR szFile )
         ComputePitch( image.format, image.width, image.height, rowPitch, slicePitch, CP_FLAGS_NONE );
     }
 
-    if ( slicePitch < 65535 )
+    if ( convFlags & CONV_FLAGS_RLE )
+    {
+        std::unique_ptr<uint8_t[]> pixels;
+        size_t pixelSize;
+        hr = _CompressPixels( image, convFlags, flags, rowPitch, pixels, pixelSize );
+        if ( FAILED(hr) )
+            return hr;
+
+        // Write header
+        DWORD bytesWritten;
+        if ( !WriteFile( hFile.get(), &tga_header, sizeof(TGA_HEADER), &bytesWritten, 0 ) )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+
+        if ( bytesWritten != sizeof(TGA_HEADER) )
+            return E_FAIL;
+
+        // Write pixels (in pieces, since very large images can exceed a single write)
+        auto pPixels = pixels.get();
+        while ( pixelSize > 0 )
+        {
+            const DWORD bytesToWrite = static_cast<DWORD>( std::min<size_t>( pixelSize, 0x10000000 ) );
+            if ( !WriteFile( hFile.get(), pPixels, bytesToWrite, &bytesWritten, 0 ) )
+            {
+                return HRESULT_FROM_WIN32( GetLastError() );
+            }
+
+            if ( bytesWritten != bytesToWrite )
+                return E_FAIL;
+
+            pPixels += bytesToWrite;
+            pixelSize -= bytesToWrite;
+        }
+    }
+    else if ( slicePitch < 65535 )
     {
         // For small images, it is better to create an in-memory file and write it out
         Blob blob;
 
-        hr = SaveToTGAMemory( image, blob );
+        hr = SaveToTGAMemory( image, flags, blob );
         if ( FAILED(hr) )
             return hr;
 
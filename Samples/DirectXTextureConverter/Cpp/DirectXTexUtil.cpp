@@ -174,26 +174,22 @@ bool _IsWIC2()
     return g_WIC2;
 }
 
-IWICImagingFactory* _GetWIC()
+static BOOL WINAPI _CreateWICFactory( PINIT_ONCE, PVOID, PVOID *ifactory )
 {
-    static IWICImagingFactory* s_Factory = nullptr;
-
-    if ( s_Factory )
-        return s_Factory;
-
 #if(_WIN32_WINNT >= _WIN32_WINNT_WIN8) || defined(_WIN7_PLATFORM_UPDATE)
     HRESULT hr = CoCreateInstance(
         CLSID_WICImagingFactory2,
         nullptr,
         CLSCTX_INPROC_SERVER,
         __uuidof(IWICImagingFactory2),
-        (LPVOID*)&s_Factory
+        ifactory
         );
 
     if ( SUCCEEDED(hr) )
     {
         // WIC2 is available on Windows 8 and Windows 7 SP1 with KB 2670838 installed
         g_WIC2 = true;
+        return TRUE;
     }
     else
     {
@@ -202,32 +198,30 @@ IWICImagingFactory* _GetWIC()
             nullptr,
             CLSCTX_INPROC_SERVER,
             __uuidof(IWICImagingFactory),
-            (LPVOID*)&s_Factory
+            ifactory
             );
-
-        if ( FAILED(hr) )
-        {
-            s_Factory = nullptr;
-            return nullptr;
-        }
+        return SUCCEEDED(hr) ? TRUE : FALSE;
     }
 #else
-    HRESULT hr = CoCreateInstance(
+    return SUCCEEDED( CoCreateInstance(
         CLSID_WICImagingFactory,
         nullptr,
         CLSCTX_INPROC_SERVER,
         __uuidof(IWICImagingFactory),
-        (LPVOID*)&s_Factory
-        );
+        ifactory) ) ? TRUE : FALSE;
+#endif
+}
 
-    if ( FAILED(hr) )
-    {
-        s_Factory = nullptr;
+IWICImagingFactory* _GetWIC()
+{
+    // Loaders and writers may be called from several threads at once (e.g. texconv -batch)
+    static INIT_ONCE s_initOnce = INIT_ONCE_STATIC_INIT;
+
+    IWICImagingFactory* factory = nullptr;
+    if ( !InitOnceExecuteOnce( &s_initOnce, _CreateWICFactory, nullptr, reinterpret_cast<LPVOID*>(&factory) ) )
         return nullptr;
-    }
-#endif
 
-    return s_Factory;
+    return factory;
 }
 
 
@@ -22,9 +22,88 @@
 
 #include "scoped.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 6993)
+#endif
+
 namespace DirectX
 {
 
+//-------------------------------------------------------------------------------------
+// Band helpers
+//-------------------------------------------------------------------------------------
+
+// Smallest band of rows worth scheduling; each band reloads the source rows at its top edge
+static const size_t BAND_MIN_ROWS = 16;
+
+// Calls bandFunc( start, end, scratch ) over [0,count) with scratchSize vectors of
+// scratch space. With TEX_FILTER_PARALLEL the range is split into bands of at least
+// minBand entries which are handed out dynamically to the OpenMP threads; each thread
+// allocates its own scratch and reuses it for every band it picks up. Otherwise the
+// whole range is processed as a single band on the calling thread.
+template<class BandFunc>
+HRESULT _ProcessBands( _In_ size_t count, _In_ size_t minBand, _In_ size_t scratchSize, _In_ DWORD filter, BandFunc bandFunc )
+{
+    assert( count > 0 && minBand > 0 );
+
+#ifdef _OPENMP
+    if ( filter & TEX_FILTER_PARALLEL )
+    {
+        // A few bands per thread so that dynamic scheduling can even out the load
+        size_t bandSize = std::max<size_t>( minBand, count / ( size_t( omp_get_max_threads() ) * 4 ) );
+        if ( count > bandSize )
+        {
+            const int nBands = static_cast<int>( ( count + bandSize - 1 ) / bandSize );
+
+            HRESULT hr = S_OK;
+
+#pragma omp parallel
+            {
+                ScopedAlignedArrayXMVECTOR scratch( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * scratchSize, 16 ) ) );
+
+#ifdef _DEBUG
+                if ( scratch )
+                    memset( scratch.get(), 0xCD, sizeof(XMVECTOR) * scratchSize );
+#endif
+
+#pragma omp for schedule(dynamic)
+                for( int band = 0; band < nBands; ++band )
+                {
+                    HRESULT hrBand = E_OUTOFMEMORY;
+                    if ( scratch )
+                    {
+                        size_t start = size_t(band) * bandSize;
+                        hrBand = bandFunc( start, std::min<size_t>( start + bandSize, count ), scratch.get() );
+                    }
+
+                    if ( FAILED(hrBand) )
+                    {
+#pragma omp critical
+                        hr = hrBand;
+                    }
+                }
+            }
+
+            return hr;
+        }
+    }
+#else
+    UNREFERENCED_PARAMETER(filter);
+#endif // _OPENMP
+
+    ScopedAlignedArrayXMVECTOR scratch( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * scratchSize, 16 ) ) );
+    if ( !scratch )
+        return E_OUTOFMEMORY;
+
+#ifdef _DEBUG
+    memset( scratch.get(), 0xCD, sizeof(XMVECTOR) * scratchSize );
+#endif
+
+    return bandFunc( 0, count, scratch.get() );
+}
+
+
 //-------------------------------------------------------------------------------------
 // Box filtering helpers
 //-------------------------------------------------------------------------------------
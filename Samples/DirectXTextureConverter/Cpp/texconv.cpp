@@ -8,12 +8,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <limits.h>
 #include <assert.h>
+#include <process.h>
+#include <new>
 
 #include <dxgiformat.h>
 
 #include "directxtex.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace DirectX;
 
 enum OPTIONS    // Note: dwOptions below assumes 32 or less options.
@@ -43,6 +51,12 @@ enum OPTIONS    // Note: dwOptions below assumes 32 or less options.
     OPT_TA_WRAP,
     OPT_TA_MIRROR,
     OPT_FORCE_SINGLEPROC,
+    OPT_THREADS,
+    OPT_BATCH,
+    OPT_TIMING,
+    OPT_BC_QUALITY,
+    OPT_BENCHMARK,
+    OPT_TGA_RLE,
 };
 
 struct SConversion
@@ -53,6 +67,92 @@ struct SConversion
     SConversion *pNext;
 };
 
+struct SSettings
+{
+    size_t      width;
+    size_t      height;
+    size_t      mipLevels;
+    DXGI_FORMAT format;
+    DWORD       dwFilter;
+    DWORD       dwSRGB;
+    DWORD       dwFilterOpts;
+    DWORD       dwCompress;
+    DWORD       FileType;
+    DWORD       dwOptions;
+    const WCHAR *szPrefix;
+    const WCHAR *szSuffix;
+};
+
+enum STAGES
+{
+    STAGE_LOAD = 0,
+    STAGE_CONVERT,
+    STAGE_COMPRESS,
+    STAGE_SAVE,
+    STAGE_MAX
+};
+
+struct SJob
+{
+    SConversion     *pConv;
+    ScratchImage    *image;
+    TexMetadata     info;
+    TexMetadata     srcInfo;
+    DXGI_FORMAT     tformat;
+
+    HRESULT         hr;
+    STAGES          stageFailed;    // STAGE_MAX if no stage failed
+    bool            fatal;          // Failure should stop the whole conversion run
+    bool            nonpow2warn;
+    bool            pmalphawarn;
+    bool            streamCompress; // Compression is left to the save stage, which writes each image as it is compressed
+    WCHAR           szError[128];
+
+    LONGLONG        qpcStage[STAGE_MAX];
+
+    SJob            *pNext;
+};
+
+struct SJobQueue
+{
+    CRITICAL_SECTION    cs;
+    HANDLE              hItems;     // Semaphore counting queued jobs
+    SJob                *pHead;
+    SJob                *pTail;
+    SJob                sentinel;   // Queued to mark the end of the stream
+};
+
+struct SReport
+{
+    FILE        *fp;
+    size_t      files;
+    size_t      failed;
+    LONGLONG    qpcStart;
+    LONGLONG    qpcBusy[STAGE_MAX];
+    LONGLONG    qpcWait[STAGE_MAX];
+};
+
+struct SPipeline;
+
+struct SStageThread
+{
+    SPipeline   *pPipeline;
+    STAGES      stage;
+};
+
+struct SPipeline
+{
+    const SSettings *pSettings;
+    SReport         *pReport;
+    HANDLE          hSlots;         // Semaphore bounding the number of images in flight
+    volatile LONG   abort;
+    bool            nonpow2warn;
+
+    SJobQueue       queues[STAGE_MAX];
+    SStageThread    threads[STAGE_MAX];
+    LONGLONG        qpcWait[STAGE_MAX];
+};
+
 struct SValue
 {
     LPCWSTR pName;
@@ -90,9 +190,23 @@ SValue g_pOptions[] =
     { L"wrap",          OPT_TA_WRAP },
     { L"mirror",        OPT_TA_MIRROR },
     { L"singleproc",    OPT_FORCE_SINGLEPROC },
+    { L"threads",       OPT_THREADS },
+    { L"batch",         OPT_BATCH },
+    { L"timing",        OPT_TIMING },
+    { L"bcq",           OPT_BC_QUALITY },
+    { L"bench",         OPT_BENCHMARK },
+    { L"tgarle",        OPT_TGA_RLE },
     { nullptr,          0             }
 };
 
+const char* g_pStageNames[STAGE_MAX] =
+{
+    "load",
+    "convert",
+    "compress",
+    "save",
+};
+
 #define DEFFMT(fmt) { L#fmt, DXGI_FORMAT_ ## fmt }
 
 SValue g_pFormats[] = 
@@ -176,6 +290,13 @@ SValue g_pFormats[] =
     { nullptr, DXGI_FORMAT_UNKNOWN }
 };
 
+SValue g_pBCQuality[] =
+{
+    { L"FAST",                      TEX_COMPRESS_BC67_FAST },
+    { L"FASTEST",                   TEX_COMPRESS_BC67_FASTEST },
+    { nullptr,                      TEX_COMPRESS_DEFAULT }
+};
+
 SValue g_pFilters[] = 
 {
     { L"POINT",                     TEX_FILTER_POINT },
@@ -365,10 +486,19 @@ void PrintUsage()
     wprintf( L"   -xlum               expand legacy L8, L16, and A8P8 formats\n");
     wprintf( L"\n                       (DDS output only)\n");
     wprintf( L"   -dx10               Force use of 'DX10' extended header\n");
+    wprintf( L"\n                       (TGA output only)\n");
+    wprintf( L"   -tgarle             RLE compress the image data\n");
     wprintf( L"\n   -nologo             suppress copyright message\n");
 #ifdef _OPENMP
-    wprintf( L"   -singleproc         Do not use multi-threaded compression\n");
+    wprintf( L"   -singleproc         Do not use multi-threaded filtering or compression\n");
+    wprintf( L"   -threads <n>        number of threads for filtering and compression\n");
 #endif
+    wprintf( L"   -batch <n>          pipeline load, convert, compress, and save across\n");
+    wprintf( L"                       files, keeping at most <n> images in memory\n");
+    wprintf( L"   -timing <file>      write per-stage timings as a JSON report\n");
+    wprintf( L"   -bcq <quality>      trade BC6H/BC7 quality for compression speed\n");
+    wprintf( L"   -bench              report BC compression speed (MPix/s) per format\n");
+    wprintf( L"                       instead of writing files\n");
 
     wprintf( L"\n");
     wprintf( L"   <format>: ");
@@ -381,389 +511,491 @@ void PrintUsage()
     wprintf( L"\n");
     wprintf( L"   <filetype>: ");
     PrintList(15, g_pSaveFileTypes);
+
+    wprintf( L"\n");
+    wprintf( L"   <quality>: ");
+    PrintList(14, g_pBCQuality);
 }
 
 
 //--------------------------------------------------------------------------------------
-// Entry-point
+// Conversion stages
 //--------------------------------------------------------------------------------------
-#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+LONGLONG GetTicks()
+{
+    LARGE_INTEGER qpc;
+    QueryPerformanceCounter( &qpc );
+    return qpc.QuadPart;
+}
 
-int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+double TicksToMS( LONGLONG ticks )
 {
-    // Parameters and defaults
-    HRESULT hr;
-    INT nReturn;
+    static LONGLONG s_frequency = 0;
 
-    size_t width = 0;
-    size_t height = 0; 
-    size_t mipLevels = 0;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    DWORD dwFilter = TEX_FILTER_DEFAULT;
-    DWORD dwSRGB = 0;
-    DWORD dwFilterOpts = 0;
-    DWORD FileType = CODEC_DDS;
+    if ( !s_frequency )
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency( &freq );
+        s_frequency = freq.QuadPart;
+    }
 
-    WCHAR szPrefix   [MAX_PATH];
-    WCHAR szSuffix   [MAX_PATH];
-    WCHAR szOutputDir[MAX_PATH];
+    return double(ticks) * 1000.0 / double(s_frequency);
+}
 
-    szPrefix[0]    = 0;
-    szSuffix[0]    = 0;
-    szOutputDir[0] = 0;
+void InitJob( SJob& job, SConversion* pConv )
+{
+    memset( &job, 0, sizeof(SJob) );
+    job.pConv = pConv;
+    job.stageFailed = STAGE_MAX;
+}
 
-    // Initialize COM (needed for WIC)
-    if( FAILED( hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED) ) )
+HRESULT SetJobError( SJob& job, HRESULT hr, bool fatal, LPCWSTR szFormat, ... )
+{
+    va_list args;
+    va_start( args, szFormat );
+    vswprintf_s( job.szError, _countof(job.szError), szFormat, args );
+    va_end( args );
+
+    job.fatal = fatal;
+    return FAILED(hr) ? hr : E_FAIL;
+}
+
+void MakeDestName( const SSettings& settings, SConversion* pConv )
+{
+    WCHAR *pchSlash, *pchDot;
+
+    wcscpy_s(pConv->szDest, MAX_PATH, settings.szPrefix);
+
+    pchSlash = wcsrchr(pConv->szSrc, L'\\');
+    if(pchSlash != 0)
+        wcscat_s(pConv->szDest, MAX_PATH, pchSlash + 1);
+    else
+        wcscat_s(pConv->szDest, MAX_PATH, pConv->szSrc);
+
+    pchSlash = wcsrchr(pConv->szDest, '\\');
+    pchDot = wcsrchr(pConv->szDest, '.');
+
+    if(pchDot > pchSlash)
+        *pchDot = 0;
+
+    wcscat_s(pConv->szDest, MAX_PATH, settings.szSuffix);
+}
+
+
+// Compares full paths, so differently written names for the same file still match
+bool IsSameFile( LPCWSTR szFile1, LPCWSTR szFile2 )
+{
+    WCHAR szPath1[MAX_PATH];
+    WCHAR szPath2[MAX_PATH];
+
+    if ( !GetFullPathNameW( szFile1, MAX_PATH, szPath1, nullptr )
+         || !GetFullPathNameW( szFile2, MAX_PATH, szPath2, nullptr ) )
     {
-        wprintf( L"Failed to initialize COM (%08X)\n", hr);
-        return 1;
+        // Assume the worst
+        return true;
     }
 
-    // Process command line
-    DWORD dwOptions = 0;
-    SConversion *pConversion = nullptr;
-    SConversion **ppConversion = &pConversion;
+    return _wcsicmp( szPath1, szPath2 ) == 0;
+}
 
-    for(int iArg = 1; iArg < argc; iArg++)
-    {
-        PWSTR pArg = argv[iArg];
 
-        if(('-' == pArg[0]) || ('/' == pArg[0]))
-        {
-            pArg++;
-            PWSTR pValue;
+//--- Load source image ---
+HRESULT LoadStage( const SSettings& settings, SJob& job )
+{
+    WCHAR ext[_MAX_EXT];
+    _wsplitpath_s( job.pConv->szSrc, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT );
 
-            for(pValue = pArg; *pValue && (':' != *pValue); pValue++);
+    TexMetadata& info = job.info;
 
-            if(*pValue)
-                *pValue++ = 0;
+    job.image = new ScratchImage;
+    if ( !job.image )
+    {
+        return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
+    }
 
-            DWORD dwOption = LookupByName(pArg, g_pOptions);
+    HRESULT hr;
+    if ( _wcsicmp( ext, L".dds" ) == 0 )
+    {
+        DWORD ddsFlags = DDS_FLAGS_NONE;
+        if ( settings.dwOptions & (1 << OPT_DDS_DWORD_ALIGN) )
+            ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+        if ( settings.dwOptions & (1 << OPT_EXPAND_LUMINANCE) )
+            ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+
+        // A mapped file can't be replaced while it is in use, so only map sources that aren't also the output
+        MakeDestName( settings, job.pConv );
+        if ( !IsSameFile( job.pConv->szSrc, job.pConv->szDest ) )
+            ddsFlags |= DDS_FLAGS_MAPPED;
+
+        hr = LoadFromDDSFile( job.pConv->szSrc, ddsFlags, &info, *job.image );
+        if ( FAILED(hr) )
+        {
+            return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+        }
 
-            if(!dwOption || (dwOptions & (1 << dwOption)))
+        if ( IsTypeless( info.format ) )
+        {
+            if ( settings.dwOptions & (1 << OPT_TYPELESS_UNORM) )
             {
-                PrintUsage();
-                return 1;
+                info.format = MakeTypelessUNORM( info.format );
             }
-
-            dwOptions |= 1 << dwOption;
-
-            if( (OPT_NOLOGO != dwOption) && (OPT_TYPELESS_UNORM != dwOption) && (OPT_TYPELESS_FLOAT != dwOption)
-                && (OPT_SEPALPHA != dwOption) && (OPT_PREMUL_ALPHA != dwOption) && (OPT_EXPAND_LUMINANCE != dwOption)
-                && (OPT_TA_WRAP != dwOption) && (OPT_TA_MIRROR != dwOption)
-                && (OPT_FORCE_SINGLEPROC != dwOption)
-                && (OPT_SRGB != dwOption) && (OPT_SRGBI != dwOption) && (OPT_SRGBO != dwOption)
-                && (OPT_HFLIP != dwOption) && (OPT_VFLIP != dwOption)
-                && (OPT_DDS_DWORD_ALIGN != dwOption) && (OPT_USE_DX10 != dwOption) )
+            else if ( settings.dwOptions & (1 << OPT_TYPELESS_FLOAT) )
             {
-                if(!*pValue)
-                {
-                    if((iArg + 1 >= argc))
-                    {
-                        PrintUsage();
-                        return 1;
-                    }
-
-                    iArg++;
-                    pValue = argv[iArg];
-                }
+                info.format = MakeTypelessFLOAT( info.format );
             }
 
-            switch(dwOption)
+            if ( IsTypeless( info.format ) )
             {
-            case OPT_WIDTH:
-                if (swscanf_s(pValue, L"%Iu", &width) != 1)
-                {
-                    wprintf( L"Invalid value specified with -w (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+                return SetJobError( job, E_FAIL, false, L" FAILED due to Typeless format %d\n", info.format );
+            }
 
-            case OPT_HEIGHT:
-                if (swscanf_s(pValue, L"%Iu", &height) != 1)
-                {
-                    wprintf( L"Invalid value specified with -h (%s)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            job.image->OverrideFormat( info.format );
+        }
+    }
+    else if ( _wcsicmp( ext, L".tga" ) == 0 )
+    {
+        DWORD tgaFlags = TGA_FLAGS_NONE;
+#ifdef _OPENMP
+        if ( !(settings.dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
+            tgaFlags |= TGA_FLAGS_PARALLEL;
+#endif
 
-            case OPT_MIPLEVELS:
-                if (swscanf_s(pValue, L"%Iu", &mipLevels) != 1)
-                {
-                    wprintf( L"Invalid value specified with -m (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        hr = LoadFromTGAFile( job.pConv->szSrc, tgaFlags, &info, *job.image );
+        if ( FAILED(hr) )
+        {
+            return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+        }
+    }
+    else
+    {
+        // WIC shares the same filter values for mode and dither
+        static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
+        static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+        static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
+
+        hr = LoadFromWICFile( job.pConv->szSrc, settings.dwFilter, &info, *job.image );
+        if ( FAILED(hr) )
+        {
+            return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+        }
+    }
 
-            case OPT_FORMAT:
-                format = (DXGI_FORMAT) LookupByName(pValue, g_pFormats);
-                if ( !format )
-                {
-                    wprintf( L"Invalid value specified with -f (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    job.srcInfo = info;
+    job.tformat = ( settings.format == DXGI_FORMAT_UNKNOWN ) ? info.format : settings.format;
 
-            case OPT_FILTER:
-                dwFilter = LookupByName(pValue, g_pFilters);
-                if ( !dwFilter )
-                {
-                    wprintf( L"Invalid value specified with -if (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    return S_OK;
+}
 
-            case OPT_SRGBI:
-                dwSRGB |= TEX_FILTER_SRGB_IN;
-                break;
 
-            case OPT_SRGBO:
-                dwSRGB |= TEX_FILTER_SRGB_OUT;
-                break;
+//--- Decompress, flip/rotate, resize, convert, generate mips, and premultiply alpha ---
+HRESULT ConvertStage( const SSettings& settings, SJob& job )
+{
+    TexMetadata& info = job.info;
+    DXGI_FORMAT tformat = job.tformat;
 
-            case OPT_SRGB:
-                dwSRGB |= TEX_FILTER_SRGB;
-                break;
+    size_t twidth = ( !settings.width ) ? info.width : settings.width;
+    size_t theight = ( !settings.height ) ? info.height : settings.height;
+    size_t tMips = ( !settings.mipLevels && info.mipLevels > 1 ) ? info.mipLevels : settings.mipLevels;
 
-            case OPT_SEPALPHA:
-                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
-                break;
+    DWORD dwFilter = settings.dwFilter;
+    DWORD dwFilterOpts = settings.dwFilterOpts;
+    DWORD dwOptions = settings.dwOptions;
 
-            case OPT_PREFIX:
-                wcscpy_s(szPrefix, MAX_PATH, pValue);
-                break;
+    HRESULT hr;
 
-            case OPT_SUFFIX:
-                wcscpy_s(szSuffix, MAX_PATH, pValue);
-                break;
+    // --- Decompress --------------------------------------------------------------
+    if ( IsCompressed( info.format ) )
+    {
+        const Image* img = job.image->GetImage(0,0,0);
+        assert( img );
+        size_t nimg = job.image->GetImageCount();
 
-            case OPT_OUTPUTDIR:
-                wcscpy_s(szOutputDir, MAX_PATH, pValue);
-                break;
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
+        {
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
+        }
 
-            case OPT_FILETYPE:
-                FileType = LookupByName(pValue, g_pSaveFileTypes);
-                if ( !FileType )
-                {
-                    wprintf( L"Invalid value specified with -ft (%s)\n", pValue);
-                    wprintf( L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        hr = Decompress( img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
+        if ( FAILED(hr) )
+        {
+            delete timage;
+            return SetJobError( job, hr, false, L" FAILED [decompress] (%x)\n", hr );
+        }
 
-            case OPT_TA_WRAP:
-                if ( dwFilterOpts & TEX_FILTER_MIRROR )
-                {
-                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_WRAP;
-                break;
+        const TexMetadata& tinfo = timage->GetMetadata();
 
-            case OPT_TA_MIRROR:
-                if ( dwFilterOpts & TEX_FILTER_WRAP )
-                {
-                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_MIRROR;
-                break;
-            }
-        }
-        else
-        {         
-            SConversion *pConv = new SConversion;
-            if ( !pConv )
-                return 1;
+        info.format = tinfo.format;
 
-            wcscpy_s(pConv->szSrc, MAX_PATH, pArg);
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
 
-            pConv->szDest[0] = 0;
-            pConv->pNext = nullptr;
+        delete job.image;
+        job.image = timage;
+    }
 
-            *ppConversion = pConv;
-            ppConversion = &pConv->pNext;
+    // --- Flip/Rotate -------------------------------------------------------------
+    if ( dwOptions & ( (1 << OPT_HFLIP) | (1 << OPT_VFLIP) ) )
+    {
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
+        {
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
         }
-    }
 
-    if(!pConversion)
-    {
-        PrintUsage();
-        return 0;
-    }
+        DWORD dwFlags = 0;
 
-    if(~dwOptions & (1 << OPT_NOLOGO))
-        PrintLogo();
+        if ( dwOptions & (1 << OPT_HFLIP) )
+            dwFlags |= TEX_FR_FLIP_HORIZONTAL;
 
-    // Work out out filename prefix and suffix
-    if(szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
-        wcscat_s( szOutputDir, MAX_PATH, L"\\" );
+        if ( dwOptions & (1 << OPT_VFLIP) )
+            dwFlags |= TEX_FR_FLIP_VERTICAL;
 
-    if(szPrefix[0])
-        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
+        assert( dwFlags != 0 );
 
-    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
+        hr = FlipRotate( job.image->GetImages(), job.image->GetImageCount(), job.image->GetMetadata(), dwFlags, *timage );
+        if ( FAILED(hr) )
+        {
+            delete timage;
+            return SetJobError( job, hr, true, L" FAILED [fliprotate] (%x)\n", hr );
+        }
 
-    const WCHAR* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
+        const TexMetadata& tinfo = timage->GetMetadata();
 
-    if (fileTypeName)
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".");
-        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
-    }
-    else
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".unknown");
+        assert( tinfo.width == twidth && tinfo.height == theight );
+
+        info.width = tinfo.width;
+        info.height = tinfo.height;
+
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.format == tinfo.format );
+        assert( info.dimension == tinfo.dimension );
+
+        delete job.image;
+        job.image = timage;
     }
 
-    if (FileType != CODEC_DDS)
+    // --- Resize ------------------------------------------------------------------
+    if ( info.width != twidth || info.height != theight )
     {
-        mipLevels = 1;
-    }
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
+        {
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
+        }
 
-    // Convert images
-    bool nonpow2warn = false;
-    SConversion *pConv;
+        hr = Resize( job.image->GetImages(), job.image->GetImageCount(), job.image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage );
+        if ( FAILED(hr) )
+        {
+            delete timage;
+            return SetJobError( job, hr, true, L" FAILED [resize] (%x)\n", hr );
+        }
 
-    for(pConv = pConversion; pConv; pConv = pConv->pNext)
-    {
-        // Load source image
-        if(pConv != pConversion)
-            wprintf( L"\n");
+        const TexMetadata& tinfo = timage->GetMetadata();
 
-        wprintf( L"reading %s", pConv->szSrc );
-        fflush(stdout);
+        assert( tinfo.width == twidth && tinfo.height == theight && tinfo.mipLevels == 1 );
+        info.width = tinfo.width;
+        info.height = tinfo.height;
+        info.mipLevels = 1;
 
-        WCHAR ext[_MAX_EXT];
-        WCHAR fname[_MAX_FNAME];
-        _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.format == tinfo.format );
+        assert( info.dimension == tinfo.dimension );
 
-        TexMetadata info;
-        ScratchImage *image = new ScratchImage;
+        delete job.image;
+        job.image = timage;
+    }
 
-        if ( !image )
+    // --- Convert -----------------------------------------------------------------
+    if ( info.format != tformat && !IsCompressed( tformat ) )
+    {
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
         {
-            wprintf( L" ERROR: Memory allocation failed\n" );
-            goto LError;
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
         }
 
-        if ( _wcsicmp( ext, L".dds" ) == 0 )
+        hr = Convert( job.image->GetImages(), job.image->GetImageCount(), job.image->GetMetadata(), tformat, dwFilter | dwFilterOpts | settings.dwSRGB, 0.5f, *timage );
+        if ( FAILED(hr) )
         {
-            DWORD ddsFlags = DDS_FLAGS_NONE;
-            if ( dwOptions & (1 << OPT_DDS_DWORD_ALIGN) )
-                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
-            if ( dwOptions & (1 << OPT_EXPAND_LUMINANCE) )
-                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+            delete timage;
+            return SetJobError( job, hr, true, L" FAILED [convert] (%x)\n", hr );
+        }
 
-            hr = LoadFromDDSFile( pConv->szSrc, ddsFlags, &info, *image );
-            if ( FAILED(hr) )
+        const TexMetadata& tinfo = timage->GetMetadata();
+
+        assert( tinfo.format == tformat );
+        info.format = tinfo.format;
+
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
+
+        delete job.image;
+        job.image = timage;
+    }
+
+    // --- Generate mips -----------------------------------------------------------
+    if ( !ispow2(info.width) || !ispow2(info.height) || !ispow2(info.depth) )
+    {
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+        {
+            if ( !tMips )
             {
-                wprintf( L" FAILED (%x)\n", hr);
-                delete image;
-                continue;
+                tMips = 1;
             }
+            else
+            {
+                return SetJobError( job, E_FAIL, true, L" ERROR: Cannot generate mips for non-power-of-2 volume textures\n" );
+            }
+        }
+        else if ( !tMips || info.mipLevels != 1 )
+        {
+            job.nonpow2warn = true;
+        }
+    }
 
-            if ( IsTypeless( info.format ) )
+    if ( (!tMips || info.mipLevels != tMips) && ( info.mipLevels != 1 ) )
+    {
+        // Mips generation only works on a single base image, so strip off existing mip levels
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
+        {
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
+        }
+
+        TexMetadata mdata = info;
+        mdata.mipLevels = 1;
+        hr = timage->Initialize( mdata );
+        if ( FAILED(hr) )
+        {
+            delete timage;
+            return SetJobError( job, hr, true, L" FAILED [copy to single level] (%x)\n", hr );
+        }
+
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
+        {
+            for( size_t d = 0; d < info.depth; ++d )
             {
-                if ( dwOptions & (1 << OPT_TYPELESS_UNORM) )
+                hr = CopyRectangle( *job.image->GetImage( 0, 0, d ), Rect( 0, 0, info.width, info.height ),
+                                    *timage->GetImage( 0, 0, d ), TEX_FILTER_DEFAULT, 0, 0 );
+                if ( FAILED(hr) )
                 {
-                    info.format = MakeTypelessUNORM( info.format );
+                    delete timage;
+                    return SetJobError( job, hr, true, L" FAILED [copy to single level] (%x)\n", hr );
                 }
-                else if ( dwOptions & (1 << OPT_TYPELESS_FLOAT) )
+            }
+        }
+        else
+        {
+            for( size_t i = 0; i < info.arraySize; ++i )
+            {
+                hr = CopyRectangle( *job.image->GetImage( 0, i, 0 ), Rect( 0, 0, info.width, info.height ),
+                                    *timage->GetImage( 0, i, 0 ), TEX_FILTER_DEFAULT, 0, 0 );
+                if ( FAILED(hr) )
                 {
-                    info.format = MakeTypelessFLOAT( info.format );
+                    delete timage;
+                    return SetJobError( job, hr, true, L" FAILED [copy to single level] (%x)\n", hr );
                 }
+            }
+        }
 
-                if ( IsTypeless( info.format ) )
-                {
-                    wprintf( L" FAILED due to Typeless format %d\n", info.format );
-                    delete image;
-                    continue;
-                }
+        delete job.image;
+        job.image = timage;
 
-                image->OverrideFormat( info.format );
-            }
+        const TexMetadata& tinfo = timage->GetMetadata();
+        info.mipLevels = tinfo.mipLevels;
+    }
+
+    if ( !tMips || info.mipLevels != tMips )
+    {
+        ScratchImage *timage = new ScratchImage;
+        if ( !timage )
+        {
+            return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
         }
-        else if ( _wcsicmp( ext, L".tga" ) == 0 )
+
+        if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
         {
-            hr = LoadFromTGAFile( pConv->szSrc, &info, *image );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                delete image;
-                continue;
-            }
+            hr = GenerateMipMaps3D( job.image->GetImages(), job.image->GetImageCount(), job.image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
         }
         else
         {
-            // WIC shares the same filter values for mode and dither
-            static_assert( WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match" );
-            static_assert( WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-            static_assert( WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match"  );
-
-            hr = LoadFromWICFile( pConv->szSrc, dwFilter, &info, *image );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                delete image;
-                continue;
-            }
+            hr = GenerateMipMaps( job.image->GetImages(), job.image->GetImageCount(), job.image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
+        }
+        if ( FAILED(hr) )
+        {
+            delete timage;
+            return SetJobError( job, hr, true, L" FAILED [mipmaps] (%x)\n", hr );
         }
 
-        PrintInfo( info );
+        const TexMetadata& tinfo = timage->GetMetadata();
+        info.mipLevels = tinfo.mipLevels;
 
-        size_t twidth = ( !width ) ? info.width : width;
-        size_t theight = ( !height ) ? info.height : height;
-        size_t tMips = ( !mipLevels && info.mipLevels > 1 ) ? info.mipLevels : mipLevels;
-        DXGI_FORMAT tformat = ( format == DXGI_FORMAT_UNKNOWN ) ? info.format : format;
+        assert( info.width == tinfo.width );
+        assert( info.height == tinfo.height );
+        assert( info.depth == tinfo.depth );
+        assert( info.arraySize == tinfo.arraySize );
+        assert( info.mipLevels == tinfo.mipLevels );
+        assert( info.miscFlags == tinfo.miscFlags );
+        assert( info.miscFlags2 == tinfo.miscFlags2 );
+        assert( info.dimension == tinfo.dimension );
 
-        // Convert texture
-        wprintf( L" as");
-        fflush(stdout);
+        delete job.image;
+        job.image = timage;
+    }
 
-        // --- Decompress --------------------------------------------------------------
-        if ( IsCompressed( info.format ) )
+    // --- Premultiplied alpha (if requested) --------------------------------------
+    if ( ( dwOptions & (1 << OPT_PREMUL_ALPHA) )
+         && HasAlpha( info.format )
+         && info.format != DXGI_FORMAT_A8_UNORM )
+    {
+        if ( info.IsPMAlpha() )
+        {
+            job.pmalphawarn = true;
+        }
+        else
         {
-            const Image* img = image->GetImage(0,0,0);
+            const Image* img = job.image->GetImage(0,0,0);
             assert( img );
-            size_t nimg = image->GetImageCount();
+            size_t nimg = job.image->GetImageCount();
 
             ScratchImage *timage = new ScratchImage;
             if ( !timage )
             {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
+                return SetJobError( job, E_OUTOFMEMORY, true, L" ERROR: Memory allocation failed\n" );
             }
 
-            hr = Decompress( img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage );
+            hr = PremultiplyAlpha( img, nimg, info, *timage );
             if ( FAILED(hr) )
             {
-                wprintf( L" FAILED [decompress] (%x)\n", hr);
                 delete timage;
-                delete image;
-                continue;
+                return SetJobError( job, hr, false, L" FAILED [premultiply alpha] (%x)\n", hr );
             }
 
             const TexMetadata& tinfo = timage->GetMetadata();
-
-            info.format = tinfo.format;
+            info.miscFlags2 = tinfo.miscFlags2;
 
             assert( info.width == tinfo.width );
             assert( info.height == tinfo.height );
@@ -774,452 +1006,1103 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             assert( info.miscFlags2 == tinfo.miscFlags2 );
             assert( info.dimension == tinfo.dimension );
 
-            delete image;
-            image = timage;
+            delete job.image;
+            job.image = timage;
         }
+    }
+
+    return S_OK;
+}
 
-        // --- Flip/Rotate -------------------------------------------------------------
-        if ( dwOptions & ( (1 << OPT_HFLIP) | (1 << OPT_VFLIP) ) )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
 
-            DWORD dwFlags = 0;
+//--- Compress and set alpha mode ---
+DWORD GetCompressFlags( const SSettings& settings, DXGI_FORMAT tformat )
+{
+    DWORD cflags = settings.dwCompress;
+#ifdef _OPENMP
+    switch( tformat )
+    {
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        if ( !(settings.dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
+        {
+            cflags |= TEX_COMPRESS_PARALLEL;
+        }
+        break;
+    }
+#else
+    UNREFERENCED_PARAMETER( tformat );
+#endif
 
-            if ( dwOptions & (1 << OPT_HFLIP) )
-                dwFlags |= TEX_FR_FLIP_HORIZONTAL;
+    return cflags;
+}
 
-            if ( dwOptions & (1 << OPT_VFLIP) )
-                dwFlags |= TEX_FR_FLIP_VERTICAL;
+// Formats whose alpha mode is recorded in the DDS header
+bool HasAlphaMode( DXGI_FORMAT format )
+{
+    return HasAlpha( format ) && format != DXGI_FORMAT_A8_UNORM;
+}
 
-            assert( dwFlags != 0 );
+void SetAlphaMode( const SSettings& settings, TexMetadata& info, bool opaque )
+{
+    if ( HasAlphaMode( info.format ) )
+    {
+        if ( opaque )
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+        }
+        else if ( info.IsPMAlpha() )
+        {
+            // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
+        }
+        else if ( settings.dwOptions & (1 << OPT_SEPALPHA) )
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
+        }
+        else
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
+        }
+    }
+    else
+    {
+        info.miscFlags2 &= ~TEX_MISC2_ALPHA_MODE_MASK;
+    }
+}
 
-            hr = FlipRotate( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFlags, *timage );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [fliprotate] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
-            }
+HRESULT CompressStage( const SSettings& settings, SJob& job )
+{
+    TexMetadata& info = job.info;
+    DXGI_FORMAT tformat = job.tformat;
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+    // --- Compress ----------------------------------------------------------------
+    if ( IsCompressed( tformat ) && (settings.FileType == CODEC_DDS) )
+    {
+        // Each image is compressed as it is written, so a compressed copy of the whole texture is never held.
+        // The alpha mode depends on the compressed result and is set then as well.
+        info.format = tformat;
+        job.streamCompress = true;
+        return S_OK;
+    }
 
-            assert( tinfo.width == twidth && tinfo.height == theight );
+    // --- Set alpha mode ----------------------------------------------------------
+    SetAlphaMode( settings, info, HasAlphaMode( info.format ) && job.image->IsAlphaAllOpaque() );
 
-            info.width = tinfo.width;
-            info.height = tinfo.height;
+    return S_OK;
+}
 
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.format == tinfo.format );
-            assert( info.dimension == tinfo.dimension );
 
-            delete image;
-            image = timage;
-        }
+//--- Compress and write a DDS file one image at a time ---
+HRESULT SaveCompressedDDS( const SSettings& settings, SJob& job, DWORD ddsFlags )
+{
+    TexMetadata& info = job.info;
 
-        // --- Resize ------------------------------------------------------------------
-        if ( info.width != twidth || info.height != theight )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+    const Image* img = job.image->GetImages();
+    assert( img );
+    size_t nimg = job.image->GetImageCount();
 
-            hr = Resize( image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [resize] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
-            }
+    // As when the whole chain is compressed at once, only the top level must divide into blocks
+    // (or be 1 or 2 texels); lower levels may be any size
+    if ( ( (info.width % 4) != 0 && info.width > 2 ) || ( (info.height % 4) != 0 && info.height > 2 ) )
+    {
+        return SetJobError( job, E_INVALIDARG, false, L" FAILED [compress] (%x)\n", E_INVALIDARG );
+    }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+    DDSFileWriter writer;
+    HRESULT hr = writer.Initialize( info, ddsFlags, job.pConv->szDest );
+    if ( FAILED(hr) )
+    {
+        return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+    }
 
-            assert( tinfo.width == twidth && tinfo.height == theight && tinfo.mipLevels == 1 );
-            info.width = tinfo.width;
-            info.height = tinfo.height;
-            info.mipLevels = 1;
+    assert( nimg == writer.GetImageCount() );
 
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.format == tinfo.format );
-            assert( info.dimension == tinfo.dimension );
+    DWORD cflags = GetCompressFlags( settings, info.format );
+    bool opaque = HasAlphaMode( info.format );
 
-            delete image;
-            image = timage;
+    for( size_t index = 0; index < nimg; ++index )
+    {
+        ScratchImage timage;
+        hr = Compress( img[ index ], info.format, cflags, 0.5f, timage );
+        if ( FAILED(hr) )
+        {
+            writer.Release();
+            DeleteFileW( job.pConv->szDest );
+            return SetJobError( job, hr, false, L" FAILED [compress] (%x)\n", hr );
         }
 
-        // --- Convert -----------------------------------------------------------------
-        if ( info.format != tformat && !IsCompressed( tformat ) )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+        if ( opaque )
+            opaque = timage.IsAlphaAllOpaque();
 
-            hr = Convert( image->GetImages(), image->GetImageCount(), image->GetMetadata(), tformat, dwFilter | dwFilterOpts | dwSRGB, 0.5f, *timage );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [convert] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
-            }
+        hr = writer.WriteImage( *timage.GetImages() );
+        if ( FAILED(hr) )
+            break;
+    }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+    if ( SUCCEEDED(hr) )
+    {
+        SetAlphaMode( settings, info, opaque );
+        hr = writer.Finish( &info );
+    }
 
-            assert( tinfo.format == tformat );
-            info.format = tinfo.format;
+    if ( FAILED(hr) )
+    {
+        writer.Release();
+        DeleteFileW( job.pConv->szDest );
+        return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+    }
 
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
+    return S_OK;
+}
 
-            delete image;
-            image = timage;
-        }
 
-        // --- Generate mips -----------------------------------------------------------
-        if ( !ispow2(info.width) || !ispow2(info.height) || !ispow2(info.depth) )
-        {
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
-            {
-                if ( !tMips )
-                {
-                    tMips = 1;
-                }
-                else
-                {
-                    wprintf( L" ERROR: Cannot generate mips for non-power-of-2 volume textures\n" );
-                    delete image;
-                    goto LError;
-                }
-            }
-            else if ( !tMips || info.mipLevels != 1 )
-            {
-                nonpow2warn = true;
-            }
-        }
+//--- Save result (destination name must already be set) ---
+HRESULT SaveStage( const SSettings& settings, SJob& job )
+{
+    const Image* img = job.image->GetImage(0,0,0);
+    assert( img );
+    size_t nimg = job.image->GetImageCount();
 
-        if ( (!tMips || info.mipLevels != tMips) && ( info.mipLevels != 1 ) )
+    HRESULT hr;
+    switch( settings.FileType )
+    {
+    case CODEC_DDS:
         {
-            // Mips generation only works on a single base image, so strip off existing mip levels
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+            DWORD ddsFlags = (settings.dwOptions & (1 << OPT_USE_DX10) ) ? (DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE;
 
-            TexMetadata mdata = info;
-            mdata.mipLevels = 1;
-            hr = timage->Initialize( mdata );
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
-            }
+            if ( job.streamCompress )
+                return SaveCompressedDDS( settings, job, ddsFlags );
 
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
-            {
-                for( size_t d = 0; d < info.depth; ++d )
-                {
-                    hr = CopyRectangle( *image->GetImage( 0, 0, d ), Rect( 0, 0, info.width, info.height ),
-                                        *timage->GetImage( 0, 0, d ), TEX_FILTER_DEFAULT, 0, 0 );
-                    if ( FAILED(hr) )
-                    {
-                        wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                        delete timage;
-                        delete image;
-                        goto LError;
-                    }
-                }
-            }
-            else
-            {
-                for( size_t i = 0; i < info.arraySize; ++i )
-                {
-                    hr = CopyRectangle( *image->GetImage( 0, i, 0 ), Rect( 0, 0, info.width, info.height ),
-                                        *timage->GetImage( 0, i, 0 ), TEX_FILTER_DEFAULT, 0, 0 );
-                    if ( FAILED(hr) )
-                    {
-                        wprintf( L" FAILED [copy to single level] (%x)\n", hr);
-                        delete timage;
-                        delete image;
-                        goto LError;
-                    }
-                }
-            }
+            hr = SaveToDDSFile( img, nimg, job.info, ddsFlags, job.pConv->szDest );
+        }
+        break;
 
-            delete image;
-            image = timage;
+    case CODEC_TGA:
+        {
+            DWORD tgaFlags = (settings.dwOptions & (1u << OPT_TGA_RLE) ) ? TGA_FLAGS_RLE : TGA_FLAGS_NONE;
+#ifdef _OPENMP
+            if ( !(settings.dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
+                tgaFlags |= TGA_FLAGS_PARALLEL;
+#endif
 
-            const TexMetadata& tinfo = timage->GetMetadata();
-            info.mipLevels = tinfo.mipLevels;
+            hr = SaveToTGAFile( img[0], tgaFlags, job.pConv->szDest );
         }
+        break;
 
-        if ( !tMips || info.mipLevels != tMips )
-        {
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+    default:
+        hr = SaveToWICFile( img, nimg, WIC_FLAGS_ALL_FRAMES, GetWICCodec( static_cast<WICCodecs>(settings.FileType) ), job.pConv->szDest );
+        break;
+    }
 
-            if ( info.dimension == TEX_DIMENSION_TEXTURE3D )
-            {
-                hr = GenerateMipMaps3D( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
-            }
-            else
-            {
-                hr = GenerateMipMaps( image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage );
-            }
-            if ( FAILED(hr) )
-            {
-                wprintf( L" FAILED [mipmaps] (%x)\n", hr);
-                delete timage;
-                delete image;
-                goto LError;
-            }
+    if ( FAILED(hr) )
+    {
+        return SetJobError( job, hr, false, L" FAILED (%x)\n", hr );
+    }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
-            info.mipLevels = tinfo.mipLevels;
+    return S_OK;
+}
 
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
 
-            delete image;
-            image = timage;
+HRESULT RunStage( STAGES stage, const SSettings& settings, SJob& job )
+{
+    LONGLONG start = GetTicks();
+
+    HRESULT hr;
+    switch( stage )
+    {
+    case STAGE_LOAD:        hr = LoadStage( settings, job ); break;
+    case STAGE_CONVERT:     hr = ConvertStage( settings, job ); break;
+    case STAGE_COMPRESS:    hr = CompressStage( settings, job ); break;
+    case STAGE_SAVE:        hr = SaveStage( settings, job ); break;
+    default:                hr = E_UNEXPECTED; break;
+    }
+
+    job.qpcStage[ stage ] = GetTicks() - start;
+
+    if ( FAILED(hr) )
+    {
+        job.hr = hr;
+        job.stageFailed = stage;
+    }
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Timing report (JSON)
+//--------------------------------------------------------------------------------------
+void WriteJSONString( FILE* fp, LPCWSTR str )
+{
+    char utf8[ MAX_PATH * 4 ];
+    if ( WideCharToMultiByte( CP_UTF8, 0, str, -1, utf8, sizeof(utf8), nullptr, nullptr ) <= 0 )
+        utf8[0] = 0;
+
+    fputc( '"', fp );
+    for( const char* pch = utf8; *pch; ++pch )
+    {
+        unsigned char ch = static_cast<unsigned char>( *pch );
+        if ( ch == '"' || ch == '\\' )
+        {
+            fputc( '\\', fp );
+            fputc( ch, fp );
+        }
+        else if ( ch < 0x20 )
+        {
+            fprintf( fp, "\\u%04x", ch );
+        }
+        else
+        {
+            fputc( ch, fp );
         }
+    }
+    fputc( '"', fp );
+}
+
+bool BeginReport( SReport& report, LPCWSTR szFile )
+{
+    memset( &report, 0, sizeof(SReport) );
+
+    if ( _wfopen_s( &report.fp, szFile, L"wb" ) != 0 || !report.fp )
+    {
+        report.fp = nullptr;
+        return false;
+    }
+
+    fprintf( report.fp, "{\n  \"files\": [" );
+    report.qpcStart = GetTicks();
+    return true;
+}
+
+// Only called from one thread at a time, in file order
+void ReportJob( SReport* pReport, const SJob& job )
+{
+    if ( !pReport || !pReport->fp )
+        return;
+
+    FILE* fp = pReport->fp;
+
+    fprintf( fp, (pReport->files > 0) ? ",\n    { \"src\": " : "\n    { \"src\": " );
+    WriteJSONString( fp, job.pConv->szSrc );
+    fprintf( fp, ", \"dest\": " );
+    WriteJSONString( fp, job.pConv->szDest );
+    fprintf( fp, ", \"hr\": \"0x%08X\"", static_cast<unsigned int>( job.hr ) );
+
+    for( size_t stage = 0; stage < STAGE_MAX; ++stage )
+    {
+        fprintf( fp, ", \"%s_ms\": %.3f", g_pStageNames[ stage ], TicksToMS( job.qpcStage[ stage ] ) );
+        pReport->qpcBusy[ stage ] += job.qpcStage[ stage ];
+    }
+
+    fprintf( fp, " }" );
+
+    ++pReport->files;
+    if ( FAILED(job.hr) )
+        ++pReport->failed;
+}
+
+void EndReport( SReport& report, size_t inflight )
+{
+    if ( !report.fp )
+        return;
+
+    FILE* fp = report.fp;
+    double wall = TicksToMS( GetTicks() - report.qpcStart );
+
+    fprintf( fp, "\n  ],\n" );
+    fprintf( fp, "  \"mode\": \"%s\",\n", inflight ? "batch" : "serial" );
+    fprintf( fp, "  \"inflight\": %Iu,\n", inflight ? inflight : 1 );
+    fprintf( fp, "  \"count\": %Iu,\n", report.files );
+    fprintf( fp, "  \"failed\": %Iu,\n", report.failed );
+    fprintf( fp, "  \"wall_ms\": %.3f,\n", wall );
+    fprintf( fp, "  \"stages\": {" );
+
+    for( size_t stage = 0; stage < STAGE_MAX; ++stage )
+    {
+        double busy = TicksToMS( report.qpcBusy[ stage ] );
+        fprintf( fp, "%s\n    \"%s\": { \"busy_ms\": %.3f, \"wait_ms\": %.3f, \"avg_ms\": %.3f, \"utilization\": %.3f }",
+                 (stage > 0) ? "," : "",
+                 g_pStageNames[ stage ],
+                 busy,
+                 TicksToMS( report.qpcWait[ stage ] ),
+                 report.files ? busy / double(report.files) : 0.0,
+                 (wall > 0.0) ? busy / wall : 0.0 );
+    }
+
+    fprintf( fp, "\n  }\n}\n" );
+    fclose( fp );
+    report.fp = nullptr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Serial conversion: each file runs through every stage before the next is read
+//--------------------------------------------------------------------------------------
+bool ConvertSerial( const SSettings& settings, SConversion* pConversion, SReport* pReport, bool& nonpow2warn )
+{
+    for(SConversion *pConv = pConversion; pConv; pConv = pConv->pNext)
+    {
+        // Load source image
+        if(pConv != pConversion)
+            wprintf( L"\n");
+
+        wprintf( L"reading %s", pConv->szSrc );
+        fflush(stdout);
+
+        SJob job;
+        InitJob( job, pConv );
+
+        bool fatal = false;
 
-        // --- Premultiplied alpha (if requested) --------------------------------------
-        if ( ( dwOptions & (1 << OPT_PREMUL_ALPHA) )
-             && HasAlpha( info.format )
-             && info.format != DXGI_FORMAT_A8_UNORM )
+        if ( SUCCEEDED( RunStage( STAGE_LOAD, settings, job ) ) )
         {
-            if ( info.IsPMAlpha() )
-            {
+            PrintInfo( job.info );
+
+            // Convert texture
+            wprintf( L" as");
+            fflush(stdout);
+
+            HRESULT hr = RunStage( STAGE_CONVERT, settings, job );
+
+            if ( job.pmalphawarn )
                 printf("WARNING: Image is already using premultiplied alpha\n");
-            }
-            else
+
+            nonpow2warn |= job.nonpow2warn;
+
+            if ( SUCCEEDED(hr) )
+                hr = RunStage( STAGE_COMPRESS, settings, job );
+
+            if ( SUCCEEDED(hr) )
             {
-                const Image* img = image->GetImage(0,0,0);
-                assert( img );
-                size_t nimg = image->GetImageCount();
+                PrintInfo( job.info );
+                wprintf( L"\n");
 
-                ScratchImage *timage = new ScratchImage;
-                if ( !timage )
-                {
-                    wprintf( L" ERROR: Memory allocation failed\n" );
-                    delete image;
-                    goto LError;
-                }
+                MakeDestName( settings, pConv );
 
-                hr = PremultiplyAlpha( img, nimg, info, *timage );
-                if ( FAILED(hr) )
+                // Write texture
+                wprintf( L"writing %s", pConv->szDest);
+                fflush(stdout);
+
+                if ( SUCCEEDED( RunStage( STAGE_SAVE, settings, job ) ) )
                 {
-                    wprintf( L" FAILED [premultiply alpha] (%x)\n", hr);
-                    delete timage;
-                    delete image;
-                    continue;
+                    wprintf( L"\n");
                 }
-
-                const TexMetadata& tinfo = timage->GetMetadata();
-                info.miscFlags2 = tinfo.miscFlags2;
- 
-                assert( info.width == tinfo.width );
-                assert( info.height == tinfo.height );
-                assert( info.depth == tinfo.depth );
-                assert( info.arraySize == tinfo.arraySize );
-                assert( info.mipLevels == tinfo.mipLevels );
-                assert( info.miscFlags == tinfo.miscFlags );
-                assert( info.miscFlags2 == tinfo.miscFlags2 );
-                assert( info.dimension == tinfo.dimension );
-
-                delete image;
-                image = timage;
             }
         }
 
-        // --- Compress ----------------------------------------------------------------
-        if ( IsCompressed( tformat ) && (FileType == CODEC_DDS) )
+        if ( FAILED( job.hr ) )
         {
-            const Image* img = image->GetImage(0,0,0);
-            assert( img );
-            size_t nimg = image->GetImageCount();
+            wprintf( L"%s", job.szError );
+            fatal = job.fatal;
+        }
 
-            ScratchImage *timage = new ScratchImage;
-            if ( !timage )
-            {
-                wprintf( L" ERROR: Memory allocation failed\n" );
-                delete image;
-                goto LError;
-            }
+        ReportJob( pReport, job );
 
-            DWORD cflags = TEX_COMPRESS_DEFAULT;
-#ifdef _OPENMP
-            switch( tformat )
+        delete job.image;
+
+        if ( fatal )
+            return false;
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Benchmark: compress each loaded image to the BC formats and report throughput
+//--------------------------------------------------------------------------------------
+const DXGI_FORMAT g_pBenchFormats[] =
+{
+    DXGI_FORMAT_BC1_UNORM,
+    DXGI_FORMAT_BC2_UNORM,
+    DXGI_FORMAT_BC3_UNORM,
+    DXGI_FORMAT_BC4_UNORM,
+    DXGI_FORMAT_BC4_SNORM,
+    DXGI_FORMAT_BC5_UNORM,
+    DXGI_FORMAT_BC5_SNORM,
+    DXGI_FORMAT_BC6H_UF16,
+    DXGI_FORMAT_BC6H_SF16,
+    DXGI_FORMAT_BC7_UNORM,
+};
+
+bool BenchmarkCompress( const SSettings& settings, SConversion* pConversion )
+{
+    for(SConversion *pConv = pConversion; pConv; pConv = pConv->pNext)
+    {
+        if(pConv != pConversion)
+            wprintf( L"\n");
+
+        wprintf( L"reading %s", pConv->szSrc );
+        fflush(stdout);
+
+        SJob job;
+        InitJob( job, pConv );
+
+        if ( FAILED( RunStage( STAGE_LOAD, settings, job ) ) || FAILED( RunStage( STAGE_CONVERT, settings, job ) ) )
+        {
+            wprintf( L"%s", job.szError );
+            delete job.image;
+
+            if ( job.fatal )
+                return false;
+
+            continue;
+        }
+
+        PrintInfo( job.info );
+        wprintf( L"\n");
+
+        const Image* img = job.image->GetImages();
+        size_t nimg = job.image->GetImageCount();
+
+        size_t pixels = 0;
+        for( size_t i = 0; i < nimg; ++i )
+        {
+            pixels += img[i].width * img[i].height;
+        }
+
+        for( size_t i = 0; i < _countof(g_pBenchFormats); ++i )
+        {
+            DXGI_FORMAT tformat = g_pBenchFormats[i];
+
+            // An explicit -f BC format benchmarks just that format
+            if ( IsCompressed( settings.format ) && settings.format != tformat )
+                continue;
+
+            DWORD cflags = GetCompressFlags( settings, tformat );
+
+            // Repeat until enough time has passed for a stable figure on small images
+            HRESULT hr = S_OK;
+            LONGLONG ticks = 0;
+            size_t passes = 0;
+            while ( passes < 100 && ( !passes || TicksToMS( ticks ) < 250.0 ) )
             {
-            case DXGI_FORMAT_BC6H_TYPELESS:
-            case DXGI_FORMAT_BC6H_UF16:
-            case DXGI_FORMAT_BC6H_SF16:
-            case DXGI_FORMAT_BC7_TYPELESS:
-            case DXGI_FORMAT_BC7_UNORM:
-            case DXGI_FORMAT_BC7_UNORM_SRGB:
-                if ( !(dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
-                {
-                    cflags |= TEX_COMPRESS_PARALLEL;
-                }
-                break;
+                ScratchImage timage;
+
+                LONGLONG start = GetTicks();
+                hr = Compress( img, nimg, job.info, tformat, cflags, 0.5f, timage );
+                ticks += GetTicks() - start;
+
+                if ( FAILED(hr) )
+                    break;
+
+                ++passes;
             }
-#endif
 
-            hr = Compress( img, nimg, info, tformat, cflags, 0.5f, *timage );
+            wprintf( L"   %-16s", LookupByValue( tformat, g_pFormats ) );
+
             if ( FAILED(hr) )
             {
-                wprintf( L" FAILED [compress] (%x)\n", hr);
-                delete timage;
-                delete image;
+                wprintf( L" FAILED (%x)\n", hr );
                 continue;
             }
 
-            const TexMetadata& tinfo = timage->GetMetadata();
+            double ms = TicksToMS( ticks ) / double( passes );
+            wprintf( L" %9.2f MPix/s  %9.3f ms  (%Iu passes)\n", double( pixels ) / ( ms * 1000.0 ), ms, passes );
+        }
 
-            info.format = tinfo.format;
-            assert( info.width == tinfo.width );
-            assert( info.height == tinfo.height );
-            assert( info.depth == tinfo.depth );
-            assert( info.arraySize == tinfo.arraySize );
-            assert( info.mipLevels == tinfo.mipLevels );
-            assert( info.miscFlags == tinfo.miscFlags );
-            assert( info.miscFlags2 == tinfo.miscFlags2 );
-            assert( info.dimension == tinfo.dimension );
+        delete job.image;
+    }
+
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Batch conversion: load, convert, compress, and save run as a pipeline across files
+//--------------------------------------------------------------------------------------
+void InitQueue( SJobQueue& queue )
+{
+    InitializeCriticalSection( &queue.cs );
+    queue.hItems = CreateSemaphore( nullptr, 0, LONG_MAX, nullptr );
+    queue.pHead = queue.pTail = nullptr;
+}
+
+void DestroyQueue( SJobQueue& queue )
+{
+    if ( queue.hItems )
+        CloseHandle( queue.hItems );
+    DeleteCriticalSection( &queue.cs );
+}
+
+// A null job marks the end of the stream
+void PushJob( SJobQueue& queue, SJob* pJob )
+{
+    SJob* pEntry = pJob;
+    if ( !pEntry )
+    {
+        pEntry = &queue.sentinel;
+    }
+
+    pEntry->pNext = nullptr;
+
+    EnterCriticalSection( &queue.cs );
+    if ( queue.pTail )
+        queue.pTail->pNext = pEntry;
+    else
+        queue.pHead = pEntry;
+    queue.pTail = pEntry;
+    LeaveCriticalSection( &queue.cs );
+
+    ReleaseSemaphore( queue.hItems, 1, nullptr );
+}
 
-            delete image;
-            image = timage;
+SJob* PopJob( SJobQueue& queue )
+{
+    WaitForSingleObject( queue.hItems, INFINITE );
+
+    EnterCriticalSection( &queue.cs );
+    SJob* pJob = queue.pHead;
+    assert( pJob );
+    queue.pHead = pJob->pNext;
+    if ( !queue.pHead )
+        queue.pTail = nullptr;
+    LeaveCriticalSection( &queue.cs );
+
+    return ( pJob == &queue.sentinel ) ? nullptr : pJob;
+}
+
+// Batch output is written by the save stage so it stays in file order
+void PrintJob( const SJob& job, bool first )
+{
+    if ( !first )
+        wprintf( L"\n");
+
+    wprintf( L"reading %s", job.pConv->szSrc );
+
+    if ( job.stageFailed != STAGE_LOAD )
+    {
+        PrintInfo( job.srcInfo );
+        wprintf( L" as");
+
+        if ( job.pmalphawarn )
+            printf("WARNING: Image is already using premultiplied alpha\n");
+
+        if ( job.stageFailed > STAGE_COMPRESS )
+        {
+            PrintInfo( job.info );
+            wprintf( L"\n");
+            wprintf( L"writing %s", job.pConv->szDest);
+
+            if ( job.stageFailed == STAGE_MAX )
+                wprintf( L"\n");
         }
+    }
 
-        // --- Set alpha mode ----------------------------------------------------------
-        if ( HasAlpha( info.format )
-             && info.format != DXGI_FORMAT_A8_UNORM )
+    if ( FAILED( job.hr ) )
+        wprintf( L"%s", job.szError );
+
+    fflush(stdout);
+}
+
+unsigned __stdcall StageThreadProc( void* pContext )
+{
+    SStageThread* pThread = reinterpret_cast<SStageThread*>( pContext );
+    SPipeline* pPipeline = pThread->pPipeline;
+    STAGES stage = pThread->stage;
+
+    const SSettings& settings = *pPipeline->pSettings;
+
+    // Loading and saving through WIC needs COM on this thread
+    HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+    bool first = true;
+
+    for(;;)
+    {
+        LONGLONG start = GetTicks();
+        SJob* pJob = PopJob( pPipeline->queues[ stage ] );
+        pPipeline->qpcWait[ stage ] += GetTicks() - start;
+
+        if ( !pJob )
         {
-            if ( image->IsAlphaAllOpaque() )
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
-            }
-            else if ( info.IsPMAlpha() )
-            {
-                // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
-            }
-            else if ( dwOptions & (1 << OPT_SEPALPHA) )
+            if ( stage != STAGE_SAVE )
+                PushJob( pPipeline->queues[ stage + 1 ], nullptr );
+            break;
+        }
+
+        // Once a fatal error has been seen, remaining jobs drain through without further work
+        bool skipped = false;
+        if ( SUCCEEDED( pJob->hr ) )
+        {
+            if ( pPipeline->abort )
             {
-                info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
+                skipped = true;
             }
             else
             {
-                info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
+                if ( stage == STAGE_SAVE )
+                    MakeDestName( settings, pJob->pConv );
+
+                if ( FAILED( RunStage( stage, settings, *pJob ) ) && pJob->fatal )
+                {
+                    InterlockedExchange( &pPipeline->abort, 1 );
+                }
             }
         }
-        else
+
+        if ( stage != STAGE_SAVE )
         {
-            info.miscFlags2 &= ~TEX_MISC2_ALPHA_MODE_MASK;
+            PushJob( pPipeline->queues[ stage + 1 ], pJob );
+            continue;
         }
 
-        // --- Save result -------------------------------------------------------------
+        if ( !skipped )
         {
-            const Image* img = image->GetImage(0,0,0);
-            assert( img );
-            size_t nimg = image->GetImageCount();
+            PrintJob( *pJob, first );
+            first = false;
 
-            PrintInfo( info );
-            wprintf( L"\n");
+            pPipeline->nonpow2warn |= pJob->nonpow2warn;
+            ReportJob( pPipeline->pReport, *pJob );
+        }
 
-            // Figure out dest filename
-            WCHAR *pchSlash, *pchDot;
+        delete pJob->image;
+        delete pJob;
 
-            wcscpy_s(pConv->szDest, MAX_PATH, szPrefix);
+        ReleaseSemaphore( pPipeline->hSlots, 1, nullptr );
+    }
 
-            pchSlash = wcsrchr(pConv->szSrc, L'\\');
-            if(pchSlash != 0)
-                wcscat_s(pConv->szDest, MAX_PATH, pchSlash + 1);
-            else
-                wcscat_s(pConv->szDest, MAX_PATH, pConv->szSrc);
+    if ( SUCCEEDED(hrCOM) )
+        CoUninitialize();
 
-            pchSlash = wcsrchr(pConv->szDest, '\\');
-            pchDot = wcsrchr(pConv->szDest, '.');
+    return 0;
+}
 
-            if(pchDot > pchSlash)
-                *pchDot = 0;
+bool ConvertBatch( const SSettings& settings, SConversion* pConversion, size_t inflight, SReport* pReport, bool& nonpow2warn )
+{
+    SPipeline pipeline;
+    memset( &pipeline, 0, sizeof(SPipeline) );
+    pipeline.pSettings = &settings;
+    pipeline.pReport = pReport;
+
+    // Each image in flight holds a slot from load until its save completes, which bounds memory use
+    pipeline.hSlots = CreateSemaphore( nullptr, static_cast<LONG>( inflight ), static_cast<LONG>( inflight ), nullptr );
+    if ( !pipeline.hSlots )
+    {
+        wprintf( L"ERROR: Failed to create batch pipeline (%x)\n", HRESULT_FROM_WIN32( GetLastError() ) );
+        return false;
+    }
 
-            wcscat_s(pConv->szDest, MAX_PATH, szSuffix);
+    for( size_t stage = 0; stage < STAGE_MAX; ++stage )
+    {
+        InitQueue( pipeline.queues[ stage ] );
+    }
 
-            // Write texture
-            wprintf( L"writing %s", pConv->szDest);
-            fflush(stdout);
+    HANDLE hThreads[ STAGE_MAX ];
+    DWORD nThreads = 0;
 
-            switch( FileType )
-            {
-            case CODEC_DDS:
-                hr = SaveToDDSFile( img, nimg, info,
-                                    (dwOptions & (1 << OPT_USE_DX10) ) ? (DDS_FLAGS_FORCE_DX10_EXT|DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE, 
-                                    pConv->szDest );
-                break;
+    for( size_t stage = STAGE_CONVERT; stage < STAGE_MAX; ++stage )
+    {
+        pipeline.threads[ stage ].pPipeline = &pipeline;
+        pipeline.threads[ stage ].stage = static_cast<STAGES>( stage );
 
-            case CODEC_TGA:
-                hr = SaveToTGAFile( img[0], pConv->szDest );
-                break;
+        HANDLE hThread = reinterpret_cast<HANDLE>( _beginthreadex( nullptr, 0, StageThreadProc, &pipeline.threads[ stage ], 0, nullptr ) );
+        if ( !hThread )
+        {
+            wprintf( L"ERROR: Failed to create batch pipeline thread\n" );
+            pipeline.abort = 1;
+            break;
+        }
 
-            default:
-                hr = SaveToWICFile( img, nimg, WIC_FLAGS_ALL_FRAMES, GetWICCodec( static_cast<WICCodecs>(FileType) ), pConv->szDest );
-                break;
-            }
+        hThreads[ nThreads++ ] = hThread;
+    }
 
-            if(FAILED(hr))
-            {
-                wprintf( L" FAILED (%x)\n", hr);
-                delete image;
-                continue;
+    // The calling thread runs the load stage
+    for(SConversion *pConv = pConversion; pConv && !pipeline.abort; pConv = pConv->pNext)
+    {
+        LONGLONG start = GetTicks();
+        WaitForSingleObject( pipeline.hSlots, INFINITE );
+        pipeline.qpcWait[ STAGE_LOAD ] += GetTicks() - start;
+
+        if ( pipeline.abort )
+            break;
+
+        SJob* pJob = new (std::nothrow) SJob;
+        if ( !pJob )
+        {
+            wprintf( L"ERROR: Memory allocation failed\n" );
+            pipeline.abort = 1;
+            break;
+        }
+
+        InitJob( *pJob, pConv );
+
+        if ( FAILED( RunStage( STAGE_LOAD, settings, *pJob ) ) && pJob->fatal )
+        {
+            InterlockedExchange( &pipeline.abort, 1 );
+        }
+
+        PushJob( pipeline.queues[ STAGE_CONVERT ], pJob );
+    }
+
+    PushJob( pipeline.queues[ STAGE_CONVERT ], nullptr );
+
+    if ( nThreads > 0 )
+    {
+        WaitForMultipleObjects( nThreads, hThreads, TRUE, INFINITE );
+
+        for( DWORD j = 0; j < nThreads; ++j )
+            CloseHandle( hThreads[ j ] );
+    }
+
+    for( size_t stage = 0; stage < STAGE_MAX; ++stage )
+    {
+        if ( pReport )
+            pReport->qpcWait[ stage ] = pipeline.qpcWait[ stage ];
+
+        DestroyQueue( pipeline.queues[ stage ] );
+    }
+
+    CloseHandle( pipeline.hSlots );
+
+    nonpow2warn |= pipeline.nonpow2warn;
+
+    return !pipeline.abort;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters and defaults
+    HRESULT hr;
+    INT nReturn;
+
+    size_t width = 0;
+    size_t height = 0; 
+    size_t mipLevels = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    DWORD dwFilter = TEX_FILTER_DEFAULT;
+    DWORD dwSRGB = 0;
+    DWORD dwFilterOpts = 0;
+    DWORD dwCompress = TEX_COMPRESS_DEFAULT;
+    DWORD FileType = CODEC_DDS;
+
+    size_t inflight = 0;
+
+    WCHAR szPrefix   [MAX_PATH];
+    WCHAR szSuffix   [MAX_PATH];
+    WCHAR szOutputDir[MAX_PATH];
+    WCHAR szTiming   [MAX_PATH];
+
+    szPrefix[0]    = 0;
+    szSuffix[0]    = 0;
+    szOutputDir[0] = 0;
+    szTiming[0]    = 0;
+
+    // Initialize COM (needed for WIC)
+    if( FAILED( hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED) ) )
+    {
+        wprintf( L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    // Process command line
+    DWORD dwOptions = 0;
+    SConversion *pConversion = nullptr;
+    SConversion **ppConversion = &pConversion;
+
+    for(int iArg = 1; iArg < argc; iArg++)
+    {
+        PWSTR pArg = argv[iArg];
+
+        if(('-' == pArg[0]) || ('/' == pArg[0]))
+        {
+            pArg++;
+            PWSTR pValue;
+
+            for(pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+            if(*pValue)
+                *pValue++ = 0;
+
+            DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+            if(!dwOption || (dwOptions & (1u << dwOption)))
+            {
+                PrintUsage();
+                return 1;
             }
-            wprintf( L"\n");
+
+            dwOptions |= 1u << dwOption;
+
+            if( (OPT_NOLOGO != dwOption) && (OPT_TYPELESS_UNORM != dwOption) && (OPT_TYPELESS_FLOAT != dwOption)
+                && (OPT_SEPALPHA != dwOption) && (OPT_PREMUL_ALPHA != dwOption) && (OPT_EXPAND_LUMINANCE != dwOption)
+                && (OPT_TA_WRAP != dwOption) && (OPT_TA_MIRROR != dwOption)
+                && (OPT_FORCE_SINGLEPROC != dwOption)
+                && (OPT_SRGB != dwOption) && (OPT_SRGBI != dwOption) && (OPT_SRGBO != dwOption)
+                && (OPT_HFLIP != dwOption) && (OPT_VFLIP != dwOption)
+                && (OPT_DDS_DWORD_ALIGN != dwOption) && (OPT_USE_DX10 != dwOption)
+                && (OPT_BENCHMARK != dwOption) && (OPT_TGA_RLE != dwOption) )
+            {
+                if(!*pValue)
+                {
+                    if((iArg + 1 >= argc))
+                    {
+                        PrintUsage();
+                        return 1;
+                    }
+
+                    iArg++;
+                    pValue = argv[iArg];
+                }
+            }
+
+            switch(dwOption)
+            {
+            case OPT_WIDTH:
+                if (swscanf_s(pValue, L"%Iu", &width) != 1)
+                {
+                    wprintf( L"Invalid value specified with -w (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_HEIGHT:
+                if (swscanf_s(pValue, L"%Iu", &height) != 1)
+                {
+                    wprintf( L"Invalid value specified with -h (%s)\n", pValue);
+                    printf("\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_MIPLEVELS:
+                if (swscanf_s(pValue, L"%Iu", &mipLevels) != 1)
+                {
+                    wprintf( L"Invalid value specified with -m (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_FORMAT:
+                format = (DXGI_FORMAT) LookupByName(pValue, g_pFormats);
+                if ( !format )
+                {
+                    wprintf( L"Invalid value specified with -f (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_FILTER:
+                dwFilter = LookupByName(pValue, g_pFilters);
+                if ( !dwFilter )
+                {
+                    wprintf( L"Invalid value specified with -if (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_SRGBI:
+                dwSRGB |= TEX_FILTER_SRGB_IN;
+                break;
+
+            case OPT_SRGBO:
+                dwSRGB |= TEX_FILTER_SRGB_OUT;
+                break;
+
+            case OPT_SRGB:
+                dwSRGB |= TEX_FILTER_SRGB;
+                break;
+
+            case OPT_SEPALPHA:
+                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
+                break;
+
+            case OPT_PREFIX:
+                wcscpy_s(szPrefix, MAX_PATH, pValue);
+                break;
+
+            case OPT_SUFFIX:
+                wcscpy_s(szSuffix, MAX_PATH, pValue);
+                break;
+
+            case OPT_OUTPUTDIR:
+                wcscpy_s(szOutputDir, MAX_PATH, pValue);
+                break;
+
+            case OPT_FILETYPE:
+                FileType = LookupByName(pValue, g_pSaveFileTypes);
+                if ( !FileType )
+                {
+                    wprintf( L"Invalid value specified with -ft (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_TA_WRAP:
+                if ( dwFilterOpts & TEX_FILTER_MIRROR )
+                {
+                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_WRAP;
+                break;
+
+            case OPT_TA_MIRROR:
+                if ( dwFilterOpts & TEX_FILTER_WRAP )
+                {
+                    wprintf( L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_MIRROR;
+                break;
+
+            case OPT_THREADS:
+                {
+                    int threads = 0;
+                    if ( swscanf_s(pValue, L"%d", &threads) != 1 || threads < 1 )
+                    {
+                        wprintf( L"Invalid value specified with -threads (%s)\n", pValue);
+                        wprintf( L"\n");
+                        PrintUsage();
+                        return 1;
+                    }
+#ifdef _OPENMP
+                    omp_set_num_threads( threads );
+#endif
+                }
+                break;
+
+            case OPT_BATCH:
+                if ( swscanf_s(pValue, L"%Iu", &inflight) != 1 || !inflight || inflight > 1024 )
+                {
+                    wprintf( L"Invalid value specified with -batch (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_TIMING:
+                wcscpy_s(szTiming, MAX_PATH, pValue);
+                break;
+
+            case OPT_BC_QUALITY:
+                dwCompress = LookupByName(pValue, g_pBCQuality);
+                if ( !dwCompress )
+                {
+                    wprintf( L"Invalid value specified with -bcq (%s)\n", pValue);
+                    wprintf( L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+            }
+        }
+        else
+        {         
+            SConversion *pConv = new SConversion;
+            if ( !pConv )
+                return 1;
+
+            wcscpy_s(pConv->szSrc, MAX_PATH, pArg);
+
+            pConv->szDest[0] = 0;
+            pConv->pNext = nullptr;
+
+            *ppConversion = pConv;
+            ppConversion = &pConv->pNext;
+        }
+    }
+
+    if(!pConversion)
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    if(~dwOptions & (1 << OPT_NOLOGO))
+        PrintLogo();
+
+#ifdef _OPENMP
+    // Resize and mipmap generation split large images into bands of rows across threads
+    if ( !(dwOptions & (1 << OPT_FORCE_SINGLEPROC) ) )
+    {
+        dwFilterOpts |= TEX_FILTER_PARALLEL;
+    }
+#endif
+
+    // Work out out filename prefix and suffix
+    if(szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
+        wcscat_s( szOutputDir, MAX_PATH, L"\\" );
+
+    if(szPrefix[0])
+        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
+
+    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
+
+    const WCHAR* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
+
+    if (fileTypeName)
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".");
+        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
+    }
+    else
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".unknown");
+    }
+
+    if (FileType != CODEC_DDS)
+    {
+        mipLevels = 1;
+    }
+
+    SSettings settings = { width, height, mipLevels, format, dwFilter, dwSRGB, dwFilterOpts, dwCompress, FileType, dwOptions, szPrefix, szSuffix };
+
+    SReport report;
+    SReport *pReport = nullptr;
+    bool nonpow2warn = false;
+    bool success;
+
+    if ( szTiming[0] )
+    {
+        if ( !BeginReport( report, szTiming ) )
+        {
+            wprintf( L"ERROR: Failed to create timing report %s\n", szTiming );
+            goto LError;
         }
+        pReport = &report;
+    }
 
-        delete image;
+    // Convert images
+    if ( dwOptions & (1 << OPT_BENCHMARK) )
+    {
+        success = BenchmarkCompress( settings, pConversion );
     }
+    else
+    {
+        success = ( inflight > 0 ) ? ConvertBatch( settings, pConversion, inflight, pReport, nonpow2warn )
+                                   : ConvertSerial( settings, pConversion, pReport, nonpow2warn );
+    }
+
+    if ( pReport )
+        EndReport( report, inflight );
+
+    if ( !success )
+        goto LError;
 
     if ( nonpow2warn )
         wprintf( L"\n WARNING: Not all feature levels support non-power-of-2 textures with mipmaps\n" );
@@ -1235,7 +2118,7 @@ LDone:
 
     while(pConversion)
     {
-        pConv = pConversion;
+        SConversion *pConv = pConversion;
         pConversion = pConversion->pNext;
         delete pConv;
     }
@@ -0,0 +1,59 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    backingStore.h
+
+Abstract:
+
+    The interface between the RegFS provider and the namespace it projects.
+
+    RegfsProvider turns ProjFS callbacks into calls on a BackingStore, so the same provider can project
+    anything that can answer three questions: what is at a path, what is in a directory, and what are
+    the contents of a file.  RegistryStore projects the registry; DirTreeStore projects a tree of
+    directories and files held in memory.
+
+    Paths are relative to the virtualization root, with '\' between components, and the root itself
+    is "" or "\".  ProjFS may call the provider on several threads at once, so a store must be safe to
+    call concurrently.
+
+--*/
+
+#pragma once
+
+namespace regfs {
+
+class BackingStore {
+
+public:
+
+    virtual ~BackingStore() = default;
+
+    // Finds out whether the given path exists, and whether it is a directory or a file.  Returns
+    // HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if it does not exist.
+    virtual HRESULT GetEntry(
+        _In_    const std::wstring& path,
+        _Out_   bool&               isDirectory,
+        _Out_   INT64&              fileSize
+    ) = 0;
+
+    // Adds an entry to dirInfo for each child of the directory at the given path whose name matches
+    // searchExpression, and marks dirInfo filled, with the entries in PrjFileNameCompare order.
+    virtual HRESULT FillDirInfo(
+        _In_    const std::wstring& path,
+        _In_    DirInfo*            dirInfo,
+        _In_    const std::wstring& searchExpression
+    ) = 0;
+
+    // Reads length bytes of the file at the given path, starting at byteOffset, into buffer.
+    virtual HRESULT ReadFile(
+        _In_    const std::wstring& path,
+        _In_    UINT64              byteOffset,
+        _In_    UINT32              length,
+        _Out_   PBYTE               buffer
+    ) = 0;
+};
+
+}
@@ -87,6 +87,11 @@ void DirInfo::FillItemEntry(LPCWSTR FileName, INT64 FileSize, bool IsDirectory)
     _entries.push_back(entry);
 }
 
+void DirInfo::MarkFilled()
+{
+    _entriesFilled = true;
+}
+
 void DirInfo::SortEntriesAndMarkFilled()
 {
     _entriesFilled = true;
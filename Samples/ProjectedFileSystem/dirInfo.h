@@ -51,6 +51,9 @@ public:
     // Sorts the entries in the DirInfo object and marks the object as being fully populated.
     void SortEntriesAndMarkFilled();
 
+    // Marks the object as being fully populated, for entries that were added in sorted order.
+    void MarkFilled();
+
     // Returns true if the DirInfo object has been populated with entries.
     bool EntriesFilled();
 
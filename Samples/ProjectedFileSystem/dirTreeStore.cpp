@@ -0,0 +1,296 @@
+#include "stdafx.h"
+
+using namespace regfs;
+
+//////////////////////////////////////////////////////////////////////////
+// See dirTreeStore.h for descriptions of the routines in this module.
+//////////////////////////////////////////////////////////////////////////
+
+// A 64-bit FNV-1a hash of a blob's contents.
+UINT64 HashContents(const BYTE* data, size_t size)
+{
+    UINT64 hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Returns the position of the child of directory with the given name, or where it would go.
+std::vector<std::unique_ptr<TreeNode>>::iterator LowerBound(TreeNode& directory, const std::wstring& name)
+{
+    return std::lower_bound(directory.Children.begin(),
+                            directory.Children.end(),
+                            name,
+                            [](const std::unique_ptr<TreeNode>& child, const std::wstring& name)
+                            {
+                                return PrjFileNameCompare(child->Name.c_str(), name.c_str()) < 0;
+                            });
+}
+
+DirTreeStore::DirTreeStore() :
+    _root(std::make_unique<TreeNode>())
+{
+    _root->IsDirectory = true;
+}
+
+HRESULT DirTreeStore::AddDirectory(const std::wstring& path)
+{
+    AcquireSRWLockExclusive(&_lock);
+    TreeNode* directory = AddDirectoryNode(path);
+    ReleaseSRWLockExclusive(&_lock);
+
+    return directory != nullptr ? S_OK : HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+}
+
+HRESULT DirTreeStore::AddFile(const std::wstring& path, const BYTE* data, size_t size)
+{
+    std::wstring parentPath;
+    std::wstring name = PathUtils::GetLastComponent(path, parentPath);
+    if (name.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+
+    AcquireSRWLockExclusive(&_lock);
+
+    TreeNode* directory = AddDirectoryNode(parentPath);
+    if (directory != nullptr)
+    {
+        TreeNode* file = FindOrAddChild(*directory, name, false);
+        if (!file->IsDirectory)
+        {
+            file->Data = InternBlob(data, size);
+            hr = S_OK;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&_lock);
+
+    return hr;
+}
+
+DirTreeStore::Statistics DirTreeStore::GetStatistics()
+{
+    Statistics statistics = {};
+
+    AcquireSRWLockShared(&_lock);
+
+    // Walk the tree with an explicit stack, so that a deep tree cannot overflow the thread's stack.
+    std::vector<const TreeNode*> pending;
+    pending.push_back(_root.get());
+    while (!pending.empty())
+    {
+        const TreeNode* directory = pending.back();
+        pending.pop_back();
+        statistics.Directories++;
+
+        for (auto& child : directory->Children)
+        {
+            if (child->IsDirectory)
+            {
+                pending.push_back(child.get());
+            }
+            else
+            {
+                statistics.Files++;
+                statistics.FileBytes += child->Data->size();
+            }
+        }
+    }
+
+    for (auto& blob : _blobs)
+    {
+        statistics.Blobs++;
+        statistics.BlobBytes += blob.second->size();
+    }
+
+    ReleaseSRWLockShared(&_lock);
+
+    // The root is not a directory in the projection.
+    statistics.Directories--;
+    return statistics;
+}
+
+HRESULT DirTreeStore::GetEntry(
+    _In_    const std::wstring& path,
+    _Out_   bool&               isDirectory,
+    _Out_   INT64&              fileSize
+)
+{
+    HRESULT hr = S_OK;
+    isDirectory = false;
+    fileSize = 0;
+
+    AcquireSRWLockShared(&_lock);
+
+    TreeNode* node = FindNode(path);
+    if (node == nullptr)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    else
+    {
+        isDirectory = node->IsDirectory;
+        fileSize = node->IsDirectory ? 0 : static_cast<INT64>(node->Data->size());
+    }
+
+    ReleaseSRWLockShared(&_lock);
+
+    return hr;
+}
+
+HRESULT DirTreeStore::FillDirInfo(
+    _In_    const std::wstring& path,
+    _In_    DirInfo*            dirInfo,
+    _In_    const std::wstring& searchExpression
+)
+{
+    HRESULT hr = S_OK;
+
+    AcquireSRWLockShared(&_lock);
+
+    TreeNode* directory = FindNode(path);
+    if (directory == nullptr || !directory->IsDirectory)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    else
+    {
+        for (auto& child : directory->Children)
+        {
+            if (PrjFileNameMatch(child->Name.c_str(), searchExpression.c_str()))
+            {
+                if (child->IsDirectory)
+                {
+                    dirInfo->FillDirEntry(child->Name.c_str());
+                }
+                else
+                {
+                    dirInfo->FillFileEntry(child->Name.c_str(), static_cast<INT64>(child->Data->size()));
+                }
+            }
+        }
+
+        // The children are sorted already.
+        dirInfo->MarkFilled();
+    }
+
+    ReleaseSRWLockShared(&_lock);
+
+    return hr;
+}
+
+HRESULT DirTreeStore::ReadFile(
+    _In_    const std::wstring& path,
+    _In_    UINT64              byteOffset,
+    _In_    UINT32              length,
+    _Out_   PBYTE               buffer
+)
+{
+    // Take a reference to the blob, so that it can be copied from without holding the lock.
+    std::shared_ptr<const Blob> data;
+
+    AcquireSRWLockShared(&_lock);
+    TreeNode* file = FindNode(path);
+    if (file != nullptr && !file->IsDirectory)
+    {
+        data = file->Data;
+    }
+    ReleaseSRWLockShared(&_lock);
+
+    if (data == nullptr)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    if (byteOffset > data->size() || length > data->size() - byteOffset)
+    {
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    if (length != 0)
+    {
+        memcpy(buffer, data->data() + byteOffset, length);
+    }
+    return S_OK;
+}
+
+TreeNode* DirTreeStore::FindNode(const std::wstring& path)
+{
+    TreeNode* node = _root.get();
+    PathUtils::ForEachComponent(path, [&](const std::wstring& name, const std::wstring&)
+    {
+        if (!node->IsDirectory)
+        {
+            node = nullptr;
+            return false;
+        }
+
+        auto it = LowerBound(*node, name);
+        if (it == node->Children.end() ||
+            PrjFileNameCompare((*it)->Name.c_str(), name.c_str()) != 0)
+        {
+            node = nullptr;
+            return false;
+        }
+
+        node = it->get();
+        return true;
+    });
+    return node;
+}
+
+TreeNode* DirTreeStore::AddDirectoryNode(const std::wstring& path)
+{
+    TreeNode* directory = _root.get();
+    PathUtils::ForEachComponent(path, [&](const std::wstring& name, const std::wstring&)
+    {
+        directory = FindOrAddChild(*directory, name, true);
+        if (!directory->IsDirectory)
+        {
+            directory = nullptr;
+            return false;
+        }
+        return true;
+    });
+    return directory;
+}
+
+TreeNode* DirTreeStore::FindOrAddChild(TreeNode& directory, const std::wstring& name, bool isDirectory)
+{
+    auto it = LowerBound(directory, name);
+    if (it != directory.Children.end() &&
+        PrjFileNameCompare((*it)->Name.c_str(), name.c_str()) == 0)
+    {
+        return it->get();
+    }
+
+    auto child = std::make_unique<TreeNode>();
+    child->Name = name;
+    child->IsDirectory = isDirectory;
+    return directory.Children.insert(it, std::move(child))->get();
+}
+
+std::shared_ptr<const Blob> DirTreeStore::InternBlob(const BYTE* data, size_t size)
+{
+    const UINT64 hash = HashContents(data, size);
+
+    auto range = _blobs.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->size() == size &&
+            (size == 0 || memcmp(it->second->data(), data, size) == 0))
+        {
+            return it->second;
+        }
+    }
+
+    std::shared_ptr<const Blob> blob = std::make_shared<Blob>(data, data + size);
+    _blobs.emplace(hash, blob);
+    return blob;
+}
@@ -0,0 +1,113 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    dirTreeStore.h
+
+Abstract:
+
+    A backing store that projects a tree of directories and files held in memory.
+
+    The tree is built up front with AddDirectory and AddFile, and can be added to while it is being
+    projected.  Each directory keeps its children sorted in PrjFileNameCompare order, so a lookup is
+    a binary search at each level and an enumeration needs no sorting.
+
+    File contents are kept as blobs, and files with identical contents share one blob, the way a
+    source control system stores them.  Blobs are kept for as long as the store is.
+
+    The store only uses the standard library and the ProjFS name comparison routines, so it can be
+    built and driven without ProjFS; see harness\regfsHarness.cpp.
+
+--*/
+
+#pragma once
+
+namespace regfs {
+
+typedef std::vector<BYTE> Blob;
+
+// A directory or file in the tree.
+struct TreeNode {
+    std::wstring Name;
+    bool IsDirectory;
+
+    // Files only.
+    std::shared_ptr<const Blob> Data;
+
+    // Directories only.  In PrjFileNameCompare order.
+    std::vector<std::unique_ptr<TreeNode>> Children;
+};
+
+class DirTreeStore : public BackingStore {
+
+public:
+
+    DirTreeStore();
+    DirTreeStore(const DirTreeStore&) = delete;
+    DirTreeStore& operator=(const DirTreeStore&) = delete;
+
+    // Adds a directory, and any directories above it that are not there yet.  Returns
+    // HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) if there is a file on the way.
+    HRESULT AddDirectory(const std::wstring& path);
+
+    // Adds a file with the given contents, or replaces the contents of the file if it is there already,
+    // adding any directories above it that are not there yet.  Returns
+    // HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) if there is a directory at the path or a file on the way.
+    HRESULT AddFile(const std::wstring& path, const BYTE* data, size_t size);
+
+    struct Statistics {
+        UINT64 Directories;
+        UINT64 Files;
+        UINT64 FileBytes;     // The total size of all the files.
+        UINT64 Blobs;
+        UINT64 BlobBytes;     // The memory the contents take, once identical contents are shared.
+    };
+
+    Statistics GetStatistics();
+
+    HRESULT GetEntry(
+        _In_    const std::wstring& path,
+        _Out_   bool&               isDirectory,
+        _Out_   INT64&              fileSize
+    ) override;
+
+    HRESULT FillDirInfo(
+        _In_    const std::wstring& path,
+        _In_    DirInfo*            dirInfo,
+        _In_    const std::wstring& searchExpression
+    ) override;
+
+    HRESULT ReadFile(
+        _In_    const std::wstring& path,
+        _In_    UINT64              byteOffset,
+        _In_    UINT32              length,
+        _Out_   PBYTE               buffer
+    ) override;
+
+private:
+
+    // Returns the node at the given path, or nullptr.  Must be called with the lock held.
+    TreeNode* FindNode(const std::wstring& path);
+
+    // Returns the directory at the given path, adding it and any directories above it that are not
+    // there yet, or nullptr if there is a file on the way.  Must be called with the lock held exclusive.
+    TreeNode* AddDirectoryNode(const std::wstring& path);
+
+    // Returns the child of directory with the given name, adding it if it is not there yet.
+    static TreeNode* FindOrAddChild(TreeNode& directory, const std::wstring& name, bool isDirectory);
+
+    // Returns the blob with the given contents, adding one if there is none yet.  Must be called with
+    // the lock held exclusive.
+    std::shared_ptr<const Blob> InternBlob(const BYTE* data, size_t size);
+
+    // Guards the tree and the blobs.  Lookups take it shared; adding to the tree takes it exclusive.
+    SRWLOCK _lock = SRWLOCK_INIT;
+    std::unique_ptr<TreeNode> _root;
+
+    // The blobs, by a hash of their contents.
+    std::unordered_multimap<UINT64, std::shared_ptr<const Blob>> _blobs;
+};
+
+}
@@ -0,0 +1,305 @@
+#include "../stdafx.h"
+
+#include <chrono>
+#include <cstdlib>
+
+//////////////////////////////////////////////////////////////////////////
+// See projfsShim.h for descriptions of the routines in this module.
+//////////////////////////////////////////////////////////////////////////
+
+// The instance PrjStartVirtualizing started last.
+static shim::Instance g_instance;
+static bool g_started = false;
+
+// Where the provider's output for the callback running on this thread goes.
+static thread_local shim::CallbackOutput* t_output = nullptr;
+
+// The per-entry overhead ProjFS's directory entry buffer has, which is that of
+// FILE_ID_BOTH_DIR_INFORMATION.
+constexpr size_t DirEntryHeaderSize = 104;
+
+UINT64 HashBytes(UINT64 hash, const BYTE* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+WCHAR FoldCase(WCHAR c)
+{
+    return static_cast<WCHAR>(towupper(static_cast<wint_t>(c)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Windows routines.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+    counter->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+    frequency->QuadPart = 1000000000;
+    return TRUE;
+}
+
+DWORD GetLastError()
+{
+    return ERROR_SUCCESS;
+}
+
+// The virtualization root always appears to be new, so VirtualizationInstance stamps it with an ID
+// and marks it as a placeholder.
+BOOL CreateDirectory(LPCWSTR, void*)
+{
+    return TRUE;
+}
+
+BOOL RemoveDirectory(LPCWSTR)
+{
+    return TRUE;
+}
+
+BOOL DeleteFile(LPCWSTR)
+{
+    return TRUE;
+}
+
+HANDLE CreateFile2(LPCWSTR, DWORD, DWORD, DWORD, void*)
+{
+    static int file;
+    return &file;
+}
+
+BOOL ReadFile(HANDLE, LPVOID buffer, DWORD length, LPDWORD bytesRead, void*)
+{
+    memset(buffer, 0, length);
+    *bytesRead = length;
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE, LPCVOID, DWORD length, LPDWORD bytesWritten, void*)
+{
+    *bytesWritten = length;
+    return TRUE;
+}
+
+BOOL CloseHandle(HANDLE)
+{
+    return TRUE;
+}
+
+HRESULT CoCreateGuid(GUID* guid)
+{
+    static std::atomic<uint32_t> next{ 1 };
+    *guid = {};
+    guid->Data1 = next++;
+    return S_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// ProjFS routines.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+HRESULT PrjStartVirtualizing(PCWSTR,
+                             const PRJ_CALLBACKS* callbacks,
+                             const void* instanceContext,
+                             const PRJ_STARTVIRTUALIZING_OPTIONS*,
+                             PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT* namespaceVirtualizationContext)
+{
+    g_instance.Callbacks = *callbacks;
+    g_instance.InstanceContext = const_cast<void*>(instanceContext);
+    g_instance.WriteAlignment = 4096;
+    g_instance.Running = true;
+    g_started = true;
+
+    *namespaceVirtualizationContext = reinterpret_cast<PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT>(&g_instance);
+    return S_OK;
+}
+
+void PrjStopVirtualizing(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext)
+{
+    reinterpret_cast<shim::Instance*>(namespaceVirtualizationContext)->Running = false;
+}
+
+HRESULT PrjMarkDirectoryAsPlaceholder(PCWSTR, PCWSTR, const PRJ_PLACEHOLDER_VERSION_INFO*, const GUID*)
+{
+    return S_OK;
+}
+
+HRESULT PrjGetVirtualizationInstanceInfo(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                                         PRJ_VIRTUALIZATION_INSTANCE_INFO* virtualizationInstanceInfo)
+{
+    if (namespaceVirtualizationContext == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *virtualizationInstanceInfo = {};
+    virtualizationInstanceInfo->WriteAlignment =
+        reinterpret_cast<shim::Instance*>(namespaceVirtualizationContext)->WriteAlignment;
+    return S_OK;
+}
+
+HRESULT PrjWritePlaceholderInfo(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                                PCWSTR,
+                                const PRJ_PLACEHOLDER_INFO* placeholderInfo,
+                                UINT32 placeholderInfoSize)
+{
+    if (namespaceVirtualizationContext == nullptr || placeholderInfoSize < sizeof(PRJ_PLACEHOLDER_INFO))
+    {
+        return E_INVALIDARG;
+    }
+
+    if (t_output != nullptr)
+    {
+        t_output->PlaceholderWritten = true;
+        t_output->Placeholder = *placeholderInfo;
+    }
+    return S_OK;
+}
+
+HRESULT PrjWriteFileData(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                         const GUID*,
+                         void* buffer,
+                         UINT64,
+                         UINT32 length)
+{
+    if (namespaceVirtualizationContext == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (t_output != nullptr)
+    {
+        t_output->DataWritten += length;
+        t_output->DataHash = HashBytes(t_output->DataHash, static_cast<const BYTE*>(buffer), length);
+    }
+    return S_OK;
+}
+
+void* PrjAllocateAlignedBuffer(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext, size_t size)
+{
+    // aligned_alloc wants a whole number of alignment units, and at least one.
+    const size_t alignment = reinterpret_cast<shim::Instance*>(namespaceVirtualizationContext)->WriteAlignment;
+    return aligned_alloc(alignment, (std::max)((size + alignment - 1) / alignment, size_t(1)) * alignment);
+}
+
+void PrjFreeAlignedBuffer(void* buffer)
+{
+    free(buffer);
+}
+
+HRESULT PrjFillDirEntryBuffer(PCWSTR fileName,
+                              PRJ_FILE_BASIC_INFO* fileBasicInfo,
+                              PRJ_DIR_ENTRY_BUFFER_HANDLE dirEntryBufferHandle)
+{
+    auto buffer = reinterpret_cast<shim::DirEntryBuffer*>(dirEntryBufferHandle);
+
+    // Names take two bytes a character in ProjFS's buffer, and entries are 8-byte aligned.
+    const size_t entrySize = (DirEntryHeaderSize + wcslen(fileName) * 2 + 7) & ~size_t(7);
+    if (buffer->Used + entrySize > buffer->Capacity)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+    }
+
+    buffer->Used += entrySize;
+    buffer->Entries.push_back({ fileName, *fileBasicInfo });
+    return S_OK;
+}
+
+int PrjFileNameCompare(PCWSTR fileName1, PCWSTR fileName2)
+{
+    for (;; fileName1++, fileName2++)
+    {
+        const WCHAR c1 = FoldCase(*fileName1);
+        const WCHAR c2 = FoldCase(*fileName2);
+        if (c1 != c2)
+        {
+            return c1 < c2 ? -1 : 1;
+        }
+        if (c1 == L'\0')
+        {
+            return 0;
+        }
+    }
+}
+
+BOOLEAN PrjFileNameMatch(PCWSTR fileNameToCheck, PCWSTR pattern)
+{
+    if (pattern == nullptr || *pattern == L'\0')
+    {
+        return TRUE;
+    }
+
+    // Match with backtracking to the last '*'.  The DOS wildcards '<', '>' and '"' are treated as
+    // '*', '?' and '.'.
+    PCWSTR name = fileNameToCheck;
+    PCWSTR starPattern = nullptr;
+    PCWSTR starName = nullptr;
+
+    while (*name != L'\0')
+    {
+        WCHAR p = *pattern;
+        if (p == L'<')
+        {
+            p = L'*';
+        }
+        else if (p == L'>')
+        {
+            p = L'?';
+        }
+        else if (p == L'"')
+        {
+            p = L'.';
+        }
+
+        if (p == L'*')
+        {
+            starPattern = ++pattern;
+            starName = name;
+        }
+        else if (p != L'\0' && (p == L'?' || FoldCase(p) == FoldCase(*name)))
+        {
+            pattern++;
+            name++;
+        }
+        else if (starPattern != nullptr)
+        {
+            pattern = starPattern;
+            name = ++starName;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    while (*pattern == L'*' || *pattern == L'<')
+    {
+        pattern++;
+    }
+
+    return *pattern == L'\0';
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Harness routines.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+shim::Instance* shim::GetInstance()
+{
+    return g_started ? &g_instance : nullptr;
+}
+
+void shim::SetCallbackOutput(CallbackOutput* output)
+{
+    t_output = output;
+}
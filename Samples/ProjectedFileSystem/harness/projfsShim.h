@@ -0,0 +1,367 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    projfsShim.h
+
+Abstract:
+
+    Stand-ins for the parts of the Windows SDK and the ProjFS API that the RegFS provider framework
+    uses, so that RegfsProvider, VirtualizationInstance, DirInfo and DirTreeStore can be built on a
+    machine without ProjFS, and their callbacks driven by regfsHarness.cpp.
+
+    PrjStartVirtualizing does not start anything: it records the callbacks the provider registers, so
+    that the harness can call them the way ProjFS would.  What the provider sends back through
+    PrjWritePlaceholderInfo, PrjWriteFileData and PrjFillDirEntryBuffer is captured for the harness to
+    check.  The Win32 calls VirtualizationInstance makes to set up the virtualization root succeed
+    without touching the disk.
+
+    PrjFileNameCompare and PrjFileNameMatch compare names case-insensitively, character by character,
+    which is close enough to what ProjFS does for the names the harness uses.
+
+--*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Windows types, macros and error codes.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef int32_t HRESULT;
+typedef int32_t LONG;
+typedef int32_t INT32;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef uint32_t UINT32;
+typedef int64_t INT64;
+typedef int64_t LONGLONG;
+typedef uint64_t UINT64;
+typedef uint64_t ULONGLONG;
+typedef uint8_t BYTE;
+typedef uint8_t UINT8;
+typedef BYTE* PBYTE;
+typedef BYTE BOOLEAN;
+typedef int BOOL;
+typedef wchar_t WCHAR;
+typedef WCHAR* PWSTR;
+typedef const WCHAR* PCWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef void* HANDLE;
+typedef DWORD* LPDWORD;
+
+struct GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+typedef const GUID* LPCGUID;
+
+struct LARGE_INTEGER {
+    LONGLONG QuadPart;
+};
+
+#define TRUE    1
+#define FALSE   0
+#define MAX_PATH 260
+#define MAXDWORD 0xffffffffu
+#define CALLBACK
+
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+
+#define S_OK            ((HRESULT)0)
+#define E_FAIL          ((HRESULT)0x80004005)
+#define E_INVALIDARG    ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000E)
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+
+#define ERROR_SUCCESS               0u
+#define ERROR_FILE_NOT_FOUND        2u
+#define ERROR_PATH_NOT_FOUND        3u
+#define ERROR_ACCESS_DENIED         5u
+#define ERROR_HANDLE_EOF            38u
+#define ERROR_INSUFFICIENT_BUFFER   122u
+#define ERROR_ALREADY_EXISTS        183u
+#define ERROR_RETRY                 1237u
+#define ERROR_BAD_CONFIGURATION     1610u
+
+#define STATUS_CANNOT_DELETE        ((LONG)0xC0000121)
+
+inline HRESULT HRESULT_FROM_WIN32(DWORD error)
+{
+    return error == 0 ? S_OK : static_cast<HRESULT>((error & 0x0000FFFF) | 0x80070000);
+}
+
+#define HRESULT_FROM_NT(status) ((HRESULT)((status) | 0x10000000))
+
+#define DEFINE_ENUM_FLAG_OPERATORS(ENUMTYPE)                                                          \
+    inline ENUMTYPE operator|(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(int(a) | int(b)); }           \
+    inline ENUMTYPE operator&(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(int(a) & int(b)); }           \
+    inline ENUMTYPE& operator|=(ENUMTYPE& a, ENUMTYPE b) { return a = a | b; }                        \
+    inline ENUMTYPE& operator&=(ENUMTYPE& a, ENUMTYPE b) { return a = a & b; }                        \
+    inline ENUMTYPE operator~(ENUMTYPE a) { return ENUMTYPE(~int(a)); }
+
+// Slim reader/writer locks.
+struct SRWLOCK {
+    std::shared_timed_mutex Mutex;
+};
+#define SRWLOCK_INIT {}
+
+inline void AcquireSRWLockShared(SRWLOCK* lock) { lock->Mutex.lock_shared(); }
+inline void ReleaseSRWLockShared(SRWLOCK* lock) { lock->Mutex.unlock_shared(); }
+inline void AcquireSRWLockExclusive(SRWLOCK* lock) { lock->Mutex.lock(); }
+inline void ReleaseSRWLockExclusive(SRWLOCK* lock) { lock->Mutex.unlock(); }
+
+// The performance counter counts nanoseconds.
+BOOL QueryPerformanceCounter(LARGE_INTEGER* counter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency);
+
+// What VirtualizationInstance::EnsureVirtualizationRoot uses.
+#define GENERIC_READ        0x80000000u
+#define GENERIC_WRITE       0x40000000u
+#define FILE_SHARE_READ     0x00000001u
+#define FILE_SHARE_WRITE    0x00000002u
+#define CREATE_NEW          1u
+#define OPEN_EXISTING       3u
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+DWORD GetLastError();
+BOOL CreateDirectory(LPCWSTR path, void* securityAttributes);
+BOOL RemoveDirectory(LPCWSTR path);
+BOOL DeleteFile(LPCWSTR path);
+HANDLE CreateFile2(LPCWSTR path, DWORD access, DWORD share, DWORD disposition, void* parameters);
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD length, LPDWORD bytesRead, void* overlapped);
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD length, LPDWORD bytesWritten, void* overlapped);
+BOOL CloseHandle(HANDLE handle);
+HRESULT CoCreateGuid(GUID* guid);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// ProjFS types and routines.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT_* PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT;
+typedef struct PRJ_DIR_ENTRY_BUFFER_HANDLE_* PRJ_DIR_ENTRY_BUFFER_HANDLE;
+
+enum PRJ_CALLBACK_DATA_FLAGS {
+    PRJ_CB_DATA_FLAG_ENUM_RESTART_SCAN          = 0x00000001,
+    PRJ_CB_DATA_FLAG_ENUM_RETURN_SINGLE_ENTRY   = 0x00000002
+};
+
+enum PRJ_NOTIFY_TYPES {
+    PRJ_NOTIFY_NONE                 = 0x00000000,
+    PRJ_NOTIFY_FILE_OPENED          = 0x00000002,
+    PRJ_NOTIFY_PRE_DELETE           = 0x00000010,
+    PRJ_NOTIFY_PRE_RENAME           = 0x00000020
+};
+DEFINE_ENUM_FLAG_OPERATORS(PRJ_NOTIFY_TYPES);
+
+enum PRJ_NOTIFICATION {
+    PRJ_NOTIFICATION_FILE_OPENED                        = 0x00000002,
+    PRJ_NOTIFICATION_NEW_FILE_CREATED                   = 0x00000004,
+    PRJ_NOTIFICATION_FILE_OVERWRITTEN                   = 0x00000008,
+    PRJ_NOTIFICATION_PRE_DELETE                         = 0x00000010,
+    PRJ_NOTIFICATION_PRE_RENAME                         = 0x00000020,
+    PRJ_NOTIFICATION_PRE_SET_HARDLINK                   = 0x00000040,
+    PRJ_NOTIFICATION_FILE_RENAMED                       = 0x00000080,
+    PRJ_NOTIFICATION_HARDLINK_CREATED                   = 0x00000100,
+    PRJ_NOTIFICATION_FILE_HANDLE_CLOSED_NO_MODIFICATION = 0x00000200,
+    PRJ_NOTIFICATION_FILE_HANDLE_CLOSED_FILE_MODIFIED   = 0x00000400,
+    PRJ_NOTIFICATION_FILE_HANDLE_CLOSED_FILE_DELETED    = 0x00000800,
+    PRJ_NOTIFICATION_FILE_PRE_CONVERT_TO_FULL           = 0x00001000
+};
+
+struct PRJ_PLACEHOLDER_VERSION_INFO {
+    UINT8 ProviderID[128];
+    UINT8 ContentID[128];
+};
+
+struct PRJ_CALLBACK_DATA {
+    UINT32 Size;
+    PRJ_CALLBACK_DATA_FLAGS Flags;
+    PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT NamespaceVirtualizationContext;
+    INT32 CommandId;
+    GUID FileId;
+    GUID DataStreamId;
+    PCWSTR FilePathName;
+    PRJ_PLACEHOLDER_VERSION_INFO* VersionInfo;
+    UINT32 TriggeringProcessId;
+    PCWSTR TriggeringProcessImageFileName;
+    void* InstanceContext;
+};
+
+struct PRJ_FILE_BASIC_INFO {
+    BOOLEAN IsDirectory;
+    INT64 FileSize;
+    LARGE_INTEGER CreationTime;
+    LARGE_INTEGER LastAccessTime;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER ChangeTime;
+    UINT32 FileAttributes;
+};
+
+struct PRJ_PLACEHOLDER_INFO {
+    PRJ_FILE_BASIC_INFO FileBasicInfo;
+    PRJ_PLACEHOLDER_VERSION_INFO VersionInfo;
+};
+
+// The notification parameters RegfsProvider::Notify receives but does not look at.
+struct PRJ_NOTIFICATION_PARAMETERS {
+    PRJ_NOTIFY_TYPES NotificationMask;
+};
+
+struct PRJ_NOTIFICATION_MAPPING {
+    PRJ_NOTIFY_TYPES NotificationBitMask;
+    PCWSTR NotificationRoot;
+};
+
+struct PRJ_STARTVIRTUALIZING_OPTIONS {
+    UINT32 Flags;
+    UINT32 PoolThreadCount;
+    UINT32 ConcurrentThreadCount;
+    PRJ_NOTIFICATION_MAPPING* NotificationMappings;
+    UINT32 NotificationMappingsCount;
+};
+
+struct PRJ_VIRTUALIZATION_INSTANCE_INFO {
+    GUID InstanceID;
+    UINT32 WriteAlignment;
+};
+
+typedef HRESULT (CALLBACK PRJ_START_DIRECTORY_ENUMERATION_CB)(const PRJ_CALLBACK_DATA* callbackData,
+                                                              const GUID* enumerationId);
+typedef HRESULT (CALLBACK PRJ_GET_DIRECTORY_ENUMERATION_CB)(const PRJ_CALLBACK_DATA* callbackData,
+                                                            const GUID* enumerationId,
+                                                            PCWSTR searchExpression,
+                                                            PRJ_DIR_ENTRY_BUFFER_HANDLE dirEntryBufferHandle);
+typedef HRESULT (CALLBACK PRJ_END_DIRECTORY_ENUMERATION_CB)(const PRJ_CALLBACK_DATA* callbackData,
+                                                            const GUID* enumerationId);
+typedef HRESULT (CALLBACK PRJ_GET_PLACEHOLDER_INFO_CB)(const PRJ_CALLBACK_DATA* callbackData);
+typedef HRESULT (CALLBACK PRJ_GET_FILE_DATA_CB)(const PRJ_CALLBACK_DATA* callbackData,
+                                                UINT64 byteOffset,
+                                                UINT32 length);
+typedef HRESULT (CALLBACK PRJ_QUERY_FILE_NAME_CB)(const PRJ_CALLBACK_DATA* callbackData);
+typedef HRESULT (CALLBACK PRJ_NOTIFICATION_CB)(const PRJ_CALLBACK_DATA* callbackData,
+                                               BOOLEAN isDirectory,
+                                               PRJ_NOTIFICATION notification,
+                                               PCWSTR destinationFileName,
+                                               PRJ_NOTIFICATION_PARAMETERS* operationParameters);
+typedef void (CALLBACK PRJ_CANCEL_COMMAND_CB)(const PRJ_CALLBACK_DATA* callbackData);
+
+struct PRJ_CALLBACKS {
+    PRJ_START_DIRECTORY_ENUMERATION_CB* StartDirectoryEnumerationCallback;
+    PRJ_END_DIRECTORY_ENUMERATION_CB* EndDirectoryEnumerationCallback;
+    PRJ_GET_DIRECTORY_ENUMERATION_CB* GetDirectoryEnumerationCallback;
+    PRJ_GET_PLACEHOLDER_INFO_CB* GetPlaceholderInfoCallback;
+    PRJ_GET_FILE_DATA_CB* GetFileDataCallback;
+    PRJ_QUERY_FILE_NAME_CB* QueryFileNameCallback;
+    PRJ_NOTIFICATION_CB* NotificationCallback;
+    PRJ_CANCEL_COMMAND_CB* CancelCommandCallback;
+};
+
+HRESULT PrjStartVirtualizing(PCWSTR virtualizationRootPath,
+                             const PRJ_CALLBACKS* callbacks,
+                             const void* instanceContext,
+                             const PRJ_STARTVIRTUALIZING_OPTIONS* options,
+                             PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT* namespaceVirtualizationContext);
+
+void PrjStopVirtualizing(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext);
+
+HRESULT PrjMarkDirectoryAsPlaceholder(PCWSTR rootPathName,
+                                      PCWSTR targetPathName,
+                                      const PRJ_PLACEHOLDER_VERSION_INFO* versionInfo,
+                                      const GUID* virtualizationInstanceID);
+
+HRESULT PrjGetVirtualizationInstanceInfo(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                                         PRJ_VIRTUALIZATION_INSTANCE_INFO* virtualizationInstanceInfo);
+
+HRESULT PrjWritePlaceholderInfo(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                                PCWSTR destinationFileName,
+                                const PRJ_PLACEHOLDER_INFO* placeholderInfo,
+                                UINT32 placeholderInfoSize);
+
+HRESULT PrjWriteFileData(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext,
+                         const GUID* dataStreamId,
+                         void* buffer,
+                         UINT64 byteOffset,
+                         UINT32 length);
+
+void* PrjAllocateAlignedBuffer(PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT namespaceVirtualizationContext, size_t size);
+void PrjFreeAlignedBuffer(void* buffer);
+
+HRESULT PrjFillDirEntryBuffer(PCWSTR fileName,
+                              PRJ_FILE_BASIC_INFO* fileBasicInfo,
+                              PRJ_DIR_ENTRY_BUFFER_HANDLE dirEntryBufferHandle);
+
+int PrjFileNameCompare(PCWSTR fileName1, PCWSTR fileName2);
+BOOLEAN PrjFileNameMatch(PCWSTR fileNameToCheck, PCWSTR pattern);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// What the harness uses to play the part of ProjFS.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace shim {
+
+// A virtualization instance started with PrjStartVirtualizing.
+struct Instance {
+    PRJ_CALLBACKS Callbacks;
+    void* InstanceContext;
+    UINT32 WriteAlignment;
+    bool Running;
+};
+
+// Returns the instance PrjStartVirtualizing started last, or nullptr.  The handle ProjFS hands the
+// provider is a pointer to it.
+Instance* GetInstance();
+
+// A buffer the harness passes to the GetDirectoryEnumeration callback.  Like ProjFS's, it holds a
+// fixed number of bytes, so that a large directory takes several callbacks.
+struct DirEntryBuffer {
+    struct Entry {
+        std::wstring FileName;
+        PRJ_FILE_BASIC_INFO BasicInfo;
+    };
+
+    explicit DirEntryBuffer(size_t capacity) :
+        Capacity(capacity)
+    {}
+
+    PRJ_DIR_ENTRY_BUFFER_HANDLE Handle()
+    {
+        return reinterpret_cast<PRJ_DIR_ENTRY_BUFFER_HANDLE>(this);
+    }
+
+    size_t Capacity;
+    size_t Used = 0;
+    std::vector<Entry> Entries;
+};
+
+// What the provider wrote while the harness was calling a callback on the current thread.  The
+// harness sets it with SetCallbackOutput before each callback.
+struct CallbackOutput {
+    bool PlaceholderWritten = false;
+    PRJ_PLACEHOLDER_INFO Placeholder;
+    UINT64 DataWritten = 0;
+    UINT64 DataHash = 14695981039346656037ULL;  // FNV-1a of the data written, in order.
+};
+
+void SetCallbackOutput(CallbackOutput* output);
+
+}
@@ -0,0 +1,761 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    regfsHarness.cpp
+
+Abstract:
+
+    Drives RegfsProvider over a DirTreeStore without ProjFS, the way ProjFS would: it starts the
+    provider, then replays a trace of the callbacks that listing a tree and reading its files cause,
+    checks every answer, and reports how many callbacks a second the provider answers.
+
+    The harness builds on any machine with a C++14 compiler, against the stand-ins for ProjFS in
+    projfsShim.h.  From the ProjectedFileSystem directory:
+
+        g++ -std=c++14 -O2 -pthread -I. -o regfsHarness harness/projfsShim.cpp harness/regfsHarness.cpp
+            dirInfo.cpp dirTreeStore.cpp logger.cpp regfsProvider.cpp virtualizationInstance.cpp
+
+    Usage:
+
+        regfsHarness [-tree <directory>] [-depth <n>] [-fanout <n>] [-files <n>]
+                     [-trace <file>] [-save <file>] [-threads <n>] [-passes <n>] [-buffer <bytes>] [-v]
+
+    By default the store holds a generated tree -depth levels deep, with -fanout subdirectories and
+    -files files in each directory.  Many of the files have the same contents, so they share blobs.
+    With -tree the store holds a copy of the given directory instead.
+
+    By default the trace is that of a recursive listing of the whole tree that also reads every file:
+    for each directory a placeholder lookup, an enumeration, and a lookup of a desktop.ini that is not
+    there, and for each file a placeholder lookup and a read.  -save writes the trace to a file, and
+    -trace replays one from a file instead.  Each line of a trace file is one of
+
+        enum <entries> <path>
+        lookup <d|f|-> <size> <path>
+        read <size> <hash> <path>
+
+    where <entries> is the number of entries the enumeration should return, a lookup of '-' should not
+    find anything, and <hash> is the 64-bit FNV-1a hash of the file's contents, in hex.
+
+    Each of -threads threads replays the whole trace -passes times.  Enumerations get a buffer of
+    -buffer bytes, so that large directories take several GetDirectoryEnumeration callbacks, like they
+    do with ProjFS.
+
+    The provider's log only records warnings and errors, unless -v is given.  If any answer is wrong,
+    the harness writes out the log and exits with 1.
+
+--*/
+
+#include "../stdafx.h"
+
+#include <chrono>
+#include <clocale>
+#include <cstdlib>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace regfs;
+
+namespace {
+
+constexpr UINT64 HashSeed = 14695981039346656037ULL;
+
+UINT64 HashBytes(UINT64 hash, const BYTE* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::wstring Widen(const std::string& text)
+{
+    std::wstring result(text.size(), L'\0');
+    size_t length = mbstowcs(&result[0], text.c_str(), result.size());
+    result.resize(length == static_cast<size_t>(-1) ? 0 : length);
+    return result;
+}
+
+std::string Narrow(const std::wstring& text)
+{
+    std::string result(text.size() * MB_CUR_MAX, '\0');
+    size_t length = wcstombs(&result[0], text.c_str(), result.size());
+    result.resize(length == static_cast<size_t>(-1) ? 0 : length);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The tree, and the trace of listing it.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+struct TraceOp {
+    enum OpKind {
+        Enumerate,
+        Lookup,
+        Read
+    };
+
+    OpKind Kind;
+    std::wstring Path;
+    bool Exists;
+    bool IsDirectory;
+    UINT64 Size;        // Entries, for an enumeration.
+    UINT64 Hash;        // Reads only.
+};
+
+typedef std::vector<TraceOp> Trace;
+
+// Adds the files and directories to the store, and the trace of listing and reading them to the
+// trace, in the order "dir /s" visits them.
+class TreeBuilder {
+
+public:
+
+    TreeBuilder(DirTreeStore& store, Trace& trace) :
+        _store(store),
+        _trace(trace)
+    {}
+
+    // Adds a directory that has the given number of entries.  Its entries are added after it.
+    void BeginDirectory(const std::wstring& path, size_t entries)
+    {
+        if (!path.empty())
+        {
+            _store.AddDirectory(path);
+            _trace.push_back({ TraceOp::Lookup, path, true, true, 0, 0 });
+        }
+        _trace.push_back({ TraceOp::Enumerate, path, true, true, entries, 0 });
+        _trace.push_back({ TraceOp::Lookup, PathUtils::CombinePath(path, L"desktop.ini"), false, false, 0, 0 });
+    }
+
+    void AddFile(const std::wstring& path, const std::vector<BYTE>& contents)
+    {
+        _store.AddFile(path, contents.data(), contents.size());
+        _trace.push_back({ TraceOp::Lookup, path, true, false, contents.size(), 0 });
+        _trace.push_back({ TraceOp::Read, path, true, false, contents.size(),
+                           HashBytes(HashSeed, contents.data(), contents.size()) });
+    }
+
+private:
+
+    DirTreeStore& _store;
+    Trace& _trace;
+};
+
+// Generates a tree of the given shape.  A quarter of the files have one of a few shared contents.
+void GenerateTree(TreeBuilder& builder, const std::wstring& path, int depth, int fanout, int files, UINT64& seed)
+{
+    auto next = [&seed]()
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<UINT32>(seed >> 33);
+    };
+
+    builder.BeginDirectory(path, (depth > 0 ? fanout : 0) + files);
+
+    for (int i = 0; i < files; i++)
+    {
+        UINT32 shape = next();
+        std::vector<BYTE> contents((shape % 4 == 0) ? (shape >> 8) % 64 * 17 : next() % 8192);
+        UINT32 fill = (shape % 4 == 0) ? (shape >> 8) % 64 : next();
+        for (size_t j = 0; j < contents.size(); j++)
+        {
+            contents[j] = static_cast<BYTE>(fill + j * 31);
+        }
+
+        builder.AddFile(PathUtils::CombinePath(path, L"File" + std::to_wstring(i) + L".txt"), contents);
+    }
+
+    if (depth > 0)
+    {
+        for (int i = 0; i < fanout; i++)
+        {
+            GenerateTree(builder, PathUtils::CombinePath(path, L"Dir" + std::to_wstring(i)), depth - 1, fanout, files, seed);
+        }
+    }
+}
+
+// Copies a directory on disk.  Symbolic links and anything that cannot be read are skipped.
+bool CopyTree(TreeBuilder& builder, const std::string& diskPath, const std::wstring& path)
+{
+    DIR* directory = opendir(diskPath.c_str());
+    if (directory == nullptr)
+    {
+        return false;
+    }
+
+    std::vector<std::pair<std::string, bool>> entries;
+    while (dirent* entry = readdir(directory))
+    {
+        std::string name = entry->d_name;
+        struct stat info;
+        if (name == "." || name == ".." ||
+            lstat((diskPath + "/" + name).c_str(), &info) != 0 ||
+            !(S_ISDIR(info.st_mode) || S_ISREG(info.st_mode)))
+        {
+            continue;
+        }
+        entries.emplace_back(name, S_ISDIR(info.st_mode));
+    }
+    closedir(directory);
+
+    // Visit the entries in the order a listing returns them.  Files whose names only differ in case
+    // are the same file in the projection, so keep only the first of those.
+    auto nameLess = [](const std::wstring& name1, const std::wstring& name2)
+    {
+        return PrjFileNameCompare(name1.c_str(), name2.c_str()) < 0;
+    };
+    std::map<std::wstring, std::pair<std::string, bool>, decltype(nameLess)> children(nameLess);
+    for (auto& entry : entries)
+    {
+        std::wstring name = Widen(entry.first);
+        if (!name.empty())
+        {
+            children.emplace(name, entry);
+        }
+    }
+
+    builder.BeginDirectory(path, children.size());
+
+    for (auto& child : children)
+    {
+        std::string childDiskPath = diskPath + "/" + child.second.first;
+        std::wstring childPath = PathUtils::CombinePath(path, child.first);
+        if (child.second.second)
+        {
+            if (!CopyTree(builder, childDiskPath, childPath))
+            {
+                // Still list it, as an empty directory.
+                builder.BeginDirectory(childPath, 0);
+            }
+            continue;
+        }
+
+        std::vector<BYTE> contents;
+        if (FILE* file = fopen(childDiskPath.c_str(), "rb"))
+        {
+            BYTE chunk[65536];
+            size_t read;
+            while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            {
+                contents.insert(contents.end(), chunk, chunk + read);
+            }
+            fclose(file);
+        }
+        builder.AddFile(childPath, contents);
+    }
+
+    return true;
+}
+
+bool SaveTrace(const Trace& trace, const char* fileName)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    for (auto& op : trace)
+    {
+        std::string path = op.Path.empty() ? "\\" : Narrow(op.Path);
+        switch (op.Kind)
+        {
+        case TraceOp::Enumerate:
+            fprintf(file, "enum %llu %s\n", static_cast<unsigned long long>(op.Size), path.c_str());
+            break;
+
+        case TraceOp::Lookup:
+            fprintf(file, "lookup %c %llu %s\n",
+                    !op.Exists ? '-' : op.IsDirectory ? 'd' : 'f',
+                    static_cast<unsigned long long>(op.Size),
+                    path.c_str());
+            break;
+
+        case TraceOp::Read:
+            fprintf(file, "read %llu %016llx %s\n",
+                    static_cast<unsigned long long>(op.Size),
+                    static_cast<unsigned long long>(op.Hash),
+                    path.c_str());
+            break;
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+bool LoadTrace(Trace& trace, const char* fileName)
+{
+    FILE* file = fopen(fileName, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool valid = true;
+    char line[4096];
+    while (valid && fgets(line, sizeof(line), file) != nullptr)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+
+        TraceOp op = {};
+        op.Exists = true;
+        unsigned long long size = 0;
+        unsigned long long hash = 0;
+        char type = 0;
+        int pathStart = 0;
+
+        if (sscanf(line, "enum %llu %n", &size, &pathStart) == 1 && pathStart > 0)
+        {
+            op.Kind = TraceOp::Enumerate;
+            op.IsDirectory = true;
+        }
+        else if (sscanf(line, "lookup %c %llu %n", &type, &size, &pathStart) == 2 && pathStart > 0)
+        {
+            op.Kind = TraceOp::Lookup;
+            op.Exists = type != '-';
+            op.IsDirectory = type == 'd';
+        }
+        else if (sscanf(line, "read %llu %llx %n", &size, &hash, &pathStart) == 2 && pathStart > 0)
+        {
+            op.Kind = TraceOp::Read;
+        }
+        else
+        {
+            fwprintf(stderr, L"Bad trace line: %hs\n", line);
+            valid = false;
+            break;
+        }
+
+        op.Size = size;
+        op.Hash = hash;
+        op.Path = Widen(line + pathStart);
+        if (op.Path == L"\\")
+        {
+            op.Path.clear();
+        }
+        trace.push_back(op);
+    }
+
+    fclose(file);
+    return valid;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Replaying a trace.
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+struct ReplayStats {
+    UINT64 Callbacks = 0;
+    UINT64 Failures = 0;
+    UINT64 Ops[3] = {};
+    double Seconds[3] = {};
+};
+
+class Replayer {
+
+public:
+
+    Replayer(shim::Instance& instance, size_t bufferSize, std::atomic<UINT32>& nextCommandId) :
+        _instance(instance),
+        _bufferSize(bufferSize),
+        _nextCommandId(nextCommandId)
+    {}
+
+    void Replay(const Trace& trace, ReplayStats& stats)
+    {
+        for (auto& op : trace)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            bool passed = false;
+            switch (op.Kind)
+            {
+            case TraceOp::Enumerate:
+                passed = Enumerate(op, stats);
+                break;
+
+            case TraceOp::Lookup:
+                passed = Lookup(op, stats);
+                break;
+
+            case TraceOp::Read:
+                passed = Read(op, stats);
+                break;
+            }
+
+            auto end = std::chrono::steady_clock::now();
+            stats.Ops[op.Kind]++;
+            stats.Seconds[op.Kind] += std::chrono::duration<double>(end - start).count();
+
+            if (!passed)
+            {
+                stats.Failures++;
+            }
+        }
+    }
+
+private:
+
+    PRJ_CALLBACK_DATA CallbackData(const std::wstring& path)
+    {
+        PRJ_CALLBACK_DATA data = {};
+        data.Size = sizeof(data);
+        data.NamespaceVirtualizationContext = reinterpret_cast<PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT>(&_instance);
+        data.CommandId = static_cast<INT32>(_nextCommandId++);
+        data.FilePathName = path.c_str();
+        data.TriggeringProcessId = 1;
+        data.TriggeringProcessImageFileName = L"regfsHarness";
+        data.InstanceContext = _instance.InstanceContext;
+        return data;
+    }
+
+    bool Enumerate(const TraceOp& op, ReplayStats& stats)
+    {
+        PRJ_CALLBACK_DATA data = CallbackData(op.Path);
+        GUID enumerationId = {};
+        enumerationId.Data1 = static_cast<uint32_t>(data.CommandId);
+
+        HRESULT hr = _instance.Callbacks.StartDirectoryEnumerationCallback(&data, &enumerationId);
+        stats.Callbacks++;
+
+        // Ask for entries until a callback returns none, like ProjFS does.
+        std::vector<shim::DirEntryBuffer::Entry> entries;
+        bool sorted = true;
+        while (SUCCEEDED(hr))
+        {
+            shim::DirEntryBuffer buffer(_bufferSize);
+            hr = _instance.Callbacks.GetDirectoryEnumerationCallback(&data, &enumerationId, L"*", buffer.Handle());
+            stats.Callbacks++;
+
+            if (buffer.Entries.empty())
+            {
+                break;
+            }
+
+            for (auto& entry : buffer.Entries)
+            {
+                if (!entries.empty() &&
+                    PrjFileNameCompare(entries.back().FileName.c_str(), entry.FileName.c_str()) >= 0)
+                {
+                    sorted = false;
+                }
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        _instance.Callbacks.EndDirectoryEnumerationCallback(&data, &enumerationId);
+        stats.Callbacks++;
+
+        return Check(SUCCEEDED(hr) == op.Exists && (!op.Exists || (entries.size() == op.Size && sorted)),
+                     L"enumeration", op);
+    }
+
+    bool Lookup(const TraceOp& op, ReplayStats& stats)
+    {
+        PRJ_CALLBACK_DATA data = CallbackData(op.Path);
+        shim::CallbackOutput output;
+        shim::SetCallbackOutput(&output);
+        HRESULT hr = _instance.Callbacks.GetPlaceholderInfoCallback(&data);
+        shim::SetCallbackOutput(nullptr);
+        stats.Callbacks++;
+
+        if (!op.Exists)
+        {
+            return Check(hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) && !output.PlaceholderWritten,
+                         L"lookup", op);
+        }
+
+        return Check(SUCCEEDED(hr) &&
+                     output.PlaceholderWritten &&
+                     !!output.Placeholder.FileBasicInfo.IsDirectory == op.IsDirectory &&
+                     static_cast<UINT64>(output.Placeholder.FileBasicInfo.FileSize) == op.Size,
+                     L"lookup", op);
+    }
+
+    bool Read(const TraceOp& op, ReplayStats& stats)
+    {
+        PRJ_CALLBACK_DATA data = CallbackData(op.Path);
+        data.DataStreamId.Data1 = static_cast<uint32_t>(data.CommandId);
+
+        shim::CallbackOutput output;
+        shim::SetCallbackOutput(&output);
+        HRESULT hr = _instance.Callbacks.GetFileDataCallback(&data, 0, static_cast<UINT32>(op.Size));
+        shim::SetCallbackOutput(nullptr);
+        stats.Callbacks++;
+
+        return Check(SUCCEEDED(hr) && output.DataWritten == op.Size && output.DataHash == op.Hash,
+                     L"read", op);
+    }
+
+    static bool Check(bool passed, PCWSTR what, const TraceOp& op)
+    {
+        if (!passed)
+        {
+            RegfsLog(LogLevel::Error, L"regfsHarness: wrong answer to %ls of [%ls]", what, op.Path.c_str());
+        }
+        return passed;
+    }
+
+    shim::Instance& _instance;
+    size_t _bufferSize;
+    std::atomic<UINT32>& _nextCommandId;
+};
+
+// Checks that the provider turns down a delete, since its namespace is read-only.
+bool CheckDeleteRejected(shim::Instance& instance)
+{
+    if (instance.Callbacks.NotificationCallback == nullptr)
+    {
+        return false;
+    }
+
+    PRJ_CALLBACK_DATA data = {};
+    data.Size = sizeof(data);
+    data.NamespaceVirtualizationContext = reinterpret_cast<PRJ_NAMESPACE_VIRTUALIZATION_CONTEXT>(&instance);
+    data.FilePathName = L"File0.txt";
+    data.TriggeringProcessImageFileName = L"regfsHarness";
+    data.InstanceContext = instance.InstanceContext;
+
+    PRJ_NOTIFICATION_PARAMETERS parameters = {};
+    HRESULT hr = instance.Callbacks.NotificationCallback(&data, FALSE, PRJ_NOTIFICATION_PRE_DELETE, nullptr, &parameters);
+    return hr == HRESULT_FROM_NT(STATUS_CANNOT_DELETE);
+}
+
+int Usage()
+{
+    fwprintf(stderr,
+             L"Usage: regfsHarness [-tree <directory>] [-depth <n>] [-fanout <n>] [-files <n>]\n"
+             L"                    [-trace <file>] [-save <file>] [-threads <n>] [-passes <n>] [-buffer <bytes>] [-v]\n");
+    return 2;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    setlocale(LC_ALL, "");
+
+    const char* treePath = nullptr;
+    const char* tracePath = nullptr;
+    const char* savePath = nullptr;
+    int depth = 4;
+    int fanout = 6;
+    int files = 16;
+    int threadCount = 1;
+    int passes = 3;
+    size_t bufferSize = 16384;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else if (arg == "-tree" && hasValue)
+        {
+            treePath = argv[++i];
+        }
+        else if (arg == "-trace" && hasValue)
+        {
+            tracePath = argv[++i];
+        }
+        else if (arg == "-save" && hasValue)
+        {
+            savePath = argv[++i];
+        }
+        else if (arg == "-depth" && hasValue)
+        {
+            depth = atoi(argv[++i]);
+        }
+        else if (arg == "-fanout" && hasValue)
+        {
+            fanout = atoi(argv[++i]);
+        }
+        else if (arg == "-files" && hasValue)
+        {
+            files = atoi(argv[++i]);
+        }
+        else if (arg == "-threads" && hasValue)
+        {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (arg == "-passes" && hasValue)
+        {
+            passes = atoi(argv[++i]);
+        }
+        else if (arg == "-buffer" && hasValue)
+        {
+            bufferSize = static_cast<size_t>(atoll(argv[++i]));
+        }
+        else
+        {
+            return Usage();
+        }
+    }
+
+    // The buffer must hold at least an entry with the longest name.
+    if (depth < 0 || fanout < 0 || files < 0 || threadCount < 1 || passes < 1 || bufferSize < 1024)
+    {
+        return Usage();
+    }
+
+    // Record what a provider would normally report, but do not write it out; that would be most of
+    // what is being measured.
+    Logger::SetLevel(verbose ? LogLevel::Verbose : LogLevel::Warning);
+    Logger::SetEchoLevel(LogLevel::Error);
+
+    // Build the store, and the trace of listing it.
+    DirTreeStore store;
+    Trace trace;
+    TreeBuilder builder(store, trace);
+
+    auto buildStart = std::chrono::steady_clock::now();
+    if (treePath != nullptr)
+    {
+        if (!CopyTree(builder, treePath, L""))
+        {
+            fwprintf(stderr, L"Could not read directory %hs\n", treePath);
+            return 1;
+        }
+    }
+    else
+    {
+        UINT64 seed = 1;
+        GenerateTree(builder, L"", depth, fanout, files, seed);
+    }
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+    if (tracePath != nullptr)
+    {
+        trace.clear();
+        if (!LoadTrace(trace, tracePath))
+        {
+            fwprintf(stderr, L"Could not read trace %hs\n", tracePath);
+            return 1;
+        }
+    }
+
+    if (savePath != nullptr && !SaveTrace(trace, savePath))
+    {
+        fwprintf(stderr, L"Could not write trace %hs\n", savePath);
+        return 1;
+    }
+
+    DirTreeStore::Statistics storeStats = store.GetStatistics();
+    fwprintf(stdout,
+             L"Store: %llu directories, %llu files, %llu bytes in %llu blobs of %llu bytes, built in %.0f ms\n",
+             static_cast<unsigned long long>(storeStats.Directories),
+             static_cast<unsigned long long>(storeStats.Files),
+             static_cast<unsigned long long>(storeStats.FileBytes),
+             static_cast<unsigned long long>(storeStats.Blobs),
+             static_cast<unsigned long long>(storeStats.BlobBytes),
+             buildSeconds * 1e3);
+
+    // Start the provider.  The notification mapping makes VirtualizationInstance register Notify.
+    PRJ_NOTIFICATION_MAPPING notificationMappings[1] = {};
+    notificationMappings[0].NotificationRoot = L"";
+    notificationMappings[0].NotificationBitMask = PRJ_NOTIFY_PRE_DELETE;
+
+    PRJ_STARTVIRTUALIZING_OPTIONS opts = {};
+    opts.NotificationMappings = notificationMappings;
+    opts.NotificationMappingsCount = 1;
+
+    RegfsProvider provider(store);
+    HRESULT hr = provider.Start(L"harnessRoot", &opts);
+    shim::Instance* instance = shim::GetInstance();
+    if (FAILED(hr) || instance == nullptr)
+    {
+        fwprintf(stderr, L"Failed to start virtualization instance: 0x%08x\n", hr);
+        return 1;
+    }
+
+    bool passed = CheckDeleteRejected(*instance);
+    if (!passed)
+    {
+        RegfsLog(LogLevel::Error, L"regfsHarness: a delete was not rejected");
+    }
+
+    // Replay the trace on each thread.
+    std::atomic<UINT32> nextCommandId{ 1 };
+    std::vector<ReplayStats> threadStats(threadCount);
+    std::vector<std::thread> threads;
+
+    auto replayStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            Replayer replayer(*instance, bufferSize, nextCommandId);
+            for (int pass = 0; pass < passes; pass++)
+            {
+                replayer.Replay(trace, threadStats[i]);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+
+    provider.Stop();
+
+    ReplayStats total;
+    for (auto& stats : threadStats)
+    {
+        total.Callbacks += stats.Callbacks;
+        total.Failures += stats.Failures;
+        for (int kind = 0; kind < 3; kind++)
+        {
+            total.Ops[kind] += stats.Ops[kind];
+            total.Seconds[kind] += stats.Seconds[kind];
+        }
+    }
+
+    static const PCWSTR kindNames[] = { L"Enumerations", L"Lookups", L"Reads" };
+    fwprintf(stdout,
+             L"Trace: %zu operations, %d pass(es) on %d thread(s)\n",
+             trace.size(), passes, threadCount);
+    for (int kind = 0; kind < 3; kind++)
+    {
+        fwprintf(stdout,
+                 L"  %-12ls %10llu  %8.2f us each\n",
+                 kindNames[kind],
+                 static_cast<unsigned long long>(total.Ops[kind]),
+                 total.Ops[kind] ? total.Seconds[kind] * 1e6 / total.Ops[kind] : 0);
+    }
+    fwprintf(stdout,
+             L"Callbacks: %llu in %.0f ms, %.0f callbacks/sec\n",
+             static_cast<unsigned long long>(total.Callbacks),
+             seconds * 1e3,
+             seconds > 0 ? total.Callbacks / seconds : 0);
+
+    if (total.Failures != 0)
+    {
+        fwprintf(stdout, L"%llu wrong answer(s)\n", static_cast<unsigned long long>(total.Failures));
+        passed = false;
+    }
+
+    if (!passed || verbose)
+    {
+        fwprintf(stdout, L"Log:\n");
+        Logger::Dump(stdout);
+    }
+
+    return passed ? 0 : 1;
+}
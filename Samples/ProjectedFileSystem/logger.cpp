@@ -0,0 +1,100 @@
+#include "stdafx.h"
+
+using namespace regfs;
+
+//////////////////////////////////////////////////////////////////////////
+// See logger.h for descriptions of the routines in this module.
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t Logger::Capacity;
+constexpr size_t Logger::MaxMessageLength;
+
+std::atomic<LogLevel> Logger::_level{ LogLevel::Info };
+std::atomic<LogLevel> Logger::_echoLevel{ LogLevel::Warning };
+std::atomic<UINT64> Logger::_nextSequence{ 1 };
+Logger::Slot Logger::_slots[Logger::Capacity];
+
+void Logger::SetLevel(LogLevel level)
+{
+    _level = level;
+}
+
+void Logger::SetEchoLevel(LogLevel level)
+{
+    _echoLevel = level;
+}
+
+void Logger::Write(LogLevel level, PCWSTR format, ...)
+{
+    // Format and echo outside the slot, so that a writer that wraps around onto it only waits for a
+    // copy, never for stdout.
+    WCHAR text[MaxMessageLength];
+
+    va_list args;
+    va_start(args, format);
+    if (vswprintf(text, MaxMessageLength, format, args) < 0)
+    {
+        // The message was cut short.
+        text[MaxMessageLength - 1] = L'\0';
+    }
+    va_end(args);
+
+    const size_t length = wcslen(text) + 1;
+
+    const UINT64 sequence = _nextSequence.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = _slots[sequence % Capacity];
+
+    while (slot.Busy.test_and_set(std::memory_order_acquire))
+    {
+    }
+
+    memcpy(slot.Text, text, length * sizeof(WCHAR));
+    slot.Sequence = sequence;
+    slot.Level = level;
+
+    slot.Busy.clear(std::memory_order_release);
+
+    if (level <= _echoLevel.load(std::memory_order_relaxed))
+    {
+        fwprintf(stdout, L"%ls\n", text);
+    }
+}
+
+void Logger::Dump(FILE* stream)
+{
+    static const PCWSTR levelNames[] = { L"error", L"warning", L"info", L"verbose" };
+
+    // Start at the slot the next message will go to, which holds the oldest message once the buffer
+    // has wrapped around.
+    const UINT64 next = _nextSequence.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < Capacity; i++)
+    {
+        Slot& slot = _slots[(next + i) % Capacity];
+
+        WCHAR text[MaxMessageLength];
+        UINT64 sequence;
+        LogLevel level;
+
+        while (slot.Busy.test_and_set(std::memory_order_acquire))
+        {
+        }
+
+        sequence = slot.Sequence;
+        level = slot.Level;
+        if (sequence != 0)
+        {
+            memcpy(text, slot.Text, (wcslen(slot.Text) + 1) * sizeof(WCHAR));
+        }
+
+        slot.Busy.clear(std::memory_order_release);
+
+        if (sequence != 0)
+        {
+            fwprintf(stream,
+                     L"%8llu %-7ls %ls\n",
+                     static_cast<unsigned long long>(sequence),
+                     levelNames[static_cast<int>(level)],
+                     text);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    logger.h
+
+Abstract:
+
+    RegFS's log.  ProjFS can call the provider many thousands of times a second, and writing a line to
+    the console for each callback would take longer than answering it.  So messages go into a ring
+    buffer in memory instead, which keeps the most recent ones, and only messages at or below the echo
+    level are also written to the console.
+
+    Messages above the log level are dropped before they are formatted.  Use the RegfsLog macro rather
+    than calling Logger::Write directly, so that the arguments are not even evaluated then.
+
+--*/
+
+#pragma once
+
+namespace regfs {
+
+enum class LogLevel {
+    Error = 0,
+    Warning,
+    Info,
+    Verbose
+};
+
+class Logger {
+
+public:
+
+    // The number of messages the ring buffer keeps, and the longest message it keeps in full.
+    static constexpr size_t Capacity = 4096;
+    static constexpr size_t MaxMessageLength = 256;
+
+    // Sets the most detailed level that is recorded.  The default is LogLevel::Info.
+    static void SetLevel(LogLevel level);
+
+    // Sets the most detailed level that is also written to stdout.  The default is LogLevel::Warning.
+    static void SetEchoLevel(LogLevel level);
+
+    static bool IsEnabled(LogLevel level)
+    {
+        return level <= _level.load(std::memory_order_relaxed);
+    }
+
+    // Formats a message with swprintf-style arguments and records it.
+    static void Write(LogLevel level, PCWSTR format, ...);
+
+    // Writes the messages the ring buffer holds, oldest first, to the given stream.
+    static void Dump(FILE* stream);
+
+private:
+
+    struct Slot {
+        // Held while the slot is being written or copied.  Writers only meet on a slot when the buffer
+        // wraps around while one of them is still formatting.
+        std::atomic_flag Busy = ATOMIC_FLAG_INIT;
+        UINT64 Sequence = 0;    // 0 if the slot has never been written.
+        LogLevel Level = LogLevel::Error;
+        WCHAR Text[MaxMessageLength];
+    };
+
+    static std::atomic<LogLevel> _level;
+    static std::atomic<LogLevel> _echoLevel;
+    static std::atomic<UINT64> _nextSequence;
+    static Slot _slots[Capacity];
+};
+
+}
+
+// Records a message if its level is enabled.  The format arguments are only evaluated if it is.
+#define RegfsLog(level, ...)                                        \
+    do                                                              \
+    {                                                               \
+        if (regfs::Logger::IsEnabled(level))                        \
+        {                                                           \
+            regfs::Logger::Write(level, __VA_ARGS__);               \
+        }                                                           \
+    } while (0)
@@ -8,8 +8,8 @@ Module Name:
 
 Abstract:
 
-    This implements the wmain() function for the RegFS provider.  It sets up the RegfsProvider object
-    and starts the provider.
+    This implements the wmain() function for the RegFS provider.  It sets up a RegistryStore and a
+    RegfsProvider object that projects it, and starts the provider.
 
 --*/
 
@@ -17,19 +17,72 @@ Abstract:
 
 using namespace regfs;
 
+// Replays a recursive listing of the given registry path against the provider twice without the
+// index, then twice with it, and prints how long the callbacks took.  The results go to stderr.
+int RunBenchmark(const std::wstring& path)
+{
+    // Keys that cannot be read are counted, not reported one by one.
+    Logger::SetLevel(LogLevel::Error);
+    Logger::SetEchoLevel(LogLevel::Error);
+
+    const bool useIndex[] = { false, true };
+    for (bool index : useIndex)
+    {
+        RegistryStore store(index);
+        RegfsProvider provider(store);
+
+        for (int pass = 1; pass <= 2; pass++)
+        {
+            RegfsProvider::ListingStats stats;
+            provider.ReplayRecursiveListing(path, stats);
+
+            fwprintf(stderr,
+                     L"%-8s pass %d: %8llu keys (%llu unreadable) in %8.0f ms;  enumeration %8.1f us/key;  lookup %8.1f us/key\n",
+                     index ? L"Index" : L"Registry",
+                     pass,
+                     stats.Directories,
+                     stats.Failures,
+                     (stats.EnumSeconds + stats.LookupSeconds) * 1e3,
+                     stats.Directories ? stats.EnumSeconds * 1e6 / stats.Directories : 0,
+                     stats.Lookups ? stats.LookupSeconds * 1e6 / stats.Lookups : 0);
+        }
+    }
+
+    return 0;
+}
+
 int __cdecl wmain(int argc, const WCHAR **argv)
 {
     if (argc <= 1)
     {
         wprintf(L"Usage: \n");
-        wprintf(L"> regfs.exe <Virtualization Root Path> \n");
+        wprintf(L"> regfs.exe <Virtualization Root Path> [-v]\n");
+        wprintf(L"> regfs.exe -benchmark <Registry Path>\n");
 
         return -1;
     }
 
+    if (argc > 2 && _wcsicmp(argv[1], L"-benchmark") == 0)
+    {
+        return RunBenchmark(argv[2]);
+    }
+
     // argv[1] should be the path to the virtualization root.
     std::wstring rootPath = argv[1];
 
+    // Report what happens to the projected files.  With -v also report every callback, which slows
+    // the provider down considerably.
+    if (argc > 2 && _wcsicmp(argv[2], L"-v") == 0)
+    {
+        Logger::SetLevel(LogLevel::Verbose);
+        Logger::SetEchoLevel(LogLevel::Verbose);
+    }
+    else
+    {
+        Logger::SetLevel(LogLevel::Info);
+        Logger::SetEchoLevel(LogLevel::Info);
+    }
+
     // Specify the notifications that we want ProjFS to send to us.  Everywhere under the virtualization
     // root we want ProjFS to tell us when files have been opened, when they're about to be renamed,
     // and when they're about to be deleted.
@@ -46,7 +99,8 @@ int __cdecl wmain(int argc, const WCHAR **argv)
     opts.NotificationMappingsCount = 1;
 
     // Start the provider using the options we set up.
-    RegfsProvider provider;
+    RegistryStore store;
+    RegfsProvider provider(store);
     auto hr = provider.Start(rootPath.c_str(), &opts);
     if (FAILED(hr))
     {
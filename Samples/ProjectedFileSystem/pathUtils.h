@@ -99,6 +99,37 @@ public:
 
         return fullPath;
     }
+
+    // Calls callback with each component of a path, and with the path up to and including it, until
+    // the callback returns false.
+    // Example:
+    //
+    //      ForEachComponent(L"foo\bar", callback);
+    //
+    // Result:
+    //
+    //      callback(L"foo", L"foo"), then callback(L"bar", L"foo\bar")
+    template <typename Callback>
+    static void ForEachComponent(const std::wstring& path, Callback callback)
+    {
+        size_t start = 0;
+        while (start < path.size())
+        {
+            size_t end = path.find(L'\\', start);
+            if (end == std::wstring::npos)
+            {
+                end = path.size();
+            }
+
+            if (end > start &&
+                !callback(path.substr(start, end - start), path.substr(0, end)))
+            {
+                return;
+            }
+
+            start = end + 1;
+        }
+    }
 };
 
 }
\ No newline at end of file
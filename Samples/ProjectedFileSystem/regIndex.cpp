@@ -0,0 +1,352 @@
+#include "stdafx.h"
+
+using namespace regfs;
+
+//////////////////////////////////////////////////////////////////////////
+// See regIndex.h for descriptions of the routines in this module.
+//////////////////////////////////////////////////////////////////////////
+
+// How many times a lookup re-reads keys that keep changing under it before it settles for what it
+// read last.
+constexpr int MaxPopulateAttempts = 4;
+
+// Orders nodes the way the file system sorts names, with a subkey ahead of a value of the same name.
+int CompareNodes(const IndexNode& node1, const IndexNode& node2)
+{
+    int result = PrjFileNameCompare(node1.Name.c_str(), node2.Name.c_str());
+    if (result == 0 && node1.IsKey != node2.IsKey)
+    {
+        result = node1.IsKey ? -1 : 1;
+    }
+    return result;
+}
+
+KeyWatch::~KeyWatch()
+{
+    if (_wait != nullptr)
+    {
+        SetThreadpoolWait(_wait, nullptr, nullptr);
+        WaitForThreadpoolWaitCallbacks(_wait, TRUE);
+        CloseThreadpoolWait(_wait);
+    }
+
+    // The registry keeps its own reference to the event while the notification is pending, so it is
+    // safe to close it even when the key stays open.
+    if (_event != nullptr)
+    {
+        CloseHandle(_event);
+    }
+
+    if (_ownsKey)
+    {
+        RegCloseKey(_key);
+    }
+}
+
+void KeyWatch::Start(HKEY hKey, bool ownsKey)
+{
+    _key = hKey;
+    _ownsKey = ownsKey;
+
+    _event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (_event != nullptr)
+    {
+        _wait = CreateThreadpoolWait(OnChange, this, nullptr);
+    }
+
+    // Watch only the key itself: a change further down is picked up by the watch on that key.  The
+    // notification is thread agnostic, so that it is not signaled when the ProjFS callback thread
+    // that set it up exits.
+    if (_wait == nullptr ||
+        RegNotifyChangeKeyValue(_key,
+                                FALSE,
+                                REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC,
+                                _event,
+                                TRUE) != ERROR_SUCCESS)
+    {
+        RegfsLog(LogLevel::Warning,
+                 L"%hs: could not watch key for changes",
+                 __FUNCTION__);
+        _changed = true;
+        return;
+    }
+
+    SetThreadpoolWait(_wait, _event, nullptr);
+}
+
+VOID CALLBACK KeyWatch::OnChange(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult)
+{
+    UNREFERENCED_PARAMETER(Instance);
+    UNREFERENCED_PARAMETER(Wait);
+    UNREFERENCED_PARAMETER(WaitResult);
+
+    // This must not take the index lock: the watch is destroyed with the lock held, and waits for
+    // this callback to finish.
+    static_cast<KeyWatch*>(Context)->_changed = true;
+}
+
+RegIndex::RegIndex(RegOps& regOps) :
+    _regOps(regOps),
+    _root(std::make_unique<IndexNode>())
+{
+    _root->IsKey = true;
+    _root->Size = 0;
+}
+
+HRESULT RegIndex::Find(const std::wstring& path, bool& isKey, INT64& size)
+{
+    if (PathUtils::IsVirtualizationRoot(path.c_str()))
+    {
+        isKey = true;
+        size = 0;
+        return S_OK;
+    }
+
+    std::wstring parentPath;
+    std::wstring name = PathUtils::GetLastComponent(path, parentPath);
+
+    return VisitKey(parentPath, [&](const IndexNode& parent)
+    {
+        IndexNode* child = FindChild(parent, name, false);
+        if (child == nullptr)
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+
+        isKey = child->IsKey;
+        size = child->Size;
+        return S_OK;
+    });
+}
+
+HRESULT RegIndex::FillDirInfo(const std::wstring& path, DirInfo* dirInfo, const std::wstring& searchExpression)
+{
+    return VisitKey(path, [&](const IndexNode& node)
+    {
+        for (auto& child : node.Children)
+        {
+            if (PrjFileNameMatch(child->Name.c_str(), searchExpression.c_str()))
+            {
+                if (child->IsKey)
+                {
+                    dirInfo->FillDirEntry(child->Name.c_str());
+                }
+                else
+                {
+                    dirInfo->FillFileEntry(child->Name.c_str(), child->Size);
+                }
+            }
+        }
+        return S_OK;
+    });
+}
+
+template <typename Visit>
+HRESULT RegIndex::VisitKey(const std::wstring& path, Visit visit)
+{
+    // Reading a key for the first time always makes progress down the path, so only re-reads of keys
+    // that changed count as attempts.
+    int attempts = 0;
+
+    for (;;)
+    {
+        HRESULT hr = S_OK;
+        const bool ignoreChanges = attempts >= MaxPopulateAttempts;
+
+        // Walk down to the key, stopping at the first key on the way whose children are not cached.
+        std::wstring stalePath;
+        bool stale = false;
+        bool changed = false;
+
+        AcquireSRWLockShared(&_lock);
+
+        IndexNode* node = _root.get();
+        if (node->IsStale(ignoreChanges))
+        {
+            stale = true;
+            changed = node->Populated;
+        }
+        else
+        {
+            PathUtils::ForEachComponent(path, [&](const std::wstring& name, const std::wstring& pathSoFar)
+            {
+                node = FindChild(*node, name, true);
+                if (node == nullptr)
+                {
+                    hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+                    return false;
+                }
+                if (node->IsStale(ignoreChanges))
+                {
+                    stalePath = pathSoFar;
+                    stale = true;
+                    changed = node->Populated;
+                    return false;
+                }
+                return true;
+            });
+        }
+
+        if (SUCCEEDED(hr) && !stale)
+        {
+            hr = visit(*node);
+        }
+
+        ReleaseSRWLockShared(&_lock);
+
+        if (!stale)
+        {
+            if (ignoreChanges)
+            {
+                RegfsLog(LogLevel::Warning,
+                         L"%hs: [%ls] keeps changing, using the entries read last",
+                         __FUNCTION__, path.c_str());
+            }
+            return hr;
+        }
+
+        // Read the stale key from the registry, then walk down again.
+        if (changed)
+        {
+            attempts++;
+        }
+
+        hr = Populate(stalePath);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+}
+
+HRESULT RegIndex::Populate(const std::wstring& path)
+{
+    HRESULT hr = S_OK;
+    RegEntries entries;
+    std::unique_ptr<KeyWatch> watch;
+
+    if (PathUtils::IsVirtualizationRoot(path.c_str()))
+    {
+        // The root holds the predefined keys, which never change, so it needs no watch.
+        hr = _regOps.EnumerateKey(path, entries);
+    }
+    else
+    {
+        HKEY hKey = nullptr;
+        hr = _regOps.OpenKeyByPath(path, hKey);
+        if (hKey == nullptr)
+        {
+            return FAILED(hr) ? hr : HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+
+        // Start watching before reading, so that a change made while the key is being read is not
+        // missed.  A path with no '\' is a predefined key, whose handle must not be closed.
+        watch = std::make_unique<KeyWatch>();
+        watch->Start(hKey, path.find(L'\\') != std::wstring::npos);
+
+        hr = _regOps.EnumerateKey(hKey, entries);
+    }
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    std::vector<std::unique_ptr<IndexNode>> children;
+    children.reserve(entries.SubKeys.size() + entries.Values.size());
+
+    for (auto& subKey : entries.SubKeys)
+    {
+        auto child = std::make_unique<IndexNode>();
+        child->Name = std::move(subKey.Name);
+        child->IsKey = true;
+        child->Size = 0;
+        children.push_back(std::move(child));
+    }
+
+    for (auto& value : entries.Values)
+    {
+        auto child = std::make_unique<IndexNode>();
+        child->Name = std::move(value.Name);
+        child->IsKey = false;
+        child->Size = value.Size;
+        children.push_back(std::move(child));
+    }
+
+    // Sort once here, so that every enumeration of this key can hand the children out in order.
+    std::sort(children.begin(),
+              children.end(),
+              [](const std::unique_ptr<IndexNode>& child1, const std::unique_ptr<IndexNode>& child2)
+              {
+                  return CompareNodes(*child1, *child2) < 0;
+              });
+
+    AcquireSRWLockExclusive(&_lock);
+
+    // Another thread may have refreshed a key above this one in the meantime and found that this one
+    // is gone.  In that case there is nothing to update.
+    IndexNode* node = FindKeyNode(path);
+    if (node != nullptr)
+    {
+        // Both lists are sorted, so a single pass finds the subkeys that were there before.  Those
+        // keep their cached children (and their watches).
+        auto oldChild = node->Children.begin();
+        for (auto& child : children)
+        {
+            while (oldChild != node->Children.end() && CompareNodes(**oldChild, *child) < 0)
+            {
+                ++oldChild;
+            }
+
+            if (oldChild != node->Children.end() &&
+                child->IsKey &&
+                CompareNodes(**oldChild, *child) == 0)
+            {
+                (*oldChild)->Name = std::move(child->Name);
+                child = std::move(*oldChild);
+                ++oldChild;
+            }
+        }
+
+        node->Children = std::move(children);
+        node->Watch = std::move(watch);
+        node->Populated = true;
+    }
+
+    ReleaseSRWLockExclusive(&_lock);
+
+    return S_OK;
+}
+
+IndexNode* RegIndex::FindChild(const IndexNode& node, const std::wstring& name, bool keysOnly)
+{
+    // Subkeys sort ahead of values with the same name, so the first match is the subkey if there is
+    // one.
+    auto it = std::lower_bound(node.Children.begin(),
+                               node.Children.end(),
+                               name,
+                               [](const std::unique_ptr<IndexNode>& child, const std::wstring& name)
+                               {
+                                   return PrjFileNameCompare(child->Name.c_str(), name.c_str()) < 0;
+                               });
+
+    if (it == node.Children.end() ||
+        PrjFileNameCompare((*it)->Name.c_str(), name.c_str()) != 0 ||
+        (keysOnly && !(*it)->IsKey))
+    {
+        return nullptr;
+    }
+
+    return it->get();
+}
+
+IndexNode* RegIndex::FindKeyNode(const std::wstring& path)
+{
+    IndexNode* node = _root.get();
+    PathUtils::ForEachComponent(path, [&](const std::wstring& name, const std::wstring&)
+    {
+        node = FindChild(*node, name, true);
+        return node != nullptr;
+    });
+    return node;
+}
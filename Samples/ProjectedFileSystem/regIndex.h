@@ -0,0 +1,129 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    regIndex.h
+
+Abstract:
+
+    An in-memory index of the registry namespace that RegFS projects.
+
+    ProjFS asks about the same paths over and over: GetPlaceholderInfo is called for each component
+    of a path that is opened, and every directory enumeration asks for the full list of entries in a
+    key.  Answering each of these from the registry means opening keys and enumerating them again and
+    again.  The index instead keeps a trie of the keys and values seen so far, each key's children
+    already sorted in PrjFileNameCompare order, so that repeated lookups and listings are answered
+    from memory.
+
+    The index is populated lazily: a key's children are read from the registry the first time they
+    are needed.  At that point RegFS also asks the registry to signal it when the key's subkeys or
+    values change (RegNotifyChangeKeyValue).  When that happens the key is marked stale, and its
+    children are read again the next time they are needed.  Subkeys that are still there keep their
+    own cached children.
+
+    Each cached key holds an open registry handle, an event and a thread pool wait for its change
+    notification.
+
+--*/
+
+#pragma once
+
+namespace regfs {
+
+// Watches a registry key for changes to its subkeys and values.  A notification fires at most once,
+// so a key whose children are read again gets a new watch.
+class KeyWatch {
+
+public:
+
+    KeyWatch() = default;
+    KeyWatch(const KeyWatch&) = delete;
+    KeyWatch& operator=(const KeyWatch&) = delete;
+    ~KeyWatch();
+
+    // Starts watching the given key.  If ownsKey is true the watch closes the handle when it is
+    // destroyed.  If the watch cannot be set up it reports a change straight away, so that the key is
+    // never served from a stale cache.
+    void Start(HKEY hKey, bool ownsKey);
+
+    // Returns true once the key has changed since Start was called.
+    bool Changed() const
+    {
+        return _changed;
+    }
+
+private:
+
+    static VOID CALLBACK OnChange(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult);
+
+    HKEY _key = nullptr;
+    bool _ownsKey = false;
+    HANDLE _event = nullptr;
+    PTP_WAIT _wait = nullptr;
+    std::atomic<bool> _changed{ false };
+};
+
+// A key or value in the index.  Keys have children once they have been populated.
+struct IndexNode {
+    std::wstring Name;
+    bool IsKey;
+    INT64 Size;
+
+    // Keys only.
+    bool Populated = false;
+    std::vector<std::unique_ptr<IndexNode>> Children;   // In PrjFileNameCompare order.
+    std::unique_ptr<KeyWatch> Watch;                     // None for the virtualization root.
+
+    // A key that has been read but has changed since counts as stale unless ignoreChanges is set.
+    bool IsStale(bool ignoreChanges = false) const
+    {
+        return !Populated || (!ignoreChanges && Watch && Watch->Changed());
+    }
+};
+
+class RegIndex {
+
+public:
+
+    RegIndex(RegOps& regOps);
+    RegIndex(const RegIndex&) = delete;
+    RegIndex& operator=(const RegIndex&) = delete;
+
+    // Finds the key or value at the given path.  Returns HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) if
+    // there is none, and another error if a key on the way could not be read.
+    HRESULT Find(const std::wstring& path, bool& isKey, INT64& size);
+
+    // Adds an entry to dirInfo for each subkey and value of the key at the given path that matches
+    // searchExpression.  The entries are added in sorted order.
+    HRESULT FillDirInfo(const std::wstring& path, DirInfo* dirInfo, const std::wstring& searchExpression);
+
+private:
+
+    // Calls visit with the node for the key at the given path, under the shared lock, after reading
+    // the key's children from the registry if they are not cached.  A key that keeps changing is
+    // read at most MaxPopulateAttempts times; after that, visit sees what was read last.
+    template <typename Visit>
+    HRESULT VisitKey(const std::wstring& path, Visit visit);
+
+    // Reads the children of the key at the given path from the registry into its node.
+    HRESULT Populate(const std::wstring& path);
+
+    // Returns the child of node with the given name, or nullptr.  A subkey is preferred over a value
+    // with the same name, like RegFS does when it looks things up in the registry.
+    static IndexNode* FindChild(const IndexNode& node, const std::wstring& name, bool keysOnly);
+
+    // Returns the node for the key at the given path if it is in the index, without populating
+    // anything.  Must be called with the lock held.
+    IndexNode* FindKeyNode(const std::wstring& path);
+
+    RegOps& _regOps;
+
+    // Guards the whole trie.  Lookups take it shared; populating a key takes it exclusive, but only
+    // once the key has been read from the registry.
+    SRWLOCK _lock = SRWLOCK_INIT;
+    std::unique_ptr<IndexNode> _root;
+};
+
+}
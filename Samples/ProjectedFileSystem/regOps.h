@@ -107,8 +107,9 @@ public:
 
         if (ret != ERROR_SUCCESS)
         {
-            wprintf(L"%hs: RegQueryValueEx [%s]: %d\n",
-                    __FUNCTION__, valName.c_str(), ret);
+            RegfsLog(LogLevel::Warning,
+                     L"%hs: RegQueryValueEx [%ls]: %d",
+                     __FUNCTION__, valName.c_str(), ret);
             RegCloseKey(subkey);
             return false;
         }
@@ -125,8 +126,9 @@ public:
         OpenKeyByPath(path, subkey);
         if (subkey == nullptr)
         {
-            wprintf(L"%hs: key [%s] doesn't exist \n",
-                    __FUNCTION__, path.c_str());
+            RegfsLog(LogLevel::Verbose,
+                     L"%hs: key [%ls] doesn't exist",
+                     __FUNCTION__, path.c_str());
             return false;
         }
 
@@ -151,8 +153,9 @@ public:
             OpenKeyByPath(path.substr(0, pos), subkey);
             if (subkey == nullptr)
             {
-                wprintf(L"%hs: value [%s] doesn't exist \n",
-                        __FUNCTION__, path.substr(0, pos).c_str());
+                RegfsLog(LogLevel::Verbose,
+                         L"%hs: value [%ls] doesn't exist",
+                         __FUNCTION__, path.substr(0, pos).c_str());
                 return false;
             }
 
@@ -167,8 +170,9 @@ public:
 
             if (res != ERROR_SUCCESS)
             {
-                wprintf(L"%hs: Could not get value [%s] at key [%s]: %d\n",
-                        __FUNCTION__, valPathStr.c_str(), path.substr(0, pos).c_str(), res);
+                RegfsLog(LogLevel::Verbose,
+                         L"%hs: Could not get value [%ls] at key [%ls]: %d",
+                         __FUNCTION__, valPathStr.c_str(), path.substr(0, pos).c_str(), res);
                 return false;
             }
 
@@ -178,9 +182,8 @@ public:
         return true;
     }
 
-private:
-
-    // Gets the HKEY for a registry key given the path, if it exists.
+    // Gets the HKEY for a registry key given the path, if it exists.  For a predefined key this is
+    // the predefined HKEY value, which the caller must not close.
     HRESULT OpenKeyByPath(const std::wstring& path, HKEY& hKey)
     {
         HRESULT hr = S_OK;
@@ -198,8 +201,9 @@ private:
             }
             else
             {
-                wprintf(L"%hs: root key [%s] doesn't exist\n",
-                        __FUNCTION__, path.c_str());
+                RegfsLog(LogLevel::Verbose,
+                         L"%hs: root key [%ls] doesn't exist",
+                         __FUNCTION__, path.c_str());
                 hr = HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
             }
         }
@@ -217,8 +221,9 @@ private:
 
             if (res != ERROR_SUCCESS)
             {
-                wprintf(L"%hs: failed to open key [%s]: %d\n",
-                        __FUNCTION__, path.substr(pos + 1).c_str(), res);
+                RegfsLog(LogLevel::Verbose,
+                         L"%hs: failed to open key [%ls]: %d",
+                         __FUNCTION__, path.substr(pos + 1).c_str(), res);
                 hr = HRESULT_FROM_WIN32(res);
             }
         }
@@ -251,8 +256,9 @@ private:
 
         if (retCode != ERROR_SUCCESS)
         {
-            wprintf(L"%hs: RegQueryInfoKey: %d\n",
-                    __FUNCTION__, retCode);
+            RegfsLog(LogLevel::Warning,
+                     L"%hs: RegQueryInfoKey: %d",
+                     __FUNCTION__, retCode);
             return HRESULT_FROM_WIN32(retCode);
         }
 
@@ -262,8 +268,9 @@ private:
         // If there are subkeys, enumerate them until RegEnumKeyEx fails.
         if (subKeyCount)
         {
-            wprintf(L"\n%hs: Subkeys:\n",
-                    __FUNCTION__);
+            RegfsLog(LogLevel::Verbose,
+                     L"%hs: Subkeys:",
+                     __FUNCTION__);
 
             for (i = 0, retCode = ERROR_SUCCESS; retCode == ERROR_SUCCESS; i++)
             {
@@ -281,7 +288,7 @@ private:
 
                 if (retCode == ERROR_SUCCESS)
                 {
-                    wprintf(TEXT("(%d) %s\n"), i + 1, keyName);
+                    RegfsLog(LogLevel::Verbose, L"(%d) %ls", i + 1, keyName);
 
                     RegEntry entry;
                     entry.Name = std::wstring(keyName);
@@ -291,8 +298,9 @@ private:
                 }
                 else if (retCode != ERROR_NO_MORE_ITEMS)
                 {
-                    wprintf(L"%hs: RegEnumKeyEx: %d\n",
-                            __FUNCTION__, retCode);
+                    RegfsLog(LogLevel::Warning,
+                             L"%hs: RegEnumKeyEx: %d",
+                             __FUNCTION__, retCode);
                     hr = HRESULT_FROM_WIN32(retCode);
 
                     return hr;
@@ -306,8 +314,9 @@ private:
         // If there are values, enumerate them until RegEnumValue fails.
         if (valueCount)
         {
-            wprintf(L"\n%hs: Values: \n",
-                    __FUNCTION__);
+            RegfsLog(LogLevel::Verbose,
+                     L"%hs: Values:",
+                     __FUNCTION__);
 
             retCode = ERROR_SUCCESS;
 
@@ -328,7 +337,7 @@ private:
 
                 if (retCode == ERROR_SUCCESS)
                 {
-                    wprintf(TEXT("(%d) %s (%d bytes)\n"), i + 1, valueName, size);
+                    RegfsLog(LogLevel::Verbose, L"(%d) %ls (%d bytes)", i + 1, valueName, size);
 
                     RegEntry entry;
                     entry.Name = std::wstring(valueName);
@@ -338,8 +347,9 @@ private:
                 }
                 else if (retCode != ERROR_NO_MORE_ITEMS)
                 {
-                    wprintf(L"%hs: RegEnumValue: %d\n",
-                            __FUNCTION__, retCode);
+                    RegfsLog(LogLevel::Warning,
+                             L"%hs: RegEnumValue: %d",
+                             __FUNCTION__, retCode);
                     hr = HRESULT_FROM_WIN32(retCode);
 
                     return hr;
@@ -2,7 +2,8 @@
 
 using namespace regfs;
 
-RegfsProvider::RegfsProvider()
+RegfsProvider::RegfsProvider(BackingStore& store) :
+    _store(store)
 {
     // Record that this class implements the optional Notify callback.
     this->SetOptionalMethods(OptionalMethods::Notify);
@@ -76,41 +77,37 @@ HRESULT RegfsProvider::GetPlaceholderInfo(
     _In_    const PRJ_CALLBACK_DATA*    CallbackData
 )
 {
-    wprintf(L"\n----> %hs: Path [%s] triggered by [%s] \n",
-            __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs: Path [%ls] triggered by [%ls]",
+             __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
 
-    bool isKey;
-    INT64 valSize = 0;
+    bool isDirectory;
+    INT64 fileSize = 0;
 
-    // Find out whether the specified path exists in the registry, and whether it is a key or a value.
-    if (_regOps.DoesKeyExist(CallbackData->FilePathName))
-    {
-        isKey = true;
-    }
-    else if (_regOps.DoesValueExist(CallbackData->FilePathName, valSize))
-    {
-        isKey = false;
-    }
-    else
+    // Find out whether the specified path exists in the backing store, and whether it is a directory
+    // or a file.
+    HRESULT hr = _store.GetEntry(CallbackData->FilePathName, isDirectory, fileSize);
+    if (FAILED(hr))
     {
-        wprintf(L"<---- %hs: return 0x%08x\n",
-                __FUNCTION__, ERROR_FILE_NOT_FOUND);
-        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        RegfsLog(LogLevel::Verbose,
+                 L"<---- %hs: return 0x%08x",
+                 __FUNCTION__, hr);
+        return hr;
     }
 
-    // Format the PRJ_PLACEHOLDER_INFO structure.  For registry keys we create directories on disk,
-    // for values we create files.
+    // Format the PRJ_PLACEHOLDER_INFO structure.
     PRJ_PLACEHOLDER_INFO placeholderInfo = {};
-    placeholderInfo.FileBasicInfo.IsDirectory = isKey;
-    placeholderInfo.FileBasicInfo.FileSize = valSize;
+    placeholderInfo.FileBasicInfo.IsDirectory = isDirectory;
+    placeholderInfo.FileBasicInfo.FileSize = fileSize;
 
     // Create the on-disk placeholder.
-    HRESULT hr = this->WritePlaceholderInfo(CallbackData->FilePathName,
-                                            &placeholderInfo,
-                                            sizeof(placeholderInfo));
+    hr = this->WritePlaceholderInfo(CallbackData->FilePathName,
+                                    &placeholderInfo,
+                                    sizeof(placeholderInfo));
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, hr);
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, hr);
 
     return hr;
 }
@@ -135,8 +132,9 @@ HRESULT RegfsProvider::StartDirEnum(
     _In_     const GUID*                EnumerationId
 )
 {
-    wprintf(L"\n----> %hs: Path [%s] triggerred by [%s]\n",
-            __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs: Path [%ls] triggered by [%ls]",
+             __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
 
     // For each dir enum session, ProjFS sends:
     //      one StartEnumCallback
@@ -144,10 +142,15 @@ HRESULT RegfsProvider::StartDirEnum(
     //      one EndEnumCallback
     // These callbacks will use the same value for EnumerationId for the same session.
     // Here we map the EnumerationId to a new DirInfo object.
-    _activeEnumSessions[*EnumerationId] = std::make_unique<DirInfo>(CallbackData->FilePathName);
+    auto dirInfo = std::make_unique<DirInfo>(CallbackData->FilePathName);
+
+    AcquireSRWLockExclusive(&_enumSessionsLock);
+    _activeEnumSessions[*EnumerationId] = std::move(dirInfo);
+    ReleaseSRWLockExclusive(&_enumSessionsLock);
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, S_OK);
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, S_OK);
 
     return S_OK;
 };
@@ -166,14 +169,26 @@ HRESULT RegfsProvider::EndDirEnum(
     _In_     const GUID*                EnumerationId
 )
 {
-    wprintf(L"\n----> %hs\n",
-            __FUNCTION__);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs",
+             __FUNCTION__);
 
-    // Get rid of the DirInfo object we created in StartDirEnum.
-    _activeEnumSessions.erase(*EnumerationId);
+    // Get rid of the DirInfo object we created in StartDirEnum.  It is destroyed once the lock is
+    // released.
+    std::unique_ptr<DirInfo> dirInfo;
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, S_OK);
+    AcquireSRWLockExclusive(&_enumSessionsLock);
+    auto it = _activeEnumSessions.find(*EnumerationId);
+    if (it != _activeEnumSessions.end())
+    {
+        dirInfo = std::move(it->second);
+        _activeEnumSessions.erase(it);
+    }
+    ReleaseSRWLockExclusive(&_enumSessionsLock);
+
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, S_OK);
 
     return S_OK;
 };
@@ -184,8 +199,8 @@ Description:
 
     ProjFS invokes this callback to request a list of files and directories under the given directory.
 
-    To handle this callback, RegFS calls DirInfo->FillFileEntry/FillDirEntry for each matching file
-    or directory.
+    To handle this callback, RegFS asks the backing store to call DirInfo->FillFileEntry/FillDirEntry
+    for each matching file or directory.
 
     If the SearchExpression argument specifies something that doesn't exist in provider's namespace,
     or if the directory being enumerated is empty, the provider just returns S_OK without storing
@@ -215,27 +230,26 @@ HRESULT RegfsProvider::GetDirEnum(
     _In_        PRJ_DIR_ENTRY_BUFFER_HANDLE DirEntryBufferHandle
 )
 {
-    wprintf(L"\n----> %hs: Path [%s] SearchExpression [%s]\n",
-            __FUNCTION__, CallbackData->FilePathName, SearchExpression);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs: Path [%ls] SearchExpression [%ls]",
+             __FUNCTION__, CallbackData->FilePathName, SearchExpression);
 
     HRESULT hr = S_OK;
 
-    // Get the correct enumeration session from our map.
-    auto it = _activeEnumSessions.find(*EnumerationId);
-    if (it == _activeEnumSessions.end())
+    // Get our DirInfo helper object, which manages the context for this enumeration, from our map.
+    DirInfo* dirInfo = FindEnumSession(*EnumerationId);
+    if (dirInfo == nullptr)
     {
         // We were asked for an enumeration we don't know about.
         hr = E_INVALIDARG;
 
-        wprintf(L"<---- %hs: Unknown enumeration ID\n",
-                __FUNCTION__);
+        RegfsLog(LogLevel::Warning,
+                 L"<---- %hs: Unknown enumeration ID",
+                 __FUNCTION__);
 
         return hr;
     }
 
-    // Get out our DirInfo helper object, which manages the context for this enumeration.
-    auto& dirInfo = it->second;
-
     // If the enumeration is restarting, reset our bookkeeping information.
     if (CallbackData->Flags & PRJ_CB_DATA_FLAG_ENUM_RESTART_SCAN)
     {
@@ -244,23 +258,22 @@ HRESULT RegfsProvider::GetDirEnum(
 
     if (!dirInfo->EntriesFilled())
     {
-        // The DirInfo associated with the current session hasn't been initialized yet.  This method
-        // will enumerate the subkeys and values in the registry key corresponding to CallbackData->FilePathName.
-        // For each one that matches SearchExpression it will create an entry to return to ProjFS
-        // and store it in the DirInfo object.
-        HRESULT hr = PopulateDirInfoForPath(CallbackData->FilePathName,
-                                            dirInfo.get(),
-                                            SearchExpression);
+        // The DirInfo associated with the current session hasn't been initialized yet.  The backing
+        // store will enumerate the directory corresponding to CallbackData->FilePathName.  For each
+        // entry that matches SearchExpression it will create an entry to return to ProjFS and store
+        // it in the DirInfo object, sorted the way the file system expects.  A missing search
+        // expression matches everything.
+        hr = _store.FillDirInfo(CallbackData->FilePathName,
+                                dirInfo,
+                                SearchExpression != nullptr ? SearchExpression : L"*");
 
         if (FAILED(hr))
         {
-            wprintf(L"<---- %hs: Failed to populate dirInfo: 0x%08x\n",
-                    __FUNCTION__, hr);
+            RegfsLog(LogLevel::Warning,
+                     L"<---- %hs: Failed to populate dirInfo for [%ls]: 0x%08x",
+                     __FUNCTION__, CallbackData->FilePathName, hr);
             return hr;
         }
-
-        // This will ensure the entries in the DirInfo are sorted the way the file system expects.
-        dirInfo->SortEntriesAndMarkFilled();
     }
 
     // Return our directory entries to ProjFS.
@@ -268,8 +281,9 @@ HRESULT RegfsProvider::GetDirEnum(
     {
         // ProjFS allocates a fixed size buffer then invokes this callback.  The callback needs to
         // call PrjFillDirEntryBuffer to fill as many entries as possible until the buffer is full.
+        PRJ_FILE_BASIC_INFO basicInfo = dirInfo->CurrentBasicInfo();
         if (S_OK != PrjFillDirEntryBuffer(dirInfo->CurrentFileName(),
-                                          &dirInfo->CurrentBasicInfo(),
+                                          &basicInfo,
                                           DirEntryBufferHandle))
         {
             break;
@@ -281,50 +295,90 @@ HRESULT RegfsProvider::GetDirEnum(
         dirInfo->MoveNext();
     }
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, hr);
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, hr);
 
     return hr;
 };
 
-// Populates a DirInfo object with directory and file entires that represent the registry keys and
-// values that are under a given key.
-HRESULT RegfsProvider::PopulateDirInfoForPath (
-    _In_     std::wstring                       relativePath,
-    _In_     DirInfo*                           dirInfo,
-    _In_     std::wstring                       searchExpression
-)
+DirInfo* RegfsProvider::FindEnumSession(const GUID& enumerationId)
 {
-    RegEntries entries;
+    DirInfo* dirInfo = nullptr;
 
-    // Get a list of the registry keys and values under the given key.
-    HRESULT hr = _regOps.EnumerateKey(relativePath.c_str(), entries);
-    if (FAILED(hr))
+    AcquireSRWLockShared(&_enumSessionsLock);
+    auto it = _activeEnumSessions.find(enumerationId);
+    if (it != _activeEnumSessions.end())
     {
-        wprintf(L"%hs: Could not enumerate key: 0x%08x",
-                __FUNCTION__, hr);
-        return hr;
+        dirInfo = it->second.get();
     }
+    ReleaseSRWLockShared(&_enumSessionsLock);
 
-    // Store each registry key that matches searchExpression as a directory entry.
-    for (auto subKey : entries.SubKeys)
+    return dirInfo;
+}
+
+HRESULT RegfsProvider::ReplayRecursiveListing(
+    const std::wstring&     path,
+    ListingStats&           stats
+)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    // Walk the directories depth first, the way "dir /s" does, with an explicit stack so that deep keys
+    // cannot overflow the thread's stack.
+    std::vector<std::wstring> pending;
+    pending.push_back(path);
+
+    while (!pending.empty())
     {
-        if (PrjFileNameMatch(subKey.Name.c_str(), searchExpression.c_str()))
+        std::wstring directoryPath = std::move(pending.back());
+        pending.pop_back();
+
+        // StartDirEnum/GetDirEnum/EndDirEnum for the directory.
+        LARGE_INTEGER start, end;
+        DirInfo dirInfo(directoryPath.c_str());
+        QueryPerformanceCounter(&start);
+        HRESULT hr = _store.FillDirInfo(directoryPath, &dirInfo, L"*");
+        QueryPerformanceCounter(&end);
+
+        stats.Directories++;
+        stats.EnumSeconds += static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+        if (FAILED(hr))
         {
-            dirInfo->FillDirEntry(subKey.Name.c_str());
+            stats.Failures++;
+            continue;
         }
-    }
 
-    // Store each registry value that matches searchExpression as a file entry.
-    for (auto val : entries.Values)
-    {
-        if (PrjFileNameMatch(val.Name.c_str(), searchExpression.c_str()))
+        std::vector<std::wstring> subdirectoryPaths;
+        for (; dirInfo.CurrentIsValid(); dirInfo.MoveNext())
         {
-            dirInfo->FillFileEntry(val.Name.c_str(), val.Size);
+            if (dirInfo.CurrentBasicInfo().IsDirectory)
+            {
+                subdirectoryPaths.push_back(PathUtils::CombinePath(directoryPath, dirInfo.CurrentFileName()));
+            }
+        }
+
+        // GetPlaceholderInfo for each subdirectory, when the listing opens it.  Push them in reverse,
+        // so that they are visited in order.
+        for (auto it = subdirectoryPaths.rbegin(); it != subdirectoryPaths.rend(); ++it)
+        {
+            bool isDirectory;
+            INT64 fileSize;
+            QueryPerformanceCounter(&start);
+            hr = _store.GetEntry(*it, isDirectory, fileSize);
+            QueryPerformanceCounter(&end);
+
+            stats.Lookups++;
+            stats.LookupSeconds += static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+            if (SUCCEEDED(hr) && isDirectory)
+            {
+                pending.push_back(std::move(*it));
+            }
         }
     }
 
-    return hr;
+    return S_OK;
 }
 
 /*++
@@ -360,8 +414,9 @@ HRESULT RegfsProvider::GetFileData(
     _In_    UINT32                      Length
 )
 {
-    wprintf(L"\n----> %hs: Path [%s] triggered by [%s]\n",
-            __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs: Path [%ls] triggered by [%ls]",
+             __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
 
     HRESULT hr = S_OK;
 
@@ -373,8 +428,9 @@ HRESULT RegfsProvider::GetFileData(
 
     if (FAILED(hr))
     {
-        wprintf(L"<---- %hs: PrjGetVirtualizationInstanceInfo: 0x%08x\n",
-                __FUNCTION__, hr);
+        RegfsLog(LogLevel::Error,
+                 L"<---- %hs: PrjGetVirtualizationInstanceInfo: 0x%08x",
+                 __FUNCTION__, hr);
         return hr;
     }
 
@@ -387,24 +443,29 @@ HRESULT RegfsProvider::GetFileData(
 
     if (writeBuffer == nullptr)
     {
-        wprintf(L"<---- %hs: Could not allocate write buffer.\n",
-                __FUNCTION__);
+        RegfsLog(LogLevel::Error,
+                 L"<---- %hs: Could not allocate write buffer.",
+                 __FUNCTION__);
         return E_OUTOFMEMORY;
     }
 
-    // Read the data out of the registry.
-    if (!_regOps.ReadValue(CallbackData->FilePathName, reinterpret_cast<PBYTE>(writeBuffer), Length))
-    {
-        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    // Read the data out of the backing store.
+    hr = _store.ReadFile(CallbackData->FilePathName,
+                         ByteOffset,
+                         Length,
+                         reinterpret_cast<PBYTE>(writeBuffer));
 
+    if (FAILED(hr))
+    {
         PrjFreeAlignedBuffer(writeBuffer);
-        wprintf(L"<---- %hs: Failed to read from registry.\n",
-                __FUNCTION__);
+        RegfsLog(LogLevel::Warning,
+                 L"<---- %hs: Failed to read [%ls] from the backing store: 0x%08x",
+                 __FUNCTION__, CallbackData->FilePathName, hr);
 
         return hr;
     }
 
-    // Call ProjFS to write the data we read from the registry into the on-disk placeholder.
+    // Call ProjFS to write the data we read from the backing store into the on-disk placeholder.
     hr = this->WriteFileData(&CallbackData->DataStreamId,
                              reinterpret_cast<PVOID>(writeBuffer),
                              ByteOffset,
@@ -414,15 +475,17 @@ HRESULT RegfsProvider::GetFileData(
     {
         // If this callback returns an error, ProjFS will return this error code to the thread that
         // issued the file read, and the target file will remain an empty placeholder.
-        wprintf(L"%hs: failed to write file for [%s]: 0x%08x\n",
-                __FUNCTION__, CallbackData->FilePathName, hr);
+        RegfsLog(LogLevel::Warning,
+                 L"%hs: failed to write file for [%ls]: 0x%08x",
+                 __FUNCTION__, CallbackData->FilePathName, hr);
     }
 
     // Free the memory-aligned buffer we allocated.
     PrjFreeAlignedBuffer(writeBuffer);
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, hr);
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, hr);
 
     return hr;
 }
@@ -462,9 +525,9 @@ HRESULT RegfsProvider::Notify (
 {
     HRESULT hr = S_OK;
 
-    wprintf(L"\n----> %hs: Path [%s] triggered by [%s]",
-            __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName);
-    wprintf(L"\n----  Notification: 0x%08x\n", NotificationType);
+    RegfsLog(LogLevel::Verbose,
+             L"----> %hs: Path [%ls] triggered by [%ls] Notification: 0x%08x",
+             __FUNCTION__, CallbackData->FilePathName, CallbackData->TriggeringProcessImageFileName, NotificationType);
 
     switch (NotificationType)
     {
@@ -475,23 +538,23 @@ HRESULT RegfsProvider::Notify (
     case PRJ_NOTIFICATION_FILE_HANDLE_CLOSED_FILE_MODIFIED:
     case PRJ_NOTIFICATION_FILE_OVERWRITTEN:
 
-        wprintf(L"\n ----- [%s] was modified\n", CallbackData->FilePathName);
+        RegfsLog(LogLevel::Info, L" ----- [%ls] was modified", CallbackData->FilePathName);
         break;
 
     case PRJ_NOTIFICATION_NEW_FILE_CREATED:
 
-        wprintf(L"\n ----- [%s] was created\n", CallbackData->FilePathName);
+        RegfsLog(LogLevel::Info, L" ----- [%ls] was created", CallbackData->FilePathName);
         break;
 
     case PRJ_NOTIFICATION_FILE_RENAMED:
 
-        wprintf(L"\n ----- [%s] -> [%s]\n", CallbackData->FilePathName,
-                DestinationFileName);
+        RegfsLog(LogLevel::Info, L" ----- [%ls] -> [%ls]", CallbackData->FilePathName,
+                 DestinationFileName);
         break;
 
     case PRJ_NOTIFICATION_FILE_HANDLE_CLOSED_FILE_DELETED:
 
-        wprintf(L"\n ----- [%s] was deleted\n", CallbackData->FilePathName);
+        RegfsLog(LogLevel::Info, L" ----- [%ls] was deleted", CallbackData->FilePathName);
         break;
 
     case PRJ_NOTIFICATION_PRE_RENAME:
@@ -500,11 +563,11 @@ HRESULT RegfsProvider::Notify (
         {
             // Block file renames.
             hr = HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED);
-            wprintf(L"\n ----- rename request for [%s] was rejected \n", CallbackData->FilePathName);
+            RegfsLog(LogLevel::Info, L" ----- rename request for [%ls] was rejected", CallbackData->FilePathName);
         }
         else
         {
-            wprintf(L"\n ----- rename request for [%s] \n", CallbackData->FilePathName);
+            RegfsLog(LogLevel::Info, L" ----- rename request for [%ls]", CallbackData->FilePathName);
         }
         break;
 
@@ -515,11 +578,11 @@ HRESULT RegfsProvider::Notify (
             // Block file deletion.  We must return a particular NTSTATUS to ensure the file system
             // properly recognizes that this is a deny-delete.
             hr = HRESULT_FROM_NT(STATUS_CANNOT_DELETE);
-            wprintf(L"\n ----- delete request for [%s] was rejected \n", CallbackData->FilePathName);
+            RegfsLog(LogLevel::Info, L" ----- delete request for [%ls] was rejected", CallbackData->FilePathName);
         }
         else
         {
-            wprintf(L"\n ----- delete request for [%s] \n", CallbackData->FilePathName);
+            RegfsLog(LogLevel::Info, L" ----- delete request for [%ls]", CallbackData->FilePathName);
         }
         break;
 
@@ -529,11 +592,13 @@ HRESULT RegfsProvider::Notify (
 
     default:
 
-        wprintf(L"%hs: Unexpected notification\n",
-                __FUNCTION__);
+        RegfsLog(LogLevel::Warning,
+                 L"%hs: Unexpected notification",
+                 __FUNCTION__);
     }
 
-    wprintf(L"<---- %hs: return 0x%08x\n",
-            __FUNCTION__, hr);
+    RegfsLog(LogLevel::Verbose,
+             L"<---- %hs: return 0x%08x",
+             __FUNCTION__, hr);
     return hr;
 }
\ No newline at end of file
@@ -12,9 +12,10 @@ Abstract:
    system.  This class and the VirtualizationInstance class comprise the interface to ProjFS.  The
    other classes in this sample are helpers.
 
-   This class understands how to map the Windows registry to the ProjFS callbacks.  It uses the RegInfo
-   helper class to access the registry, and it overrides callback methods in the VirtualizationInstance
-   class to feed registry data to the file system via ProjFS.
+   This class understands how to map a backing store to the ProjFS callbacks.  It overrides callback
+   methods in the VirtualizationInstance class to feed the directories and files of a BackingStore to
+   the file system via ProjFS.  RegFS gives it a RegistryStore, which maps registry keys to directories
+   and registry values to files.
 
 --*/
 
@@ -24,7 +25,23 @@ class RegfsProvider : public VirtualizationInstance {
 
 public:
 
-    RegfsProvider();
+    // Constructs a provider that projects the given store.  The store must outlive the provider.
+    RegfsProvider(BackingStore& store);
+
+    // What ReplayRecursiveListing measured.
+    struct ListingStats {
+        UINT64 Directories = 0;
+        UINT64 Failures = 0;
+        UINT64 Lookups = 0;
+        double EnumSeconds = 0;
+        double LookupSeconds = 0;
+    };
+
+    // Replays the callbacks a recursive listing of the given path (such as "dir /s") causes, without
+    // going through ProjFS: a directory enumeration of every directory under the path, and a
+    // placeholder lookup for every subdirectory before it is entered.  Accumulates the time the
+    // provider takes to answer them into stats.  This is what "regfs.exe -benchmark" runs.
+    HRESULT ReplayRecursiveListing(const std::wstring& path, ListingStats& stats);
 
 private:
 
@@ -70,14 +87,8 @@ private:
 
 private:
 
-    // Helper routine 
-    HRESULT PopulateDirInfoForPath (
-        _In_     std::wstring                    relativePath,
-        _In_     DirInfo*                        dirInfo,
-        _In_     std::wstring                    searchExpression
-    );
-
-    RegOps _regOps;
+    // The namespace this provider projects.
+    BackingStore& _store;
 
     // If this flag is set to true, RegFS will block the following namespace-altering operations
     // that take place under virtualization root:
@@ -91,8 +102,14 @@ private:
     bool _readOnlyFileContent = true;
 
     // An enumeration session starts when StartDirEnum is invoked and ends when EndDirEnum is invoked.
-    // This tracks the active enumeration sessions.
+    // This tracks the active enumeration sessions.  ProjFS invokes callbacks on several threads at once,
+    // so the map is guarded by _enumSessionsLock.  The callbacks for any one session come one at a time,
+    // so a session's DirInfo needs no lock of its own.
+    SRWLOCK _enumSessionsLock = SRWLOCK_INIT;
     std::map<GUID, std::unique_ptr<DirInfo>, GUIDComparer> _activeEnumSessions;
+
+    // Returns the DirInfo for the given enumeration session, or nullptr if there is no such session.
+    DirInfo* FindEnumSession(const GUID& enumerationId);
 };
 
 }
\ No newline at end of file
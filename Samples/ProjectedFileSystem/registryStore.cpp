@@ -0,0 +1,136 @@
+#include "stdafx.h"
+
+using namespace regfs;
+
+//////////////////////////////////////////////////////////////////////////
+// See registryStore.h for descriptions of the routines in this module.
+//////////////////////////////////////////////////////////////////////////
+
+RegistryStore::RegistryStore(bool useIndex) :
+    _useIndex(useIndex)
+{}
+
+HRESULT RegistryStore::GetEntry(
+    _In_    const std::wstring& path,
+    _Out_   bool&               isDirectory,
+    _Out_   INT64&              fileSize
+)
+{
+    isDirectory = false;
+    fileSize = 0;
+
+    if (_useIndex)
+    {
+        HRESULT hr = _regIndex.Find(path, isDirectory, fileSize);
+
+        // If a key on the way could not be enumerated, the path may still be there: the registry checks
+        // access on the key that is opened, not on the keys above it.  Ask the registry directly then.
+        if (SUCCEEDED(hr) || hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))
+        {
+            return hr;
+        }
+    }
+
+    if (_regOps.DoesKeyExist(path))
+    {
+        isDirectory = true;
+    }
+    else if (_regOps.DoesValueExist(path, fileSize))
+    {
+        isDirectory = false;
+    }
+    else
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    return S_OK;
+}
+
+HRESULT RegistryStore::FillDirInfo(
+    _In_    const std::wstring& path,
+    _In_    DirInfo*            dirInfo,
+    _In_    const std::wstring& searchExpression
+)
+{
+    if (_useIndex)
+    {
+        // The index keeps each key's children sorted already.
+        HRESULT hr = _regIndex.FillDirInfo(path, dirInfo, searchExpression);
+        if (SUCCEEDED(hr))
+        {
+            dirInfo->MarkFilled();
+        }
+        return hr;
+    }
+
+    RegEntries entries;
+
+    // Get a list of the registry keys and values under the given key.
+    HRESULT hr = _regOps.EnumerateKey(path.c_str(), entries);
+    if (FAILED(hr))
+    {
+        RegfsLog(LogLevel::Warning,
+                 L"%hs: Could not enumerate key [%ls]: 0x%08x",
+                 __FUNCTION__, path.c_str(), hr);
+        return hr;
+    }
+
+    // Store each registry key that matches searchExpression as a directory entry.
+    for (auto& subKey : entries.SubKeys)
+    {
+        if (PrjFileNameMatch(subKey.Name.c_str(), searchExpression.c_str()))
+        {
+            dirInfo->FillDirEntry(subKey.Name.c_str());
+        }
+    }
+
+    // Store each registry value that matches searchExpression as a file entry.
+    for (auto& val : entries.Values)
+    {
+        if (PrjFileNameMatch(val.Name.c_str(), searchExpression.c_str()))
+        {
+            dirInfo->FillFileEntry(val.Name.c_str(), val.Size);
+        }
+    }
+
+    // This will ensure the entries in the DirInfo are sorted the way the file system expects.
+    dirInfo->SortEntriesAndMarkFilled();
+
+    return hr;
+}
+
+HRESULT RegistryStore::ReadFile(
+    _In_    const std::wstring& path,
+    _In_    UINT64              byteOffset,
+    _In_    UINT32              length,
+    _Out_   PBYTE               buffer
+)
+{
+    // The registry only reads a value from its start.  ProjFS asks for the whole of a file this small
+    // in one request, so reading the value into a temporary buffer for a request further in is rare.
+    if (byteOffset == 0)
+    {
+        UINT32 readLength = length;
+        if (!_regOps.ReadValue(path, buffer, readLength))
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+        }
+        return S_OK;
+    }
+
+    if (byteOffset > MAXDWORD - length)
+    {
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    std::vector<BYTE> value(static_cast<size_t>(byteOffset) + length);
+    UINT32 readLength = static_cast<UINT32>(value.size());
+    if (!_regOps.ReadValue(path, value.data(), readLength))
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    memcpy(buffer, value.data() + byteOffset, length);
+    return S_OK;
+}
@@ -0,0 +1,59 @@
+/*++
+
+Copyright (c) Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    registryStore.h
+
+Abstract:
+
+    The backing store that projects the Windows registry: registry keys are directories and registry
+    values are files.  It uses the RegOps helper class to read the registry, and by default answers
+    from the in-memory index in regIndex.h.
+
+--*/
+
+#pragma once
+
+namespace regfs {
+
+class RegistryStore : public BackingStore {
+
+public:
+
+    // If useIndex is false, every request is answered straight from the registry, as RegFS did before
+    // it had an index.  That is only useful to compare the two.
+    RegistryStore(bool useIndex = true);
+
+    HRESULT GetEntry(
+        _In_    const std::wstring& path,
+        _Out_   bool&               isDirectory,
+        _Out_   INT64&              fileSize
+    ) override;
+
+    HRESULT FillDirInfo(
+        _In_    const std::wstring& path,
+        _In_    DirInfo*            dirInfo,
+        _In_    const std::wstring& searchExpression
+    ) override;
+
+    HRESULT ReadFile(
+        _In_    const std::wstring& path,
+        _In_    UINT64              byteOffset,
+        _In_    UINT32              length,
+        _Out_   PBYTE               buffer
+    ) override;
+
+private:
+
+    RegOps _regOps;
+
+    // If this flag is set to true, RegFS answers requests from _regIndex, an in-memory index of the
+    // registry keys and values it has seen, and goes to the registry only for keys it has not read yet
+    // or that have changed since.
+    bool _useIndex = true;
+    RegIndex _regIndex{ _regOps };
+};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#ifdef _WIN32
+
 // prevent redefinition of NTSTATUS messages
 #define UMDF_USING_NTSTATUS
 
@@ -8,20 +10,43 @@
 
 #include <ntstatus.h>   // For STATUS_CANNOT_DELETE
 
+#endif
+
 // STL
 #include <string>
+#include <atomic>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef _WIN32
 
 // Windows SDK
 #include <projectedfslib.h>
 
+#else
+
+// Stand-ins for the parts of the Windows SDK and ProjFS that the provider framework uses, so that it
+// can be driven by the harness without ProjFS.  The registry store is Windows only.
+#include "harness/projfsShim.h"
+
+#endif
+
 // regfs headers
+#include "logger.h"
 #include "dirInfo.h"
 #include "virtualizationInstance.h"
 #include "pathUtils.h"
+#include "backingStore.h"
+#include "dirTreeStore.h"
+#ifdef _WIN32
 #include "RegOps.h"
+#include "regIndex.h"
+#include "registryStore.h"
+#endif
 #include "regfsProvider.h"
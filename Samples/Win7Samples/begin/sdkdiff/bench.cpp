@@ -0,0 +1,670 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+/*
+ * bench.cpp
+ *
+ * timing runs for the comparison engine (sdkdiff -B). Each test times
+ * an operation the comparison does many times, on made-up input whose
+ * shape is the one that matters for that operation, and writes one
+ * line of results per case.
+ *
+ * The TREE test compares the hash table in tree.cpp with the unbalanced
+ * binary tree it replaced, a copy of which is kept here for the purpose.
+ * Both are driven the way section_makectree and section_matchlists drive
+ * a CTREE: one ctree_update per line, then a count and a find per line.
+ *
+ * The HASH test times hash_string and line_compare with and without
+ * their SSE2 paths (see utils_enablesimd), with blanks counted and with
+ * them ignored, over lines whose lengths follow a mix of source code and
+ * log files. The lines are packed into one text block, as file_readlines
+ * packs them, so they start at every alignment. It also checks that
+ * line_compare gives the same answer both ways on DBCS text.
+ *
+ * The DIFF test is the exception: it compares real files, the ones given
+ * on the command line, once with the section matching algorithm and once
+ * with the linear (Myers) diff, and reports how many lines each found
+ * moved. The files are read before either is timed.
+ */
+
+#include "precomp.h"
+
+#include "sdkdiff.h"
+#include "tree.h"
+#include "list.h"
+#include "scandir.h"
+#include "file.h"
+#include "compitem.h"
+#include "complist.h"
+#include "line.h"
+#include "section.h"
+#include "state.h"
+#include "bench.h"
+
+
+/* -- results file and timer ---------------------------------------- */
+
+static HANDLE bench_fh;
+static LARGE_INTEGER bench_freq;
+
+/* printf to the results file */
+static void
+bench_printf(LPCSTR fmt, ...)
+{
+    char msg[512];
+    DWORD cbWritten;
+    va_list va;
+    HRESULT hr;
+
+    va_start(va, fmt);
+    hr = StringCchVPrintf(msg, sizeof(msg), fmt, va);
+    va_end(va);
+    if (FAILED(hr)) {
+        OutputError(hr, IDS_SAFE_PRINTF);
+        return;
+    }
+    WriteFile(bench_fh, msg, lstrlen(msg), &cbWritten, NULL);
+}
+
+static LONGLONG
+bench_now(void)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+    return(now.QuadPart);
+}
+
+/* milliseconds since start, a bench_now value */
+static double
+bench_ms(LONGLONG start)
+{
+    return((double) (bench_now() - start) * 1000.0 / (double) bench_freq.QuadPart);
+}
+
+/* the same pseudo-random sequence on every run (Knuth's LCG) */
+static DWORD
+bench_random(DWORD * pseed)
+{
+    *pseed = *pseed * 1664525 + 1013904223;
+    return(*pseed);
+}
+
+
+/* -- TREE ------------------------------------------------------------ */
+
+/*
+ * the unbalanced binary tree that tree.cpp used to be, reduced to the
+ * operations a CTREE needs. Items and data blocks are allocated
+ * separately, as they were.
+ */
+typedef struct btreeitem FAR * BTREEITEM;
+struct btreeitem {
+    TREEKEY key;
+    BTREEITEM left, right;
+    LPVOID data;
+};
+
+/* find the item for key, or the parent a new item would hang off */
+static BTREEITEM
+btree_getitem(BTREEITEM root, TREEKEY key)
+{
+    BTREEITEM item, prev = NULL;
+
+    for (item = root; item != NULL; ) {
+        if (item->key == key) {
+            return(item);
+        }
+        prev = item;
+        item = (key < item->key) ? item->left : item->right;
+    }
+    return(prev);
+}
+
+/* as ctree_update: count a repeat, or insert the key with a count of 1 */
+static void
+btree_update(BTREEITEM * proot, TREEKEY key, LPVOID value, UINT length)
+{
+    BTREEITEM parent, item;
+    LONG_PTR FAR * pcounter;
+
+    parent = btree_getitem(*proot, key);
+    if (parent != NULL && parent->key == key) {
+        (*(LONG_PTR FAR *) parent->data)++;
+        return;
+    }
+
+    item = (BTREEITEM) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(struct btreeitem));
+    if (item == NULL) {
+        return;
+    }
+    item->key = key;
+    item->data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, length + sizeof(LONG_PTR));
+    if (item->data == NULL) {
+        HeapFree(GetProcessHeap(), NULL, item);
+        return;
+    }
+    pcounter = (LONG_PTR FAR *) item->data;
+    *pcounter = 1;
+    memcpy(pcounter + 1, value, length);
+
+    if (parent == NULL) {
+        *proot = item;
+    } else if (key < parent->key) {
+        parent->left = item;
+    } else {
+        parent->right = item;
+    }
+}
+
+/* as ctree_getcount */
+static long
+btree_getcount(BTREEITEM root, TREEKEY key)
+{
+    BTREEITEM item = btree_getitem(root, key);
+
+    if (item == NULL || item->key != key) {
+        return(0);
+    }
+    return((long) *(LONG_PTR FAR *) item->data);
+}
+
+/* as ctree_find */
+static LPVOID
+btree_find(BTREEITEM root, TREEKEY key)
+{
+    BTREEITEM item = btree_getitem(root, key);
+
+    if (item == NULL || item->key != key) {
+        return(NULL);
+    }
+    return((LONG_PTR FAR *) item->data + 1);
+}
+
+/* free a whole tree, without recursing, since a degenerate tree is as
+ * deep as it is long
+ */
+static void
+btree_delete(BTREEITEM root)
+{
+    BTREEITEM item;
+
+    while (root != NULL) {
+        if (root->left != NULL) {
+            /* rotate the left child up, so we only ever descend right */
+            item = root->left;
+            root->left = item->right;
+            item->right = root;
+            root = item;
+        } else {
+            item = root->right;
+            HeapFree(GetProcessHeap(), NULL, root->data);
+            HeapFree(GetProcessHeap(), NULL, root);
+            root = item;
+        }
+    }
+}
+
+/*
+ * time one key stream through both implementations. Every key is
+ * inserted, then counted and found, as section matching does. Returns
+ * FALSE if the two disagree about the counts.
+ */
+static BOOL
+bench_treecase(LPCSTR name, TREEKEY FAR * keys, int nkeys)
+{
+    TREE tree;
+    BTREEITEM broot = NULL;
+    LONGLONG start;
+    double msold, msnew;
+    LONG_PTR value;
+    long check = 0;
+    int i;
+
+    start = bench_now();
+    for (i = 0; i < nkeys; i++) {
+        value = i;
+        btree_update(&broot, keys[i], &value, sizeof(value));
+    }
+    for (i = 0; i < nkeys; i++) {
+        check += btree_getcount(broot, keys[i]) + (btree_find(broot, keys[i]) != NULL);
+    }
+    msold = bench_ms(start);
+    btree_delete(broot);
+
+    start = bench_now();
+    tree = ctree_create();
+    for (i = 0; i < nkeys; i++) {
+        value = i;
+        ctree_update(tree, keys[i], &value, sizeof(value));
+    }
+    for (i = 0; i < nkeys; i++) {
+        check -= ctree_getcount(tree, keys[i]) + (ctree_find(tree, keys[i]) != NULL);
+    }
+    msnew = bench_ms(start);
+    ctree_delete(tree);
+
+    bench_printf("tree\t%-10s %7d keys\told %10.3f ms\tnew %10.3f ms\t%8.1fx%s\r\n",
+                 name, nkeys, msold, msnew, msnew > 0 ? msold / msnew : 0.0,
+                 check == 0 ? "" : "\tMISMATCH");
+    return(check == 0);
+}
+
+static void
+bench_tree(void)
+{
+    static const int sizes[] = { 10000, 40000 };
+    TREEKEY FAR * keys;
+    DWORD seed;
+    UINT s;
+    int i, n;
+
+    keys = (TREEKEY FAR *) HeapAlloc(GetProcessHeap(), 0,
+                                     sizes[NUMELMS(sizes) - 1] * sizeof(TREEKEY));
+    if (keys == NULL) {
+        return;
+    }
+
+    for (s = 0; s < NUMELMS(sizes); s++) {
+        n = sizes[s];
+
+        /* ascending, as the hash codes of a sorted table tend to be */
+        for (i = 0; i < n; i++) {
+            keys[i] = 1000 + i * 7;
+        }
+        bench_treecase("sorted", keys, n);
+
+        /* a quarter of the keys repeated, as blank lines and braces are */
+        seed = 1;
+        for (i = 0; i < n; i++) {
+            keys[i] = bench_random(&seed);
+            if (i % 4 == 3) {
+                keys[i] = keys[bench_random(&seed) % i];
+            }
+        }
+        bench_treecase("random", keys, n);
+    }
+
+    HeapFree(GetProcessHeap(), NULL, keys);
+}
+
+
+/* -- HASH ------------------------------------------------------------ */
+
+#define BENCH_HASHLINES     100000
+#define BENCH_HASHPASSES    10
+#define BENCH_MAXLINE       400
+
+/*
+ * make up a line of text ending in \r\n, and return its length. Most
+ * lines are code-like: indented, 20-120 characters of words. A few are
+ * blank or a brace, and a few are long, like log and CSV lines.
+ */
+static int
+bench_makeline(DWORD * pseed, LPSTR buf)
+{
+    DWORD kind = bench_random(pseed) % 100;
+    DWORD c;
+    int len, indent, i;
+
+    if (kind < 15) {
+        len = kind % 9;
+    } else if (kind < 65) {
+        len = 20 + bench_random(pseed) % 41;
+    } else if (kind < 90) {
+        len = 60 + bench_random(pseed) % 61;
+    } else {
+        len = 120 + bench_random(pseed) % (BENCH_MAXLINE - 120 + 1);
+    }
+
+    indent = (int) (bench_random(pseed) % 4) * 4;
+    if (indent > len) {
+        indent = len;
+    }
+    for (i = 0; i < indent; i++) {
+        buf[i] = (kind & 1) ? '\t' : ' ';
+    }
+    for (; i < len; i++) {
+        c = bench_random(pseed) >> 16;
+        buf[i] = (c % 7 == 0) ? ' ' : (char) ('a' + c % 26);
+    }
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+    return(len);
+}
+
+/*
+ * fill list with BENCH_HASHLINES lines whose text is packed into one
+ * block, which is returned. The same seed gives the same lines.
+ */
+static LPSTR
+bench_makelines(LIST list, DWORD seed, int * pcbtext)
+{
+    char buf[BENCH_MAXLINE + 2];
+    LPSTR text, next;
+    DWORD s;
+    int cb = 0;
+    int i, len;
+
+    /* once to size the block, once to fill it */
+    s = seed;
+    for (i = 0; i < BENCH_HASHLINES; i++) {
+        cb += bench_makeline(&s, buf) + 1;
+    }
+    text = (LPSTR) HeapAlloc(GetProcessHeap(), 0, cb);
+    if (text == NULL) {
+        return(NULL);
+    }
+
+    s = seed;
+    next = text;
+    for (i = 0; i < BENCH_HASHLINES; i++) {
+        len = bench_makeline(&s, buf);
+        line_newinbuffer(buf, len, NULL, 0, i + 1, list, next);
+        next += len + 1;
+    }
+    *pcbtext = cb;
+    return(text);
+}
+
+/* hash every line in list BENCH_HASHPASSES times. *psum gets a check */
+static double
+bench_hashpass(LIST list, BOOL bIgnoreBlanks, DWORD * psum)
+{
+    LINE line;
+    LONGLONG start;
+    DWORD sum = 0;
+    int pass;
+
+    start = bench_now();
+    for (pass = 0; pass < BENCH_HASHPASSES; pass++) {
+        for (line = (LINE)List_First(list); line != NULL; line = (LINE)List_Next((LPVOID)line)) {
+            sum += hash_string(line_gettext(line), bIgnoreBlanks);
+        }
+    }
+    *psum = sum;
+    return(bench_ms(start));
+}
+
+/* compare each line of left with the same line of right (they are all
+ * the same) BENCH_HASHPASSES times. *pnsame gets the number that matched.
+ */
+static double
+bench_comparepass(LIST left, LIST right, int * pnsame)
+{
+    LINE line1, line2;
+    LONGLONG start;
+    int nsame = 0;
+    int pass;
+
+    start = bench_now();
+    for (pass = 0; pass < BENCH_HASHPASSES; pass++) {
+        line2 = (LINE)List_First(right);
+        for (line1 = (LINE)List_First(left); line1 != NULL; line1 = (LINE)List_Next((LPVOID)line1)) {
+            nsame += line_compare(line1, line2);
+            line2 = (LINE)List_Next((LPVOID)line2);
+        }
+    }
+    *pnsame = nsame;
+    return(bench_ms(start));
+}
+
+static void
+bench_deletelines(LIST list)
+{
+    LINE line;
+
+    for (line = (LINE)List_First(list); line != NULL; line = (LINE)List_Next((LPVOID)line)) {
+        line_delete(line);
+    }
+    List_Destroy(&list);
+}
+
+/*
+ * line_compare on DBCS text, with blanks ignored: a line with a blank
+ * after a DBCS character whose trail byte is also a lead byte, against
+ * the same line without the blank. They match. The character is moved
+ * along one byte at a time so that, at some offset, it straddles the
+ * end of a block the SSE2 path skips. Needs a DBCS ANSI code page.
+ */
+static void
+bench_dbcs(void)
+{
+    BOOL bBlanks = ignore_blanks;
+    char text1[64], text2[64];
+    LINE line1, line2;
+    int c, lead = 0, k, i;
+    int nwrong = 0;
+
+    /* a lead byte, and a second one to use as its trail */
+    for (c = 0x81; c <= 0xfe; c++) {
+        if (IsDBCSLeadByte((BYTE) c)) {
+            if (lead == 0) {
+                lead = c;
+            } else {
+                break;
+            }
+        }
+    }
+    if (c > 0xfe) {
+        bench_printf("dbcs	code page %u is not a DBCS code page\r\n", GetACP());
+        return;
+    }
+
+    ignore_blanks = TRUE;
+    for (k = 0; k < 32; k++) {
+        for (i = 0; i < k; i++) {
+            text1[i] = text2[i] = (char) ('a' + i % 26);
+        }
+        text1[i] = text2[i] = (char) lead;
+        text1[i + 1] = text2[i + 1] = (char) c;
+        lstrcpy(text1 + i + 2, " a\r\n");
+        lstrcpy(text2 + i + 2, "a\r\n");
+
+        line1 = line_new(text1, lstrlen(text1), NULL, 0, 1, NULL);
+        line2 = line_new(text2, lstrlen(text2), NULL, 0, 1, NULL);
+        if (line1 == NULL || line2 == NULL) {
+            nwrong++;
+        } else {
+            utils_enablesimd(FALSE);
+            nwrong += !line_compare(line1, line2);
+            utils_enablesimd(TRUE);
+            nwrong += !line_compare(line1, line2);
+        }
+        line_delete(line1);
+        line_delete(line2);
+    }
+    ignore_blanks = bBlanks;
+
+    bench_printf("dbcs	code page %u, ignore blanks, %d offsets%s\r\n",
+                 GetACP(), k, nwrong == 0 ? "" : "\tMISMATCH");
+}
+
+static void
+bench_hash(void)
+{
+    BOOL bBlanks = ignore_blanks;
+    LIST left, right;
+    LPSTR textleft, textright;
+    LINE line1, line2;
+    double msscalar, mssimd, mb;
+    DWORD sumscalar, sumsimd;
+    int nscalar, nsimd;
+    int cbtext;
+    int blanks;
+
+    if (!utils_usesimd()) {
+        bench_printf("hash\tSSE2 is not available\r\n");
+        return;
+    }
+
+    left = List_Create();
+    right = List_Create();
+    textleft = bench_makelines(left, 1, &cbtext);
+    textright = bench_makelines(right, 1, &cbtext);
+    if (textleft == NULL || textright == NULL) {
+        bench_printf("hash\tout of memory\r\n");
+    } else {
+        mb = (double) cbtext * BENCH_HASHPASSES / (1024.0 * 1024.0);
+        bench_printf("hash\t%d lines, %d bytes, %d passes\r\n",
+                     BENCH_HASHLINES, cbtext, BENCH_HASHPASSES);
+
+        for (blanks = 0; blanks <= 1; blanks++) {
+            utils_enablesimd(FALSE);
+            msscalar = bench_hashpass(left, blanks, &sumscalar);
+            utils_enablesimd(TRUE);
+            mssimd = bench_hashpass(left, blanks, &sumsimd);
+
+            bench_printf("hash\t%-14s scalar %8.3f ms %8.1f MB/s\tsse2 %8.3f ms %8.1f MB/s\t%6.1fx%s\r\n",
+                         blanks ? "ignore blanks" : "blanks count",
+                         msscalar, msscalar > 0 ? mb * 1000.0 / msscalar : 0.0,
+                         mssimd, mssimd > 0 ? mb * 1000.0 / mssimd : 0.0,
+                         mssimd > 0 ? msscalar / mssimd : 0.0,
+                         sumscalar == sumsimd ? "" : "\tMISMATCH");
+
+            /* line_compare: the hash codes are worked out and cached
+             * first, so only the comparison of the text is timed
+             */
+            ignore_blanks = blanks;
+            line2 = (LINE)List_First(right);
+            for (line1 = (LINE)List_First(left); line1 != NULL; line1 = (LINE)List_Next((LPVOID)line1)) {
+                line_reset(line1);
+                line_reset(line2);
+                line_gethashcode(line1);
+                line_gethashcode(line2);
+                line2 = (LINE)List_Next((LPVOID)line2);
+            }
+
+            utils_enablesimd(FALSE);
+            msscalar = bench_comparepass(left, right, &nscalar);
+            utils_enablesimd(TRUE);
+            mssimd = bench_comparepass(left, right, &nsimd);
+
+            bench_printf("compare\t%-14s scalar %8.3f ms %8.1f MB/s\tsse2 %8.3f ms %8.1f MB/s\t%6.1fx%s\r\n",
+                         blanks ? "ignore blanks" : "blanks count",
+                         msscalar, msscalar > 0 ? mb * 1000.0 / msscalar : 0.0,
+                         mssimd, mssimd > 0 ? mb * 1000.0 / mssimd : 0.0,
+                         mssimd > 0 ? msscalar / mssimd : 0.0,
+                         (nscalar == nsimd && nsimd == BENCH_HASHLINES * BENCH_HASHPASSES)
+                            ? "" : "\tMISMATCH");
+        }
+        bench_dbcs();
+    }
+
+    ignore_blanks = bBlanks;
+    utils_enablesimd(TRUE);
+    bench_deletelines(left);
+    bench_deletelines(right);
+    if (textleft != NULL) {
+        HeapFree(GetProcessHeap(), NULL, textleft);
+    }
+    if (textright != NULL) {
+        HeapFree(GetProcessHeap(), NULL, textright);
+    }
+}
+
+
+/* -- DIFF ------------------------------------------------------------ */
+
+/*
+ * compare one pair of files with the engine linear_diff selects. Returns
+ * the time taken, and sets the number of lines in the composite list and
+ * how many of those are moves.
+ */
+static double
+bench_diffonce(COMPITEM ci, BOOL bLinear, int * pnlines, int * pnmoved)
+{
+    LIST composite;
+    SECTION sec;
+    LONGLONG start;
+    double ms;
+    int state;
+
+    linear_diff = bLinear;
+    compitem_discardsections(ci);
+
+    start = bench_now();
+    composite = compitem_getcomposite(ci);
+    ms = bench_ms(start);
+
+    *pnlines = 0;
+    *pnmoved = 0;
+    if (composite == NULL) {
+        return(ms);
+    }
+    for (sec = (SECTION)List_First(composite); sec != NULL; sec = (SECTION)List_Next((LPVOID)sec)) {
+        state = section_getstate(sec);
+        *pnlines += section_getlinecount(sec);
+        if (state == STATE_MOVEDLEFT || state == STATE_MOVEDRIGHT) {
+            *pnmoved += section_getlinecount(sec);
+        }
+    }
+    return(ms);
+}
+
+static void
+bench_diff(COMPLIST cl)
+{
+    BOOL bLinear = linear_diff;
+    COMPITEM ci;
+    double mssect, mslinear;
+    int nsect, nlinear, movedsect, movedlinear;
+    int nfiles = 0;
+
+    for (ci = (COMPITEM)List_First(complist_getitems(cl)); ci != NULL; ci = (COMPITEM)List_Next((LPVOID)ci)) {
+        if (compitem_getleftfile(ci) == NULL || compitem_getrightfile(ci) == NULL) {
+            continue;
+        }
+
+        /* read both files in, so neither engine is charged for it */
+        compitem_getcomposite(ci);
+
+        mssect = bench_diffonce(ci, FALSE, &nsect, &movedsect);
+        mslinear = bench_diffonce(ci, TRUE, &nlinear, &movedlinear);
+        compitem_discardsections(ci);
+
+        bench_printf("diff\t%s\r\n", compitem_gettext_tag(ci));
+        bench_printf("diff\t\tsections %10.3f ms\t%7d lines\t%7d moved\r\n",
+                     mssect, nsect, movedsect);
+        bench_printf("diff\t\tlinear   %10.3f ms\t%7d lines\t%7d moved\t%8.1fx\r\n",
+                     mslinear, nlinear, movedlinear,
+                     mslinear > 0 ? mssect / mslinear : 0.0);
+        nfiles++;
+    }
+    if (nfiles == 0) {
+        bench_printf("diff\tno pairs of files to compare\r\n");
+    }
+
+    linear_diff = bLinear;
+}
+
+
+/* -- external functions -------------------------------------------- */
+
+BOOL APIENTRY
+bench_run(UINT tests, LPSTR resultfile, COMPLIST cl)
+{
+    bench_fh = CreateFile(resultfile, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                          CREATE_ALWAYS, 0, NULL);
+    if (bench_fh == INVALID_HANDLE_VALUE) {
+        return(FALSE);
+    }
+    QueryPerformanceFrequency(&bench_freq);
+
+    if (tests & BENCH_TREE) {
+        bench_tree();
+    }
+    if (tests & BENCH_HASH) {
+        bench_hash();
+    }
+    if ((tests & BENCH_DIFF) && cl != NULL) {
+        bench_diff(cl);
+    }
+
+    CloseHandle(bench_fh);
+    return(TRUE);
+}
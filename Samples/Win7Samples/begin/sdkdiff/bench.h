@@ -0,0 +1,33 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+/*
+ * bench.h
+ *
+ * timing runs for the comparison engine, selected with the -B command
+ * line option. Each test writes its results as text to a file, so that
+ * runs on different builds or machines can be kept and compared.
+ *
+ * include gutils.h and complist.h before this.
+ */
+
+/* which tests to run - bits for bench_run */
+#define BENCH_TREE      0x0001  /* TREE/CTREE against the old binary tree */
+#define BENCH_DIFF      0x0002  /* section matching against linear diff */
+#define BENCH_HASH      0x0004  /* SSE2 hash_string/line_compare against scalar */
+
+/*
+ * run the tests selected by the BENCH_ flags and write the results to
+ * the file resultfile. BENCH_DIFF compares the files in cl, which
+ * may be NULL for the other tests. Returns FALSE if the file could not
+ * be written.
+ */
+BOOL APIENTRY bench_run(UINT tests, LPSTR resultfile, COMPLIST cl);
+
+#endif
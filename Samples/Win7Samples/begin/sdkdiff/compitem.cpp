@@ -63,6 +63,8 @@ struct compitem {
     LPSTR result;           /* text equivalent of state */
 
     BOOL bMarked;           /* mark-state: used only by get/set mark*/
+    BOOL bRefreshed;        /* files re-read by compitem_refresh */
+    BOOL bKeepLinks;        /* lines still linked from before the refresh */
     char delims[64];        /* null term string of delimiters for lines */
 };
 
@@ -71,6 +73,7 @@ struct compitem {
 LPSTR ci_copytext(LPSTR in);
 void ci_makecomposite(COMPITEM ci);
 void ci_compare(COMPITEM ci);
+void ci_deletesections(COMPITEM ci);
 void FindDelimiters(DIRITEM leftname, DIRITEM rightname, LPSTR delims);
 LPSTR ci_AddTimeString(LPSTR in, COMPITEM ci, DIRITEM leftname, DIRITEM rightname);
 void SetStateAndTag( COMPITEM ci, DIRITEM leftname, DIRITEM rightname, BOOL fExact);
@@ -127,6 +130,8 @@ compitem_new(DIRITEM leftname, DIRITEM rightname, LIST list, BOOL fExact)
     ci->secs_composite = NULL;
     ci->secs_left = NULL;
     ci->secs_right = NULL;
+    ci->bRefreshed = FALSE;
+    ci->bKeepLinks = FALSE;
 
     FindDelimiters(leftname, rightname, ci->delims);
 
@@ -216,6 +221,43 @@ void compitem_rescan(COMPITEM ci)
 } /* compitem_rescan */
 
 
+/*
+ * the files have changed on disk (eg been edited): re-read them in place
+ * of discarding them. The lines at the start and end of each file that
+ * are unchanged stay linked (see file_refresh), and the next compare
+ * starts from those links - so it only has to match up the lines that
+ * changed, rather than the whole of both files.
+ *
+ * The compare is not done here: the caller must still discard the
+ * sections (normally through view_changediffoptions) so that the view
+ * asks for a new composite.
+ */
+void
+compitem_refresh(COMPITEM ci)
+{
+    BOOL bLeft, bRight;
+
+    if (ci == NULL) {
+        return;
+    }
+
+    /* the sections point at lines that are about to be replaced */
+    ci_deletesections(ci);
+
+    bLeft = file_refresh(ci->left);
+    bRight = file_refresh(ci->right);
+
+    if (bLeft && bRight) {
+        ci->bRefreshed = TRUE;
+    } else {
+        /* nothing useful kept - compare from scratch as before */
+        file_discardlines(ci->left);
+        file_discardlines(ci->right);
+        ci->bRefreshed = FALSE;
+    }
+} /* compitem_refresh */
+
+
 
 /*
  * delete a compitem and free all associated data.
@@ -263,21 +305,21 @@ compitem_delete(COMPITEM ci)
 void
 compitem_discardsections(COMPITEM ci)
 {
-    /* delete the lists of sections we built */
     if (ci == NULL) {
         return;
     }
-    if (ci->secs_composite) {
-        section_deletelist(ci->secs_composite);
-        ci->secs_composite = NULL;
-    }
-    if (ci->secs_left) {
-        section_deletelist(ci->secs_left);
-        ci->secs_left = NULL;
-    }
-    if (ci->secs_right) {
-        section_deletelist(ci->secs_right);
-        ci->secs_right = NULL;
+
+    ci_deletesections(ci);
+
+    /*
+     * the links kept by compitem_refresh are still good for the first
+     * discard after it (the one that makes the view re-compare), but
+     * not if options have changed again since.
+     */
+    ci->bKeepLinks = ci->bRefreshed;
+    ci->bRefreshed = FALSE;
+    if (ci->bKeepLinks) {
+        return;
     }
 
     /* reset the line lists to throw away cached hash codes and links */
@@ -971,8 +1013,8 @@ ci_makecomposite(COMPITEM ci)
  *        by just comparing the hash code.  The hashing knows whether blanks
  *        are to be ignored or not.
  *
- *    1   (and what makes it really fast) Store the hash codes in a binary
- *        search tree that will give for each hash code the number of times
+ *    1   (and what makes it really fast) Store the hash codes in a hashed
+ *        tree (see tree.h) that will give for each hash code the number of times
  *        that it occurred in each file and one of the lines where it occurred
  *        in each file.  The tree is used to rapidly find the partner
  *        of a line which occurs exactly once in each file.
@@ -1017,6 +1059,23 @@ ci_makecomposite(COMPITEM ci)
  *    uniqueness condition to see how much more progress we can make.  This is
  *    controlled by the TryDups logic at the end of the loop.
  *
+ *    LINEAR DIFF
+ *    If linear_diff is set, step 2 is replaced on the first pass: a longest
+ *    common subsequence of the two whole files is linked in one go using
+ *    Myers' O(ND) algorithm (see section_matchlinear). This does not need
+ *    unique lines to anchor on, so it stays fast on large files with few of
+ *    them, but it never reports moved blocks. Step 2 is skipped on later
+ *    passes too, since matching unique lines across the whole file is what
+ *    finds moves; only the sections between links are refined. ALGORITHM2
+ *    is not applied.
+ *
+ *    REFRESH
+ *    If the files have just been re-read by compitem_refresh, the lines
+ *    which did not change are still linked from the last compare. Step 2
+ *    is then skipped on the first pass, so the section lists are built
+ *    straight from those links and only the unmatched sections between
+ *    them (the changed part) are matched again.
+ *
  *    Finally build a composite list from the two lists of sections.
  */
 void
@@ -1027,6 +1086,7 @@ ci_compare(COMPITEM ci)
     BOOL bChanges;  /* loop control - we're still making more matches */
     BOOL bTryDups;  /* first try exact matches - then try matching non-unique ones too */
     extern BOOL Algorithm2;   /* declared in sdkdiff.cpp */
+    BOOL bFirstPass = TRUE;   /* linear diff is only run on the first pass */
 #ifdef trace
     DWORD Ticks;        /* time for profiling */
     DWORD StartTicks;   /* time for profiling */
@@ -1055,21 +1115,36 @@ ci_compare(COMPITEM ci)
          */
         bChanges = FALSE;
 
-        /* make a section covering the whole file */
-        whole_left = section_new((LINE)List_First(lines_left),
-                                 (LINE)List_Last(lines_left), NULL);
+        if (ci->bKeepLinks && bFirstPass) {
+            /* unchanged lines are still linked: go straight to
+             * matching the sections between them
+             */
+        } else if (linear_diff) {
+            /* link a longest common subsequence of the two files. On
+             * later passes only section_matchlists below runs, within
+             * the sections between the links.
+             */
+            if (bFirstPass && section_matchlinear(lines_left, lines_right)) {
+                bChanges = TRUE;
+            }
+        } else {
+            /* make a section covering the whole file */
+            whole_left = section_new((LINE)List_First(lines_left),
+                                     (LINE)List_Last(lines_left), NULL);
 
-        whole_right = section_new((LINE)List_First(lines_right),
-                                  (LINE)List_Last(lines_right), NULL);
+            whole_right = section_new((LINE)List_First(lines_right),
+                                      (LINE)List_Last(lines_right), NULL);
 
-        /* link up matching unique lines between these sections */
-        if (section_match(whole_left, whole_right, bTryDups)) {
-            bChanges = TRUE;
-        }
+            /* link up matching unique lines between these sections */
+            if (section_match(whole_left, whole_right, bTryDups)) {
+                bChanges = TRUE;
+            }
 
-        /* delete the two temp sections */
-        section_delete(whole_left);
-        section_delete(whole_right);
+            /* delete the two temp sections */
+            section_delete(whole_left);
+            section_delete(whole_right);
+        }
+        bFirstPass = FALSE;
 
         /* discard previous section lists if made */
         if (ci->secs_left) {
@@ -1114,7 +1189,7 @@ ci_compare(COMPITEM ci)
 
         /* repeat as long as we keep adding new links */
         if (bChanges) bTryDups = FALSE;
-        else if ((bTryDups==FALSE) & Algorithm2) {bTryDups = TRUE;
+        else if ((bTryDups==FALSE) & Algorithm2 && !linear_diff) {bTryDups = TRUE;
             bChanges = TRUE;  // at least one more go
         }
 
@@ -1140,6 +1215,30 @@ ci_compare(COMPITEM ci)
         Trace_File(Msg);
     }
 #endif
+
+    /* the links are ours now: a discard must reset them again */
+    ci->bKeepLinks = FALSE;
+}
+
+
+/*
+ * delete the section lists, leaving the lines (and their links) alone.
+ */
+void
+ci_deletesections(COMPITEM ci)
+{
+    if (ci->secs_composite) {
+        section_deletelist(ci->secs_composite);
+        ci->secs_composite = NULL;
+    }
+    if (ci->secs_left) {
+        section_deletelist(ci->secs_left);
+        ci->secs_left = NULL;
+    }
+    if (ci->secs_right) {
+        section_deletelist(ci->secs_right);
+        ci->secs_right = NULL;
+    }
 }
 
 
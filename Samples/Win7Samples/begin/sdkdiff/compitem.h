@@ -174,4 +174,10 @@ void compitem_SetCopyPaths(LPSTR LeftPath, LPSTR RightPath);
 
 /* Rescan the file, get new checksums etc */
 void compitem_rescan(COMPITEM ci);
+
+/* Re-read the files after they have changed, keeping the links of the
+ * unchanged lines so that the next compare only re-matches the changes.
+ * The sections must still be discarded to make the view re-compare.
+ */
+void compitem_refresh(COMPITEM ci);
 #endif
@@ -88,6 +88,7 @@ static DWORD TickCount;         /* time operation started, then time taken*/
 
 
 /* --- forward declaration of internal functions ----------------------------*/
+void complist_prefetch(COMPLIST cl, BOOL fDeep, BOOL fExact);
 int FAR PASCAL complist_dodlg_savelist(HWND hDlg, UINT message,
                                        UINT wParam, long lParam);
 int FAR PASCAL complist_dodlg_copyfiles(HWND hDlg, UINT message,
@@ -1181,6 +1182,13 @@ complist_match(COMPLIST cl, VIEW view, BOOL fDeep, BOOL fExact)
 
     /* two directories */
 
+    /* do the slow part - scanning the trees and reading the files
+     * for checksums - on the thread pool, before we walk the lists
+     */
+    if (parallel_scan) {
+        complist_prefetch(cl, fDeep, fExact);
+    }
+
     /* traverse the two lists in parallel comparing the relative names*/
 
     leftitem = dir_firstitem(cl->left);
@@ -1298,6 +1306,101 @@ complist_match(COMPLIST cl, VIEW view, BOOL fDeep, BOOL fExact)
     return(TRUE);
 } /* complist_match */
 
+/*
+ * scan both trees fully, and checksum every pair of files that
+ * complist_match will need to checksum, using the thread pool.
+ *
+ * complist_match then finds the trees already scanned and the checksums
+ * already valid. It still creates the compitems itself, in the usual
+ * order, so the result is the same as for the serial path - only
+ * faster. The time for this is included in complist_querytime, so
+ * setting ParallelScan=0 in the profile gives the serial time to compare
+ * against.
+ */
+void
+complist_prefetch(COMPLIST cl, BOOL fDeep, BOOL fExact)
+{
+    DIRITEM leftitem, rightitem;
+    DIRITEM FAR * items = NULL;
+    int nitems = 0;
+    int maxitems = 0;
+    int cmpvalue;
+    LPSTR lname;
+    LPSTR rname;
+
+    if (fDeep) {
+        dir_scanparallel(cl->left);
+        dir_scanparallel(cl->right);
+    }
+
+    /* only exact compares of files of the same size need checksums
+     * (see compitem_new), so without fExact we are done.
+     */
+    if (!fExact || !(TrackSame || TrackDifferent)) {
+        return;
+    }
+
+    /* walk the lists as complist_match will, collecting the pairs */
+    leftitem = dir_firstitem(cl->left);
+    rightitem = dir_firstitem(cl->right);
+    while ((leftitem != NULL) && (rightitem != NULL)) {
+
+        if (bAbort) break;  /* user requested abort */
+
+        lname = dir_getrelname(leftitem);
+        rname = dir_getrelname(rightitem);
+        if (!dir_compsequencenumber(leftitem, rightitem, &cmpvalue))
+        {
+            if (dir_iswildcard(cl->left) && dir_iswildcard(cl->right))
+                cmpvalue = dir_compwildcard(cl->left, cl->right, lname, rname);
+            else
+                cmpvalue = utils_CompPath(lname, rname);
+        }
+        dir_freerelname(leftitem, lname);
+        dir_freerelname(rightitem, rname);
+
+        if (cmpvalue == 0) {
+            if ((dir_getfilesize(leftitem) == dir_getfilesize(rightitem))
+                && (TrackReadonly
+                    || !(dir_getattr(leftitem) & dir_getattr(rightitem)
+                         & FILE_ATTRIBUTE_READONLY))) {
+
+                /* make room for two more, doubling the array */
+                if (nitems + 2 > maxitems) {
+                    DIRITEM FAR * newitems;
+
+                    maxitems = (maxitems == 0) ? 256 : maxitems * 2;
+                    if (items == NULL) {
+                        newitems = (DIRITEM FAR *) HeapAlloc(GetProcessHeap(), 0,
+                                                             maxitems * sizeof(DIRITEM));
+                    } else {
+                        newitems = (DIRITEM FAR *) HeapReAlloc(GetProcessHeap(), 0, items,
+                                                               maxitems * sizeof(DIRITEM));
+                    }
+                    if (newitems == NULL) {
+                        /* no matter - complist_match will do the rest */
+                        break;
+                    }
+                    items = newitems;
+                }
+                items[nitems++] = leftitem;
+                items[nitems++] = rightitem;
+            }
+            leftitem = dir_nextitem(cl->left, leftitem, fDeep);
+            rightitem = dir_nextitem(cl->right, rightitem, fDeep);
+        } else if (cmpvalue < 0) {
+            leftitem = dir_nextitem(cl->left, leftitem, fDeep);
+        } else {
+            rightitem = dir_nextitem(cl->right, rightitem, fDeep);
+        }
+    }
+
+    if (items != NULL) {
+        dir_checksumparallel(items, nitems);
+        HeapFree(GetProcessHeap(), NULL, items);
+    }
+} /* complist_prefetch */
+
 /* return time last operation took in milliseconds */
 DWORD complist_querytime(void)
 {       return TickCount;
@@ -22,7 +22,10 @@
  * calling file_reset will cause line_reset to be called for all lines
  * in the list. This clears any links and forces a recalc of line checksums.
  *
- * we allocate all memory using HeapAlloc
+ * we allocate all memory using HeapAlloc. The text of all the lines is
+ * copied into a chain of large blocks owned by the FILEDATA, rather than
+ * into one allocation per line, and the whole chain is freed at once when
+ * the lines are discarded.
  *
  */
 
@@ -36,6 +39,22 @@
 
 extern HANDLE hHeap;
 
+/* size of each block of line text. lines longer than this get a
+ * block of their own.
+ */
+#define TEXTBLOCK_SIZE  (64 * 1024)
+
+/*
+ * a block of storage for line text. blocks are chained from the
+ * FILEDATA, newest first.
+ */
+typedef struct textblock {
+    struct textblock FAR * next;    /* previously filled block */
+    UINT size;                      /* bytes available in data[] */
+    UINT used;                      /* bytes handed out from data[] */
+    char data[1];
+} TEXTBLOCK, FAR * PTEXTBLOCK;
+
 /*
  * we return FILEDATA handles: these are pointers to a
  * filedata struct defined here.
@@ -44,12 +63,15 @@ struct filedata {
 
     DIRITEM diritem;        /* handle to file name information */
     LIST lines;             /* NULL if lines not read in */
+    PTEXTBLOCK text;        /* text of the lines, NULL if not read in */
 
     BOOL fUnicode;
 };
 
 
 void file_readlines(FILEDATA fd);
+LPSTR file_alloctext(FILEDATA fd, UINT cb);
+void file_freelines(LIST FAR * plines, PTEXTBLOCK FAR * ptext);
 
 /*-- external functions ---------------------------------------------- */
 
@@ -141,25 +163,75 @@ file_getlinelist(FILEDATA fd)
 void
 file_discardlines(FILEDATA fd)
 {
-    LINE line;
-
     if (fd == NULL) {
         return;
     }
 
+    file_freelines(&fd->lines, &fd->text);
+}
+
+/*
+ * re-read the lines of a file that has changed since they were read.
+ *
+ * the unchanged lines at the start and end of the file take over the
+ * hashcodes and links of the lines they replace (see line_inherit), so
+ * that a compare need only look again at the lines in between. any
+ * other old line that was linked has its link broken, so nothing is
+ * left pointing at it.
+ *
+ * returns TRUE if this was done. returns FALSE if the lines had not been
+ * read in, or the file could not be read again: in that case the file
+ * has no lines and will be read from scratch when next needed.
+ */
+BOOL
+file_refresh(FILEDATA fd)
+{
+    LIST oldlines;
+    PTEXTBLOCK oldtext;
+    LINE oldline, newline;
+    LINE oldlast, newlast;
+
+    if ((fd == NULL) || (fd->lines == NULL)) {
+        return(FALSE);
+    }
+
+    oldlines = fd->lines;
+    oldtext = fd->text;
+    fd->lines = NULL;
+    fd->text = NULL;
+
+    file_readlines(fd);
+
     if (fd->lines != NULL) {
 
-        /* clear each line to free any memory associated
-         * with them, then discard the entire list
-         */
-		for( line=(LINE)List_First(fd->lines);  line!=NULL;  line = (LINE)List_Next((LPVOID)line)) {
-            line_delete(line);
+        /* the unchanged lines at the start... */
+        oldline = (LINE) List_First(oldlines);
+        newline = (LINE) List_First(fd->lines);
+        while ((oldline != NULL) && (newline != NULL)
+               && line_inherit(newline, oldline)) {
+            oldline = (LINE) List_Next((LPVOID)oldline);
+            newline = (LINE) List_Next((LPVOID)newline);
+        }
+
+        /* ...and at the end, stopping at the first changed line */
+        if ((oldline != NULL) && (newline != NULL)) {
+            oldlast = (LINE) List_Last(oldlines);
+            newlast = (LINE) List_Last(fd->lines);
+            while (line_inherit(newlast, oldlast)
+                   && (oldlast != oldline) && (newlast != newline)) {
+                oldlast = (LINE) List_Prev((LPVOID)oldlast);
+                newlast = (LINE) List_Prev((LPVOID)newlast);
+            }
         }
-        List_Destroy(&fd->lines);
     }
 
-    /* this is probably done in List_Destroy, but better do it anyway*/
-    fd->lines = NULL;
+    for (oldline = (LINE) List_First(oldlines); oldline != NULL;
+         oldline = (LINE) List_Next((LPVOID)oldline)) {
+        line_unlink(oldline);
+    }
+    file_freelines(&oldlines, &oldtext);
+
+    return(fd->lines != NULL);
 }
 
 
@@ -219,14 +291,74 @@ FILETIME file_GetTime(FILEDATA fd)
 
 /* --- internal functions -------------------------------------------*/
 
+/*
+ * delete a list of lines and the text blocks holding their text.
+ */
+void
+file_freelines(LIST FAR * plines, PTEXTBLOCK FAR * ptext)
+{
+    LINE line;
+
+    if (*plines != NULL) {
+
+        /* clear each line to free any memory associated
+         * with them, then discard the entire list
+         */
+		for( line=(LINE)List_First(*plines);  line!=NULL;  line = (LINE)List_Next((LPVOID)line)) {
+            line_delete(line);
+        }
+        List_Destroy(plines);
+    }
+
+    /* the lines did not own their text, so free it all now */
+    while (*ptext != NULL) {
+        PTEXTBLOCK next = (*ptext)->next;
+
+        HeapFree(GetProcessHeap(), NULL, *ptext);
+        *ptext = next;
+    }
+
+    /* this is probably done in List_Destroy, but better do it anyway*/
+    *plines = NULL;
+}
+
+/*
+ * allocate cb bytes for line text from the FILEDATA's text blocks,
+ * starting a new block if the current one is full. returns NULL if
+ * out of memory.
+ */
+LPSTR
+file_alloctext(FILEDATA fd, UINT cb)
+{
+    PTEXTBLOCK block = fd->text;
+    LPSTR p;
+
+    if ((block == NULL) || (block->size - block->used < cb)) {
+        UINT size = (cb > TEXTBLOCK_SIZE) ? cb : TEXTBLOCK_SIZE;
+
+        block = (PTEXTBLOCK) HeapAlloc(GetProcessHeap(), 0, sizeof(TEXTBLOCK) + size);
+        if (block == NULL) {
+            return(NULL);
+        }
+        block->size = size;
+        block->used = 0;
+        block->next = fd->text;
+        fd->text = block;
+    }
+
+    p = block->data + block->used;
+    block->used += cb;
+    return(p);
+}
+
 /*
  * read the file into a list of lines.
  *
- * we use the buffered read functions to read a block at a time, and
- * return us a pointer to a line within the block. The line we are
- * pointed to is not null terminated. from this we do a line_new: this
- * will make a copy of the text (since we want to re-use the buffer), and
- * will null-terminate its copy.
+ * we use the buffered read functions to read a block at a time (or map
+ * the file), and return us a pointer to a line within the block. The line
+ * we are pointed to is not null terminated. from this we do a
+ * line_newinbuffer: this will make a null-terminated copy of the text in
+ * our text blocks (since we want to re-use the buffer).
  *
  * we also give each line a number, starting at one.
  */
@@ -262,7 +394,8 @@ file_readlines(FILEDATA fd)
 
         while ( (textp = readfile_next(fbuf, &linelen, &pwzText, &cwch)) != NULL) {
             if (linelen>0) { /* readfile failure gives linelen==-1 */
-                line_new(textp, linelen, pwzText, cwch, linenr++, fd->lines);
+                line_newinbuffer(textp, linelen, pwzText, cwch, linenr++, fd->lines,
+                                 file_alloctext(fd, linelen + LINE_TEXTEXTRA));
             } else {
                 line_new("!! <unreadable> !!", 20, NULL, 0, linenr++,fd->lines);
                 break;
@@ -59,6 +59,15 @@ LIST file_getlinelist(FILEDATA fi);
  */
 void file_discardlines(FILEDATA fi);
 
+/*
+ * re-read the lines of a file after it has changed on disk. lines at the
+ * start and end that have not changed keep their hashcodes and links, so
+ * a following compare only needs to re-match the part in between.
+ * returns FALSE (leaving no lines) if the lines had not been read in or
+ * the file could not be re-read.
+ */
+BOOL file_refresh(FILEDATA fi);
+
 /*
  * force all lines in the line list to reset their hashcodes and any line
  * links. Does not cause the file to be re-read.
@@ -166,6 +166,10 @@ long APIENTRY gbit_findfree(DWORD FAR* map, long nblks,
  *
  * call readfile_delete once you have finished with this file. That will close
  * the file and free up any memory.
+ *
+ * ansi files are mapped into memory where possible, in which case the
+ * pointer returned is into the mapped view rather than a copy buffer. It
+ * remains valid until readfile_delete, but is still not null-terminated.
  */
 
 // MAX_LINE_LENGTH is the max number of physical characters we allow in a line
@@ -212,6 +216,12 @@ void APIENTRY readfile_delete(FILEBUFFER fb);
 
 DWORD APIENTRY hash_string(LPSTR string, BOOL bIgnoreBlanks);
 
+/* TRUE if the SSE2 versions of hash_string and line_compare are in use */
+BOOL APIENTRY utils_usesimd(void);
+
+/* turn the SSE2 versions off or back on - only for timing them */
+void APIENTRY utils_enablesimd(BOOL bEnable);
+
 /* return TRUE iff the string is blank.  Blank means the same as
  * the characters which are ignored in hash_string when ignore_blanks is set
  */
@@ -35,9 +35,15 @@
 #define IS_BLANK(c) \
     (((c) == ' ') || ((c) == '\t') || ((c) == '\r'))
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#define LINE_SIMD
+#endif
+
 /* flag values (or-ed) */
 #define LF_DISCARD      1       /* if true, alloced using HeapAlloc */
 #define LF_HASHVALID    2       /* if true, hashcode need not be recalced */
+#define LF_TEXTBUFFER   4       /* if true, text is owned by the caller */
 
 
 /*
@@ -48,6 +54,17 @@
  */
 LINE
 line_new(LPSTR text, int linelength, LPWSTR pwzText, int cwchText, UINT linenr, LIST list)
+{
+    return(line_newinbuffer(text, linelength, pwzText, cwchText, linenr, list, NULL));
+}
+
+/*
+ * create a new line, copying the text into textbuf if it is non-null
+ * (the caller keeps ownership), or into memory from HeapAlloc if not.
+ */
+LINE
+line_newinbuffer(LPSTR text, int linelength, LPWSTR pwzText, int cwchText,
+                 UINT linenr, LIST list, LPSTR textbuf)
 {
     LINE line;
     int cch = 0;
@@ -70,10 +87,15 @@ line_new(LPSTR text, int linelength, LPWSTR pwzText, int cwchText, UINT linenr,
     /* alloc space for the text. remember the null character */
     /* also add cr/nl pair if absent for composite file */
     cch = (text[linelength - 1] == '\n') ? 1 : 3;
-    line->text = (char*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, linelength + cch);
-    if (line->text == NULL)
-    {
-        return NULL;
+    if (textbuf != NULL) {
+        line->text = textbuf;
+        line->flags |= LF_TEXTBUFFER;
+    } else {
+        line->text = (char*)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, linelength + cch);
+        if (line->text == NULL)
+        {
+            return NULL;
+        }
     }
     My_mbsncpy(line->text, text, linelength);
     if (cch == 3) {
@@ -118,8 +140,10 @@ line_delete(LINE line)
         return;
     }
 
-    /* free up text space */
-    HeapFree(GetProcessHeap(), NULL, line->text);
+    /* free up text space, unless it belongs to our creator */
+    if (!(line->flags & LF_TEXTBUFFER)) {
+        HeapFree(GetProcessHeap(), NULL, line->text);
+    }
 
     /* free up line itself only if not on list */
     if (line->flags & LF_DISCARD) {
@@ -142,6 +166,48 @@ line_reset(LINE line)
     line->flags &= ~LF_HASHVALID;
 }
 
+/*
+ * break the link between this line and its linked line, if any.
+ */
+void
+line_unlink(LINE line)
+{
+    if ((line == NULL) || (line->link == NULL)) {
+        return;
+    }
+
+    line->link->link = NULL;
+    line->link = NULL;
+}
+
+/*
+ * if newline has the same text as oldline, give it oldline's hashcode and
+ * link (so the linked line now points back at newline) and return TRUE.
+ */
+BOOL
+line_inherit(LINE newline, LINE oldline)
+{
+    if ((newline == NULL) || (oldline == NULL)) {
+        return(FALSE);
+    }
+
+    if (strcmp(newline->text, oldline->text) != 0) {
+        return(FALSE);
+    }
+
+    if (oldline->flags & LF_HASHVALID) {
+        newline->hash = oldline->hash;
+        newline->flags |= LF_HASHVALID;
+    }
+
+    if ((oldline->link != NULL) && (newline->link == NULL)) {
+        newline->link = oldline->link;
+        newline->link->link = newline;
+        oldline->link = NULL;
+    }
+    return(TRUE);
+}
+
 
 /* return a pointer to the line text */
 LPSTR
@@ -261,6 +327,53 @@ line_getlinenr(LINE line)
     return(line->linenr);
 }
 
+#ifdef LINE_SIMD
+/*
+ * advance p1 and p2 over any 16-byte blocks that are identical and contain
+ * no terminator. p1 and p2 start on a character boundary and must end on
+ * one: line_compare decides what is a DBCS pair from where it stands, and
+ * a trail byte read as a character of its own can pair with the byte
+ * after it (in Shift-JIS most trail bytes are also lead bytes). So a block
+ * with any byte above 0x7f is walked a character at a time, and if its
+ * last byte is a lead byte only the 15 bytes before it are skipped.
+ * Skipping whole characters that match cannot change the answer.
+ *
+ * The text may end anywhere, so neither load is allowed to run into the
+ * next page.
+ */
+static void
+line_skipsame(LPSTR FAR * pp1, LPSTR FAR * pp2)
+{
+    LPSTR p1 = *pp1;
+    LPSTR p2 = *pp2;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a, b;
+    int n;
+
+    while ((((ULONG_PTR) p1 & 0xfff) <= 0x1000 - 16)
+           && (((ULONG_PTR) p2 & 0xfff) <= 0x1000 - 16)) {
+        a = _mm_loadu_si128((const __m128i *) p1);
+        b = _mm_loadu_si128((const __m128i *) p2);
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff)
+            || (_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) != 0)) {
+            break;
+        }
+        n = 0;
+        if (_mm_movemask_epi8(a) != 0) {
+            /* the blocks are the same, so one walk does for both */
+            while (n < 15) {
+                n += IsDBCSLeadByte(p1[n]) ? 2 : 1;
+            }
+        }
+        n = (n == 15 && IsDBCSLeadByte(p1[15])) ? 15 : 16;
+        p1 += n;
+        p2 += n;
+    }
+    *pp1 = p1;
+    *pp2 = p2;
+}
+#endif
+
 /* compare two lines. return TRUE if they are the same. uses
  * ignore_blanks to determine whether to ignore any
  * spaces/tabs in the comparison.
@@ -269,6 +382,9 @@ BOOL
 line_compare(LINE line1, LINE line2)
 {
     LPSTR p1, p2;
+#ifdef LINE_SIMD
+    BOOL bSIMD;
+#endif
 
     if ((line1 == NULL) || (line2 == NULL)) {
         /* null line handles do not compare */
@@ -284,6 +400,9 @@ line_compare(LINE line1, LINE line2)
     /* note that this is coupled to gutils\utils.c in definition of blank */
     p1 = line_gettext(line1);
     p2 = line_gettext(line2);
+#ifdef LINE_SIMD
+    bSIMD = utils_usesimd();
+#endif
     do {
         if (ignore_blanks) {
             while (IS_BLANK(*p1)) {
@@ -307,6 +426,11 @@ line_compare(LINE line1, LINE line2)
             p1++;
             p2++;
         }
+#ifdef LINE_SIMD
+        if (bSIMD) {
+            line_skipsame(&p1, &p2);
+        }
+#endif
     } while ( (*p1 != '\0') && (*p2 != '\0'));
 
     return(TRUE);
@@ -67,6 +67,18 @@ struct fileline
  */
 LINE line_new(LPSTR text, int linelength, LPWSTR pwzText, int cwchText, UINT linenr, LIST list);
 
+/*
+ * as line_new, but the null-terminated copy of the text is made in
+ * textbuf, supplied by the caller, rather than in memory allocated by the
+ * line. textbuf must have room for linelength + 3 bytes (LINE_TEXTEXTRA)
+ * and must remain valid until the line is deleted. line_delete will not
+ * free it. This lets the owner of many lines (a FILEDATA) keep all their
+ * text in a few large blocks.
+ */
+#define LINE_TEXTEXTRA  3
+LINE line_newinbuffer(LPSTR text, int linelength, LPWSTR pwzText, int cwchText,
+                      UINT linenr, LIST list, LPSTR textbuf);
+
 
 
 /*
@@ -85,6 +97,16 @@ void line_delete(LINE line);
  */
 void line_reset(LINE line);
 
+/* break the link between this line and its linked line (if any) */
+void line_unlink(LINE line);
+
+/*
+ * used when a file is re-read: if newline has the same text as oldline,
+ * it takes over oldline's hashcode and link, and TRUE is returned.
+ * oldline is left unlinked.
+ */
+BOOL line_inherit(LINE newline, LINE oldline);
+
 /* test if two lines are alike (they have the same text). Takes note of
  * ignore_blanks in its comparison. Does not take any note of the line numbers
  * associated with each line. Returns TRUE if they are the same.
@@ -25,6 +25,11 @@
  * within any one directory, we list filenames before going on
  * to subdirectory contents.
  *
+ * dir_scanparallel and dir_checksumparallel use the system thread pool
+ * to scan subdirectories and checksum files concurrently. Each DIRECT is
+ * only ever scanned by one thread, and is sorted as it is built, so the
+ * order of the list does not depend on the order the work completes in.
+ *
  * All memory is allocated using HeapAlloc
  */
 
@@ -146,6 +151,7 @@ BOOL dir_fileinit(DIRITEM pfile, DIRECT dir, LPSTR path, long size, FILETIME ft,
 void dir_dirinit(DIRECT dir, DIRLIST head, DIRECT parent, LPSTR name);
 long dir_getpathsizeetc(LPSTR path, FILETIME FAR*ft, DWORD FAR*attr);
 DIRITEM dir_findnextfile(DIRLIST dl, DIRECT curdir);
+void dir_queuescan(struct dirwork * pwork, DIRECT dir);
 
 /* --- external functions ------------------------------------------------*/
 
@@ -1417,6 +1423,264 @@ dir_copy(
 
 
 
+/* --- parallel scanning and checksumming ------------------------------*/
+
+/*
+ * a batch of work items queued on the thread pool. the thread that
+ * queues the work waits on hDone, which is set when the last item of
+ * the batch finishes.
+ */
+typedef struct dirwork {
+    LONG cPending;          /* items queued but not yet finished */
+    HANDLE hDone;           /* set when cPending drops to zero */
+
+    DIRITEM FAR * items;    /* files to checksum */
+    LONG cItems;            /* number of entries in items */
+    LONG iNext;             /* next entry of items to be taken */
+} DIRWORK, FAR * PDIRWORK;
+
+/* one directory to be scanned by the thread pool */
+typedef struct {
+    PDIRWORK pwork;
+    DIRECT dir;
+} DIRSCANITEM, FAR * PDIRSCANITEM;
+
+/*
+ * scan a directory if it has not been scanned yet, and then all the
+ * directories below it, on this thread. this is the fallback if we
+ * cannot use the thread pool. unlike dir_scan(dir, TRUE), it does not
+ * rescan (and so duplicate the entries of) directories already scanned.
+ */
+void
+dir_scantree(
+             DIRECT dir
+             )
+{
+    DIRECT child;
+
+    if (!dir->bScanned) {
+        dir_scan(dir, FALSE);
+    }
+    for (child = (DIRECT)List_First(dir->directs); child != NULL; child = (DIRECT)List_Next((LPVOID)child)) {
+        if (bAbort) break;  /* user requested abort */
+        dir_scantree(child);
+    }
+}
+
+/* mark one work item of a batch as finished */
+void
+dir_workdone(
+             PDIRWORK pwork
+             )
+{
+    if (InterlockedDecrement(&pwork->cPending) == 0) {
+        SetEvent(pwork->hDone);
+    }
+}
+
+/*
+ * thread pool callback: scan one directory (not recursively), then
+ * queue each of its subdirectories as a new work item.
+ */
+DWORD WINAPI
+dir_scanworker(
+               LPVOID pParam
+               )
+{
+    PDIRSCANITEM pitem = (PDIRSCANITEM) pParam;
+    PDIRWORK pwork = pitem->pwork;
+    DIRECT dir = pitem->dir;
+    DIRECT child;
+
+    HeapFree(GetProcessHeap(), NULL, pitem);
+
+    if (!dir->bScanned) {
+        dir_scan(dir, FALSE);
+    }
+
+    for (child = (DIRECT)List_First(dir->directs); child != NULL; child = (DIRECT)List_Next((LPVOID)child)) {
+        if (bAbort) break;  /* user requested abort */
+        dir_queuescan(pwork, child);
+    }
+
+    dir_workdone(pwork);
+    return 0;
+}
+
+/*
+ * queue a directory to be scanned. if we cannot queue it, scan it
+ * (and everything below it) on this thread instead.
+ */
+void
+dir_queuescan(
+              struct dirwork * pwork,
+              DIRECT dir
+              )
+{
+    PDIRSCANITEM pitem;
+
+    pitem = (PDIRSCANITEM) HeapAlloc(GetProcessHeap(), 0, sizeof(DIRSCANITEM));
+    if (pitem != NULL) {
+        pitem->pwork = pwork;
+        pitem->dir = dir;
+
+        InterlockedIncrement(&pwork->cPending);
+        if (QueueUserWorkItem(dir_scanworker, pitem, WT_EXECUTEDEFAULT)) {
+            return;
+        }
+        InterlockedDecrement(&pwork->cPending);
+        HeapFree(GetProcessHeap(), NULL, pitem);
+    }
+
+    dir_scantree(dir);
+}
+
+/*
+ * scan an entire tree, using the thread pool to scan subdirectories
+ * in parallel.
+ */
+void
+dir_scanparallel(
+                 DIRLIST dl
+                 )
+{
+    DIRWORK work;
+#ifdef trace
+    DWORD Ticks = GetTickCount();
+#endif
+
+    if ((dl == NULL) || dl->bFile) {
+        return;
+    }
+
+    ZeroMemory(&work, sizeof(work));
+
+    /* cPending starts at one for ourselves, so that the batch cannot
+     * complete while we are still queueing the first level
+     */
+    work.cPending = 1;
+    work.hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (work.hDone == NULL) {
+        dir_scantree(dl->dot);
+        return;
+    }
+
+    InterlockedIncrement(&work.cPending);
+    {
+        PDIRSCANITEM pitem = (PDIRSCANITEM) HeapAlloc(GetProcessHeap(), 0, sizeof(DIRSCANITEM));
+
+        if (pitem == NULL) {
+            InterlockedDecrement(&work.cPending);
+            dir_scantree(dl->dot);
+        } else {
+            pitem->pwork = &work;
+            pitem->dir = dl->dot;
+            /* the root is scanned on this thread; it queues the rest */
+            dir_scanworker(pitem);
+        }
+    }
+
+    dir_workdone(&work);
+    WaitForSingleObject(work.hDone, INFINITE);
+    CloseHandle(work.hDone);
+
+#ifdef trace
+    {   char msg[80];
+        StringCchPrintf(msg, 80, "dir_scanparallel: %d ms\r\n", GetTickCount() - Ticks);
+        if (bTrace) Trace_File(msg);
+    }
+#endif
+} /* dir_scanparallel */
+
+/*
+ * thread pool callback: take files from the shared array one at a time
+ * and checksum them, until there are none left.
+ */
+DWORD WINAPI
+dir_checksumworker(
+                   LPVOID pParam
+                   )
+{
+    PDIRWORK pwork = (PDIRWORK) pParam;
+    LONG i;
+
+    while ((i = InterlockedIncrement(&pwork->iNext) - 1) < pwork->cItems) {
+        if (bAbort) break;  /* user requested abort */
+        dir_getchecksum(pwork->items[i]);
+    }
+
+    dir_workdone(pwork);
+    return 0;
+}
+
+/*
+ * checksum a set of files in parallel. we queue one worker per
+ * processor; each takes the next unclaimed file from the array, so a
+ * few large files do not hold up the rest.
+ */
+void
+dir_checksumparallel(
+                     DIRITEM FAR * items,
+                     int count
+                     )
+{
+    DIRWORK work;
+    SYSTEM_INFO si;
+    int cWorkers;
+    int i;
+#ifdef trace
+    DWORD Ticks = GetTickCount();
+#endif
+
+    if (count <= 0) {
+        return;
+    }
+
+    ZeroMemory(&work, sizeof(work));
+    work.items = items;
+    work.cItems = count;
+    work.iNext = 0;
+    work.cPending = 1;
+    work.hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (work.hDone == NULL) {
+        for (i = 0; i < count; i++) {
+            dir_getchecksum(items[i]);
+        }
+        return;
+    }
+
+    GetSystemInfo(&si);
+    cWorkers = (int) si.dwNumberOfProcessors;
+    if (cWorkers > count) {
+        cWorkers = count;
+    }
+
+    for (i = 0; i < cWorkers; i++) {
+        InterlockedIncrement(&work.cPending);
+        if (!QueueUserWorkItem(dir_checksumworker, &work, WT_EXECUTELONGFUNCTION)) {
+            InterlockedDecrement(&work.cPending);
+            break;
+        }
+    }
+
+    /* this thread helps out too, and mops up if no workers were queued */
+    InterlockedIncrement(&work.cPending);
+    dir_checksumworker(&work);
+
+    dir_workdone(&work);
+    WaitForSingleObject(work.hDone, INFINITE);
+    CloseHandle(work.hDone);
+
+#ifdef trace
+    {   char msg[80];
+        StringCchPrintf(msg, 80, "dir_checksumparallel: %d files, %d ms\r\n",
+                        count, GetTickCount() - Ticks);
+        if (bTrace) Trace_File(msg);
+    }
+#endif
+} /* dir_checksumparallel */
+
+
 /*--- internal functions ---------------------------------------- */
 
 /* fill out a new DIRECT for a subdirectory (pre-allocated).
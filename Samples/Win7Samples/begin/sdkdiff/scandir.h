@@ -230,4 +230,19 @@ long CompareFileTime( CONST FILETIME * lpft1,  /* address of first file time */
 /* return the file time (last write time) (set during scanning), (0,0) if invalid */
 FILETIME dir_GetFileTime(DIRITEM cur);
 
+/*
+ * scan the whole of a directory tree now, using the system thread pool
+ * to scan several subdirectories at once. The resulting list is the same
+ * (and in the same order) as one scanned on demand by dir_nextitem.
+ */
+void dir_scanparallel(DIRLIST dl);
+
+/*
+ * calculate the checksums of count files on the system thread pool, and
+ * return when they are all done. Afterwards dir_validchecksum and
+ * dir_getchecksum behave as if dir_getchecksum had been called on each
+ * file in turn.
+ */
+void dir_checksumparallel(DIRITEM FAR * items, int count);
+
 #endif
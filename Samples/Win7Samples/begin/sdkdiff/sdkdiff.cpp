@@ -177,6 +177,7 @@
 #include "complist.h"
 #include "view.h"
 #include "findgoto.h"
+#include "bench.h"
 
 #include "state.h"
 #include "sdkdiff.h"
@@ -226,6 +227,8 @@ typedef struct {
     BOOL fDescribeFiles;                
     BOOL fInputFile;                    // TRUE means read file list from input file
     BOOL fInputFileSingle;              // TRUE means input file has one filename per line
+    UINT benchopts;                     // BENCH_ tests selected with -B
+    LPSTR benchfile;                    // file for the -B results
 } THREADARGS, FAR * PTHREADARGS;
 
 
@@ -244,6 +247,9 @@ const CHAR szSdkDiff[]                = "SdkDiff";
 static const char szD[]                      = "%d";
 static const char szBlanks[]                 = "Blanks";
 static const char szAlgorithm2[]             = "Algorithm2";
+static const char szLinearDiff[]             = "LinearDiff";
+static const char szIncremental[]            = "IncrementalRescan";
+static const char szParallelScan[]           = "ParallelScan";
 static const char szPicture[]                = "Picture";
 static const char szMonoColours[]            = "MonoColours";
 static const char szHideMark[]               = "HideMark";
@@ -527,6 +533,9 @@ int expand_include = INCLUDE_ALL;
 BOOL ignore_blanks = TRUE;
 BOOL show_whitespace = FALSE;
 BOOL Algorithm2 = TRUE;  /* Try duplicates - used in compitem.c */
+BOOL linear_diff = FALSE;  /* Myers diff, no moves - used in compitem.c */
+BOOL incremental_rescan = FALSE;  /* keep unchanged lines linked on update */
+BOOL parallel_scan = TRUE; /* thread pool scan/checksum - used in complist.c */
 BOOL picture_mode = TRUE;
 BOOL hide_markedfiles = FALSE;
 BOOL mono_colours = FALSE;       /* monochrome display */
@@ -553,6 +562,7 @@ void SetSelection(long rownr, long nrows, long dyRowsFromTop);
 void SetButtonText(LPSTR cmd);
 BOOL ToExpand(HWND hwnd);
 void ParseArgs(char * lpCmdLine);
+void RunBench(UINT tests, LPSTR resultfile, COMPLIST cl);
 void Trace_Status(LPSTR str);
 
 DWORD WINAPI wd_initial(LPVOID arg);
@@ -859,6 +869,7 @@ static const UsageStringInfo c_rg[] =
     { (UINT)-1,             0, 0, 0 },
     { IDS_USAGE_STR00,      0, 0, 0 },
     { IDS_USAGE_STR01,      0, 0, 0 },
+    { IDS_USAGE_STR01B,     0, 0, 1 },
     { IDS_USAGE_STR02,      0, 0, 1 },
     { IDS_USAGE_STR03,      0, 0, 1 },
     { IDS_USAGE_STR04,      0, 0, 3 },
@@ -1208,6 +1219,35 @@ GetNextToken(
 
 
 
+/*
+ * run the -B timing tests, and exit. There is no window to show the
+ * results in, so they only go to the results file.
+ */
+void
+RunBench(
+         UINT tests,
+         LPSTR resultfile,
+         COMPLIST cl
+         )
+{
+    char msg[MAX_PATH+100];
+    HRESULT hr;
+
+    if (bench_run(tests, resultfile, cl)) {
+        exit(0);
+    }
+
+    hr = StringCchPrintf(msg, MAX_PATH+100, LoadRcString(IDS_CANT_OPEN), resultfile);
+    if (FAILED(hr)) {
+        OutputError(hr, IDS_SAFE_PRINTF);
+    }
+    sdkdiff_UI(TRUE);
+    MessageBox(hwndClient, msg, "Sdkdiff", MB_ICONSTOP|MB_OK);
+    sdkdiff_UI(FALSE);
+    exit(1);
+}
+
+
 /*
  * parse command line arguments
  *
@@ -1221,6 +1261,9 @@ GetNextToken(
  * -s{slrd}x causes the program to exit after the list has been written out
  *
  *
+ * -B{thd} filename times the comparison engine, writes the results to the
+ * file and exits. -Bd compares the files given by the paths.
+ *
  * -T means tree.  Go deep.
  * -D means Directory or Don't go deep.
  * -O means Stay in outline mode.  No auto expand.
@@ -1270,6 +1313,39 @@ ParseArgs(
         /* is this an option ? */
         if ((tok[0] == '-') || (tok[0] == '/')) {
             switch (tok[1]) {
+                case 'b':
+                case 'B':
+                    /* read letters for the tests to run: t,h,d */
+                    for (tok+=2; *tok != '\0'; ++tok) {
+                        switch (*tok) {
+                            case 't':
+                            case 'T':
+                                ta->benchopts |= BENCH_TREE;
+                                break;
+                            case 'h':
+                            case 'H':
+                                ta->benchopts |= BENCH_HASH;
+                                break;
+                            case 'd':
+                            case 'D':
+                                ta->benchopts |= BENCH_DIFF;
+                                break;
+                            default:
+                                idsError = 0;
+                                goto LUsage;
+                        }
+                    }
+
+                    if (ta->benchopts == 0) {
+                        /* everything that does not need files */
+                        ta->benchopts = BENCH_TREE | BENCH_HASH;
+                    }
+                    ta->benchfile = GetNextToken(NULL);
+                    if (ta->benchfile == NULL || *ta->benchfile == '\0') {
+                        idsError = 0;
+                        goto LUsage;
+                    }
+                    break;
                 case 's':
                 case 'S':
                     /* read letters for the save option: s,l,r,d */
@@ -1474,6 +1550,18 @@ ParseArgs(
         tok = GetNextToken(NULL);
     }
 
+    /* -B runs the timing tests instead of a comparison. Those that
+     * need files to compare are run by wd_initial once it has them.
+     */
+    if (ta->benchopts & BENCH_DIFF) {
+        if (ta->first == NULL || ta->fInputFile) {
+            idsError = 0;
+            goto LUsage;
+        }
+    } else if (ta->benchopts != 0) {
+        RunBench(ta->benchopts, ta->benchfile, NULL);
+    }
+
     if (ta->fInputFile && ta->first)
     {
         idsError = IDS_ERROR_IARGS;
@@ -1502,8 +1590,8 @@ ParseArgs(
 
     SetBusy();
 
-    /* minimise the window if -s flag given */
-    if (ta->savelist != NULL || ta->savecomp != NULL) {
+    /* minimise the window if -s or -b flag given */
+    if (ta->savelist != NULL || ta->savecomp != NULL || ta->benchopts != 0) {
         ShowWindow(hwndClient, SW_MINIMIZE);
     }
 
@@ -1568,6 +1656,9 @@ CreateTools(void)
     expand_include = GetProfileInt(APPNAME, szLineInclude, expand_include);
     ignore_blanks = GetProfileInt(APPNAME, szBlanks, ignore_blanks);
     Algorithm2 = GetProfileInt(APPNAME, szAlgorithm2, Algorithm2);
+    linear_diff = GetProfileInt(APPNAME, szLinearDiff, linear_diff);
+    incremental_rescan = GetProfileInt(APPNAME, szIncremental, incremental_rescan);
+    parallel_scan = GetProfileInt(APPNAME, szParallelScan, parallel_scan);
     mono_colours = GetProfileInt(APPNAME, szMonoColours, mono_colours);
     picture_mode = GetProfileInt(APPNAME, szPicture, picture_mode);
     hide_markedfiles = GetProfileInt(APPNAME, szHideMark, hide_markedfiles);
@@ -2500,10 +2591,15 @@ OnUpdate(
     long cSel = selection_nrows;
 
     /* update the display.  Options or files may have changed */
-    /* discard lines  (thereby forcing re-read).
+    /* discard lines  (thereby forcing re-read), or re-read them now
+     * keeping what is still valid from the last compare.
      */
-    file_discardlines(compitem_getleftfile(item));
-    file_discardlines(compitem_getrightfile(item));
+    if (incremental_rescan) {
+        compitem_refresh(item);
+    } else {
+        file_discardlines(compitem_getleftfile(item));
+        file_discardlines(compitem_getrightfile(item));
+    }
 
     view_changediffoptions(current_view);
 
@@ -3280,6 +3376,11 @@ wd_initial(
         return 0;
     }
 
+    /* -B with files to compare: time them and exit */
+    if (pta->benchopts != 0) {
+        RunBench(pta->benchopts, pta->benchfile, cl);
+    }
+
 
     /* if savelist or savecomp was selected, write out the list or comp file */
     if (pta->savelist != NULL || pta->savecomp != NULL) {
@@ -3433,6 +3534,8 @@ MainWndProc(
             CHECKMENU(IDM_IGNBLANKS, ignore_blanks);
             CHECKMENU(IDM_SHOWWHITESPACE, show_whitespace);
             CHECKMENU(IDM_ALG2, Algorithm2);
+            CHECKMENU(IDM_LINEARDIFF, linear_diff);
+            CHECKMENU(IDM_INCREMENTAL, incremental_rescan);
             CHECKMENU(IDM_MONOCOLS, mono_colours);
             CHECKMENU(IDM_PICTURE, picture_mode);
             CHECKMENU(IDM_HIDEMARK, hide_markedfiles);
@@ -4156,6 +4259,46 @@ LTabWidth_tryagain:
 
                     break;
 
+                case IDM_LINEARDIFF:
+
+                    /* if selected, link lines with the linear (Myers)
+                     * diff. this is much faster on large files with
+                     * few unique lines, but does not find moved blocks.
+                     */
+
+                    linear_diff = !linear_diff;
+                    CheckMenuItem(hMenu, IDM_LINEARDIFF,
+                                  linear_diff? MF_CHECKED:MF_UNCHECKED);
+                    hr = StringCchPrintf(str, 32, szD, linear_diff);
+					if (FAILED(hr))
+							OutputError(hr, IDS_SAFE_PRINTF);
+                    WriteProfileString(APPNAME, szLinearDiff, str);
+
+                    view_changediffoptions(current_view);
+
+                    /* force repaint of bar window */
+                    InvalidateRect(hwndBar, NULL, TRUE);
+
+                    break;
+
+                case IDM_INCREMENTAL:
+
+                    /* if selected, a file that is rescanned or edited
+                     * is re-read keeping the links of the lines that
+                     * did not change, and only the changed part is
+                     * compared again. takes effect on the next update.
+                     */
+
+                    incremental_rescan = !incremental_rescan;
+                    CheckMenuItem(hMenu, IDM_INCREMENTAL,
+                                  incremental_rescan? MF_CHECKED:MF_UNCHECKED);
+                    hr = StringCchPrintf(str, 32, szD, incremental_rescan);
+					if (FAILED(hr))
+							OutputError(hr, IDS_SAFE_PRINTF);
+                    WriteProfileString(APPNAME, szIncremental, str);
+
+                    break;
+
                 case IDM_MONOCOLS:
 
                     /* Use monochrome colours - toggle */
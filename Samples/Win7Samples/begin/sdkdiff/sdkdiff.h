@@ -67,6 +67,15 @@ extern int expand_include;
 /* do we ignore blanks during the line-by-line diff ? */
 extern BOOL ignore_blanks;
 
+/* do we use the linear (Myers) diff instead of unique-line matching ? */
+extern BOOL linear_diff;
+
+/* do we re-read changed files keeping the links of unchanged lines ? */
+extern BOOL incremental_rescan;
+
+/* do we scan and checksum directory trees on the thread pool ? */
+extern BOOL parallel_scan;
+
 /* do we show whitespace characters ? */
 extern BOOL show_whitespace;
 
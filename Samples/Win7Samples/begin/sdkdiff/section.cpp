@@ -1429,3 +1429,239 @@ section_makectree(SECTION sec)
 }
 
 
+
+
+/* --- linear diff --------------------------------------------------*/
+
+/*
+ * section_matchlinear links lines using Myers' O(ND) difference
+ * algorithm (linear space variant) instead of the unique-line anchoring
+ * done by section_match. It finds a longest common subsequence of the
+ * two files directly, so it costs time proportional to the file size
+ * times the number of differences rather than repeated passes over
+ * the whole file, and it does not depend on having unique lines to
+ * anchor on. It never reports moved blocks: a block that moved will
+ * show up as deleted on one side and inserted on the other.
+ *
+ * Lines are compared with line_compare, so ignore_blanks is honoured.
+ * The result is expressed purely as line links, so the usual
+ * section_makelist/section_matchlists/section_makecomposite sequence
+ * builds the composite list from it.
+ */
+
+/* state shared by the recursive calls of one linear diff */
+typedef struct {
+    LINE FAR * left;        /* left file lines, indexed from 0 */
+    LINE FAR * right;       /* right file lines, indexed from 0 */
+    DWORD FAR * lhash;      /* cached hashcodes for left[] */
+    DWORD FAR * rhash;      /* cached hashcodes for right[] */
+    int FAR * fv;           /* furthest x reached on each forward diagonal */
+    int FAR * rv;           /* furthest x reached on each reverse diagonal */
+    int voffset;            /* index of diagonal 0 in fv and rv */
+    BOOL bLinked;           /* set once any new link is made */
+} LINEARDIFF, FAR * PLINEARDIFF;
+
+/* return TRUE if line i of the left file matches line j of the right */
+BOOL
+linear_equal(PLINEARDIFF pld, int i, int j)
+{
+    if (pld->lhash[i] != pld->rhash[j]) {
+        return(FALSE);
+    }
+    return(line_compare(pld->left[i], pld->right[j]));
+}
+
+/* link count lines starting at left[i] and right[j] */
+void
+linear_linkrun(PLINEARDIFF pld, int i, int j, int count)
+{
+    while (count-- > 0) {
+        if (line_link(pld->left[i++], pld->right[j++])) {
+            pld->bLinked = TRUE;
+        }
+    }
+}
+
+/*
+ * find the middle snake of the edit path between left[a..a+n) and
+ * right[b..b+m): run the greedy search forwards from the start and
+ * backwards from the end together, until the two frontiers overlap.
+ * the diagonal run where they meet is returned (relative to a and b)
+ * as *px,*py .. *pu,*pv. it lies on an optimal edit path, and splits
+ * the problem into two halves each needing about half of the edits.
+ */
+void
+linear_middlesnake(PLINEARDIFF pld, int a, int n, int b, int m,
+                   int * px, int * py, int * pu, int * pv)
+{
+    int FAR * fv = pld->fv + pld->voffset;
+    int FAR * rv = pld->rv + pld->voffset;
+    int delta = n - m;
+    BOOL odd = (delta & 1) != 0;
+    int dmax = (n + m + 1) / 2;
+    int d, k, x, y, x0, y0;
+
+    fv[1] = 0;
+    rv[1] = 0;
+
+    for (d = 0; d <= dmax; d++) {
+
+        /* forward pass: extend each diagonal by one edit then
+         * follow any run of matching lines
+         */
+        for (k = -d; k <= d; k += 2) {
+            if ((k == -d) || ((k != d) && (fv[k - 1] < fv[k + 1]))) {
+                x = fv[k + 1];
+            } else {
+                x = fv[k - 1] + 1;
+            }
+            y = x - k;
+            x0 = x;
+            y0 = y;
+            while ((x < n) && (y < m) && linear_equal(pld, a + x, b + y)) {
+                x++;
+                y++;
+            }
+            fv[k] = x;
+
+            /* forward diagonal k is reverse diagonal delta-k. with
+             * an odd delta the paths can only meet on a forward step
+             */
+            if (odd && (delta - k >= -(d - 1)) && (delta - k <= d - 1)) {
+                if (fv[k] + rv[delta - k] >= n) {
+                    *px = x0;
+                    *py = y0;
+                    *pu = x;
+                    *pv = y;
+                    return;
+                }
+            }
+        }
+
+        /* reverse pass: the same, working back from the end */
+        for (k = -d; k <= d; k += 2) {
+            if ((k == -d) || ((k != d) && (rv[k - 1] < rv[k + 1]))) {
+                x = rv[k + 1];
+            } else {
+                x = rv[k - 1] + 1;
+            }
+            y = x - k;
+            x0 = x;
+            y0 = y;
+            while ((x < n) && (y < m) &&
+                   linear_equal(pld, a + n - 1 - x, b + m - 1 - y)) {
+                x++;
+                y++;
+            }
+            rv[k] = x;
+
+            if (!odd && (delta - k >= -d) && (delta - k <= d)) {
+                if (rv[k] + fv[delta - k] >= n) {
+                    *px = n - x;
+                    *py = m - y;
+                    *pu = n - x0;
+                    *pv = m - y0;
+                    return;
+                }
+            }
+        }
+    }
+
+    /* not reached: the frontiers always meet by d == dmax */
+    TRACE_ERROR("SECTION: linear diff found no middle snake", FALSE);
+    *px = *pu = n;
+    *py = *pv = m;
+}
+
+/*
+ * link the longest common subsequence of left[a..a+n) and right[b..b+m)
+ */
+void
+linear_match(PLINEARDIFF pld, int a, int n, int b, int m)
+{
+    int x, y, u, v;
+
+    /* strip and link any common prefix and suffix. as well as
+     * being cheap, this guarantees the middle snake below splits the
+     * remaining problem into two strictly smaller ones.
+     */
+    while ((n > 0) && (m > 0) && linear_equal(pld, a, b)) {
+        linear_linkrun(pld, a, b, 1);
+        a++; b++; n--; m--;
+    }
+    while ((n > 0) && (m > 0) && linear_equal(pld, a + n - 1, b + m - 1)) {
+        linear_linkrun(pld, a + n - 1, b + m - 1, 1);
+        n--; m--;
+    }
+
+    /* if either side is empty, the rest is all inserts or all deletes */
+    if ((n == 0) || (m == 0)) {
+        return;
+    }
+
+    linear_middlesnake(pld, a, n, b, m, &x, &y, &u, &v);
+
+    linear_linkrun(pld, a + x, b + y, u - x);
+    linear_match(pld, a, x, b, y);
+    linear_match(pld, a + u, n - u, b + v, m - v);
+}
+
+/* copy the lines of a list into an array, with their hashcodes */
+int
+linear_getlines(LIST lines, LINE FAR * array, DWORD FAR * hashes)
+{
+    LINE line;
+    int n = 0;
+
+    for (line = (LINE)List_First(lines); line != NULL; line = (LINE)List_Next(line)) {
+        array[n] = line;
+        hashes[n] = line_gethashcode(line);
+        n++;
+    }
+    return(n);
+}
+
+/*
+ * link up the lines of two files using the linear diff. Returns TRUE
+ * if any new links were made. Returns FALSE without linking anything
+ * if there is not enough memory, in which case the caller should fall
+ * back to section_match.
+ */
+BOOL
+section_matchlinear(LIST lines_left, LIST lines_right)
+{
+    LINEARDIFF ld;
+    int n, m, vsize;
+    HANDLE hHeap = GetProcessHeap();
+
+    n = List_Card(lines_left);
+    m = List_Card(lines_right);
+    vsize = (n + m + 1) / 2 + 2;
+
+    ld.left = (LINE FAR *) HeapAlloc(hHeap, 0, (n + 1) * sizeof(LINE));
+    ld.right = (LINE FAR *) HeapAlloc(hHeap, 0, (m + 1) * sizeof(LINE));
+    ld.lhash = (DWORD FAR *) HeapAlloc(hHeap, 0, (n + 1) * sizeof(DWORD));
+    ld.rhash = (DWORD FAR *) HeapAlloc(hHeap, 0, (m + 1) * sizeof(DWORD));
+    ld.fv = (int FAR *) HeapAlloc(hHeap, 0, (2 * vsize + 1) * sizeof(int));
+    ld.rv = (int FAR *) HeapAlloc(hHeap, 0, (2 * vsize + 1) * sizeof(int));
+    ld.voffset = vsize;
+    ld.bLinked = FALSE;
+
+    if ((ld.left != NULL) && (ld.right != NULL) && (ld.lhash != NULL)
+        && (ld.rhash != NULL) && (ld.fv != NULL) && (ld.rv != NULL)) {
+
+        n = linear_getlines(lines_left, ld.left, ld.lhash);
+        m = linear_getlines(lines_right, ld.right, ld.rhash);
+
+        linear_match(&ld, 0, n, 0, m);
+    }
+
+    if (ld.left != NULL)  HeapFree(hHeap, 0, ld.left);
+    if (ld.right != NULL) HeapFree(hHeap, 0, ld.right);
+    if (ld.lhash != NULL) HeapFree(hHeap, 0, ld.lhash);
+    if (ld.rhash != NULL) HeapFree(hHeap, 0, ld.rhash);
+    if (ld.fv != NULL)    HeapFree(hHeap, 0, ld.fv);
+    if (ld.rv != NULL)    HeapFree(hHeap, 0, ld.rv);
+
+    return(ld.bLinked);
+} /* section_matchlinear */
@@ -155,4 +155,14 @@ LIST section_makecomposite(LIST secsleft, LIST secsright);
 BOOL section_matchlists(LIST secsleft, LIST secsright, BOOL bDups);
 
 
+/* link up the lines of two whole files using a linear-space O(ND)
+ * difference algorithm (Myers) rather than by anchoring on unique
+ * lines. This links a longest common subsequence of the two files in
+ * one pass, but never detects moved blocks. After this, build the
+ * section lists with section_makelist and section_matchlists as usual.
+ * returns TRUE if any new links between lines were made.
+ */
+BOOL section_matchlinear(LIST lines_left, LIST lines_right);
+
+
 #endif
@@ -13,7 +13,16 @@
  *
  * memory is allocated using HeapAlloc.
  *
- * currently implemented as a unbalanced binary tree.
+ * implemented as a hash table with chained buckets. The key is scrambled
+ * (fibonacci hashing) before picking a bucket, so keys presented in
+ * ascending or descending order spread out as well as random keys. The
+ * bucket array doubles in size whenever the average chain length would
+ * exceed TREE_MAXLOAD, so lookups and inserts stay O(1) on average no
+ * matter how large the tree grows.
+ *
+ * This used to be an unbalanced binary tree, which degraded to a linked
+ * list (and made section matching quadratic) on sorted input. Nothing
+ * enumerates a TREE in key order, so the ordering was never needed.
  *
  */
 
@@ -27,46 +36,43 @@
 
 /* -- data types ----------------------------------------------- */
 
+/* initial number of buckets - must be a power of two */
+#define TREE_INITBITS   6
+
+/* grow the bucket array when items > buckets * TREE_MAXLOAD */
+#define TREE_MAXLOAD    2
+
 /* on creating a tree, we return a TREE handle. This is in fact a pointer
  * to a struct tree, defined here.
  */
 struct tree {
-    TREEITEM first;
+    TREEITEM FAR * buckets;     /* array of (1 << bits) chain heads */
+    UINT bits;                  /* log2 of number of buckets */
+    ULONG count;                /* number of items in the tree */
 };
 
 /* each element in the tree is stored in a TREEITEM. a TREEITEM handle
- * is a pointer to a struct treeitem, defined here
+ * is a pointer to a struct treeitem, defined here. The user's data block
+ * is allocated in the same heap block, immediately after the treeitem.
  */
 struct treeitem {
     TREE root;
     TREEKEY key;
-    TREEITEM left, right;
+    TREEITEM next;      /* next item in the same bucket */
     UINT length;        /* length of the user's data */
     LPVOID data;        /* pointer to our copy of the users data */
 };
 
 /* -- internal functions ---------------------------------------------*/
 
-/* free up an element of the tree. recursively calls itself to
- * free left and right children
+/* map a key onto a bucket index for a table of (1 << bits) buckets.
+ * multiplying by 2^32/phi and keeping the top bits spreads runs of
+ * consecutive keys evenly over the whole table.
  */
-void
-tree_delitem(TREEITEM item)
+UINT
+tree_bucket(TREEKEY key, UINT bits)
 {
-    if (item == NULL) {
-        return;
-    }
-    if (item->left != NULL) {
-        tree_delitem(item->left);
-    }
-    if (item->right != NULL) {
-        tree_delitem(item->right);
-    }
-    if (item->data != NULL) {
-        HeapFree(GetProcessHeap(), NULL, item->data);
-    }
-
-    HeapFree(GetProcessHeap(), NULL, item);
+    return (UINT)(((DWORD)(key * 2654435769U)) >> (32 - bits));
 }
 
 /* create a new treeitem, with a data block of length bytes.
@@ -78,7 +84,8 @@ tree_newitem(TREE root, TREEKEY key, LPVOID value, UINT length)
 {
     TREEITEM item;
 
-    item = (TREEITEM) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(struct treeitem));
+    item = (TREEITEM) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                sizeof(struct treeitem) + length);
 	if (item == NULL)
     {
 		return NULL;
@@ -86,14 +93,9 @@ tree_newitem(TREE root, TREEKEY key, LPVOID value, UINT length)
 
     item->root = root;
     item->key = key;
-    item->left = NULL;
-    item->right = NULL;
+    item->next = NULL;
     item->length = length;
-    item->data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, length);
-    if (item->data == NULL)
-    {
-		return NULL;
-    }
+    item->data = (LPVOID) (item + 1);
 
 	if ( (value != NULL)  && (length <= (sizeof(LINE) + sizeof(LONG_PTR)) ))
     {
@@ -103,38 +105,61 @@ tree_newitem(TREE root, TREEKEY key, LPVOID value, UINT length)
     return(item);
 }
 
+/* double the number of buckets and rehash all the items into the
+ * new array. if we cannot get the memory, we just carry on with
+ * longer chains.
+ */
+void
+tree_grow(TREE tree)
+{
+    TREEITEM FAR * newbuckets;
+    TREEITEM item, next;
+    UINT newbits, i, nbuckets;
+
+    newbits = tree->bits + 1;
+    if (newbits > 30) {
+        return;
+    }
+
+    newbuckets = (TREEITEM FAR *) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                            sizeof(TREEITEM) << newbits);
+    if (newbuckets == NULL) {
+        return;
+    }
+
+    nbuckets = 1 << tree->bits;
+    for (i = 0; i < nbuckets; i++) {
+        for (item = tree->buckets[i]; item != NULL; item = next) {
+            UINT b = tree_bucket(item->key, newbits);
 
-/* find the item with the given key. if it does not exist, return
- * the parent item to which it would be attached. returns NULL if
- * no items in the tree
+            next = item->next;
+            item->next = newbuckets[b];
+            newbuckets[b] = item;
+        }
+    }
+
+    HeapFree(GetProcessHeap(), NULL, tree->buckets);
+    tree->buckets = newbuckets;
+    tree->bits = newbits;
+}
+
+
+/* find the item with the given key. returns NULL if it is not
+ * in the tree.
  */
 TREEITEM
 tree_getitem(TREE tree, TREEKEY key)
 {
-    TREEITEM item, prev;
-
+    TREEITEM item;
 
-    prev = NULL;
-    for (item = tree->first; item != NULL; ) {
+    for (item = tree->buckets[tree_bucket(key, tree->bits)];
+         item != NULL; item = item->next) {
 
         if (item->key == key) {
             return(item);
         }
-
-        /* not this item - go on to the correct child item.
-         * remember this item as if the child is NULL, this item
-         * will be the correct insertion point for the new item
-         */
-        prev = item;
-
-        if (key < item->key) {
-            item = item->left;
-        } else {
-            item = item->right;
-        }
     }
-    /* prev is the parent - or null if nothing in tree */
-    return(prev);
+    return(NULL);
 }
 
 /* --- external functions ------------------------------------------ */
@@ -151,7 +176,14 @@ tree_create()
     if (tree == NULL)
 		return NULL;
 
-	tree->first = NULL;
+    tree->bits = TREE_INITBITS;
+    tree->count = 0;
+    tree->buckets = (TREEITEM FAR *) HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                               sizeof(TREEITEM) << TREE_INITBITS);
+    if (tree->buckets == NULL) {
+        HeapFree(GetProcessHeap(), NULL, tree);
+        return NULL;
+    }
     return(tree);
 }
 
@@ -162,9 +194,18 @@ tree_create()
 void APIENTRY
 tree_delete(TREE tree)
 {
+    TREEITEM item, next;
+    UINT i, nbuckets;
+
+    nbuckets = 1 << tree->bits;
+    for (i = 0; i < nbuckets; i++) {
+        for (item = tree->buckets[i]; item != NULL; item = next) {
+            next = item->next;
+            HeapFree(GetProcessHeap(), NULL, item);
+        }
+    }
 
-    tree_delitem(tree->first);
-
+    HeapFree(GetProcessHeap(), NULL, tree->buckets);
     HeapFree(GetProcessHeap(), NULL, tree);
 }
 
@@ -177,16 +218,10 @@ tree_find(TREE tree, TREEKEY key)
 {
     TREEITEM item;
 
-    /* find the correct place in the tree */
     item = tree_getitem(tree, key);
 
     if (item == NULL) {
-        /* nothing in the tree */
-        return(NULL);
-    }
-
-    if (item->key != key) {
-        /* this key not in. getitem has returned parent */
+        /* this key not in the tree */
         return(NULL);
     }
 
@@ -203,12 +238,16 @@ tree_find(TREE tree, TREEKEY key)
  * existing value (increment a reference count, for example).
  *
  * if tree_search fails to find the key, it will return a TREEITEM handle
- * for the parent. This can be passed to tree_addafter to insert the
- * new element without re-searching the tree.
+ * for the insertion point. This can be passed to tree_addafter to insert
+ * the new element without re-searching the tree.
+ *
+ * with the hash table, the insertion point is simply the head of the
+ * key's chain; since the table may be resized by tree_addafter, the
+ * placeholder is only used as a hint and the bucket is recomputed there.
  */
 
 /*
- * find an element. if not, find it's correct parent item
+ * find an element. if not, set place to the head of its bucket chain
  */
 LPVOID APIENTRY
 tree_search(TREE tree, TREEKEY key, PTREEITEM pplace)
@@ -217,17 +256,7 @@ tree_search(TREE tree, TREEKEY key, PTREEITEM pplace)
 
     item = tree_getitem(tree, key);
 
-    if (item == NULL) {
-        /* no items in tree. set placeholder to NULL to
-         * indicate insert at top of tree
-         */
-        *pplace = NULL;
-
-        /* return NULL to indicate key not found */
-        return(NULL);
-    }
-
-    if (item->key == key) {
+    if (item != NULL) {
         /* found the key already there -
          * set pplace to null just for safety
          */
@@ -237,11 +266,10 @@ tree_search(TREE tree, TREEKEY key, PTREEITEM pplace)
         return(item->data);
     }
 
-
-    /* key was not found - getitem has returned the parent
-     * - set this as the place for new insertions
+    /* key was not found - remember the current chain head
+     * (possibly NULL) as the place for new insertions
      */
-    *pplace = item;
+    *pplace = tree->buckets[tree_bucket(key, tree->bits)];
 
     /* return NULL to indicate that the key was not found */
     return(NULL);
@@ -257,28 +285,27 @@ tree_search(TREE tree, TREEKEY key, PTREEITEM pplace)
 LPVOID APIENTRY
 tree_addafter(TREE tree, PTREEITEM place, TREEKEY key, LPVOID value, UINT length)
 {
-    TREEITEM item, child;
+    TREEITEM child;
+    UINT b;
 
-    item = *place;
-    if (item == NULL) {
-        tree->first = tree_newitem(tree, key, value, length);
-        return (tree->first->data);
-    }
+    UNREFERENCED_PARAMETER(place);
 
     child = tree_newitem(tree, key, value, length);
-    if (child->key < item->key ) {
-        /* should go on left leg */
-        if (item->left != NULL) {
-            Trace_Error(NULL, "TREE: left leaf leg not free", FALSE);
+    if (child == NULL) {
+        Trace_Error(NULL, "TREE: out of memory", FALSE);
+        return(NULL);
+    }
 
-        }
-        item->left = child;
-    } else {
-        if (item->right != NULL) {
-            Trace_Error(NULL, "TREE: right leaf leg not free", FALSE);
-        }
-        item->right = child;
+    if (tree->count >= ((ULONG)TREE_MAXLOAD << tree->bits)) {
+        tree_grow(tree);
     }
+
+    /* push the new item on the front of its chain */
+    b = tree_bucket(key, tree->bits);
+    child->next = tree->buckets[b];
+    tree->buckets[b] = child;
+    tree->count++;
+
     return(child->data);
 }
 
@@ -342,6 +369,9 @@ ctree_update(TREE tree, TREEKEY key, LPVOID value, UINT length)
          */
         pcounter = (LONG_PTR *)tree_addafter(tree, &item, key, NULL,
                                  length + sizeof(LONG_PTR));
+        if (pcounter == NULL) {
+            return(NULL);
+        }
         *pcounter = 1;
         /* add on size of one long to get the start of the user
          * data
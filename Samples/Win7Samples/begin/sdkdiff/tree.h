@@ -13,9 +13,9 @@
  * data type providing a map from a key to a value, where the value is
  * an arbitrary area of storage.
  *
- * The current implementation of this is a binary search tree with no
- * balancing, so it will be inefficient if the data is presented in
- * strict ascending or descending order.
+ * The current implementation of this is a hash table that grows as
+ * items are added, so lookup cost does not depend on the order in which
+ * keys are presented. Items are not kept in key order.
  *
  * include gutils.h before this.
  */
@@ -64,7 +64,7 @@ LPVOID APIENTRY tree_find(TREE tree, TREEKEY key);
  *
  * the two functions below provide an optimisation over this. tree_search
  * will return the value if found; if not, it will return NULL, and set
- * pitem to a pointer to a place holder in the tree where the item
+ * pitem to a place holder in the tree where the item
  * should be inserted. tree_addafter takes this placeholder as
  * an argument, and will insert the key/value in the tree at that point.
  *
@@ -15,6 +15,11 @@
 
 #include <winnls.h>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define HASH_SIMD
+#endif
+
 #include "gutilsrc.h"
 
 
@@ -41,8 +46,19 @@ INT_PTR dodlg_stringin(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
  * set of functions to read a line at a time from a file, using
  * a buffer to read a block at a time from the file
  *
+ * ansi files that fit comfortably in the address space are instead
+ * mapped into memory (copy-on-write, so we can still patch nulls), and
+ * readfile_next hands out pointers straight into the view. This avoids
+ * the ReadFile calls and the memmove of partial lines for each block.
  */
 
+/* largest file we will map in one view rather than read in blocks */
+#ifdef _WIN64
+#define READFILE_MAXMAP     ((DWORD)0xC0000000)
+#else
+#define READFILE_MAXMAP     ((DWORD)(256 * 1024 * 1024))
+#endif
+
 /*
  * a FILEBUFFER handle is a pointer to a struct filebuffer
  */
@@ -57,6 +73,11 @@ struct filebuffer {
     WCHAR wzBuffer[MAX_LINE_LENGTH];
     LPWSTR pwzStart;
     LPWSTR pwzLast;
+
+    HANDLE hMapping;    /* file mapping, or NULL if reading in blocks */
+    LPSTR pMapView;     /* base of mapped view of the whole file */
+    LPSTR pMapNext;     /* next character to return from the view */
+    LPSTR pMapEnd;      /* one past the last character in the view */
 };
 
 typedef enum {
@@ -93,6 +114,46 @@ DBCScharType(
     return CT_INVALID;
 }
 
+/*
+ * try to map the whole of an ansi file into memory. on any failure
+ * (empty file, too big, not mappable) we leave hMapping NULL and the
+ * file will be read in blocks as usual.
+ */
+static void
+readfile_map(
+            FILEBUFFER fbuf,
+            HANDLE fh
+            )
+{
+    DWORD cbHigh;
+    DWORD cbFile;
+
+    fbuf->fh = fh;
+    fbuf->start = fbuf->buffer;
+    fbuf->last = fbuf->buffer;
+
+    cbFile = GetFileSize(fh, &cbHigh);
+    if ((cbFile == INVALID_FILE_SIZE && GetLastError() != NO_ERROR)
+        || cbHigh != 0 || cbFile == 0 || cbFile > READFILE_MAXMAP) {
+        return;
+    }
+
+    fbuf->hMapping = CreateFileMapping(fh, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (fbuf->hMapping == NULL) {
+        return;
+    }
+
+    fbuf->pMapView = (LPSTR) MapViewOfFile(fbuf->hMapping, FILE_MAP_COPY, 0, 0, 0);
+    if (fbuf->pMapView == NULL) {
+        CloseHandle(fbuf->hMapping);
+        fbuf->hMapping = NULL;
+        return;
+    }
+
+    fbuf->pMapNext = fbuf->pMapView;
+    fbuf->pMapEnd = fbuf->pMapView + cbFile;
+}
+
 /*
  * initialise a filebuffer and return a handle to it
  */
@@ -144,6 +205,11 @@ readfile_new(
         }
     }
 
+    if (!fbuf->fUnicode)
+    {
+        readfile_map(fbuf, fh);
+    }
+
     return(fbuf);
 }
 
@@ -176,6 +242,60 @@ readfile_setdelims(
 } /* readfile_setdelims */
 
 
+/*
+ * return the next line from a mapped file. as for the buffered case, a
+ * line longer than BUFFER_SIZE is returned in BUFFER_SIZE pieces, and
+ * embedded nulls are replaced by '.' (the view is copy-on-write, so this
+ * does not touch the file).
+ */
+static LPSTR readfile_nextmapped(FILEBUFFER fbuf, int *pcch)
+{
+    LPSTR psz;
+    LPSTR pszLimit;
+    LPSTR pszLine = fbuf->pMapNext;
+
+    if (pszLine >= fbuf->pMapEnd) {
+        *pcch = 0;
+        return NULL;
+    }
+
+    pszLimit = fbuf->pMapEnd;
+    if (pszLimit - pszLine > BUFFER_SIZE) {
+        pszLimit = pszLine + BUFFER_SIZE;
+    }
+
+    for (psz = pszLine; psz < pszLimit; ) 
+    {
+        if (!*psz)
+            *psz = '.';
+
+        if (delims[*(LPBYTE)psz]) 
+        {
+            psz++;
+            break;
+        }
+
+        /* step over both bytes of a double byte character, as
+         * CharNext would. A pair that would run past the end of this
+         * piece is left for the next one, and a lead byte that ends the
+         * view stands alone, so psz never passes pszLimit.
+         */
+        if (IsDBCSLeadByte(*psz)) {
+            if (psz + 1 < pszLimit) {
+                psz++;
+            } else if (pszLimit < fbuf->pMapEnd) {
+                break;
+            }
+        }
+        psz++;
+    }
+
+    *pcch = (int)(psz - pszLine);
+    fbuf->pMapNext = psz;
+    return pszLine;
+}
+
+
 static BOOL FFindEOL(FILEBUFFER fbuf, LPSTR *ppszLine, int *pcch, LPWSTR *ppwzLine, int *pcwch)
 {
     LPSTR psz;
@@ -244,6 +364,11 @@ readfile_next(
     *ppwz = NULL;
     *pcwch = 0;
 
+    if (fbuf->hMapping != NULL) 
+    {
+        return readfile_nextmapped(fbuf, plen);
+    }
+
     /* look for an end of line in the buffer we have */
     if (FFindEOL(fbuf, &cstart, plen, ppwz, pcwch)) 
     {
@@ -406,6 +531,12 @@ readfile_delete(
                FILEBUFFER fbuf
                )
 {
+    if (fbuf->pMapView != NULL) {
+        UnmapViewOfFile(fbuf->pMapView);
+    }
+    if (fbuf->hMapping != NULL) {
+        CloseHandle(fbuf->hMapping);
+    }
     HeapFree(GetProcessHeap(), NULL, fbuf);
 }
 
@@ -457,30 +588,15 @@ checksum_file(
     unsigned Byte = 0;                   /* buffer[Byte] is next byte to process */
     DWORD Block = 0;                  /* number of bytes in buffer */
     BOOL Ending = FALSE;                 /* TRUE => binary zero padding added */
-    int i;                               /* temp loop counter */
 
     *err = -2;                            /* default is "silly" */
 
-    /* conceivably someone is fiddling with the file...?
-       we give 6 goes, with delays of 1,2,3,4 and 5 secs between
-    */
-    for (i=0; i<=5; ++i) {
-        Sleep(1000*i);
-        fh = CreateFile(fn, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
-        if (fh!=INVALID_HANDLE_VALUE)
-            break;
-
-        {
-            char msg[300];
-            HRESULT hr = StringCchPrintf( msg,300, "SDKDiff: retry open. Error(%d), file(%s)\n"
-                                          , GetLastError(), fn);
-            if (FAILED(hr)) 
-            {
-                OutputError(hr, IDS_SAFE_PRINTF);
-            }
-            OutputDebugString(msg);
-        }
-    }
+    /* share reading with anyone else looking at the file - the scan
+     * threads and the viewer may well have it open too. A file that
+     * someone holds open for writing fails at once rather than after
+     * a string of retries that would stall a checksum worker.
+     */
+    fh = CreateFile(fn, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
 
     if (fh == INVALID_HANDLE_VALUE) {
         *err = GetLastError();
@@ -760,18 +876,22 @@ utils_CompPath(
  * The large multiple ensures that anagrams generate different hash
  * codes.
  */
-DWORD APIENTRY
-hash_string(
+#define LARGENUMBER     6293815
+
+/*
+ * the straightforward version, also used to finish off a string that the
+ * SSE2 version below gives up on part way. sum, multiple and index carry
+ * the state from the characters already hashed.
+ */
+static DWORD
+hash_scalar(
            LPSTR string,
-           BOOL bIgnoreBlanks
+           BOOL bIgnoreBlanks,
+           DWORD sum,
+           DWORD multiple,
+           int index
            )
 {
-#define LARGENUMBER     6293815
-
-    DWORD sum = 0;
-    DWORD multiple = LARGENUMBER;
-    int index = 1;
-
     while (*string != '\0') {
 
         if (bIgnoreBlanks) {
@@ -784,6 +904,235 @@ hash_string(
         multiple *= LARGENUMBER;
     }
     return(sum);
+} /* hash_scalar */
+
+#ifdef HASH_SIMD
+
+/*
+ * The hash is a dot product of the (non-blank) characters with a fixed
+ * sequence of weights, position * LARGENUMBER^position, so we precompute
+ * the weights and do the multiply and add 16 characters at a time. The
+ * table covers any line we build (see BUFFER_SIZE); after that we carry on
+ * a character at a time.
+ *
+ * Blanks are squeezed out of each 8 characters with a pshufb (SSSE3) using
+ * a table of shuffle controls indexed by the mask of characters to keep.
+ * Without SSSE3, blocks containing blanks are summed a character at a time,
+ * but still using the weight table.
+ *
+ * The loads are 16-byte aligned, so although they read a few bytes either
+ * side of the string they can never touch another page.
+ */
+#define HASH_MAXWEIGHT  (BUFFER_SIZE + 32)
+
+static DWORD hash_weights[HASH_MAXWEIGHT];
+static BYTE hash_compact[256][16];
+static BYTE hash_bitcount[256];
+static BOOL hash_fSSE2;
+static BOOL hash_fSSSE3;
+static BOOL hash_fDisabled;     /* see utils_enablesimd */
+
+/* 0 = not initialised, 1 = being initialised, 2 = ready */
+static LONG hash_state;
+
+static void
+hash_init(void)
+{
+    DWORD multiple = LARGENUMBER;
+    int cpuinfo[4];
+    int i, j, n;
+
+    if (InterlockedCompareExchange(&hash_state, 1, 0) != 0) {
+        /* done, or another thread is doing it - use scalar meanwhile */
+        return;
+    }
+
+    for (i = 0; i < HASH_MAXWEIGHT; i++) {
+        hash_weights[i] = multiple * (i + 1);
+        multiple *= LARGENUMBER;
+    }
+
+    for (i = 0; i < 256; i++) {
+        n = 0;
+        for (j = 0; j < 8; j++) {
+            if (i & (1 << j)) {
+                hash_compact[i][n++] = (BYTE) j;
+            }
+        }
+        hash_bitcount[i] = (BYTE) n;
+        while (n < 16) {
+            /* a set top bit makes pshufb store a zero, which adds nothing */
+            hash_compact[i][n++] = 0x80;
+        }
+    }
+
+#ifdef _M_X64
+    hash_fSSE2 = TRUE;
+#else
+    hash_fSSE2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+    __cpuid(cpuinfo, 1);
+    hash_fSSSE3 = hash_fSSE2 && (cpuinfo[2] & (1 << 9));
+
+    InterlockedExchange(&hash_state, 2);
+}
+
+/* 32 x 32 -> 32 bit multiply of each lane: pmulld is SSE4.1, so use pmuludq */
+static __inline __m128i
+hash_mullo(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return(_mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))));
+}
+
+/*
+ * add the low 8 characters in chars times weights[0..7] into acc. The
+ * characters are sign-extended since char is signed in the scalar version.
+ */
+static __inline __m128i
+hash_dot8(__m128i acc, __m128i chars, const DWORD * weights)
+{
+    __m128i c16 = _mm_srai_epi16(_mm_unpacklo_epi8(chars, chars), 8);
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(c16, c16), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(c16, c16), 16);
+
+    acc = _mm_add_epi32(acc,
+                        hash_mullo(lo, _mm_loadu_si128((const __m128i *) weights)));
+    return(_mm_add_epi32(acc,
+                         hash_mullo(hi, _mm_loadu_si128((const __m128i *) (weights + 4)))));
+}
+
+static DWORD
+hash_simd(
+         LPSTR string,
+         BOOL bIgnoreBlanks
+         )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    __m128i acc = zero;
+    __m128i chars, ctl;
+    LPSTR block = (LPSTR) ((ULONG_PTR) string & ~(ULONG_PTR) 15);
+    UINT keep = (0xffff << (string - block)) & 0xffff;
+    UINT end, lo, hi, i;
+    UINT j = 0;         /* count of characters hashed so far */
+    DWORD sum = 0;
+    DWORD multiple;
+
+    for (;;) {
+        if (j > HASH_MAXWEIGHT - 16) {
+            /* off the end of the weight table: finish the slow way */
+            multiple = LARGENUMBER;
+            for (i = 0; i < j; i++) {
+                multiple *= LARGENUMBER;
+            }
+            sum = hash_scalar((block > string) ? block : string, bIgnoreBlanks,
+                              sum, multiple, j + 1);
+            break;
+        }
+
+        chars = _mm_load_si128((const __m128i *) block);
+
+        /* keep nothing from the terminator on */
+        end = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, zero)) & keep;
+        if (end != 0) {
+            keep &= (end & (0 - end)) - 1;
+        }
+        if (bIgnoreBlanks) {
+            keep &= ~_mm_movemask_epi8(
+                        _mm_or_si128(_mm_cmpeq_epi8(chars, space),
+                                     _mm_or_si128(_mm_cmpeq_epi8(chars, tab),
+                                                  _mm_cmpeq_epi8(chars, cr))));
+        }
+
+        if (keep == 0xffff) {
+            acc = hash_dot8(acc, chars, &hash_weights[j]);
+            acc = hash_dot8(acc, _mm_srli_si128(chars, 8), &hash_weights[j + 8]);
+            j += 16;
+        } else if (keep != 0) {
+            if (hash_fSSSE3) {
+                lo = keep & 0xff;
+                hi = keep >> 8;
+                ctl = _mm_loadu_si128((const __m128i *) hash_compact[lo]);
+                acc = hash_dot8(acc, _mm_shuffle_epi8(chars, ctl), &hash_weights[j]);
+                j += hash_bitcount[lo];
+                ctl = _mm_loadu_si128((const __m128i *) hash_compact[hi]);
+                acc = hash_dot8(acc, _mm_shuffle_epi8(_mm_srli_si128(chars, 8), ctl),
+                                &hash_weights[j]);
+                j += hash_bitcount[hi];
+            } else {
+                for (i = 0; i < 16; i++) {
+                    if (keep & (1 << i)) {
+                        sum += hash_weights[j++] * block[i];
+                    }
+                }
+            }
+        }
+
+        if (end != 0) {
+            break;
+        }
+        block += 16;
+        keep = 0xffff;
+    }
+
+    /* add up the four lanes */
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return(sum + (DWORD) _mm_cvtsi128_si32(acc));
+} /* hash_simd */
+
+#endif /* HASH_SIMD */
+
+/*
+ * return TRUE if the SSE2 versions of hash_string and line_compare
+ * can be used on this processor.
+ */
+BOOL APIENTRY
+utils_usesimd(void)
+{
+#ifdef HASH_SIMD
+    if (hash_state != 2) {
+        hash_init();
+    }
+    return(hash_state == 2 && hash_fSSE2 && !hash_fDisabled);
+#else
+    return(FALSE);
+#endif
+}
+
+/*
+ * turn the SSE2 versions of hash_string and line_compare off (or back
+ * on), so that they can be timed against the scalar code. Not for use
+ * while a comparison is running.
+ */
+void APIENTRY
+utils_enablesimd(BOOL bEnable)
+{
+#ifdef HASH_SIMD
+    hash_fDisabled = !bEnable;
+#else
+    UNREFERENCED_PARAMETER(bEnable);
+#endif
+}
+
+DWORD APIENTRY
+hash_string(
+           LPSTR string,
+           BOOL bIgnoreBlanks
+           )
+{
+#ifdef HASH_SIMD
+    if (utils_usesimd()) {
+        return(hash_simd(string, bIgnoreBlanks));
+    }
+#endif
+    return(hash_scalar(string, bIgnoreBlanks, 0, LARGENUMBER, 1));
 } /* hash_string */
 
 
@@ -99,6 +99,8 @@
 #define IDM_FPCHANGE_LAURIE		222
 #define IDM_TABWIDTH4   223
 #define IDM_TABWIDTH8   224
+#define IDM_LINEARDIFF  225
+#define IDM_INCREMENTAL 226
 
 #define IDM_MARK        300
 #define IDM_MARKPATTERN 301
@@ -222,6 +224,7 @@
 #define IDS_USAGE_STR24             759
 #define IDS_USAGE_STR25             760
 #define IDS_USAGE_STR26             761
+#define IDS_USAGE_STR01B            762
 
 #define IDS_GOTOLINE_INVALIDSTRING  800
 #define IDS_GOTOLINE_NOLINES        801
@@ -18,6 +18,17 @@
 #define MAX_BUFF_SIZE       8192
 #define MAX_WORKER_THREAD   16
 
+#define CTXT_SLAB_SIZE      (256 * 1024)    // bytes carved into contexts at a time
+#define CTXT_CACHE_MAX      32              // free contexts a thread keeps for itself
+#define CTXT_SHARD_COUNT    16              // sub-lists in the context list, power of 2
+
+#define BUFF_SLICE_SIZE     4096            // bytes of the buffer region per connection (-b)
+#define BUFF_SLICE_COUNT    1024            // default number of slices in the region
+#define BATCH_ENTRY_COUNT   64              // completions dequeued at a time (-b)
+
+#define POOL_BENCH_ROUNDS   100000          // default rounds per thread for -m
+#define POOL_BENCH_BURST    64              // connections each thread holds at once (-m)
+
 typedef enum _IO_OPERATION {
     ClientIoAccept,
     ClientIoRead,
@@ -27,9 +38,12 @@ typedef enum _IO_OPERATION {
 //
 // data to be associated for every I/O operation on a socket
 //
+// pBuffer is where the data goes: the context's own Buffer normally, or a
+// slice of the shared buffer region in batched mode. Buffer must stay last,
+// since batched mode allocates contexts without it.
+//
 typedef struct _PER_IO_CONTEXT {
     WSAOVERLAPPED               Overlapped;
-    char                        Buffer[MAX_BUFF_SIZE];
     WSABUF                      wsabuf;
     int                         nTotalBytes;
     int                         nSentBytes;
@@ -37,6 +51,9 @@ typedef struct _PER_IO_CONTEXT {
     SOCKET                      SocketAccept; 
 
     struct _PER_IO_CONTEXT      *pIOContextForward;
+    char                        *pBuffer;
+    DWORD                       cbBuffer;
+    char                        Buffer[MAX_BUFF_SIZE];
 } PER_IO_CONTEXT, *PPER_IO_CONTEXT;
 
 //
@@ -59,8 +76,64 @@ typedef struct _PER_SOCKET_CONTEXT {
     PPER_IO_CONTEXT             pIOContext;  
     struct _PER_SOCKET_CONTEXT  *pCtxtBack; 
     struct _PER_SOCKET_CONTEXT  *pCtxtForward;
+    DWORD                       dwShard;        // which context list it is on
 } PER_SOCKET_CONTEXT, *PPER_SOCKET_CONTEXT;
 
+//
+// Both kinds of context are recycled through pools instead of being allocated
+// from the process heap for every connection. A pool hands out contexts carved
+// from CTXT_SLAB_SIZE slabs; freed contexts go first to a small private list
+// of the freeing thread, then to a lock-free SLIST shared by all threads.
+//
+typedef enum _CTXT_POOL_TYPE {
+    CtxtPoolSocket,
+    CtxtPoolIo,
+    CtxtPoolCount
+} CTXT_POOL_TYPE;
+
+typedef struct _CTXT_POOL {
+    SLIST_HEADER                FreeList;       // free contexts for any thread
+    SLIST_HEADER                SlabList;       // every slab, to release at exit
+    SIZE_T                      cbEntry;        // context size, suitably aligned
+    const char                  *pszName;
+    volatile LONGLONG           nAllocs;        // contexts handed out
+    volatile LONGLONG           nHits;          // ... that were recycled
+    volatile LONG               nSlabs;
+} CTXT_POOL, *PCTXT_POOL;
+
+//
+// per-thread free list and counters for one pool, folded into the pool
+// by CtxtCacheFlush when the thread is done.
+//
+typedef struct _CTXT_CACHE {
+    PSLIST_ENTRY                pFree;
+    DWORD                       nFree;
+    LONGLONG                    nAllocs;
+    LONGLONG                    nHits;
+} CTXT_CACHE, *PCTXT_CACHE;
+
+//
+// The list of connection contexts is split CTXT_SHARD_COUNT ways by socket
+// handle, each part with its own lock, so that connections coming and going
+// on different threads seldom wait for each other.
+//
+typedef struct DECLSPEC_ALIGN(64) _CTXT_SHARD {
+    CRITICAL_SECTION            CriticalSection;
+    PPER_SOCKET_CONTEXT         pCtxtList;
+} CTXT_SHARD, *PCTXT_SHARD;
+
+//
+// Completions handled by one worker thread, printed when the server stops so
+// that changes to the worker threads can be compared.  Each worker has its own,
+// on its own cache line.
+//
+typedef struct DECLSPEC_ALIGN(64) _WORKER_STATS {
+    LONGLONG                    nCompletions;
+    LONGLONG                    nBytes;
+} WORKER_STATS, *PWORKER_STATS;
+
+#define CtxtShardOf(s)      ((DWORD)(((ULONG_PTR)(s) >> 2) & (CTXT_SHARD_COUNT - 1)))
+
 BOOL ValidOptions(int argc, char *argv[]);
 
 BOOL WINAPI CtrlHandler(
@@ -77,6 +150,20 @@ DWORD WINAPI WorkerThread (
     LPVOID WorkContext
     );
 
+DWORD WINAPI WorkerThreadBatched (
+    LPVOID WorkContext
+    );
+
+BOOL ProcessCompletion (
+    PPER_SOCKET_CONTEXT lpPerSocketContext,
+    LPWSAOVERLAPPED lpOverlapped,
+    DWORD dwIoSize,
+    BOOL bSuccess
+    );
+//
+// ProcessCompletion returns FALSE when the worker thread should exit.
+//
+
 PPER_SOCKET_CONTEXT UpdateCompletionPort(
     SOCKET s,
     IO_OPERATION ClientIo,
@@ -109,4 +196,49 @@ VOID CtxtListDeleteFrom(
     PPER_SOCKET_CONTEXT lpPerSocketContext
     );
 
+BOOL CtxtPoolCreate(
+    CTXT_POOL_TYPE Type,
+    SIZE_T cbEntry,
+    const char *pszName
+    );
+
+PVOID CtxtPoolAlloc(
+    CTXT_POOL_TYPE Type
+    );
+
+VOID CtxtPoolFree(
+    CTXT_POOL_TYPE Type,
+    PVOID pCtxt
+    );
+
+VOID CtxtCacheFlush(
+    );
+
+VOID CtxtPoolReport(
+    );
+
+VOID CtxtPoolDestroy(
+    );
+
+VOID WorkerReport(
+    );
+
+BOOL CtxtPoolBench(
+    DWORD nRounds
+    );
+
+BOOL BuffRegionCreate(
+    DWORD nSlices
+    );
+
+char *BuffSliceAlloc(
+    );
+
+VOID BuffSliceFree(
+    char *pSlice
+    );
+
+VOID BuffRegionDestroy(
+    );
+
 #endif
@@ -18,10 +18,20 @@
 #define MAX_BUFF_SIZE       8192
 #define MAX_WORKER_THREAD   16
 
+#define CTXT_SLAB_SIZE      (256 * 1024)    // bytes carved into contexts at a time
+#define CTXT_CACHE_MAX      32              // free contexts a thread keeps for itself
+#define CTXT_SHARD_COUNT    16              // sub-lists in the context list, power of 2
+
+#define ACCEPT_POOL_MIN     4               // fewest AcceptEx calls kept outstanding
+#define ACCEPT_POOL_MAX     1024            // default for the most (-a)
+#define ACCEPT_TUNE_INTERVAL 1000           // ms between looks at the accept rate
+#define REUSE_POOL_MAX      4096            // most disconnected sockets kept for reuse
+
 typedef enum _IO_OPERATION {
     ClientIoAccept,
     ClientIoRead,
-    ClientIoWrite
+    ClientIoWrite,
+    ClientIoDisconnect
 } IO_OPERATION, *PIO_OPERATION;
 
 //
@@ -37,6 +47,7 @@ typedef struct _PER_IO_CONTEXT {
     SOCKET                      SocketAccept; 
 
     struct _PER_IO_CONTEXT      *pIOContextForward;
+    struct _PER_SOCKET_CONTEXT  *pReuseCtxt;    // owner of SocketAccept, if it is reused
 } PER_IO_CONTEXT, *PPER_IO_CONTEXT;
 
 //
@@ -44,6 +55,12 @@ typedef struct _PER_IO_CONTEXT {
 // so we need to another field SocketAccept in PER_IO_CONTEXT. When the outstanding
 // AcceptEx completes, this field is our connection socket handle.
 //
+// Several AcceptEx calls are kept outstanding, each with its own PER_IO_CONTEXT
+// on the listening socket's list of i/o.  When a client closes its connection the
+// socket is disconnected with DisconnectEx rather than closed, and waits on a reuse
+// list, still holding its PER_SOCKET_CONTEXT and still on the IOCP, until an AcceptEx
+// takes it: pReuseCtxt is then that context.
+//
 
 //
 // data to be associated with every socket added to the IOCP
@@ -52,6 +69,7 @@ typedef struct _PER_SOCKET_CONTEXT {
     SOCKET                      Socket;
 
     LPFN_ACCEPTEX               fnAcceptEx;
+    LPFN_DISCONNECTEX           fnDisconnectEx;
 
 	//
     //linked list for all outstanding i/o on the socket
@@ -59,8 +77,55 @@ typedef struct _PER_SOCKET_CONTEXT {
     PPER_IO_CONTEXT             pIOContext;  
     struct _PER_SOCKET_CONTEXT  *pCtxtBack; 
     struct _PER_SOCKET_CONTEXT  *pCtxtForward;
+    DWORD                       dwShard;        // which context list it is on
+    struct _PER_SOCKET_CONTEXT  *pReuseNext;    // next on the reuse list
 } PER_SOCKET_CONTEXT, *PPER_SOCKET_CONTEXT;
 
+//
+// Both kinds of context are recycled through pools instead of being allocated
+// from the process heap for every connection. A pool hands out contexts carved
+// from CTXT_SLAB_SIZE slabs; freed contexts go first to a small private list
+// of the freeing thread, then to a lock-free SLIST shared by all threads.
+//
+typedef enum _CTXT_POOL_TYPE {
+    CtxtPoolSocket,
+    CtxtPoolIo,
+    CtxtPoolCount
+} CTXT_POOL_TYPE;
+
+typedef struct _CTXT_POOL {
+    SLIST_HEADER                FreeList;       // free contexts for any thread
+    SLIST_HEADER                SlabList;       // every slab, to release at exit
+    SIZE_T                      cbEntry;        // context size, suitably aligned
+    const char                  *pszName;
+    volatile LONGLONG           nAllocs;        // contexts handed out
+    volatile LONGLONG           nHits;          // ... that were recycled
+    volatile LONG               nSlabs;
+} CTXT_POOL, *PCTXT_POOL;
+
+//
+// per-thread free list and counters for one pool, folded into the pool
+// by CtxtCacheFlush when the thread is done.
+//
+typedef struct _CTXT_CACHE {
+    PSLIST_ENTRY                pFree;
+    DWORD                       nFree;
+    LONGLONG                    nAllocs;
+    LONGLONG                    nHits;
+} CTXT_CACHE, *PCTXT_CACHE;
+
+//
+// The list of connection contexts is split CTXT_SHARD_COUNT ways by socket
+// handle, each part with its own lock, so that connections coming and going
+// on different threads seldom wait for each other.
+//
+typedef struct DECLSPEC_ALIGN(64) _CTXT_SHARD {
+    CRITICAL_SECTION            CriticalSection;
+    PPER_SOCKET_CONTEXT         pCtxtList;
+} CTXT_SHARD, *PCTXT_SHARD;
+
+#define CtxtShardOf(s)      ((DWORD)(((ULONG_PTR)(s) >> 2) & (CTXT_SHARD_COUNT - 1)))
+
 BOOL ValidOptions(int argc, char *argv[]);
 
 BOOL WINAPI CtrlHandler(
@@ -69,8 +134,26 @@ BOOL WINAPI CtrlHandler(
 
 BOOL CreateListenSocket(void);
 
-BOOL CreateAcceptSocket(
-    BOOL fUpdateIOCP
+BOOL CreateAcceptPool(void);
+
+BOOL PostAccept(
+    PPER_IO_CONTEXT lpIOContext
+    );
+
+BOOL AcceptPoolGrow(void);
+
+VOID AcceptPoolTune(
+    BOOL bBacklog
+    );
+
+VOID AcceptIoRetire(
+    PPER_IO_CONTEXT lpIOContext
+    );
+
+VOID AcceptPoolFree(void);
+
+VOID DisconnectClient(
+    PPER_SOCKET_CONTEXT lpPerSocketContext
     );
 
 DWORD WINAPI WorkerThread (
@@ -109,4 +192,28 @@ VOID CtxtListDeleteFrom(
     PPER_SOCKET_CONTEXT lpPerSocketContext
     );
 
+BOOL CtxtPoolCreate(
+    CTXT_POOL_TYPE Type,
+    SIZE_T cbEntry,
+    const char *pszName
+    );
+
+PVOID CtxtPoolAlloc(
+    CTXT_POOL_TYPE Type
+    );
+
+VOID CtxtPoolFree(
+    CTXT_POOL_TYPE Type,
+    PVOID pCtxt
+    );
+
+VOID CtxtCacheFlush(
+    );
+
+VOID CtxtPoolReport(
+    );
+
+VOID CtxtPoolDestroy(
+    );
+
 #endif
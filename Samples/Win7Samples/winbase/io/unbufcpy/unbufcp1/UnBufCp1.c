@@ -41,6 +41,14 @@ Abstract:
   |    |                              |             |
   |____|                              |_____________|
 
+    The number of I/Os kept outstanding and the size of each one are not
+    fixed. For files large enough to measure, the first part of the copy is
+    done as a calibration pass: consecutive slices of the file are copied
+    with each queue-depth/chunk-size combination in turn, the rate of each
+    is printed, and the fastest is kept for the rest of the file. While the
+    rest is copied the queue depth keeps being adjusted from the measured
+    completion latency and throughput.
+
 --*/
 #ifdef _IA64_
 #pragma warning(disable:4100)
@@ -79,23 +87,67 @@ HANDLE IoPort;
 //
 // Structure used to track each outstanding I/O. The maximum
 // number of I/Os that will be outstanding at any time is
-// controllable by the MAX_CONCURRENT_IO definition.
+// controllable by the MAX_CONCURRENT_IO definition; the number
+// actually outstanding is QueueDepth.
 //
 
-#define MAX_CONCURRENT_IO 20
+#define MAX_CONCURRENT_IO 64
+#define MIN_CONCURRENT_IO 2
 
 typedef struct _COPY_CHUNK {
     OVERLAPPED Overlapped;
     LPVOID Buffer;
+    DWORD BufferLength;
+    LONGLONG IssueTime;
 } COPY_CHUNK, *PCOPY_CHUNK;
 
 COPY_CHUNK CopyChunk[MAX_CONCURRENT_IO];
 
 //
-// Define the size of the buffers used to do the I/O.
-// 64K is a nice number.
+// Queue depth and chunk size currently in use. These start out at
+// the 20 x 64K the sample has always used and are replaced by the
+// calibration result when the file is big enough to calibrate on.
+//
+DWORD QueueDepth = 20;
+DWORD BufferSize = 64*1024;
+
+//
+// Never have more than this many bytes outstanding at once. This
+// caps the depth used with the larger chunk sizes.
 //
-#define BUFFER_SIZE (64*1024)
+#define MAX_INFLIGHT (16*1024*1024)
+
+//
+// Calibration settings. Each combination that fits in MAX_INFLIGHT
+// copies the next CALIBRATE_BYTES of the file, so calibration is
+// part of the copy rather than extra work. CALIBRATE_BYTES must be
+// a multiple of every chunk size. Files smaller than CALIBRATE_RATIO
+// times the total calibration length are not calibrated.
+//
+DWORD DepthCandidates[] = { 4, 16, 64 };
+DWORD SizeCandidates[] = { 64*1024, 256*1024, 1024*1024 };
+
+#define CALIBRATE_BYTES (32*1024*1024)
+#define CALIBRATE_RATIO 4
+
+//
+// State for adjusting QueueDepth during the copy. Completions are
+// collected into windows of at least ADAPT_INTERVAL seconds; at the
+// end of each window the depth is stepped in Direction unless the
+// last step lost throughput, or latency has doubled over the best
+// seen without any throughput to show for it.
+//
+#define ADAPT_INTERVAL 0.25
+
+typedef struct _ADAPT_STATE {
+    LONGLONG WindowStart;
+    ULONGLONG WindowBytes;
+    LONGLONG WindowLatency;
+    DWORD WindowCount;
+    double LastRate;
+    double BestLatency;
+    int Direction;
+} ADAPT_STATE, *PADAPT_STATE;
 
 //
 // The system's page size will always be a multiple of the
@@ -103,13 +155,41 @@ COPY_CHUNK CopyChunk[MAX_CONCURRENT_IO];
 //
 DWORD PageSize;
 
+//
+// Performance counter frequency, for timing calibration passes
+// and per-I/O latency.
+//
+LARGE_INTEGER Frequency;
+
 
 //
-// Local function prototype
+// Local function prototypes
 //
 VOID
-CopyLoop(
-    ULARGE_INTEGER FileSize
+Calibrate(
+    ULARGE_INTEGER FileSize,
+    PULARGE_INTEGER CopyPointer
+    );
+
+double
+CopyRange(
+    ULARGE_INTEGER Start,
+    ULARGE_INTEGER End,
+    BOOL Adapt
+    );
+
+VOID
+IssueRead(
+    PCOPY_CHUNK Chunk,
+    PULARGE_INTEGER ReadPointer
+    );
+
+VOID
+AdjustQueueDepth(
+    PADAPT_STATE State,
+    DWORD NumberBytes,
+    LONGLONG IssueTime,
+    LONGLONG Now
     );
 
 int
@@ -121,6 +201,8 @@ main(
 {
     ULARGE_INTEGER FileSize;
     ULARGE_INTEGER InitialSize;
+    ULARGE_INTEGER CopyPointer;
+    double Rate;
     BOOL Success;
     DWORD Status;
     DWORD StartTime, EndTime;
@@ -171,6 +253,7 @@ main(
     //
     GetSystemInfo(&SystemInfo);
     PageSize = SystemInfo.dwPageSize;
+    QueryPerformanceFrequency(&Frequency);
 
     //
     // Open the source file and create the destination file.
@@ -300,9 +383,19 @@ main(
     StartTime = GetTickCount();
 
     //
-    // Do the copy
+    // Do the copy. Calibration copies the start of the file; the
+    // rest is copied with the winning settings, adjusting the queue
+    // depth as it goes.
     //
-    CopyLoop(FileSize);
+    CopyPointer.QuadPart = 0;
+    Calibrate(FileSize, &CopyPointer);
+    if (CopyPointer.QuadPart < FileSize.QuadPart) {
+        Rate = CopyRange(CopyPointer, FileSize, TRUE);
+        printf("remainder at %.2f MB/sec, final depth %d x %dK\n",
+               Rate,
+               QueueDepth,
+               BufferSize / 1024);
+    }
 
     EndTime = GetTickCount();
 
@@ -360,9 +453,75 @@ main(
 
 }
 
+
 VOID
-CopyLoop(
-    ULARGE_INTEGER FileSize
+Calibrate(
+    ULARGE_INTEGER FileSize,
+    PULARGE_INTEGER CopyPointer
+    )
+{
+    ULARGE_INTEGER End;
+    ULONGLONG TotalBytes;
+    double Rate;
+    double BestRate = 0.0;
+    DWORD BestDepth = QueueDepth;
+    DWORD BestSize = BufferSize;
+    DWORD d, s;
+
+    //
+    // Work out how much of the file calibration would use. If the file
+    // is not large enough for that to be a small part of it, just use
+    // the defaults and let the adaptive loop settle the depth.
+    //
+    TotalBytes = 0;
+    for (s = 0; s < sizeof(SizeCandidates) / sizeof(SizeCandidates[0]); s++) {
+        for (d = 0; d < sizeof(DepthCandidates) / sizeof(DepthCandidates[0]); d++) {
+            if (DepthCandidates[d] * SizeCandidates[s] <= MAX_INFLIGHT) {
+                TotalBytes += CALIBRATE_BYTES;
+            }
+        }
+    }
+    if (FileSize.QuadPart < TotalBytes * CALIBRATE_RATIO) {
+        return;
+    }
+
+    printf("calibrating on %d MB slices\n", CALIBRATE_BYTES / (1024*1024));
+
+    for (s = 0; s < sizeof(SizeCandidates) / sizeof(SizeCandidates[0]); s++) {
+        for (d = 0; d < sizeof(DepthCandidates) / sizeof(DepthCandidates[0]); d++) {
+            if (DepthCandidates[d] * SizeCandidates[s] > MAX_INFLIGHT) {
+                continue;
+            }
+            QueueDepth = DepthCandidates[d];
+            BufferSize = SizeCandidates[s];
+
+            End.QuadPart = CopyPointer->QuadPart + CALIBRATE_BYTES;
+            Rate = CopyRange(*CopyPointer, End, FALSE);
+            *CopyPointer = End;
+
+            printf("  depth %2d x %4dK: %8.2f MB/sec\n",
+                   QueueDepth,
+                   BufferSize / 1024,
+                   Rate);
+
+            if (Rate > BestRate) {
+                BestRate = Rate;
+                BestDepth = QueueDepth;
+                BestSize = BufferSize;
+            }
+        }
+    }
+
+    QueueDepth = BestDepth;
+    BufferSize = BestSize;
+    printf("using depth %d x %dK\n", QueueDepth, BufferSize / 1024);
+}
+
+double
+CopyRange(
+    ULARGE_INTEGER Start,
+    ULARGE_INTEGER End,
+    BOOL Adapt
     )
 {
     ULARGE_INTEGER ReadPointer;
@@ -371,51 +530,32 @@ CopyLoop(
     LPOVERLAPPED CompletedOverlapped;
     DWORD_PTR Key;
     PCOPY_CHUNK Chunk;
-    int PendingIO = 0;
+    PCOPY_CHUNK IdleChunk[MAX_CONCURRENT_IO];
+    DWORD IdleCount;
+    DWORD PendingIO = 0;
+    LARGE_INTEGER StartTime, Now;
+    ADAPT_STATE State;
     int i;
 
+    for (i = 0; i < MAX_CONCURRENT_IO; i++) {
+        IdleChunk[i] = &CopyChunk[MAX_CONCURRENT_IO - 1 - i];
+    }
+    IdleCount = MAX_CONCURRENT_IO;
+
+    QueryPerformanceCounter(&StartTime);
+    ZeroMemory(&State, sizeof(State));
+    State.WindowStart = StartTime.QuadPart;
+    State.Direction = 1;
+
     //
-    // Start reading the file. Kick off MAX_CONCURRENT_IO reads, then just
+    // Start reading the range. Kick off QueueDepth reads, then just
     // loop waiting for I/O to complete.
     //
-    ReadPointer.QuadPart = 0;
-
-    for (i=0; i < MAX_CONCURRENT_IO; i++) {
-        if (ReadPointer.QuadPart >= FileSize.QuadPart) {
-            break;
-        }
-        //
-        // Use VirtualAlloc so we get a page-aligned buffer suitable
-        // for unbuffered I/O.
-        //
-        CopyChunk[i].Buffer = VirtualAlloc(NULL,
-                                           BUFFER_SIZE,
-                                           MEM_COMMIT,
-                                           PAGE_READWRITE);
-        if (CopyChunk[i].Buffer == NULL) {
-            fprintf(stderr, "VirtualAlloc %d failed, error %d\n",i, GetLastError());
-            exit(1);
-        }
-        CopyChunk[i].Overlapped.Offset = ReadPointer.LowPart;
-        CopyChunk[i].Overlapped.OffsetHigh = ReadPointer.HighPart;
-        CopyChunk[i].Overlapped.hEvent = NULL;     // not needed
+    ReadPointer = Start;
 
-        Success = ReadFile(SourceFile,
-                           CopyChunk[i].Buffer,
-                           BUFFER_SIZE,
-                           &NumberBytes,
-                           &CopyChunk[i].Overlapped);
-
-        if (!Success && (GetLastError() != ERROR_IO_PENDING)) {
-            fprintf(stderr,
-                    "ReadFile at %lx failed, error %d\n",
-                    ReadPointer.LowPart,
-                    GetLastError());
-            exit(1);
-        } else {
-            ReadPointer.QuadPart += BUFFER_SIZE;
-            ++PendingIO;
-        }
+    while ((PendingIO < QueueDepth) && (ReadPointer.QuadPart < End.QuadPart)) {
+        IssueRead(IdleChunk[--IdleCount], &ReadPointer);
+        ++PendingIO;
     }
 
     //
@@ -470,44 +610,178 @@ CopyLoop(
                 exit(1);
             }
 
-            //
-            // decrement pending I/O count
-            //
-            --PendingIO;
-
         } else if (Key == WriteKey) {
 
             //
-            // A write has completed, issue the next read.
+            // A write has completed. The time since its read was issued
+            // is the latency of one round trip through both devices.
             //
+            if (Adapt) {
+                QueryPerformanceCounter(&Now);
+                AdjustQueueDepth(&State, NumberBytes, Chunk->IssueTime, Now.QuadPart);
+            }
 
-            if (ReadPointer.QuadPart < FileSize.QuadPart) {
-                Chunk->Overlapped.Offset = ReadPointer.LowPart;
-                Chunk->Overlapped.OffsetHigh = ReadPointer.HighPart;
-                ReadPointer.QuadPart += BUFFER_SIZE;
-                Success = ReadFile(SourceFile,
-                                   Chunk->Buffer,
-                                   NumberBytes,
-                                   &NumberBytes,
-                                   &Chunk->Overlapped);
-                if (!Success && (GetLastError() != ERROR_IO_PENDING)) {
-                    fprintf(stderr,
-                            "ReadFile at %lx failed, error %d\n",
-                            Chunk->Overlapped.Offset,
-                            GetLastError());
-                    exit(1);
-                }
+            //
+            // Issue the next read, unless there are no more reads left
+            // to issue or the queue depth has been lowered, in which
+            // case the chunk is parked.
+            //
+            if ((ReadPointer.QuadPart < End.QuadPart) && (PendingIO <= QueueDepth)) {
+                IssueRead(Chunk, &ReadPointer);
             } else {
-                //
-                // There are no more reads left to issue, just
-                // wait for the pending writes to drain.
-                //
+                IdleChunk[IdleCount++] = Chunk;
                 --PendingIO;
             }
+
+            //
+            // If the queue depth has been raised, put parked chunks
+            // back to work.
+            //
+            while ((PendingIO < QueueDepth) &&
+                   (ReadPointer.QuadPart < End.QuadPart) &&
+                   (IdleCount != 0)) {
+                IssueRead(IdleChunk[--IdleCount], &ReadPointer);
+                ++PendingIO;
+            }
         }
     }
+
+    QueryPerformanceCounter(&Now);
+
+    //
+    // There is no need to call VirtualFree() to free CopyChunk buffers
+    // here. They are reused by the next range and freed when this
+    // process exits.
+    //
+    return ((LONGLONG)(End.QuadPart - Start.QuadPart) / (1024.0*1024.0)) /
+           ((double)(Now.QuadPart - StartTime.QuadPart) / Frequency.QuadPart);
+}
+
+VOID
+IssueRead(
+    PCOPY_CHUNK Chunk,
+    PULARGE_INTEGER ReadPointer
+    )
+{
+    BOOL Success;
+    DWORD NumberBytes;
+    LARGE_INTEGER Now;
+
+    //
+    // Use VirtualAlloc so we get a page-aligned buffer suitable
+    // for unbuffered I/O. A chunk keeps its buffer from one range
+    // to the next and only reallocates when the chunk size grows.
+    //
+    if (Chunk->BufferLength < BufferSize) {
+        if (Chunk->Buffer != NULL) {
+            VirtualFree(Chunk->Buffer, 0, MEM_RELEASE);
+        }
+        Chunk->Buffer = VirtualAlloc(NULL,
+                                     BufferSize,
+                                     MEM_COMMIT,
+                                     PAGE_READWRITE);
+        if (Chunk->Buffer == NULL) {
+            fprintf(stderr, "VirtualAlloc %d failed, error %d\n", BufferSize, GetLastError());
+            exit(1);
+        }
+        Chunk->BufferLength = BufferSize;
+    }
+
+    Chunk->Overlapped.Offset = ReadPointer->LowPart;
+    Chunk->Overlapped.OffsetHigh = ReadPointer->HighPart;
+    Chunk->Overlapped.hEvent = NULL;     // not needed
+
+    QueryPerformanceCounter(&Now);
+    Chunk->IssueTime = Now.QuadPart;
+
+    Success = ReadFile(SourceFile,
+                       Chunk->Buffer,
+                       BufferSize,
+                       &NumberBytes,
+                       &Chunk->Overlapped);
+
+    if (!Success && (GetLastError() != ERROR_IO_PENDING)) {
+        fprintf(stderr,
+                "ReadFile at %lx failed, error %d\n",
+                ReadPointer->LowPart,
+                GetLastError());
+        exit(1);
+    }
+    ReadPointer->QuadPart += BufferSize;
+}
+
+VOID
+AdjustQueueDepth(
+    PADAPT_STATE State,
+    DWORD NumberBytes,
+    LONGLONG IssueTime,
+    LONGLONG Now
+    )
+{
+    double Seconds;
+    double Rate;
+    double Latency;
+    DWORD Limit;
+    DWORD Step;
+    DWORD OldDepth;
+
+    State->WindowBytes += NumberBytes;
+    State->WindowLatency += Now - IssueTime;
+    ++State->WindowCount;
+
     //
-    // All done. There is no need to call VirtualFree() to free CopyChunk 
-    // buffers here. The buffers will be freed when this process exits.
+    // Only judge a window once every outstanding I/O has had a chance
+    // to complete a couple of times at the current depth, and enough
+    // time has gone by for the rate to mean something.
     //
+    Seconds = (double)(Now - State->WindowStart) / Frequency.QuadPart;
+    if ((State->WindowCount < 2 * QueueDepth) || (Seconds < ADAPT_INTERVAL)) {
+        return;
+    }
+
+    Rate = (LONGLONG)State->WindowBytes / (1024.0*1024.0) / Seconds;
+    Latency = (double)State->WindowLatency / State->WindowCount * 1000000.0 / Frequency.QuadPart;
+
+    if ((State->BestLatency == 0.0) || (Latency < State->BestLatency)) {
+        State->BestLatency = Latency;
+    }
+
+    if (State->LastRate != 0.0) {
+        if (Rate < State->LastRate * 0.95) {
+            //
+            // The last step cost throughput, go back the other way.
+            //
+            State->Direction = -State->Direction;
+        } else if ((Rate < State->LastRate * 1.05) && (Latency > State->BestLatency * 2)) {
+            //
+            // Requests are only queueing up in the device: latency has
+            // doubled with no throughput to show for it. Back off.
+            //
+            State->Direction = -1;
+        }
+    }
+
+    Limit = min(MAX_CONCURRENT_IO, MAX_INFLIGHT / BufferSize);
+    Step = max(1, QueueDepth / 4);
+    OldDepth = QueueDepth;
+
+    if (State->Direction > 0) {
+        QueueDepth = min(Limit, QueueDepth + Step);
+    } else {
+        QueueDepth = (QueueDepth > MIN_CONCURRENT_IO + Step) ? QueueDepth - Step : MIN_CONCURRENT_IO;
+    }
+
+    if (QueueDepth != OldDepth) {
+        printf("  depth %2d -> %2d (%.2f MB/sec, %.0f us per I/O)\n",
+               OldDepth,
+               QueueDepth,
+               Rate,
+               Latency);
+    }
+
+    State->LastRate = Rate;
+    State->WindowStart = Now;
+    State->WindowBytes = 0;
+    State->WindowLatency = 0;
+    State->WindowCount = 0;
 }
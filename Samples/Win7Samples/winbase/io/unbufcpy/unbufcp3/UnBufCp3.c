@@ -0,0 +1,927 @@
+/*++
+THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+PARTICULAR PURPOSE.
+
+Copyright (C) 1994 - 2000.  Microsoft Corporation.  All rights reserved.
+
+Module Name:
+
+    unbufcp3.c
+
+Abstract:
+
+    Copies a whole directory tree with the same unbuffered, overlapped
+    I/O as unbufcp1 and unbufcp2, but keeps many files in flight at once
+    so that trees of small files and single huge files both keep the
+    device queue full.
+
+    One I/O completion port is shared by every file. The source handle
+    of each file is associated with it using ReadKey and the destination
+    handle using WriteKey, exactly as unbufcp1 does for its single file.
+    A fixed pool of copy chunks, each with its own buffer, circulates
+    through the port: a chunk reads a piece of a file, turns it around
+    into a write, and when the write completes it reads the next piece.
+
+    Files are handed to the chunks in stripes of StripeSize bytes. A
+    small file is a single stripe. A large file is several, and while it
+    is at the head of the ready list every idle chunk takes its next
+    stripe, so the file is copied as a number of ranges in parallel.
+
+    Opening and closing files is kept off the I/O path. The main thread
+    walks the source tree and opens files ahead of the copy, up to
+    OpenAhead files at a time, so there is always work ready when a
+    chunk frees up. Finished files are put on a close list that a
+    separate thread drains in batches.
+
+    main thread               worker threads              close thread
+       |                           |                           |
+    walk tree,               GetQueuedCompletionStatus     wait for
+    open files,  --ready-->  read done: write it         --finished--> set EOF,
+    queue stripes            write done: read next or      close handles
+       ^                     take the next stripe              |
+       |______________________ open slot released _____________|
+
+    The -b option runs the same engine with the settings of the single
+    file tools: one file at a time, 20 x 64K I/Os, no read-ahead of
+    opens, so the two can be compared on the same tree.
+
+--*/
+
+#define _WIN32_WINNT 0x0600
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//
+// I/O completion port. All reads and writes of every file complete
+// to this port.
+//
+HANDLE IoPort;
+
+//
+// Key values used to determine what kind of packet has completed.
+// KickKey is posted to start an idle chunk on newly queued work and
+// ExitKey tells a worker thread to exit.
+//
+#define ReadKey 0
+#define WriteKey 1
+#define KickKey 2
+#define ExitKey 3
+
+//
+// Per-file state. A file stays on the ready list until all its
+// stripes have been handed out, and is put on the close list by the
+// chunk that finishes its last stripe. Error is the first error of any
+// of its I/Os; once it is set the rest of the file is skipped, and the
+// close thread reports it and deletes the destination.
+//
+typedef struct _FILE_COPY {
+    struct _FILE_COPY *Next;
+    HANDLE SourceFile;
+    HANDLE DestFile;
+    ULARGE_INTEGER FileSize;
+    ULONGLONG NextStripe;
+    LONG StripesLeft;
+    volatile LONG Error;
+    char SourcePath[MAX_PATH];
+} FILE_COPY, *PFILE_COPY;
+
+//
+// Structure used to track each outstanding I/O. A chunk works through
+// one stripe of one file at a time, from Offset up to End.
+//
+typedef struct _COPY_CHUNK {
+    OVERLAPPED Overlapped;
+    LPVOID Buffer;
+    PFILE_COPY File;
+    ULONGLONG Offset;
+    ULONGLONG End;
+} COPY_CHUNK, *PCOPY_CHUNK;
+
+#define MAX_CONCURRENT_IO 256
+
+COPY_CHUNK CopyChunk[MAX_CONCURRENT_IO];
+
+//
+// Engine settings. They can be changed from the command line; -b
+// switches to the settings of unbufcp1.
+//
+DWORD QueueDepth = 64;
+DWORD BufferSize = 256*1024;
+DWORD StripeSize = 4*1024*1024;
+DWORD OpenAhead = 256;
+DWORD WorkerCount = 0;
+
+//
+// Ready list of opened files with stripes left to hand out, and the
+// chunks that are waiting for one. Both are protected by WorkLock.
+//
+CRITICAL_SECTION WorkLock;
+PFILE_COPY ReadyHead;
+PFILE_COPY ReadyTail;
+PCOPY_CHUNK IdleChunk[MAX_CONCURRENT_IO];
+DWORD IdleCount;
+
+//
+// Close list of finished files, protected by CloseLock. CloseEvent
+// wakes the close thread; DoneEvent is set once every opened file has
+// been closed and the walk of the tree is over.
+//
+CRITICAL_SECTION CloseLock;
+PFILE_COPY CloseHead;
+HANDLE CloseEvent;
+HANDLE DoneEvent;
+
+//
+// Limits the number of files that are open at once.
+//
+HANDLE OpenSlots;
+
+//
+// Totals. FilesOpened and FilesFailed are only written by the main
+// thread, FilesCopied, FilesAborted and BytesCopied only by the close
+// thread.
+//
+volatile BOOL WalkDone;
+volatile DWORD FilesOpened;
+DWORD FilesFailed;
+DWORD FilesCopied;
+DWORD FilesAborted;
+ULONGLONG BytesCopied;
+
+//
+// The system's page size will always be a multiple of the
+// sector size. Do all I/Os in page-size chunks.
+//
+DWORD PageSize;
+
+
+//
+// Local function prototypes
+//
+VOID
+CopyTree(
+    LPCSTR SourceDir,
+    LPCSTR DestDir
+    );
+
+VOID
+OpenFileCopy(
+    LPCSTR SourcePath,
+    LPCSTR DestPath,
+    WIN32_FIND_DATA *FindData
+    );
+
+VOID
+QueueFile(
+    PFILE_COPY File
+    );
+
+BOOL
+TakeStripe(
+    PCOPY_CHUNK Chunk
+    );
+
+BOOL
+IssueRead(
+    PCOPY_CHUNK Chunk
+    );
+
+VOID
+FailChunk(
+    PCOPY_CHUNK Chunk,
+    DWORD Error
+    );
+
+BOOL
+EndStripe(
+    PCOPY_CHUNK Chunk
+    );
+
+VOID
+RunChunk(
+    PCOPY_CHUNK Chunk
+    );
+
+VOID
+FinishFile(
+    PFILE_COPY File
+    );
+
+DWORD
+WINAPI
+WorkerThread(
+    LPVOID Parameter
+    );
+
+DWORD
+WINAPI
+CloseThread(
+    LPVOID Parameter
+    );
+
+VOID
+Usage(
+    char *Name
+    )
+{
+    fprintf(stderr, "Usage: %s [-b] [-q:depth] [-c:KB] [-s:KB] [-o:files] [-t:threads] SourceDir DestinationDir\n", Name);
+    fprintf(stderr, "  -b           baseline: the unbufcp1 settings, one file at a time\n");
+    fprintf(stderr, "  -q:depth     I/Os outstanding across all files (default %d, max %d)\n", QueueDepth, MAX_CONCURRENT_IO);
+    fprintf(stderr, "  -c:KB        size of each I/O (default %d)\n", BufferSize / 1024);
+    fprintf(stderr, "  -s:KB        stripe size large files are split into (default %d)\n", StripeSize / 1024);
+    fprintf(stderr, "  -o:files     files opened ahead of the copy (default %d)\n", OpenAhead);
+    fprintf(stderr, "  -t:threads   completion threads (default one per processor)\n");
+    exit(1);
+}
+
+int
+__cdecl
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    HANDLE Thread;
+    HANDLE *Workers;
+    LPBYTE Buffers;
+    DWORD StartTime, EndTime;
+    double Seconds;
+    DWORD i;
+    int Arg;
+
+    GetSystemInfo(&SystemInfo);
+    PageSize = SystemInfo.dwPageSize;
+
+    for (Arg = 1; (Arg < argc) && ((argv[Arg][0] == '-') || (argv[Arg][0] == '/')); Arg++) {
+        switch (tolower(argv[Arg][1])) {
+        case 'b':
+            QueueDepth = 20;
+            BufferSize = 64*1024;
+            StripeSize = 64*1024;
+            OpenAhead = 1;
+            WorkerCount = 1;
+            break;
+        case 'q':
+            if (strlen(argv[Arg]) <= 3) Usage(argv[0]);
+            QueueDepth = atoi(&argv[Arg][3]);
+            break;
+        case 'c':
+            if (strlen(argv[Arg]) <= 3) Usage(argv[0]);
+            BufferSize = atoi(&argv[Arg][3]) * 1024;
+            break;
+        case 's':
+            if (strlen(argv[Arg]) <= 3) Usage(argv[0]);
+            StripeSize = atoi(&argv[Arg][3]) * 1024;
+            break;
+        case 'o':
+            if (strlen(argv[Arg]) <= 3) Usage(argv[0]);
+            OpenAhead = atoi(&argv[Arg][3]);
+            break;
+        case 't':
+            if (strlen(argv[Arg]) <= 3) Usage(argv[0]);
+            WorkerCount = atoi(&argv[Arg][3]);
+            break;
+        default:
+            Usage(argv[0]);
+        }
+    }
+    if (argc - Arg != 2) {
+        Usage(argv[0]);
+    }
+
+    //
+    // Every I/O must be a multiple of the page size, and a stripe must
+    // be a whole number of I/Os so that chunks never overlap.
+    //
+    if ((QueueDepth == 0) || (QueueDepth > MAX_CONCURRENT_IO) ||
+        (BufferSize == 0) || (BufferSize % PageSize) ||
+        (StripeSize < BufferSize) || (StripeSize % BufferSize) ||
+        (OpenAhead == 0)) {
+        Usage(argv[0]);
+    }
+    if (WorkerCount == 0) {
+        WorkerCount = SystemInfo.dwNumberOfProcessors;
+    }
+
+    if (!CreateDirectory(argv[Arg + 1], NULL) && (GetLastError() != ERROR_ALREADY_EXISTS)) {
+        fprintf(stderr, "failed to create %s, error %d\n", argv[Arg + 1], GetLastError());
+        exit(1);
+    }
+
+    IoPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, WorkerCount);
+    if (IoPort == NULL) {
+        fprintf(stderr, "failed to create IoPort, error %d\n", GetLastError());
+        exit(1);
+    }
+
+    InitializeCriticalSection(&WorkLock);
+    InitializeCriticalSection(&CloseLock);
+    CloseEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    DoneEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    OpenSlots = CreateSemaphore(NULL, OpenAhead, OpenAhead, NULL);
+    if ((CloseEvent == NULL) || (DoneEvent == NULL) || (OpenSlots == NULL)) {
+        fprintf(stderr, "failed to create synchronization objects, error %d\n", GetLastError());
+        exit(1);
+    }
+
+    //
+    // Use VirtualAlloc so we get page-aligned buffers suitable for
+    // unbuffered I/O. One allocation is carved up between the chunks,
+    // all of which start out idle.
+    //
+    Buffers = (LPBYTE)VirtualAlloc(NULL,
+                                   (SIZE_T)QueueDepth * BufferSize,
+                                   MEM_COMMIT,
+                                   PAGE_READWRITE);
+    if (Buffers == NULL) {
+        fprintf(stderr, "VirtualAlloc failed, error %d\n", GetLastError());
+        exit(1);
+    }
+    for (i = 0; i < QueueDepth; i++) {
+        CopyChunk[i].Buffer = Buffers + (SIZE_T)i * BufferSize;
+        IdleChunk[IdleCount++] = &CopyChunk[i];
+    }
+
+    Workers = (HANDLE *)HeapAlloc(GetProcessHeap(), 0, WorkerCount * sizeof(HANDLE));
+    if (Workers == NULL) {
+        fprintf(stderr, "HeapAlloc failed\n");
+        exit(1);
+    }
+    for (i = 0; i < WorkerCount; i++) {
+        Workers[i] = CreateThread(NULL, 0, WorkerThread, NULL, 0, NULL);
+        if (Workers[i] == NULL) {
+            fprintf(stderr, "failed to create worker thread, error %d\n", GetLastError());
+            exit(1);
+        }
+    }
+    Thread = CreateThread(NULL, 0, CloseThread, NULL, 0, NULL);
+    if (Thread == NULL) {
+        fprintf(stderr, "failed to create close thread, error %d\n", GetLastError());
+        exit(1);
+    }
+
+    StartTime = GetTickCount();
+
+    //
+    // Walk the tree, opening and queueing files as we go. Once the walk
+    // is over, wake the close thread so it can tell when the last file
+    // has been closed.
+    //
+    CopyTree(argv[Arg], argv[Arg + 1]);
+
+    WalkDone = TRUE;
+    SetEvent(CloseEvent);
+    WaitForSingleObject(DoneEvent, INFINITE);
+
+    EndTime = GetTickCount();
+
+    for (i = 0; i < WorkerCount; i++) {
+        PostQueuedCompletionStatus(IoPort, 0, ExitKey, NULL);
+    }
+    WaitForMultipleObjects(WorkerCount, Workers, TRUE, INFINITE);
+    for (i = 0; i < WorkerCount; i++) {
+        CloseHandle(Workers[i]);
+    }
+    CloseHandle(Thread);
+    CloseHandle(IoPort);
+
+    Seconds = (EndTime == StartTime) ? 0.001 : (double)(EndTime - StartTime) / 1000.0;
+
+    printf("%d files, %I64u bytes copied in %.3f seconds\n",
+           FilesCopied,
+           BytesCopied,
+           Seconds);
+    printf("%.2f MB/sec, %.0f files/sec\n",
+           (LONGLONG)BytesCopied / (1024.0*1024.0) / Seconds,
+           FilesCopied / Seconds);
+    printf("depth %d x %dK, stripe %dK, %d files open ahead, %d threads\n",
+           QueueDepth,
+           BufferSize / 1024,
+           StripeSize / 1024,
+           OpenAhead,
+           WorkerCount);
+    if (FilesFailed) {
+        printf("%d files could not be opened\n", FilesFailed);
+    }
+    if (FilesAborted) {
+        printf("%d files failed during the copy\n", FilesAborted);
+    }
+
+    return((FilesFailed || FilesAborted) ? 1 : 0);
+}
+
+VOID
+CopyTree(
+    LPCSTR SourceDir,
+    LPCSTR DestDir
+    )
+{
+    WIN32_FIND_DATA FindData;
+    HANDLE Find;
+    char SourcePath[MAX_PATH];
+    char DestPath[MAX_PATH];
+
+    if (_snprintf_s(SourcePath, MAX_PATH, _TRUNCATE, "%s\\*", SourceDir) < 0) {
+        fprintf(stderr, "path too long: %s\n", SourceDir);
+        return;
+    }
+
+    Find = FindFirstFile(SourcePath, &FindData);
+    if (Find == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "failed to list %s, error %d\n", SourceDir, GetLastError());
+        return;
+    }
+
+    do {
+        if ((strcmp(FindData.cFileName, ".") == 0) ||
+            (strcmp(FindData.cFileName, "..") == 0)) {
+            continue;
+        }
+
+        if ((_snprintf_s(SourcePath, MAX_PATH, _TRUNCATE, "%s\\%s", SourceDir, FindData.cFileName) < 0) ||
+            (_snprintf_s(DestPath, MAX_PATH, _TRUNCATE, "%s\\%s", DestDir, FindData.cFileName) < 0)) {
+            fprintf(stderr, "path too long: %s\\%s\n", SourceDir, FindData.cFileName);
+            FilesFailed++;
+            continue;
+        }
+
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            //
+            // Do not follow junctions; they can loop back into the tree.
+            //
+            if (FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+                continue;
+            }
+            if (!CreateDirectory(DestPath, NULL) && (GetLastError() != ERROR_ALREADY_EXISTS)) {
+                fprintf(stderr, "failed to create %s, error %d\n", DestPath, GetLastError());
+                continue;
+            }
+            CopyTree(SourcePath, DestPath);
+        } else {
+            //
+            // Wait for an open slot. The close thread hands slots back
+            // as files finish, so at most OpenAhead files are open.
+            //
+            WaitForSingleObject(OpenSlots, INFINITE);
+            OpenFileCopy(SourcePath, DestPath, &FindData);
+        }
+    } while (FindNextFile(Find, &FindData));
+
+    FindClose(Find);
+}
+
+VOID
+OpenFileCopy(
+    LPCSTR SourcePath,
+    LPCSTR DestPath,
+    WIN32_FIND_DATA *FindData
+    )
+{
+    PFILE_COPY File;
+    FILE_END_OF_FILE_INFO EndOfFile;
+
+    File = (PFILE_COPY)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FILE_COPY));
+    if (File == NULL) {
+        fprintf(stderr, "HeapAlloc failed\n");
+        exit(1);
+    }
+
+    //
+    // The size comes from the directory listing, which saves asking
+    // the file system for it again on every file.
+    //
+    File->FileSize.LowPart = FindData->nFileSizeLow;
+    File->FileSize.HighPart = FindData->nFileSizeHigh;
+    strcpy_s(File->SourcePath, MAX_PATH, SourcePath);
+
+    File->SourceFile = CreateFile(SourcePath,
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+                                  NULL);
+    if (File->SourceFile == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "failed to open %s, error %d\n", SourcePath, GetLastError());
+        goto Failed;
+    }
+
+    //
+    // DELETE lets the close thread remove a destination whose copy failed.
+    //
+    File->DestFile = CreateFile(DestPath,
+                                GENERIC_READ | GENERIC_WRITE | DELETE,
+                                0,
+                                NULL,
+                                CREATE_ALWAYS,
+                                FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+                                File->SourceFile);
+    if (File->DestFile == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "failed to open %s, error %d\n", DestPath, GetLastError());
+        CloseHandle(File->SourceFile);
+        goto Failed;
+    }
+
+    FilesOpened++;
+
+    //
+    // An empty file needs no I/O, it can go straight to the close thread.
+    //
+    if (File->FileSize.QuadPart == 0) {
+        File->StripesLeft = 1;
+        FinishFile(File);
+        return;
+    }
+
+    //
+    // Extend a striped destination so that the filesystem does not turn
+    // the asynchronous writes past its end into synchronous ones. A file
+    // of one stripe is written in order by a single chunk, so it is not
+    // worth the extra call.
+    //
+    if (File->FileSize.QuadPart > StripeSize) {
+        EndOfFile.EndOfFile.QuadPart = (File->FileSize.QuadPart + PageSize - 1) & ~((ULONGLONG)(PageSize-1));
+        if (!SetFileInformationByHandle(File->DestFile, FileEndOfFileInfo, &EndOfFile, sizeof(EndOfFile))) {
+            fprintf(stderr, "failed to extend %s, error %d\n", DestPath, GetLastError());
+            goto FailedOpen;
+        }
+    }
+
+    if ((CreateIoCompletionPort(File->SourceFile, IoPort, ReadKey, 0) == NULL) ||
+        (CreateIoCompletionPort(File->DestFile, IoPort, WriteKey, 0) == NULL)) {
+        fprintf(stderr, "failed to associate %s with IoPort, error %d\n", SourcePath, GetLastError());
+        goto FailedOpen;
+    }
+
+    File->StripesLeft = (LONG)((File->FileSize.QuadPart + StripeSize - 1) / StripeSize);
+    QueueFile(File);
+    return;
+
+FailedOpen:
+    FilesOpened--;
+    CloseHandle(File->SourceFile);
+    CloseHandle(File->DestFile);
+    DeleteFile(DestPath);
+
+Failed:
+    FilesFailed++;
+    HeapFree(GetProcessHeap(), 0, File);
+    ReleaseSemaphore(OpenSlots, 1, NULL);
+}
+
+VOID
+QueueFile(
+    PFILE_COPY File
+    )
+{
+    PCOPY_CHUNK Chunk;
+
+    EnterCriticalSection(&WorkLock);
+
+    if (ReadyTail != NULL) {
+        ReadyTail->Next = File;
+    } else {
+        ReadyHead = File;
+    }
+    ReadyTail = File;
+
+    //
+    // Start any idle chunks on the new work. The reads are issued from
+    // the worker threads so that the main thread can get on with
+    // opening the next file.
+    //
+    while ((IdleCount != 0) && (ReadyHead != NULL)) {
+        Chunk = IdleChunk[--IdleCount];
+        TakeStripe(Chunk);
+        PostQueuedCompletionStatus(IoPort, 0, KickKey, &Chunk->Overlapped);
+    }
+
+    LeaveCriticalSection(&WorkLock);
+}
+
+BOOL
+TakeStripe(
+    PCOPY_CHUNK Chunk
+    )
+{
+    PFILE_COPY File;
+
+    //
+    // Called with WorkLock held. Hand out the next stripe of the file at
+    // the head of the ready list, and move on to the next file once
+    // this one has no stripes left.
+    //
+    File = ReadyHead;
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    Chunk->File = File;
+    Chunk->Offset = File->NextStripe;
+    Chunk->End = min(File->NextStripe + StripeSize, File->FileSize.QuadPart);
+
+    File->NextStripe += StripeSize;
+    if (File->NextStripe >= File->FileSize.QuadPart) {
+        ReadyHead = File->Next;
+        if (ReadyHead == NULL) {
+            ReadyTail = NULL;
+        }
+        File->Next = NULL;
+    }
+    return TRUE;
+}
+
+BOOL
+IssueRead(
+    PCOPY_CHUNK Chunk
+    )
+{
+    BOOL Success;
+    DWORD NumberBytes;
+    ULARGE_INTEGER Offset;
+
+    //
+    // Once one I/O of a file has failed there is no point reading the
+    // rest of it.
+    //
+    if (Chunk->File->Error != 0) {
+        return FALSE;
+    }
+
+    Offset.QuadPart = Chunk->Offset;
+    Chunk->Overlapped.Internal = 0;
+    Chunk->Overlapped.InternalHigh = 0;
+    Chunk->Overlapped.Offset = Offset.LowPart;
+    Chunk->Overlapped.OffsetHigh = Offset.HighPart;
+    Chunk->Overlapped.hEvent = NULL;     // not needed
+
+    Success = ReadFile(Chunk->File->SourceFile,
+                       Chunk->Buffer,
+                       BufferSize,
+                       &NumberBytes,
+                       &Chunk->Overlapped);
+
+    if (!Success && (GetLastError() != ERROR_IO_PENDING)) {
+        InterlockedCompareExchange(&Chunk->File->Error, GetLastError(), 0);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+VOID
+FailChunk(
+    PCOPY_CHUNK Chunk,
+    DWORD Error
+    )
+{
+    //
+    // An I/O of the chunk's file has failed. Keep the first error for
+    // the close thread to report, give up on the rest of the stripe and
+    // go on to other work.
+    //
+    InterlockedCompareExchange(&Chunk->File->Error, (LONG)Error, 0);
+    if (EndStripe(Chunk)) {
+        RunChunk(Chunk);
+    }
+}
+
+BOOL
+EndStripe(
+    PCOPY_CHUNK Chunk
+    )
+{
+    BOOL HaveWork;
+
+    //
+    // The chunk is done with its stripe, whether it was copied or not.
+    // Take the next stripe, or go idle if there is none.
+    //
+    FinishFile(Chunk->File);
+
+    EnterCriticalSection(&WorkLock);
+    HaveWork = TakeStripe(Chunk);
+    if (!HaveWork) {
+        IdleChunk[IdleCount++] = Chunk;
+    }
+    LeaveCriticalSection(&WorkLock);
+
+    return HaveWork;
+}
+
+VOID
+RunChunk(
+    PCOPY_CHUNK Chunk
+    )
+{
+    //
+    // Start the next read of the chunk. If the file has failed, skip the
+    // stripe and try the next one, until a read is started or the chunk
+    // goes idle.
+    //
+    while (!IssueRead(Chunk)) {
+        if (!EndStripe(Chunk)) {
+            return;
+        }
+    }
+}
+
+VOID
+FinishFile(
+    PFILE_COPY File
+    )
+{
+    //
+    // The chunk that finishes the last stripe of a file passes it on to
+    // the close thread.
+    //
+    if (InterlockedDecrement(&File->StripesLeft) != 0) {
+        return;
+    }
+
+    EnterCriticalSection(&CloseLock);
+    File->Next = CloseHead;
+    CloseHead = File;
+    LeaveCriticalSection(&CloseLock);
+
+    SetEvent(CloseEvent);
+}
+
+DWORD
+WINAPI
+WorkerThread(
+    LPVOID Parameter
+    )
+{
+    BOOL Success;
+    DWORD NumberBytes;
+    LPOVERLAPPED CompletedOverlapped;
+    DWORD_PTR Key;
+    PCOPY_CHUNK Chunk;
+    ULONGLONG Expected;
+
+    UNREFERENCED_PARAMETER(Parameter);
+
+    for (;;) {
+        Success = GetQueuedCompletionStatus(IoPort,
+                                            &NumberBytes,
+                                            &Key,
+                                            &CompletedOverlapped,
+                                            INFINITE);
+        if (!Success && (CompletedOverlapped == NULL)) {
+            //
+            // The function failed to dequeue a completion packet.
+            //
+            fprintf(stderr,
+                    "GetQueuedCompletionStatus on the IoPort failed, error %d\n",
+                    GetLastError());
+            exit(1);
+        }
+        if (!Success) {
+            //
+            // It dequeued the packet of a failed read or write. A read
+            // that starts past the end of a file that has got shorter
+            // since the tree was listed fails with ERROR_HANDLE_EOF.
+            //
+            FailChunk((PCOPY_CHUNK)CompletedOverlapped, GetLastError());
+            continue;
+        }
+
+        if (Key == ExitKey) {
+            return 0;
+        }
+
+        Chunk = (PCOPY_CHUNK)CompletedOverlapped;
+
+        if (Key == KickKey) {
+
+            //
+            // An idle chunk has been given a stripe, start reading it.
+            //
+            RunChunk(Chunk);
+
+        } else if (Key == ReadKey) {
+
+            //
+            // A read has completed, issue the corresponding write to the
+            // same offset of the destination. Anything less than the
+            // listed size left at this offset means the file has got
+            // shorter, and the copy of it would be wrong.
+            //
+            Expected = min((ULONGLONG)BufferSize, Chunk->File->FileSize.QuadPart - Chunk->Offset);
+            if (NumberBytes < Expected) {
+                FailChunk(Chunk, ERROR_HANDLE_EOF);
+                continue;
+            }
+
+            //
+            // Round the number of bytes to write up to a sector boundary.
+            //
+            NumberBytes = (NumberBytes + PageSize - 1) & ~(PageSize-1);
+
+            Success = WriteFile(Chunk->File->DestFile,
+                                Chunk->Buffer,
+                                NumberBytes,
+                                &NumberBytes,
+                                &Chunk->Overlapped);
+
+            if (!Success && (GetLastError() != ERROR_IO_PENDING)) {
+                FailChunk(Chunk, GetLastError());
+            }
+
+        } else if (Key == WriteKey) {
+
+            //
+            // A write has completed. Read the next piece of this stripe,
+            // or if the stripe is done, take the next one.
+            //
+            Chunk->Offset += BufferSize;
+            if ((Chunk->Offset < Chunk->End) || EndStripe(Chunk)) {
+                RunChunk(Chunk);
+            }
+        }
+    }
+}
+
+DWORD
+WINAPI
+CloseThread(
+    LPVOID Parameter
+    )
+{
+    PFILE_COPY Batch;
+    PFILE_COPY File;
+    FILE_END_OF_FILE_INFO EndOfFile;
+    FILE_DISPOSITION_INFO Disposition;
+    LONG Count;
+
+    UNREFERENCED_PARAMETER(Parameter);
+
+    for (;;) {
+        WaitForSingleObject(CloseEvent, INFINITE);
+
+        //
+        // Take every finished file at once and close them as a batch,
+        // handing their open slots back in one call.
+        //
+        EnterCriticalSection(&CloseLock);
+        Batch = CloseHead;
+        CloseHead = NULL;
+        LeaveCriticalSection(&CloseLock);
+
+        Count = 0;
+        while (Batch != NULL) {
+            File = Batch;
+            Batch = File->Next;
+
+            //
+            // Set the destination's file size to the size of the
+            // source file, in case the size of the source file was
+            // not a multiple of the page size. Unlike the single file
+            // samples this is done on the unbuffered handle, which
+            // saves opening every file a second time.
+            //
+            if (File->Error == 0) {
+                EndOfFile.EndOfFile.QuadPart = File->FileSize.QuadPart;
+                if (!SetFileInformationByHandle(File->DestFile, FileEndOfFileInfo, &EndOfFile, sizeof(EndOfFile))) {
+                    File->Error = GetLastError();
+                }
+            }
+
+            //
+            // A file that could not be copied is reported, and its
+            // destination is deleted when it is closed.
+            //
+            if (File->Error != 0) {
+                fprintf(stderr, "failed to copy %s, error %d%s\n",
+                        File->SourcePath,
+                        File->Error,
+                        (File->Error == ERROR_HANDLE_EOF) ? " (it got shorter during the copy)" : "");
+                Disposition.DeleteFile = TRUE;
+                SetFileInformationByHandle(File->DestFile, FileDispositionInfo, &Disposition, sizeof(Disposition));
+                FilesAborted++;
+            } else {
+                FilesCopied++;
+                BytesCopied += File->FileSize.QuadPart;
+            }
+            CloseHandle(File->SourceFile);
+            CloseHandle(File->DestFile);
+            HeapFree(GetProcessHeap(), 0, File);
+            Count++;
+        }
+        if (Count != 0) {
+            ReleaseSemaphore(OpenSlots, Count, NULL);
+        }
+
+        if (WalkDone && (FilesCopied + FilesAborted == FilesOpened)) {
+            SetEvent(DoneEvent);
+            return 0;
+        }
+    }
+}